@@ -85,14 +85,17 @@
 
 #define configCLINT_BASE_ADDRESS		MTIME_CTRL_ADDR
 #define configUSE_PREEMPTION			1
-#define configUSE_IDLE_HOOK				0
-#define configUSE_TICK_HOOK				0
 #define configCPU_CLOCK_HZ				( MTIME_RATE_HZ ) 
 #define configTICK_RATE_HZ				( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES			( 7 )
 #define configMINIMAL_STACK_SIZE		( ( size_t ) 128 + PORT_CONTEXT_lastIDX )
 #define configAPPLICATION_ALLOCATED_HEAP 0
 #define configTOTAL_HEAP_SIZE          ( ( size_t ) 8192 )
+#define configSUPPORT_STATIC_ALLOCATION	1
+#define configSUPPORT_DYNAMIC_ALLOCATION	1
+/* RAM the statically allocated objects of the application may reserve,
+checked at compile time by rtos.hpp. */
+#define configSTATIC_RAM_BUDGET			( ( size_t ) 8192 )
 #define configMAX_TASK_NAME_LEN			( 16 )
 #define configUSE_TRACE_FACILITY		1
 #define configUSE_16_BIT_TICKS			0
@@ -118,6 +121,157 @@
 /* Minimal value for configTIMER_TASK_STACK_DEPTH is 80 + PORT_CONTEXT_lastIDX  to avoid stack overflow */
 #define configTIMER_TASK_STACK_DEPTH	( 100 + PORT_CONTEXT_lastIDX )
 
+/* Timer wheel definitions (timer_wheel.c).  An O(1) alternative to the
+software timers for applications running many timeouts at once. */
+#define configUSE_TIMER_WHEEL			0
+#define configTIMER_WHEEL_TASK_PRIORITY	( configMAX_PRIORITIES - 1 )
+#define configTIMER_WHEEL_TASK_STACK_DEPTH	( 100 + PORT_CONTEXT_lastIDX )
+
+/* LED pattern engine (led_pattern.c).  Drives all the LEDs from one software
+timer instead of one task per LED.  The LEDs of the supported boards are lit
+when the pin is low. */
+#define configUSE_LED_PATTERN			0
+#define configLED_PATTERN_MAX_LEDS		( 3 )
+#define configLED_PATTERN_ACTIVE_LOW	1
+
+/* Stackless lightweight tasks (lwtask.c).  Runs many cooperative activities
+on the stack of a single scheduler task. */
+#define configUSE_LWTASK				0
+#define configLWTASK_SCHEDULER_PRIORITY	( tskIDLE_PRIORITY + 1 )
+#define configLWTASK_SCHEDULER_STACK_DEPTH	( configMINIMAL_STACK_SIZE )
+
+/* Immediate priority ceiling mutexes (ceiling_mutex.c).  Bounded blocking
+without priority inheritance, for the hard real time paths. */
+#define configUSE_CEILING_MUTEX			0
+
+/* Reader-writer lock with writer preference (rw_lock.c), for read mostly
+data shared between tasks.  seqlock.h needs no option. */
+#define configUSE_RW_LOCK				0
+
+/* Size of the L1 cache lines, used to keep data written by different harts
+on separate lines. */
+#define configCACHE_LINE_SIZE			( 64 )
+
+/* Telemetry blocks (telemetry.c).  Counters published through seqlocks,
+readable from any hart or interrupt.  The blocks are written to the UART every
+configTELEMETRY_DUMP_PERIOD_MS, or never if 0. */
+#define configUSE_TELEMETRY				0
+#define configTELEMETRY_MAX_FIELDS		( 24 )
+#define configTELEMETRY_SNAPSHOT_RETRIES	( 8 )
+#define configTELEMETRY_DUMP_PERIOD_MS	( 10000 )
+
+/* Secondary hart work loop (hart_launch.c).  The other harts wait for
+functions posted from hart 0 instead of sleeping forever. */
+#define configUSE_HART_LAUNCH			0
+
+/* Lock-free fixed block pools (block_pool.c), usable from tasks, interrupts
+and the other harts. */
+#define configUSE_BLOCK_POOL			0
+
+/* Critical section profiler (critical_profiler.c).  Build with
+"make CRITICAL_PROFILER=1", which also has the linker wrap the kernel
+functions it times.  Needs configUSE_TELEMETRY. */
+#ifndef configUSE_CRITICAL_PROFILER
+	#define configUSE_CRITICAL_PROFILER	0
+#endif
+
+/* Idle sleep (idle_sleep.c).  The idle task and the waiting secondary harts
+sleep in wfi, and account their time asleep per hart.  Needs
+configUSE_TELEMETRY. */
+#define configUSE_IDLE_SLEEP			0
+
+/* Preemption threshold (preempt_threshold.c).  Once running, a task with a
+threshold can only be preempted by the tasks above its threshold.  Uses one
+thread local storage pointer per task.  Turns time slicing off, which would
+let a task woken at the threshold itself preempt the raised task at the next
+tick. */
+#define configUSE_PREEMPT_THRESHOLD		0
+#define configUSE_TIME_SLICING			( !configUSE_PREEMPT_THRESHOLD )
+
+/* Per task execution budgets (task_budget.c), accounted at every context
+switch and enforced from the tick hook.  Uses one thread local storage
+pointer per task. */
+#define configUSE_TASK_BUDGET			0
+
+/* Mixed criticality modes (criticality.c).  A budget overrun of a high
+criticality task or a deadline miss degrades or suspends the low criticality
+tasks until configCRITICALITY_HOLD_MS go by without another. */
+#define configUSE_CRITICALITY			0
+#define configCRITICALITY_HOLD_MS		( 100 )
+
+/* Latency stamped queue messages (queue_stats.c): residency and wake
+latency histograms per registered queue.  Needs configUSE_TELEMETRY. */
+#define configUSE_QUEUE_STATS			0
+
+/* Depth, peak, items and blocking counts of every queue (queue_monitor.c),
+from the kernel trace macros.  Queues get one of configQUEUE_REGISTRY_SIZE
+slots.  Needs configUSE_TELEMETRY. */
+#define configUSE_QUEUE_MONITOR			0
+
+/* Producer side flow control (flow_control.c): block, drop newest, drop
+oldest or coalesce on a full queue, and optional credits.  The demo send task
+drops the oldest message instead of asserting. */
+#define configUSE_FLOW_CONTROL			0
+
+/* Priority ordered message queue (prio_queue.c), a binary heap in static
+storage with the blocking API of the kernel queues. */
+#define configUSE_PRIO_QUEUE			0
+
+/* Publish/subscribe event bus (event_bus.c): reference counted payloads
+fanned out without copy to queue or task notification subscribers.  Needs
+configUSE_BLOCK_POOL. */
+#define configUSE_EVENT_BUS			0
+
+/* Dataflow pipelines (pipeline.c): stages in tasks of hart 0 or on the
+secondary harts, connected by lock-free bounded channels, with batching and
+backpressure.  The hart stages need configUSE_HART_LAUNCH. */
+#define configUSE_PIPELINE			0
+
+/* Work-stealing fork/join pool (work_steal.c) on the secondary harts, one
+Chase-Lev deque of configWORK_STEAL_DEQUE_SIZE jobs per hart, a power of two.
+Needs configUSE_HART_LAUNCH. */
+#define configUSE_WORK_STEAL			0
+#define configWORK_STEAL_DEQUE_SIZE		( 64 )
+
+/* memcpy, memset, CRC-32 and sums offloaded to the idle harts (block_ops.c),
+with a completion notification through the msip of hart 0.  Shorter buffers
+than configBLOCK_OPS_THRESHOLD bytes stay on the calling task, see
+xBlockOpsCalibrate().  Needs configUSE_HART_LAUNCH. */
+#define configUSE_BLOCK_OPS				0
+#define configBLOCK_OPS_THRESHOLD		( 4096 )
+
+/* Set to 1 to build the kernels of vec_kernels.c (memcpy, checksum, min/max,
+Q15 FIR), on the vector unit when the toolchain and the core have V, and the
+lazy switch of the vector registers of the tasks that enable it.  Each such
+task keeps 32 * configVECTOR_VLENB_MAX bytes of registers. */
+#define configUSE_VECTOR_KERNELS		0
+#define configVECTOR_VLENB_MAX			( 16 )
+
+/* Hart-local storage (hart_local.c): tp points at a cache line aligned block
+of each hart, with configHART_LOCAL_SLOTS pointers and
+configHART_LOCAL_COUNTERS counters. */
+#define configUSE_HART_LOCAL			0
+#define configHART_LOCAL_SLOTS			( 4 )
+#define configHART_LOCAL_COUNTERS		( 4 )
+
+/* The hart-local slot where idle_sleep.c keeps the sleep accounting of each
+hart, with configUSE_HART_LOCAL. */
+#define configIDLE_SLEEP_HART_LOCAL_SLOT	( configHART_LOCAL_SLOTS - 1 )
+
+/* Kernel hooks, only called when a module uses them. */
+#define configUSE_IDLE_HOOK				( configUSE_IDLE_SLEEP )
+#define configUSE_TICK_HOOK				( configUSE_CRITICAL_PROFILER | configUSE_TASK_BUDGET )
+
+/* Thread local storage pointers, one per module that uses them. */
+#define configPREEMPT_THRESHOLD_TLS_INDEX	0
+#define configTASK_BUDGET_TLS_INDEX		( configUSE_PREEMPT_THRESHOLD )
+#define configVECTOR_TLS_INDEX			( configUSE_PREEMPT_THRESHOLD + configUSE_TASK_BUDGET )
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS	( configUSE_PREEMPT_THRESHOLD + configUSE_TASK_BUDGET + configUSE_VECTOR_KERNELS )
+
+/* Set to 1 to run the benchmark of every enabled module (bench.c) and print
+the results on the UART. */
+#define configUSE_BENCHMARKS			0
+
 /* Task priorities.  Allow these to be overridden. */
 #ifndef uartPRIMARY_PRIORITY
 	#define uartPRIMARY_PRIORITY		( configMAX_PRIORITIES - 3 )
@@ -160,4 +314,9 @@ Like all task stack sizes, the value is the number of words, not bytes. */
 # endif
 #endif
 
+/* Trace macros of the application modules, for the C sources only. */
+#ifndef __ASSEMBLY__
+	#include "trace_hooks.h"
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,239 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "bench.h"
+#include "console.h"
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#if( configUSE_TIMER_WHEEL == 1 )
+	#include "timer_wheel.h"
+#endif
+
+#if( configUSE_LED_PATTERN == 1 )
+	#include "led_pattern.h"
+#endif
+
+#if( configUSE_LWTASK == 1 )
+	#include "lwtask.h"
+#endif
+
+#if( configUSE_CEILING_MUTEX == 1 )
+	#include "ceiling_mutex.h"
+#endif
+
+#if( configUSE_RW_LOCK == 1 )
+	#include "rw_lock.h"
+#endif
+
+#if( configUSE_TELEMETRY == 1 )
+	#include "telemetry.h"
+#endif
+
+#if( configUSE_BLOCK_POOL == 1 )
+	#include "block_pool.h"
+#endif
+
+#if( configUSE_CRITICAL_PROFILER == 1 )
+	#include "critical_profiler.h"
+#endif
+
+#if( configUSE_IDLE_SLEEP == 1 )
+	#include "idle_sleep.h"
+#endif
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+	#include "preempt_threshold.h"
+#endif
+
+#if( configUSE_TASK_BUDGET == 1 )
+	#include "task_budget.h"
+#endif
+
+#if( configUSE_CRITICALITY == 1 )
+	#include "criticality.h"
+#endif
+
+#if( configUSE_QUEUE_STATS == 1 )
+	#include "queue_stats.h"
+#endif
+
+#if( configUSE_QUEUE_MONITOR == 1 )
+	#include "queue_monitor.h"
+#endif
+
+#if( configUSE_FLOW_CONTROL == 1 )
+	#include "flow_control.h"
+#endif
+
+#if( configUSE_PRIO_QUEUE == 1 )
+	#include "prio_queue.h"
+#endif
+
+#if( configUSE_EVENT_BUS == 1 )
+	#include "event_bus.h"
+#endif
+
+#if( configUSE_PIPELINE == 1 )
+	#include "pipeline.h"
+#endif
+
+#if( configUSE_WORK_STEAL == 1 )
+	#include "work_steal.h"
+#endif
+
+#if( configUSE_BLOCK_OPS == 1 )
+	#include "block_ops.h"
+#endif
+
+#if( configUSE_VECTOR_KERNELS == 1 )
+	#include "vec_kernels.h"
+#endif
+
+#if( configUSE_HART_LOCAL == 1 )
+	#include "hart_local.h"
+#endif
+
+#if( configUSE_HART_LAUNCH == 1 )
+	#include "cache_layout.h"
+#endif
+
+/* The benchmarks run below every demo task so they only use spare time. */
+#define benchTASK_PRIORITY		( tskIDLE_PRIORITY + 1 )
+#define benchTASK_STACK_SIZE	( configMINIMAL_STACK_SIZE * 2 )
+
+/* Give the demo tasks and the other harts time to start before measuring. */
+#define benchSTART_DELAY_MS		pdMS_TO_TICKS( 2000 )
+
+static void prvBenchTask( void *pvParameters );
+
+/*-----------------------------------------------------------*/
+
+void vBenchStart( void )
+{
+	xTaskCreate( prvBenchTask, "Bench", benchTASK_STACK_SIZE, NULL, benchTASK_PRIORITY, NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vBenchReport( const char *pcName, uint32_t ulParameter, uint64_t ullCycles, uint32_t ulOperations )
+{
+	if( ulOperations == 0U )
+	{
+		ulOperations = 1U;
+	}
+
+	vConsoleWriteIndexedValue( "bench", pcName, ulParameter, ullCycles / ulOperations );
+}
+/*-----------------------------------------------------------*/
+
+static void prvBenchTask( void *pvParameters )
+{
+	/* Remove compiler warning about unused parameter. */
+	( void ) pvParameters;
+
+	vTaskDelay( benchSTART_DELAY_MS );
+
+	vConsoleWrite( "Benchmarks start (cycles per operation)\r\n" );
+
+#if( configUSE_TIMER_WHEEL == 1 )
+	vTimerWheelBenchmark();
+#endif
+
+#if( configUSE_LED_PATTERN == 1 )
+	vLedPatternBenchmark();
+#endif
+
+#if( configUSE_LWTASK == 1 )
+	vLwTaskBenchmark();
+#endif
+
+#if( configUSE_CEILING_MUTEX == 1 )
+	vCeilingMutexBenchmark();
+#endif
+
+#if( configUSE_RW_LOCK == 1 )
+	vRwLockBenchmark();
+#endif
+
+#if( configUSE_TELEMETRY == 1 )
+	vTelemetryBenchmark();
+#endif
+
+#if( configUSE_BLOCK_POOL == 1 )
+	vBlockPoolBenchmark();
+#endif
+
+#if( configUSE_CRITICAL_PROFILER == 1 )
+	vCriticalProfilerBenchmark();
+#endif
+
+#if( configUSE_IDLE_SLEEP == 1 )
+	vIdleSleepBenchmark();
+#endif
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+	vPreemptThresholdBenchmark();
+#endif
+
+#if( configUSE_TASK_BUDGET == 1 )
+	vTaskBudgetBenchmark();
+#endif
+
+#if( configUSE_CRITICALITY == 1 )
+	vCriticalityBenchmark();
+#endif
+
+#if( configUSE_QUEUE_STATS == 1 )
+	vQueueStatsBenchmark();
+#endif
+
+#if( configUSE_QUEUE_MONITOR == 1 )
+	vQueueMonitorBenchmark();
+#endif
+
+#if( configUSE_FLOW_CONTROL == 1 )
+	vFlowControlBenchmark();
+#endif
+
+#if( configUSE_PRIO_QUEUE == 1 )
+	vPrioQueueBenchmark();
+#endif
+
+#if( configUSE_EVENT_BUS == 1 )
+	vEventBusBenchmark();
+#endif
+
+#if( configUSE_PIPELINE == 1 )
+	vPipelineBenchmark();
+#endif
+
+#if( configUSE_WORK_STEAL == 1 )
+	vWorkStealBenchmark();
+#endif
+
+#if( configUSE_BLOCK_OPS == 1 )
+	vBlockOpsBenchmark();
+#endif
+
+#if( configUSE_VECTOR_KERNELS == 1 )
+	vVecKernelsBenchmark();
+#endif
+
+#if( configUSE_HART_LOCAL == 1 )
+	vHartLocalBenchmark();
+#endif
+
+#if( configUSE_HART_LAUNCH == 1 )
+	vCacheLayoutBenchmark();
+#endif
+
+	vConsoleWrite( "Benchmarks done\r\n" );
+
+	vTaskDelete( NULL );
+}
+
+#endif /* configUSE_BENCHMARKS */
@@ -0,0 +1,33 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * Benchmark runner.
+ *
+ * When configUSE_BENCHMARKS is 1, vBenchStart() creates one low priority task
+ * that runs the benchmark of every enabled module in turn, prints the results
+ * on the UART, then deletes itself.  Each module provides its own
+ * v<Module>Benchmark() function, compiled only when configUSE_BENCHMARKS is 1.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "timestamp.h"
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/* Creates the benchmark task.  Call from main() before the scheduler starts. */
+void vBenchStart( void );
+
+/* Prints "bench.<pcName>[<ulParameter>] = <cycles per operation>".
+ulParameter is the problem size of the run (number of timers, bytes, ...). */
+void vBenchReport( const char *pcName, uint32_t ulParameter, uint64_t ullCycles, uint32_t ulOperations );
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* BENCH_H */
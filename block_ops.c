@@ -0,0 +1,610 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "block_ops.h"
+#include "hart_launch.h"
+
+#include <metal/cpu.h>
+#include <metal/interrupt.h>
+
+#if( configUSE_BLOCK_OPS == 1 ) || ( configUSE_VECTOR_KERNELS == 1 )
+
+#define blockopsCRC32_POLYNOMIAL	( 0xEDB88320UL )
+
+static uint32_t ulCrcTable[ 256 ];
+static BaseType_t xCrcTableBuilt = pdFALSE;
+
+/*-----------------------------------------------------------*/
+
+void vBlockOpsCrc32Init( void )
+{
+uint32_t ulCrc;
+uint32_t ulByte;
+uint32_t ulBit;
+
+	if( xCrcTableBuilt != pdFALSE )
+	{
+		return;
+	}
+
+	for( ulByte = 0; ulByte < 256U; ulByte++ )
+	{
+		ulCrc = ulByte;
+
+		for( ulBit = 0; ulBit < 8U; ulBit++ )
+		{
+			ulCrc = ( ( ulCrc & 1U ) != 0U ) ? ( ( ulCrc >> 1 ) ^ blockopsCRC32_POLYNOMIAL ) : ( ulCrc >> 1 );
+		}
+
+		ulCrcTable[ ulByte ] = ulCrc;
+	}
+
+	xCrcTableBuilt = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulBlockOpsCrc32Update( uint32_t ulCrc, const void *pvData, size_t xLength )
+{
+const uint8_t *pucData = ( const uint8_t * ) pvData;
+
+	configASSERT( xCrcTableBuilt != pdFALSE );
+
+	ulCrc = ~ulCrc;
+
+	while( xLength-- > 0U )
+	{
+		ulCrc = ulCrcTable[ ( ulCrc ^ *pucData++ ) & 0xFFU ] ^ ( ulCrc >> 8 );
+	}
+
+	return ~ulCrc;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_BLOCK_OPS || configUSE_VECTOR_KERNELS */
+
+#if( configUSE_BLOCK_OPS == 1 )
+
+#ifndef configCLINT_BASE_ADDRESS
+	#error No CLINT Base Address defined
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* The msip register of hart 0, at the base of the CLINT, and the cause of the
+machine software interrupt. */
+#define blockopsMSIP_HART0		( ( volatile uint32_t * ) ( configCLINT_BASE_ADDRESS ) )
+#define blockopsMSIP_ID			( 3 )
+
+/* Chunks end on cache line boundaries of the destination, so that no two
+harts write the same line of it, and are not too small to be worth a hart. */
+#define blockopsMIN_CHUNK		( 4U * configCACHE_LINE_SIZE )
+
+#define blockopsCALIBRATE_MIN		( 256U )
+#define blockopsCALIBRATE_ROUNDS	( 4U )
+
+cachelayoutASSERT_ISOLATED( BlockOpsChunk_t );
+
+static size_t xThreshold = configBLOCK_OPS_THRESHOLD;
+
+/* Operations whose last chunk is done, pushed by the harts and taken by the
+msip handler. */
+static BlockOp_t *pxDone = NULL;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvChecksum( const uint8_t *pucData, size_t xLength )
+{
+uint32_t ulSum = 0;
+
+	while( xLength-- > 0U )
+	{
+		ulSum += *pucData++;
+	}
+
+	return ulSum;
+}
+/*-----------------------------------------------------------*/
+
+/* Multiplies the 32x32 matrix over GF(2) pulMatrix by ulVector. */
+static uint32_t prvGf2Times( const uint32_t *pulMatrix, uint32_t ulVector )
+{
+uint32_t ulSum = 0;
+
+	while( ulVector != 0U )
+	{
+		if( ( ulVector & 1U ) != 0U )
+		{
+			ulSum ^= *pulMatrix;
+		}
+
+		ulVector >>= 1;
+		pulMatrix++;
+	}
+
+	return ulSum;
+}
+
+static void prvGf2Square( uint32_t *pulSquare, const uint32_t *pulMatrix )
+{
+uint32_t ul;
+
+	for( ul = 0; ul < 32U; ul++ )
+	{
+		pulSquare[ ul ] = prvGf2Times( pulMatrix, pulMatrix[ ul ] );
+	}
+}
+
+uint32_t ulBlockOpsCrc32Combine( uint32_t ulCrc1, uint32_t ulCrc2, size_t xLength2 )
+{
+uint32_t ulEven[ 32 ];
+uint32_t ulOdd[ 32 ];
+uint32_t ulRow = 1;
+uint32_t ul;
+
+	if( xLength2 == 0U )
+	{
+		return ulCrc1;
+	}
+
+	/* The operator for one zero bit, then for two and four. */
+	ulOdd[ 0 ] = blockopsCRC32_POLYNOMIAL;
+
+	for( ul = 1; ul < 32U; ul++ )
+	{
+		ulOdd[ ul ] = ulRow;
+		ulRow <<= 1;
+	}
+
+	prvGf2Square( ulEven, ulOdd );
+	prvGf2Square( ulOdd, ulEven );
+
+	/* Appends xLength2 zero bytes to ulCrc1, squaring the operator for each
+	bit of the length. */
+	do
+	{
+		prvGf2Square( ulEven, ulOdd );
+
+		if( ( xLength2 & 1U ) != 0U )
+		{
+			ulCrc1 = prvGf2Times( ulEven, ulCrc1 );
+		}
+
+		xLength2 >>= 1;
+
+		if( xLength2 == 0U )
+		{
+			break;
+		}
+
+		prvGf2Square( ulOdd, ulEven );
+
+		if( ( xLength2 & 1U ) != 0U )
+		{
+			ulCrc1 = prvGf2Times( ulOdd, ulCrc1 );
+		}
+
+		xLength2 >>= 1;
+	} while( xLength2 != 0U );
+
+	return ulCrc1 ^ ulCrc2;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvRun( const BlockOp_t *pxOp, size_t xOffset, size_t xLength )
+{
+	switch( pxOp->eKind )
+	{
+		case blockopsMEMCPY:
+			memcpy( pxOp->pucDestination + xOffset, pxOp->pucSource + xOffset, xLength );
+			break;
+
+		case blockopsMEMSET:
+			memset( pxOp->pucDestination + xOffset, pxOp->ucValue, xLength );
+			break;
+
+		case blockopsCRC32:
+			return ulBlockOpsCrc32Update( 0, pxOp->pucSource + xOffset, xLength );
+
+		case blockopsCHECKSUM:
+			return prvChecksum( pxOp->pucSource + xOffset, xLength );
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+/* On a secondary hart: queues the operation for the msip handler and rings
+hart 0. */
+static void prvRingDoorbell( BlockOp_t *pxOp )
+{
+BlockOp_t *pxHead = __atomic_load_n( &pxDone, __ATOMIC_RELAXED );
+
+	/* Release: the results of the chunks are written before the operation
+	is published. */
+	do
+	{
+		pxOp->pxNextDone = pxHead;
+	} while( __atomic_compare_exchange_n( &pxDone, &pxHead, pxOp, pdTRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED ) == 0 );
+
+	/* The list must be visible before the interrupt. */
+	__asm__ volatile( "fence w, o" ::: "memory" );
+	*blockopsMSIP_HART0 = 1;
+}
+
+static void prvChunk( void *pvArgument )
+{
+BlockOpsChunk_t *pxChunk = ( BlockOpsChunk_t * ) pvArgument;
+BlockOp_t *pxOp = pxChunk->pxOp;
+
+	pxChunk->ulResult = prvRun( pxOp, pxChunk->xOffset, pxChunk->xLength );
+
+	/* The starting task holds a count until every chunk is launched, so the
+	chunks it runs itself never ring. */
+	if( __atomic_fetch_sub( &( pxOp->ulPending ), 1U, __ATOMIC_ACQ_REL ) == 1U )
+	{
+		prvRingDoorbell( pxOp );
+	}
+}
+
+/* The machine software interrupt of hart 0. */
+static void prvDoorbellHandler( int iId, void *pvData )
+{
+BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+BlockOp_t *pxOp;
+BlockOp_t *pxNext;
+TaskHandle_t xTask;
+
+	( void ) iId;
+	( void ) pvData;
+
+	/* Acknowledge before taking the list, so that a ring that comes after
+	raises the interrupt again. */
+	*blockopsMSIP_HART0 = 0;
+	__asm__ volatile( "fence o, rw" ::: "memory" );
+
+	pxOp = __atomic_exchange_n( &pxDone, NULL, __ATOMIC_ACQUIRE );
+
+	while( pxOp != NULL )
+	{
+		/* The task may reuse the operation as soon as it is complete. */
+		pxNext = pxOp->pxNextDone;
+		xTask = pxOp->xTask;
+		pxOp->ulComplete = 1;
+
+		vTaskNotifyGiveFromISR( xTask, &xHigherPriorityTaskWoken );
+
+		pxOp = pxNext;
+	}
+
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+/*-----------------------------------------------------------*/
+
+void vBlockOpsInit( void )
+{
+struct metal_cpu *pxCpu = metal_cpu_get( 0 );
+struct metal_interrupt *pxInterrupt;
+
+	vBlockOpsCrc32Init();
+
+	configASSERT( pxCpu != NULL );
+	pxInterrupt = metal_cpu_interrupt_controller( pxCpu );
+	configASSERT( pxInterrupt != NULL );
+
+	*blockopsMSIP_HART0 = 0;
+
+	if( metal_interrupt_register_handler( pxInterrupt, blockopsMSIP_ID, prvDoorbellHandler, NULL ) != 0 )
+	{
+		configASSERT( 0 );
+	}
+
+	( void ) metal_interrupt_enable( pxInterrupt, blockopsMSIP_ID );
+}
+/*-----------------------------------------------------------*/
+
+static void prvStart( BlockOp_t *pxOp, BlockOpsKind_t eKind, void *pvDestination, const void *pvSource, uint8_t ucValue,
+					  size_t xLength, size_t xMinLength )
+{
+uint32_t ulIdle = 0;
+uint32_t ulChunks = 0;
+uint32_t ulChunk;
+uint32_t ulHartId;
+size_t xChunkSize;
+size_t xHead;
+size_t xEnd;
+BaseType_t xLaunched;
+
+	pxOp->eKind = eKind;
+	pxOp->pucDestination = ( uint8_t * ) pvDestination;
+	pxOp->pucSource = ( const uint8_t * ) pvSource;
+	pxOp->ucValue = ucValue;
+	pxOp->xLength = xLength;
+	pxOp->xTask = xTaskGetCurrentTaskHandle();
+	pxOp->ulComplete = 0;
+
+	if( xLength >= xMinLength )
+	{
+		for( ulHartId = 1; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+		{
+			if( xHartLaunchIsIdle( ulHartId ) != pdFALSE )
+			{
+				ulIdle++;
+			}
+		}
+
+		ulChunks = ( uint32_t ) ( xLength / blockopsMIN_CHUNK );
+		ulChunks = ( ulIdle < ulChunks ) ? ulIdle : ulChunks;
+	}
+
+	if( ulChunks == 0U )
+	{
+		pxOp->ulChunks = 1;
+		pxOp->xChunks[ 0 ].xOffset = 0;
+		pxOp->xChunks[ 0 ].xLength = xLength;
+		pxOp->xChunks[ 0 ].ulResult = prvRun( pxOp, 0, xLength );
+		pxOp->ulComplete = 1;
+		return;
+	}
+
+	/* Whole cache lines, counted from the first line boundary of the
+	destination: the first chunk also takes the bytes before it, the last
+	what is left.  The CRC and the checksum write nothing, so they are cut
+	from their start.  xLength is at least blockopsMIN_CHUNK, so more than
+	xHead. */
+	xHead = ( size_t ) ( ( 0U - ( uintptr_t ) pxOp->pucDestination ) & ( configCACHE_LINE_SIZE - 1U ) );
+	xChunkSize = ( xLength + ulChunks - 1U ) / ulChunks;
+	xChunkSize = ( ( xChunkSize + configCACHE_LINE_SIZE - 1U ) / configCACHE_LINE_SIZE ) * configCACHE_LINE_SIZE;
+	ulChunks = ( uint32_t ) ( ( xLength - xHead + xChunkSize - 1U ) / xChunkSize );
+
+	pxOp->ulChunks = ulChunks;
+	pxOp->ulPending = ulChunks + 1U;
+
+	for( ulChunk = 0; ulChunk < ulChunks; ulChunk++ )
+	{
+		xEnd = xHead + ( ( ulChunk + 1U ) * xChunkSize );
+		pxOp->xChunks[ ulChunk ].pxOp = pxOp;
+		pxOp->xChunks[ ulChunk ].xOffset = ( ulChunk == 0U ) ? 0U : ( xHead + ( ulChunk * xChunkSize ) );
+		pxOp->xChunks[ ulChunk ].xLength = ( ( xEnd < xLength ) ? xEnd : xLength ) - pxOp->xChunks[ ulChunk ].xOffset;
+	}
+
+	/* xHartLaunch() publishes the chunk before the hart runs it. */
+	ulHartId = 1;
+
+	for( ulChunk = 0; ulChunk < ulChunks; ulChunk++ )
+	{
+		xLaunched = pdFALSE;
+
+		while( ( xLaunched == pdFALSE ) && ( ulHartId < __METAL_DT_MAX_HARTS ) )
+		{
+			xLaunched = xHartLaunch( ulHartId, prvChunk, &( pxOp->xChunks[ ulChunk ] ) );
+			ulHartId++;
+		}
+
+		/* A hart was taken since it was counted. */
+		if( xLaunched == pdFALSE )
+		{
+			prvChunk( &( pxOp->xChunks[ ulChunk ] ) );
+		}
+	}
+
+	/* The harts were all done already. */
+	if( __atomic_fetch_sub( &( pxOp->ulPending ), 1U, __ATOMIC_ACQ_REL ) == 1U )
+	{
+		pxOp->ulComplete = 1;
+	}
+}
+
+void vBlockOpsMemcpyStart( BlockOp_t *pxOp, void *pvDestination, const void *pvSource, size_t xLength )
+{
+	prvStart( pxOp, blockopsMEMCPY, pvDestination, pvSource, 0, xLength, xThreshold );
+}
+
+void vBlockOpsMemsetStart( BlockOp_t *pxOp, void *pvDestination, int iValue, size_t xLength )
+{
+	prvStart( pxOp, blockopsMEMSET, pvDestination, NULL, ( uint8_t ) iValue, xLength, xThreshold );
+}
+
+void vBlockOpsCrc32Start( BlockOp_t *pxOp, const void *pvData, size_t xLength )
+{
+	prvStart( pxOp, blockopsCRC32, NULL, pvData, 0, xLength, xThreshold );
+}
+
+void vBlockOpsChecksumStart( BlockOp_t *pxOp, const void *pvData, size_t xLength )
+{
+	prvStart( pxOp, blockopsCHECKSUM, NULL, pvData, 0, xLength, xThreshold );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xBlockOpsWait( BlockOp_t *pxOp, TickType_t xTicksToWait, uint32_t *pulResult )
+{
+uint32_t ulResult;
+uint32_t ulChunk;
+
+	/* The notifications of other operations of the task may wake it
+	first. */
+	while( pxOp->ulComplete == 0U )
+	{
+		if( ( ulTaskNotifyTake( pdTRUE, xTicksToWait ) == 0U ) && ( pxOp->ulComplete == 0U ) )
+		{
+			return pdFAIL;
+		}
+	}
+
+	ulResult = pxOp->xChunks[ 0 ].ulResult;
+
+	for( ulChunk = 1; ulChunk < pxOp->ulChunks; ulChunk++ )
+	{
+		if( pxOp->eKind == blockopsCRC32 )
+		{
+			ulResult = ulBlockOpsCrc32Combine( ulResult, pxOp->xChunks[ ulChunk ].ulResult, pxOp->xChunks[ ulChunk ].xLength );
+		}
+		else
+		{
+			ulResult += pxOp->xChunks[ ulChunk ].ulResult;
+		}
+	}
+
+	pxOp->ulResult = ulResult;
+
+	if( pulResult != NULL )
+	{
+		*pulResult = ulResult;
+	}
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+void vBlockOpsMemcpy( void *pvDestination, const void *pvSource, size_t xLength )
+{
+BlockOp_t xOp;
+
+	vBlockOpsMemcpyStart( &xOp, pvDestination, pvSource, xLength );
+	( void ) xBlockOpsWait( &xOp, portMAX_DELAY, NULL );
+}
+
+void vBlockOpsMemset( void *pvDestination, int iValue, size_t xLength )
+{
+BlockOp_t xOp;
+
+	vBlockOpsMemsetStart( &xOp, pvDestination, iValue, xLength );
+	( void ) xBlockOpsWait( &xOp, portMAX_DELAY, NULL );
+}
+
+uint32_t ulBlockOpsCrc32( const void *pvData, size_t xLength )
+{
+BlockOp_t xOp;
+uint32_t ulResult;
+
+	vBlockOpsCrc32Start( &xOp, pvData, xLength );
+	( void ) xBlockOpsWait( &xOp, portMAX_DELAY, &ulResult );
+
+	return ulResult;
+}
+
+uint32_t ulBlockOpsChecksum( const void *pvData, size_t xLength )
+{
+BlockOp_t xOp;
+uint32_t ulResult;
+
+	vBlockOpsChecksumStart( &xOp, pvData, xLength );
+	( void ) xBlockOpsWait( &xOp, portMAX_DELAY, &ulResult );
+
+	return ulResult;
+}
+/*-----------------------------------------------------------*/
+
+void vBlockOpsSetThreshold( size_t xNewThreshold )
+{
+	xThreshold = xNewThreshold;
+}
+
+size_t xBlockOpsGetThreshold( void )
+{
+	return xThreshold;
+}
+/*-----------------------------------------------------------*/
+
+/* Cycles of blockopsCALIBRATE_ROUNDS operations of xLength bytes, offloaded
+from xMinLength bytes. */
+static uint64_t prvTime( BlockOpsKind_t eKind, uint8_t *pucDestination, const uint8_t *pucSource, size_t xLength, size_t xMinLength )
+{
+BlockOp_t xOp;
+uint32_t ulRound;
+uint64_t ullStart = ullTimestampCycles();
+
+	for( ulRound = 0; ulRound < blockopsCALIBRATE_ROUNDS; ulRound++ )
+	{
+		prvStart( &xOp, eKind, pucDestination, pucSource, 0, xLength, xMinLength );
+		( void ) xBlockOpsWait( &xOp, portMAX_DELAY, NULL );
+	}
+
+	return ullTimestampCycles() - ullStart;
+}
+
+size_t xBlockOpsCalibrate( void *pvBuffer, size_t xBufferSize )
+{
+uint8_t *pucSource = ( uint8_t * ) pvBuffer;
+uint8_t *pucDestination = pucSource + ( xBufferSize / 2U );
+size_t xLength;
+uint32_t ulHartId;
+BaseType_t xIdle = pdFALSE;
+
+	/* Without a hart both runs stay on this task. */
+	for( ulHartId = 1; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+	{
+		if( xHartLaunchIsIdle( ulHartId ) != pdFALSE )
+		{
+			xIdle = pdTRUE;
+		}
+	}
+
+	if( xIdle == pdFALSE )
+	{
+		return 0;
+	}
+
+	for( xLength = blockopsCALIBRATE_MIN; xLength <= ( xBufferSize / 2U ); xLength *= 2U )
+	{
+		if( prvTime( blockopsMEMCPY, pucDestination, pucSource, xLength, 0 ) <
+			prvTime( blockopsMEMCPY, pucDestination, pucSource, xLength, SIZE_MAX ) )
+		{
+			xThreshold = xLength;
+			return xLength;
+		}
+	}
+
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * memcpy and CRC-32 of blockopsCALIBRATE_MIN to blockopsBENCH_SIZE bytes, on
+ * the benchmark task and offloaded to every idle hart, then the threshold
+ * picked by xBlockOpsCalibrate(), reported as the cycle count.
+ */
+#define blockopsBENCH_SIZE		( 16384U )
+
+static uint8_t ucBenchBuffer[ 2U * blockopsBENCH_SIZE ] cachelayoutALIGNED;
+
+void vBlockOpsBenchmark( void )
+{
+uint8_t *pucSource = ucBenchBuffer;
+uint8_t *pucDestination = ucBenchBuffer + blockopsBENCH_SIZE;
+size_t xLength;
+uint32_t ul;
+
+	for( ul = 0; ul < blockopsBENCH_SIZE; ul++ )
+	{
+		pucSource[ ul ] = ( uint8_t ) ( ul * 7U );
+	}
+
+	configASSERT( ulBlockOpsCrc32( pucSource, blockopsBENCH_SIZE ) == ulBlockOpsCrc32Update( 0, pucSource, blockopsBENCH_SIZE ) );
+
+	for( xLength = blockopsCALIBRATE_MIN; xLength <= blockopsBENCH_SIZE; xLength *= 2U )
+	{
+		vBenchReport( "block_ops.memcpy_local", xLength, prvTime( blockopsMEMCPY, pucDestination, pucSource, xLength, SIZE_MAX ), blockopsCALIBRATE_ROUNDS );
+		vBenchReport( "block_ops.memcpy_offload", xLength, prvTime( blockopsMEMCPY, pucDestination, pucSource, xLength, 0 ), blockopsCALIBRATE_ROUNDS );
+		vBenchReport( "block_ops.crc32_local", xLength, prvTime( blockopsCRC32, NULL, pucSource, xLength, SIZE_MAX ), blockopsCALIBRATE_ROUNDS );
+		vBenchReport( "block_ops.crc32_offload", xLength, prvTime( blockopsCRC32, NULL, pucSource, xLength, 0 ), blockopsCALIBRATE_ROUNDS );
+	}
+
+	vBenchReport( "block_ops.threshold", 0, xBlockOpsCalibrate( ucBenchBuffer, sizeof( ucBenchBuffer ) ), 1 );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_BLOCK_OPS */
@@ -0,0 +1,141 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef BLOCK_OPS_H
+#define BLOCK_OPS_H
+
+/*
+ * Block operations offloaded to the idle harts.
+ *
+ * memcpy, memset, CRC-32 and a byte sum of large buffers are split in
+ * chunks of whole cache lines, one per secondary hart idle in
+ * vHartLaunchSecondaryLoop(), so the tasks of hart 0 keep running meanwhile.
+ * The hart that finishes the last chunk rings hart 0 through its msip
+ * register, and the software interrupt notifies the task that started the
+ * operation.  The CRCs of the chunks are combined by the task when it waits
+ * (ulBlockOpsCrc32Combine()), the sums simply added.
+ *
+ * Buffers shorter than the threshold, or started while no hart is idle, are
+ * processed by the calling task at once: launching the harts and waking the
+ * task back costs more than the copy itself below a few KiB.
+ * xBlockOpsCalibrate() measures the crossover on the target and sets the
+ * threshold.
+ *
+ * An operation is started with v<Op>Start() then waited for with
+ * xBlockOpsWait(), which blocks on the notification of the task (as a
+ * counting semaphore, so the task must not use it for something else while an
+ * operation is in flight).  The plain calls do both.
+ *
+ *	BlockOp_t xOp;
+ *	uint32_t ulCrc;
+ *
+ *	vBlockOpsCrc32Start( &xOp, pucImage, xImageSize );
+ *	prvDoSomethingElse();
+ *	xBlockOpsWait( &xOp, portMAX_DELAY, &ulCrc );
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cache_layout.h"
+
+#include <metal/machine.h>
+
+#if( configUSE_BLOCK_OPS == 1 ) || ( configUSE_VECTOR_KERNELS == 1 )
+
+/* The table CRC-32 (zlib's crc32()) on the calling task, of which the chunks
+are made, also used by vec_kernels.c.  vBlockOpsCrc32Init() builds the table
+once: vBlockOpsInit() and vVecKernelsInit() call it. */
+void vBlockOpsCrc32Init( void );
+uint32_t ulBlockOpsCrc32Update( uint32_t ulCrc, const void *pvData, size_t xLength );
+
+#endif /* configUSE_BLOCK_OPS || configUSE_VECTOR_KERNELS */
+
+#if( configUSE_BLOCK_OPS == 1 )
+
+#if( configUSE_HART_LAUNCH != 1 )
+	#error The chunks run on the secondary harts, set configUSE_HART_LAUNCH to 1
+#endif
+
+typedef enum
+{
+	blockopsMEMCPY,
+	blockopsMEMSET,
+	blockopsCRC32,
+	blockopsCHECKSUM
+} BlockOpsKind_t;
+
+/* The part of an operation run by one hart, which writes its result: on lines
+of its own.  The members are private to block_ops.c. */
+typedef struct cachelayoutALIGNED xBLOCK_OPS_CHUNK
+{
+	struct xBLOCK_OP *pxOp;
+	size_t xOffset;
+	size_t xLength;
+	uint32_t ulResult;
+} BlockOpsChunk_t;
+
+/* The members are private to block_ops.c. */
+typedef struct xBLOCK_OP
+{
+	BlockOpsKind_t eKind;
+	uint8_t *pucDestination;
+	const uint8_t *pucSource;
+	size_t xLength;
+	uint8_t ucValue;
+	uint32_t ulChunks;
+	uint32_t ulResult;
+	TaskHandle_t xTask;
+	volatile uint32_t ulPending;	/* Chunks left, plus one while starting. */
+	volatile uint32_t ulComplete;	/* Set on hart 0 once the task is notified. */
+	struct xBLOCK_OP *pxNextDone;
+	BlockOpsChunk_t xChunks[ __METAL_DT_MAX_HARTS ];
+} BlockOp_t;
+
+/* Installs the msip handler of hart 0.  Call once from hart 0, after its
+interrupt controller is initialised. */
+void vBlockOpsInit( void );
+
+/* Start an operation from a task.  The buffers must stay valid, and
+untouched, until xBlockOpsWait() returns pdPASS. */
+void vBlockOpsMemcpyStart( BlockOp_t *pxOp, void *pvDestination, const void *pvSource, size_t xLength );
+void vBlockOpsMemsetStart( BlockOp_t *pxOp, void *pvDestination, int iValue, size_t xLength );
+void vBlockOpsCrc32Start( BlockOp_t *pxOp, const void *pvData, size_t xLength );
+void vBlockOpsChecksumStart( BlockOp_t *pxOp, const void *pvData, size_t xLength );
+
+/* Returns pdPASS once the operation is complete, with the CRC or the sum in
+*pulResult if not NULL, or pdFAIL if xTicksToWait expired first. */
+BaseType_t xBlockOpsWait( BlockOp_t *pxOp, TickType_t xTicksToWait, uint32_t *pulResult );
+
+/* Start and wait. */
+void vBlockOpsMemcpy( void *pvDestination, const void *pvSource, size_t xLength );
+void vBlockOpsMemset( void *pvDestination, int iValue, size_t xLength );
+uint32_t ulBlockOpsCrc32( const void *pvData, size_t xLength );
+uint32_t ulBlockOpsChecksum( const void *pvData, size_t xLength );
+
+/* The CRC-32 of the concatenation of two buffers, from their CRCs and the
+length of the second (zlib's crc32_combine()). */
+uint32_t ulBlockOpsCrc32Combine( uint32_t ulCrc1, uint32_t ulCrc2, size_t xLength2 );
+
+/* Buffers shorter than xThreshold bytes stay on the calling task.  The
+default is configBLOCK_OPS_THRESHOLD. */
+void vBlockOpsSetThreshold( size_t xThreshold );
+size_t xBlockOpsGetThreshold( void );
+
+/* Times memcpy on the calling task against offloaded, between the halves of
+pvBuffer, for sizes doubling from blockopsCALIBRATE_MIN bytes up to
+xBufferSize / 2.  Sets the threshold to the first size at which offloading
+wins and returns it, or leaves it unchanged and returns 0 if offloading never
+wins or no hart is idle. */
+size_t xBlockOpsCalibrate( void *pvBuffer, size_t xBufferSize );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vBlockOpsBenchmark( void );
+#endif
+
+#endif /* configUSE_BLOCK_OPS */
+
+#endif /* BLOCK_OPS_H */
@@ -0,0 +1,293 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "block_pool.h"
+
+#if( configUSE_BLOCK_POOL == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+	#include "cache_layout.h"
+	#include "hart_launch.h"
+
+	#include <metal/machine.h>
+#endif
+
+#define blockpoolINDEX_MASK		blockpoolMAX_BLOCKS
+#define blockpoolTAG_ONE		( ( uintptr_t ) 1U << blockpoolINDEX_BITS )
+
+#if( __riscv_xlen == 64 )
+	#define blockpoolLR		"lr.d.aq"
+	#define blockpoolSC		"sc.d.rl"
+#else
+	#define blockpoolLR		"lr.w.aq"
+	#define blockpoolSC		"sc.w.rl"
+#endif
+
+/*-----------------------------------------------------------*/
+
+/* Stores uxDesired in *puxTarget if it holds uxExpected.  Acquire on
+success, so the block taken can be read, and release, so that a block freed
+is written before it is published. */
+static inline BaseType_t prvCompareAndSwap( volatile uintptr_t *puxTarget, uintptr_t uxExpected, uintptr_t uxDesired )
+{
+uintptr_t uxPrevious;
+uintptr_t uxFailed;
+
+	__asm__ volatile(
+		"1:	" blockpoolLR "	%0, (%2)\n"
+		"	bne	%0, %3, 2f\n"
+		"	" blockpoolSC "	%1, %4, (%2)\n"
+		"	bnez	%1, 1b\n"
+		"2:\n"
+		: "=&r"( uxPrevious ), "=&r"( uxFailed )
+		: "r"( puxTarget ), "r"( uxExpected ), "r"( uxDesired )
+		: "memory" );
+
+	return ( uxPrevious == uxExpected ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+/* Blocks are numbered from 1 so that 0 marks the end of the list. */
+static inline volatile uintptr_t *prvBlock( const BlockPool_t *pxPool, uintptr_t uxIndex )
+{
+	return ( volatile uintptr_t * ) ( pxPool->pucStorage + ( ( uxIndex - 1U ) * pxPool->xBlockSize ) );
+}
+
+/* The next head: uxIndex on top, and the tag moved on. */
+static inline uintptr_t prvNextHead( uintptr_t uxHead, uintptr_t uxIndex )
+{
+	return ( ( uxHead & ~blockpoolINDEX_MASK ) + blockpoolTAG_ONE ) | uxIndex;
+}
+/*-----------------------------------------------------------*/
+
+void vBlockPoolInit( BlockPool_t *pxPool, void *pvStorage, size_t xBlockSize, uint32_t ulBlockCount )
+{
+uintptr_t uxIndex;
+
+	configASSERT( ulBlockCount > 0U );
+#if( blockpoolINDEX_BITS < 32U )
+	configASSERT( ulBlockCount <= blockpoolMAX_BLOCKS );
+#endif
+	configASSERT( ( ( uintptr_t ) pvStorage % blockpoolALIGNMENT ) == 0U );
+
+	pxPool->pucStorage = ( uint8_t * ) pvStorage;
+	pxPool->xBlockSize = blockpoolBLOCK_SIZE( xBlockSize );
+	pxPool->ulBlockCount = ulBlockCount;
+	pxPool->ulFailures = 0;
+
+	for( uxIndex = 1; uxIndex < ulBlockCount; uxIndex++ )
+	{
+		*prvBlock( pxPool, uxIndex ) = uxIndex + 1U;
+	}
+	*prvBlock( pxPool, ulBlockCount ) = 0;
+
+	__asm__ volatile( "fence rw, w" ::: "memory" );
+	pxPool->uxHead = 1;
+}
+/*-----------------------------------------------------------*/
+
+void *pvBlockPoolAlloc( BlockPool_t *pxPool )
+{
+uintptr_t uxHead;
+uintptr_t uxIndex;
+uintptr_t uxNext;
+
+	do
+	{
+		uxHead = pxPool->uxHead;
+		uxIndex = uxHead & blockpoolINDEX_MASK;
+
+		if( uxIndex == 0U )
+		{
+			__atomic_fetch_add( &( pxPool->ulFailures ), 1U, __ATOMIC_RELAXED );
+			return NULL;
+		}
+
+		/* The block may have been taken since the head was read, and this
+		value be garbage, but then the tag has changed and the swap fails. */
+		uxNext = *prvBlock( pxPool, uxIndex );
+	} while( prvCompareAndSwap( &( pxPool->uxHead ), uxHead, prvNextHead( uxHead, uxNext ) ) == pdFALSE );
+
+	return ( void * ) prvBlock( pxPool, uxIndex );
+}
+/*-----------------------------------------------------------*/
+
+void vBlockPoolFree( BlockPool_t *pxPool, void *pvBlock )
+{
+uintptr_t uxOffset = ( uintptr_t ) ( ( uint8_t * ) pvBlock - pxPool->pucStorage );
+uintptr_t uxIndex = ( uxOffset / pxPool->xBlockSize ) + 1U;
+uintptr_t uxHead;
+
+	configASSERT( ( ( uint8_t * ) pvBlock >= pxPool->pucStorage ) && ( uxIndex <= pxPool->ulBlockCount ) );
+	configASSERT( ( uxOffset % pxPool->xBlockSize ) == 0U );
+
+	do
+	{
+		uxHead = pxPool->uxHead;
+		*( volatile uintptr_t * ) pvBlock = uxHead & blockpoolINDEX_MASK;
+	} while( prvCompareAndSwap( &( pxPool->uxHead ), uxHead, prvNextHead( uxHead, uxIndex ) ) == pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulBlockPoolCountFree( BlockPool_t *pxPool )
+{
+uintptr_t uxIndex = pxPool->uxHead & blockpoolINDEX_MASK;
+uint32_t ulCount = 0;
+
+	while( ( uxIndex != 0U ) && ( ulCount <= pxPool->ulBlockCount ) )
+	{
+		ulCount++;
+		uxIndex = *prvBlock( pxPool, uxIndex );
+	}
+
+	return ulCount;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#define blockpoolBENCH_PAIRS			( 1000U )
+#define blockpoolBENCH_BLOCK_SIZE		( 32U )
+#define blockpoolBENCH_BLOCKS			( 64U )
+
+/* Stress test: every hart allocates a few blocks at a time, stamps them,
+checks the stamps and frees them.  A block handed to two owners at once
+shows as a wrong stamp, a block lost or duplicated as a wrong free count. */
+#define blockpoolSTRESS_ITERATIONS		( 20000U )
+#define blockpoolSTRESS_HELD			( 4U )
+
+/* Counted by each hart as it goes, so on a cache line of its own. */
+typedef struct cachelayoutALIGNED
+{
+	uint32_t ulHartId;
+	uint32_t ulAllocations;
+	uint32_t ulErrors;
+} StressWorker_t;
+
+static blockpoolSTORAGE( xBenchStorage, blockpoolBENCH_BLOCK_SIZE, blockpoolBENCH_BLOCKS );
+static BlockPool_t xBenchPool;
+
+static void prvStressWorker( void *pvArgument )
+{
+StressWorker_t *pxWorker = ( StressWorker_t * ) pvArgument;
+volatile uint32_t *pulHeld[ blockpoolSTRESS_HELD ];
+uint32_t ulIteration;
+uint32_t ulStamp;
+uint32_t ul;
+
+	for( ulIteration = 0; ulIteration < blockpoolSTRESS_ITERATIONS; ulIteration++ )
+	{
+		ulStamp = ( pxWorker->ulHartId << 24 ) | ( ulIteration & 0xFFFFFFU );
+
+		for( ul = 0; ul < blockpoolSTRESS_HELD; ul++ )
+		{
+			pulHeld[ ul ] = ( volatile uint32_t * ) pvBlockPoolAlloc( &xBenchPool );
+
+			if( pulHeld[ ul ] != NULL )
+			{
+				pxWorker->ulAllocations++;
+				pulHeld[ ul ][ 1 ] = ulStamp;
+				pulHeld[ ul ][ 2 ] = ~ulStamp;
+			}
+		}
+
+		for( ul = 0; ul < blockpoolSTRESS_HELD; ul++ )
+		{
+			if( pulHeld[ ul ] != NULL )
+			{
+				if( ( pulHeld[ ul ][ 1 ] != ulStamp ) || ( pulHeld[ ul ][ 2 ] != ~ulStamp ) )
+				{
+					pxWorker->ulErrors++;
+				}
+
+				vBlockPoolFree( &xBenchPool, ( void * ) pulHeld[ ul ] );
+			}
+		}
+	}
+}
+
+void vBlockPoolBenchmark( void )
+{
+static StressWorker_t xWorkers[ __METAL_DT_MAX_HARTS ];
+BaseType_t xLaunched[ __METAL_DT_MAX_HARTS ];
+void *pvBlock;
+uint32_t ulPair;
+uint32_t ulHart;
+uint32_t ulHarts = 1;
+uint32_t ulAllocations = 0;
+uint32_t ulErrors = 0;
+uint64_t ullStart;
+
+	vBlockPoolInit( &xBenchPool, xBenchStorage, blockpoolBENCH_BLOCK_SIZE, blockpoolBENCH_BLOCKS );
+
+	/* Uncontended allocation and free, against the kernel heap. */
+	ullStart = ullTimestampCycles();
+	for( ulPair = 0; ulPair < blockpoolBENCH_PAIRS; ulPair++ )
+	{
+		pvBlock = pvBlockPoolAlloc( &xBenchPool );
+		vBlockPoolFree( &xBenchPool, pvBlock );
+	}
+	vBenchReport( "block_pool.alloc_free", blockpoolBENCH_BLOCK_SIZE, ullTimestampCycles() - ullStart, blockpoolBENCH_PAIRS );
+
+	ullStart = ullTimestampCycles();
+	for( ulPair = 0; ulPair < blockpoolBENCH_PAIRS; ulPair++ )
+	{
+		pvBlock = pvPortMalloc( blockpoolBENCH_BLOCK_SIZE );
+		vPortFree( pvBlock );
+	}
+	vBenchReport( "heap.alloc_free", blockpoolBENCH_BLOCK_SIZE, ullTimestampCycles() - ullStart, blockpoolBENCH_PAIRS );
+
+	/* Stress test on every hart. */
+	for( ulHart = 0; ulHart < __METAL_DT_MAX_HARTS; ulHart++ )
+	{
+		xWorkers[ ulHart ].ulHartId = ulHart;
+		xWorkers[ ulHart ].ulAllocations = 0;
+		xWorkers[ ulHart ].ulErrors = 0;
+		xLaunched[ ulHart ] = pdFALSE;
+	}
+
+	ullStart = ullTimestampCycles();
+
+#if( configUSE_HART_LAUNCH == 1 )
+	for( ulHart = 1; ulHart < __METAL_DT_MAX_HARTS; ulHart++ )
+	{
+		xLaunched[ ulHart ] = xHartLaunch( ulHart, prvStressWorker, &( xWorkers[ ulHart ] ) );
+
+		if( xLaunched[ ulHart ] == pdPASS )
+		{
+			ulHarts++;
+		}
+	}
+#endif
+
+	prvStressWorker( &( xWorkers[ 0 ] ) );
+
+#if( configUSE_HART_LAUNCH == 1 )
+	for( ulHart = 1; ulHart < __METAL_DT_MAX_HARTS; ulHart++ )
+	{
+		while( ( xLaunched[ ulHart ] == pdPASS ) && ( xHartLaunchIsIdle( ulHart ) == pdFALSE ) )
+		{
+			vTaskDelay( 1 );
+		}
+	}
+#endif
+
+	for( ulHart = 0; ulHart < __METAL_DT_MAX_HARTS; ulHart++ )
+	{
+		ulAllocations += xWorkers[ ulHart ].ulAllocations;
+		ulErrors += xWorkers[ ulHart ].ulErrors;
+	}
+
+	vBenchReport( "block_pool.stress", ulHarts, ullTimestampCycles() - ullStart, ulAllocations );
+	vBenchReport( "block_pool.stress_errors", ulHarts, ulErrors, 1 );
+	vBenchReport( "block_pool.stress_lost", ulHarts, blockpoolBENCH_BLOCKS - ulBlockPoolCountFree( &xBenchPool ), 1 );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_BLOCK_POOL */
@@ -0,0 +1,80 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+/*
+ * Lock-free pool of fixed size blocks.
+ *
+ * The free blocks form a Treiber stack: each free block holds the index of
+ * the next one, and the head is swapped with an LR/SC compare and swap.  No
+ * lock, critical section or scheduler suspension is involved, so blocks can
+ * be allocated and freed from tasks, interrupts and the other harts, in a
+ * few instructions when there is no contention.
+ *
+ * The head packs the index of the top block with a tag that changes on
+ * every update, so that a compare and swap based on a stale read of the head
+ * fails even if the same block came back to the top meanwhile (the ABA
+ * problem).  The tag has 32 bits on RV64 and 16 bits on RV32, where a pool
+ * holds at most 65535 blocks.
+ *
+ * The LR/SC pair only wraps the compare and swap: reading the next index
+ * between them would not be a constrained LR/SC loop, which the ISA does not
+ * guarantee to make progress.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#if( configUSE_BLOCK_POOL == 1 )
+
+#if( __riscv_xlen == 64 )
+	#define blockpoolINDEX_BITS		( 32U )
+#else
+	#define blockpoolINDEX_BITS		( 16U )
+#endif
+
+#define blockpoolMAX_BLOCKS		( ( ( uintptr_t ) 1U << blockpoolINDEX_BITS ) - 1U )
+
+/* Blocks are rounded up to a multiple of this, which is also their
+alignment. */
+#define blockpoolALIGNMENT		( sizeof( uintptr_t ) )
+#define blockpoolBLOCK_SIZE( xSize )	\
+	( ( ( ( size_t ) ( xSize ) + blockpoolALIGNMENT - 1U ) / blockpoolALIGNMENT ) * blockpoolALIGNMENT )
+
+/* Declares the storage of ulCount blocks of xSize bytes. */
+#define blockpoolSTORAGE( xName, xSize, ulCount )	\
+	uintptr_t xName[ ( blockpoolBLOCK_SIZE( xSize ) / blockpoolALIGNMENT ) * ( ulCount ) ]
+
+/* The members are private to block_pool.c. */
+typedef struct xBLOCK_POOL
+{
+	volatile uintptr_t uxHead;			/* Tag and index + 1 of the top free block, 0 if empty. */
+	uint8_t *pucStorage;
+	size_t xBlockSize;
+	uint32_t ulBlockCount;
+	volatile uint32_t ulFailures;		/* Allocations that found the pool empty. */
+} BlockPool_t;
+
+/* pvStorage holds ulBlockCount blocks of xBlockSize bytes, see
+blockpoolSTORAGE(). */
+void vBlockPoolInit( BlockPool_t *pxPool, void *pvStorage, size_t xBlockSize, uint32_t ulBlockCount );
+
+/* Both can be called from tasks, interrupts and any hart.  Returns NULL if
+the pool is empty. */
+void *pvBlockPoolAlloc( BlockPool_t *pxPool );
+void vBlockPoolFree( BlockPool_t *pxPool, void *pvBlock );
+
+/* Counts the free blocks.  Only exact when the pool is not in use. */
+uint32_t ulBlockPoolCountFree( BlockPool_t *pxPool );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vBlockPoolBenchmark( void );
+#endif
+
+#endif /* configUSE_BLOCK_POOL */
+
+#endif /* BLOCK_POOL_H */
@@ -0,0 +1,143 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cache_layout.h"
+#include "hart_launch.h"
+
+#if( configUSE_BENCHMARKS == 1 ) && ( configUSE_HART_LAUNCH == 1 )
+
+#include "bench.h"
+
+/*
+ * cachelayoutBENCH_ROUNDS increments of a counter by the benchmark task,
+ * while a secondary hart:
+ *
+ *	alone		does nothing
+ *	spun_line	reads a word of the same line in a loop, as a hart waiting
+ *				on a flag next to it
+ *	shared_line	increments a counter of the same line
+ *	own_line	increments a counter on a line of its own
+ *
+ * The difference between shared_line and own_line is the cost of the line
+ * moving between the harts at every write.  Needs an idle secondary hart,
+ * otherwise only alone is reported.
+ */
+#define cachelayoutBENCH_ROUNDS		( 10000U )
+
+typedef struct
+{
+	volatile uintptr_t uxHart0;
+	volatile uintptr_t uxNeighbour;
+} SharedCounters_t;
+
+static cachelayoutLINE( SharedCounters_t ) xShared;
+static cachelayoutLINE( volatile uintptr_t ) xHart0Counter;
+static cachelayoutLINE( volatile uintptr_t ) xNeighbourCounter;
+static cachelayoutLINE( volatile uint32_t ) xStop;
+static cachelayoutLINE( volatile uint32_t ) xStarted;
+
+/*-----------------------------------------------------------*/
+
+static void prvReadNeighbour( void *pvArgument )
+{
+volatile uintptr_t *puxCounter = ( volatile uintptr_t * ) pvArgument;
+
+	xStarted.xValue = 1;
+
+	while( xStop.xValue == 0U )
+	{
+		( void ) *puxCounter;
+	}
+}
+
+static void prvWriteNeighbour( void *pvArgument )
+{
+volatile uintptr_t *puxCounter = ( volatile uintptr_t * ) pvArgument;
+
+	xStarted.xValue = 1;
+
+	while( xStop.xValue == 0U )
+	{
+		*puxCounter = *puxCounter + 1U;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvTimeCounter( volatile uintptr_t *puxCounter )
+{
+uint64_t ullStart = ullTimestampCycles();
+uint32_t ulRound;
+
+	for( ulRound = 0; ulRound < cachelayoutBENCH_ROUNDS; ulRound++ )
+	{
+		*puxCounter = *puxCounter + 1U;
+	}
+
+	return ullTimestampCycles() - ullStart;
+}
+
+/* Times *puxCounter with pxNeighbour( puxNeighbour ) running on ulHartId. */
+static void prvRun( const char *pcName, uint32_t ulHartId, HartFunction_t pxNeighbour,
+					volatile uintptr_t *puxNeighbour, volatile uintptr_t *puxCounter )
+{
+uint64_t ullCycles;
+
+	/* Published by xHartLaunch(). */
+	xStop.xValue = 0;
+	xStarted.xValue = 0;
+
+	if( xHartLaunch( ulHartId, pxNeighbour, ( void * ) puxNeighbour ) == pdFAIL )
+	{
+		return;
+	}
+
+	while( xStarted.xValue == 0U )
+	{
+		/* The worker is on its way. */
+	}
+
+	ullCycles = prvTimeCounter( puxCounter );
+
+	xStop.xValue = 1;
+	__asm__ volatile( "fence rw, w" ::: "memory" );
+
+	while( xHartLaunchIsIdle( ulHartId ) == pdFALSE )
+	{
+		vTaskDelay( 1 );
+	}
+
+	vBenchReport( pcName, 0, ullCycles, cachelayoutBENCH_ROUNDS );
+}
+
+void vCacheLayoutBenchmark( void )
+{
+uint32_t ulHartId;
+
+	cachelayoutASSERT_ISOLATED( __typeof__( xShared ) );
+	cachelayoutASSERT_ISOLATED( __typeof__( xHart0Counter ) );
+
+	vBenchReport( "cache_layout.alone", 0, prvTimeCounter( &( xHart0Counter.xValue ) ), cachelayoutBENCH_ROUNDS );
+
+	for( ulHartId = 1; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+	{
+		if( xHartLaunchIsIdle( ulHartId ) != pdFALSE )
+		{
+			break;
+		}
+	}
+
+	if( ulHartId == __METAL_DT_MAX_HARTS )
+	{
+		return;
+	}
+
+	prvRun( "cache_layout.spun_line", ulHartId, prvReadNeighbour, &( xShared.xValue.uxNeighbour ), &( xShared.xValue.uxHart0 ) );
+	prvRun( "cache_layout.shared_line", ulHartId, prvWriteNeighbour, &( xShared.xValue.uxNeighbour ), &( xShared.xValue.uxHart0 ) );
+	prvRun( "cache_layout.own_line", ulHartId, prvWriteNeighbour, &( xNeighbourCounter.xValue ), &( xHart0Counter.xValue ) );
+}
+
+#endif /* configUSE_BENCHMARKS */
@@ -0,0 +1,64 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef CACHE_LAYOUT_H
+#define CACHE_LAYOUT_H
+
+/*
+ * Layout of the data shared between harts.
+ *
+ * A hart that writes a cache line takes it from the caches of the other
+ * harts, so two variables written by different harts, or one spun on and one
+ * written, must not share a line: every write of one then costs a miss to
+ * the harts using the other, although they never touch the same bytes.
+ *
+ * The data written across harts therefore goes on lines of its own:
+ *
+ *	cachelayoutALIGNED			on a type whose instances are written by one
+ *								hart each (a mailbox, one end of a channel):
+ *								each starts a line and is padded to whole lines
+ *	cachelayoutLINE( xType )	a type holding one xType, read and written as
+ *								.xValue, for a plain shared variable
+ *	cachelayoutPER_HART()		an array of one such line per hart, indexed
+ *								by hart id
+ *
+ * Read-only data needs no care once written.  cachelayoutASSERT_ISOLATED()
+ * checks a type at build time.  vCacheLayoutBenchmark() measures a counter
+ * that shares its line with the counter of another hart against one on its
+ * own line.
+ *
+ *	static cachelayoutLINE( volatile uint32_t ) xStop;
+ *	static cachelayoutPER_HART( uint64_t, xPackets );
+ *
+ *	xPackets[ ulHartId ].xValue++;
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include <metal/machine.h>
+
+#define cachelayoutALIGNED		__attribute__( ( aligned( configCACHE_LINE_SIZE ) ) )
+
+#define cachelayoutLINE( xType )	\
+	struct cachelayoutALIGNED		\
+	{								\
+		xType xValue;				\
+	}
+
+#define cachelayoutPER_HART( xType, xName )	\
+	cachelayoutLINE( xType ) xName[ __METAL_DT_MAX_HARTS ]
+
+/* Fails the build unless the instances of xType start and end on line
+boundaries, in arrays too. */
+#define cachelayoutASSERT_ISOLATED( xType )											\
+	_Static_assert( ( ( _Alignof( xType ) % configCACHE_LINE_SIZE ) == 0 ) &&		\
+					( ( sizeof( xType ) % configCACHE_LINE_SIZE ) == 0 ),			\
+					#xType " shares cache lines" )
+
+#if( configUSE_BENCHMARKS == 1 ) && ( configUSE_HART_LAUNCH == 1 )
+	void vCacheLayoutBenchmark( void );
+#endif
+
+#endif /* CACHE_LAYOUT_H */
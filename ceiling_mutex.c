@@ -0,0 +1,317 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ceiling_mutex.h"
+
+#if( configUSE_CEILING_MUTEX == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "semphr.h"
+	#include "bench.h"
+#endif
+
+/* The mutexes taken and not given yet, by any task, most recent first. */
+static CeilingMutex_t *pxHeldMutexes = NULL;
+
+/*-----------------------------------------------------------*/
+
+void vCeilingMutexInit( CeilingMutex_t *pxMutex, UBaseType_t uxCeiling )
+{
+	configASSERT( uxCeiling < configMAX_PRIORITIES );
+
+	pxMutex->xOwner = NULL;
+	pxMutex->uxCeiling = uxCeiling;
+	pxMutex->uxSavedPriority = 0;
+	pxMutex->pxNextHeld = NULL;
+}
+/*-----------------------------------------------------------*/
+
+void vCeilingMutexTake( CeilingMutex_t *pxMutex )
+{
+TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+UBaseType_t uxPriority = uxTaskPriorityGet( NULL );
+UBaseType_t uxBasePriority = uxPriority;
+CeilingMutex_t *pxHeld;
+
+	taskENTER_CRITICAL();
+	{
+		/* The priority saved by the outermost mutex of the task is the
+		lowest of those it saved. */
+		for( pxHeld = pxHeldMutexes; pxHeld != NULL; pxHeld = pxHeld->pxNextHeld )
+		{
+			if( ( pxHeld->xOwner == xTask ) && ( pxHeld->uxSavedPriority < uxBasePriority ) )
+			{
+				uxBasePriority = pxHeld->uxSavedPriority;
+			}
+		}
+
+		/* A task above the ceiling, or a mutex found taken, means that the
+		ceiling is below the priority of one of the users. */
+		configASSERT( uxBasePriority <= pxMutex->uxCeiling );
+		configASSERT( pxMutex->xOwner == NULL );
+
+		pxMutex->uxSavedPriority = uxPriority;
+		pxMutex->xOwner = xTask;
+		pxMutex->pxNextHeld = pxHeldMutexes;
+		pxHeldMutexes = pxMutex;
+
+		/* Raising the priority of the running task never causes a switch.
+		A task already above the ceiling, through an outer mutex, stays
+		there. */
+		if( uxPriority < pxMutex->uxCeiling )
+		{
+			vTaskPrioritySet( NULL, pxMutex->uxCeiling );
+		}
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vCeilingMutexGive( CeilingMutex_t *pxMutex )
+{
+UBaseType_t uxPriority = pxMutex->uxSavedPriority;
+CeilingMutex_t **ppxLink;
+
+	configASSERT( pxMutex->xOwner == xTaskGetCurrentTaskHandle() );
+
+	taskENTER_CRITICAL();
+	{
+		for( ppxLink = &pxHeldMutexes; *ppxLink != pxMutex; ppxLink = &( ( *ppxLink )->pxNextHeld ) )
+		{
+		}
+
+		*ppxLink = pxMutex->pxNextHeld;
+		pxMutex->pxNextHeld = NULL;
+		pxMutex->xOwner = NULL;
+	}
+	taskEXIT_CRITICAL();
+
+	if( uxTaskPriorityGet( NULL ) != uxPriority )
+	{
+		vTaskPrioritySet( NULL, uxPriority );
+	}
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Worst case blocking of a chain.  Relative to the benchmark task:
+ *  - Low (+1) takes A and holds it for ceilingmutexBENCH_HOLD_CYCLES;
+ *  - Mid (+2) takes B, then A;
+ *  - Hog (+3) does not use the mutexes but runs for ceilingmutexBENCH_HOG_CYCLES;
+ *  - High (+4) takes B.
+ * Low releases the others one by one while it holds A, and the time High
+ * waits for B after its release is measured.  With inheritance, Low only
+ * inherits the priority of Mid, so Hog preempts it and High waits for the
+ * rest of Low's section, Hog and Mid's section.  With the ceiling (+4 for
+ * both mutexes) the others cannot run before Low gives A back, and High only
+ * waits for the rest of Low's section.
+ */
+#define ceilingmutexBENCH_TAKES			( 1000U )
+#define ceilingmutexBENCH_ROUNDS		( 20U )
+#define ceilingmutexBENCH_HOLD_CYCLES	( 20000U )
+#define ceilingmutexBENCH_MID_CYCLES	( 5000U )
+#define ceilingmutexBENCH_HOG_CYCLES	( 50000U )
+
+enum
+{
+	ceilingmutexBENCH_LOW = 0,
+	ceilingmutexBENCH_MID,
+	ceilingmutexBENCH_HOG,
+	ceilingmutexBENCH_HIGH,
+	ceilingmutexBENCH_TASKS
+};
+
+static BaseType_t xBenchUseCeiling = pdFALSE;
+static SemaphoreHandle_t xBenchInheritA = NULL;
+static SemaphoreHandle_t xBenchInheritB = NULL;
+static CeilingMutex_t xBenchCeilingA;
+static CeilingMutex_t xBenchCeilingB;
+static TaskHandle_t xBenchTasks[ ceilingmutexBENCH_TASKS ];
+
+static uint64_t ullBenchHighRelease = 0;
+static uint64_t ullBenchWorstBlocking = 0;
+
+static void prvBenchTake( BaseType_t xMutexB )
+{
+	if( xBenchUseCeiling != pdFALSE )
+	{
+		vCeilingMutexTake( ( xMutexB != pdFALSE ) ? &xBenchCeilingB : &xBenchCeilingA );
+	}
+	else
+	{
+		xSemaphoreTake( ( xMutexB != pdFALSE ) ? xBenchInheritB : xBenchInheritA, portMAX_DELAY );
+	}
+}
+
+static void prvBenchGive( BaseType_t xMutexB )
+{
+	if( xBenchUseCeiling != pdFALSE )
+	{
+		vCeilingMutexGive( ( xMutexB != pdFALSE ) ? &xBenchCeilingB : &xBenchCeilingA );
+	}
+	else
+	{
+		xSemaphoreGive( ( xMutexB != pdFALSE ) ? xBenchInheritB : xBenchInheritA );
+	}
+}
+
+static void prvBenchSpin( uint32_t ulCycles )
+{
+uint64_t ullStart = ullTimestampCycles();
+
+	while( ( ullTimestampCycles() - ullStart ) < ulCycles )
+	{
+	}
+}
+
+static void prvBenchChainTask( void *pvParameters )
+{
+UBaseType_t uxRole = ( UBaseType_t ) ( uintptr_t ) pvParameters;
+uint64_t ullBlocking;
+
+	for( ;; )
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+		switch( uxRole )
+		{
+			case ceilingmutexBENCH_LOW:
+				prvBenchTake( pdFALSE );
+				prvBenchSpin( ceilingmutexBENCH_HOLD_CYCLES / 4U );
+				xTaskNotifyGive( xBenchTasks[ ceilingmutexBENCH_MID ] );
+				prvBenchSpin( ceilingmutexBENCH_HOLD_CYCLES / 4U );
+				ullBenchHighRelease = ullTimestampCycles();
+				xTaskNotifyGive( xBenchTasks[ ceilingmutexBENCH_HIGH ] );
+				prvBenchSpin( ceilingmutexBENCH_HOLD_CYCLES / 4U );
+				xTaskNotifyGive( xBenchTasks[ ceilingmutexBENCH_HOG ] );
+				prvBenchSpin( ceilingmutexBENCH_HOLD_CYCLES / 4U );
+				prvBenchGive( pdFALSE );
+				break;
+
+			case ceilingmutexBENCH_MID:
+				prvBenchTake( pdTRUE );
+				prvBenchTake( pdFALSE );
+				prvBenchSpin( ceilingmutexBENCH_MID_CYCLES );
+				prvBenchGive( pdFALSE );
+				prvBenchGive( pdTRUE );
+				break;
+
+			case ceilingmutexBENCH_HOG:
+				prvBenchSpin( ceilingmutexBENCH_HOG_CYCLES );
+				break;
+
+			default:
+				prvBenchTake( pdTRUE );
+				ullBlocking = ullTimestampCycles() - ullBenchHighRelease;
+				prvBenchGive( pdTRUE );
+
+				if( ullBlocking > ullBenchWorstBlocking )
+				{
+					ullBenchWorstBlocking = ullBlocking;
+				}
+				break;
+		}
+	}
+}
+
+static void prvBenchChain( const char *pcName, BaseType_t xUseCeiling )
+{
+uint32_t ulRound;
+
+	xBenchUseCeiling = xUseCeiling;
+	ullBenchWorstBlocking = 0;
+
+	/* Every task of the chain runs above this one, so a round is over when
+	this task runs again. */
+	for( ulRound = 0; ulRound < ceilingmutexBENCH_ROUNDS; ulRound++ )
+	{
+		xTaskNotifyGive( xBenchTasks[ ceilingmutexBENCH_LOW ] );
+	}
+
+	vBenchReport( pcName, ceilingmutexBENCH_TASKS, ullBenchWorstBlocking, 1 );
+}
+
+void vCeilingMutexBenchmark( void )
+{
+static const char * const pcNames[ ceilingmutexBENCH_TASKS ] = { "CmLow", "CmMid", "CmHog", "CmHigh" };
+UBaseType_t uxBase = uxTaskPriorityGet( NULL );
+UBaseType_t ux;
+uint32_t ulTake;
+CeilingMutex_t xLowCeiling;
+uint64_t ullStart;
+
+	configASSERT( ( uxBase + ceilingmutexBENCH_TASKS ) < configMAX_PRIORITIES );
+
+	xBenchInheritA = xSemaphoreCreateMutex();
+	xBenchInheritB = xSemaphoreCreateMutex();
+	configASSERT( ( xBenchInheritA != NULL ) && ( xBenchInheritB != NULL ) );
+	vCeilingMutexInit( &xBenchCeilingA, uxBase + ceilingmutexBENCH_TASKS );
+	vCeilingMutexInit( &xBenchCeilingB, uxBase + ceilingmutexBENCH_TASKS );
+
+	/* Uncontended take and give. */
+	ullStart = ullTimestampCycles();
+	for( ulTake = 0; ulTake < ceilingmutexBENCH_TAKES; ulTake++ )
+	{
+		xSemaphoreTake( xBenchInheritA, portMAX_DELAY );
+		xSemaphoreGive( xBenchInheritA );
+	}
+	vBenchReport( "inherit_mutex.take_give", 1, ullTimestampCycles() - ullStart, ceilingmutexBENCH_TAKES );
+
+	ullStart = ullTimestampCycles();
+	for( ulTake = 0; ulTake < ceilingmutexBENCH_TAKES; ulTake++ )
+	{
+		vCeilingMutexTake( &xBenchCeilingA );
+		vCeilingMutexGive( &xBenchCeilingA );
+	}
+	vBenchReport( "ceiling_mutex.take_give", 1, ullTimestampCycles() - ullStart, ceilingmutexBENCH_TAKES );
+
+	/* Nested, the inner mutex with the lower ceiling: the task stays at the
+	outer ceiling until it gives the outer mutex back. */
+	vCeilingMutexInit( &xLowCeiling, uxBase + 1U );
+	vCeilingMutexTake( &xBenchCeilingA );
+	vCeilingMutexTake( &xLowCeiling );
+	configASSERT( uxTaskPriorityGet( NULL ) == ( uxBase + ceilingmutexBENCH_TASKS ) );
+	vCeilingMutexGive( &xLowCeiling );
+	configASSERT( uxTaskPriorityGet( NULL ) == ( uxBase + ceilingmutexBENCH_TASKS ) );
+	vCeilingMutexGive( &xBenchCeilingA );
+	configASSERT( uxTaskPriorityGet( NULL ) == uxBase );
+
+	/* And the other way round. */
+	vCeilingMutexTake( &xLowCeiling );
+	vCeilingMutexTake( &xBenchCeilingA );
+	configASSERT( uxTaskPriorityGet( NULL ) == ( uxBase + ceilingmutexBENCH_TASKS ) );
+	vCeilingMutexGive( &xBenchCeilingA );
+	configASSERT( uxTaskPriorityGet( NULL ) == ( uxBase + 1U ) );
+	vCeilingMutexGive( &xLowCeiling );
+	configASSERT( uxTaskPriorityGet( NULL ) == uxBase );
+
+	/* Worst case blocking of the highest priority task of a chain. */
+	for( ux = 0; ux < ceilingmutexBENCH_TASKS; ux++ )
+	{
+		xBenchTasks[ ux ] = NULL;
+		xTaskCreate( prvBenchChainTask, pcNames[ ux ], configMINIMAL_STACK_SIZE, ( void * ) ( uintptr_t ) ux, uxBase + 1U + ux, &xBenchTasks[ ux ] );
+		configASSERT( xBenchTasks[ ux ] != NULL );
+	}
+
+	prvBenchChain( "inherit_mutex.blocking", pdFALSE );
+	prvBenchChain( "ceiling_mutex.blocking", pdTRUE );
+
+	for( ux = 0; ux < ceilingmutexBENCH_TASKS; ux++ )
+	{
+		vTaskDelete( xBenchTasks[ ux ] );
+		xBenchTasks[ ux ] = NULL;
+	}
+
+	vSemaphoreDelete( xBenchInheritA );
+	vSemaphoreDelete( xBenchInheritB );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_CEILING_MUTEX */
@@ -0,0 +1,64 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef CEILING_MUTEX_H
+#define CEILING_MUTEX_H
+
+/*
+ * Immediate priority ceiling mutex.
+ *
+ * The ceiling of a mutex is declared when it is created, and must be at
+ * least the priority of every task that takes it.  Taking the mutex raises
+ * the calling task to the ceiling straight away, so no other task that uses
+ * the mutex can run until it is given back: the mutex is never found taken,
+ * a take never blocks, and a task is delayed by at most one critical section
+ * of lower priority tasks, whatever the nesting of mutexes.  The kernel
+ * mutexes (configUSE_MUTEXES) use priority inheritance instead, which only
+ * raises the holder once a higher priority task blocks, does not follow a
+ * chain of holders, and moves the tasks between the kernel lists on every
+ * contended take.
+ *
+ * Rules of use:
+ *  - only tasks can use the mutexes, not interrupts;
+ *  - nested mutexes are given back in the reverse order of the takes;
+ *  - a task must not hold a kernel mutex while it takes a ceiling mutex, as
+ *    the priority it inherited would be restored as its base priority.
+ *
+ * A take that finds the mutex held, or a caller whose priority before its
+ * outermost take is above the ceiling, means the ceiling is wrong and fails
+ * configASSERT().  A task already raised above the ceiling of an inner mutex
+ * by an outer one keeps its priority until it gives the outer one back.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if( configUSE_CEILING_MUTEX == 1 )
+
+typedef struct xCEILING_MUTEX
+{
+	TaskHandle_t xOwner;
+	UBaseType_t uxCeiling;
+	UBaseType_t uxSavedPriority;	/* Priority of the owner before the take. */
+	struct xCEILING_MUTEX *pxNextHeld;
+} CeilingMutex_t;
+
+/* Static initialiser, the same as vCeilingMutexInit(). */
+#define ceilingmutexINIT( uxCeiling )	{ NULL, ( uxCeiling ), 0, NULL }
+
+void vCeilingMutexInit( CeilingMutex_t *pxMutex, UBaseType_t uxCeiling );
+
+/* Raises the calling task to the ceiling.  Never blocks. */
+void vCeilingMutexTake( CeilingMutex_t *pxMutex );
+
+/* Restores the priority the calling task had before the take, which can
+switch to a task that became ready meanwhile. */
+void vCeilingMutexGive( CeilingMutex_t *pxMutex );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vCeilingMutexBenchmark( void );
+#endif
+
+#endif /* configUSE_CEILING_MUTEX */
+
+#endif /* CEILING_MUTEX_H */
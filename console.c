@@ -0,0 +1,123 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Standard includes. */
+#include <string.h>
+#include <unistd.h>
+
+#include "console.h"
+
+/* Longest line produced by the helpers below, including the terminator. */
+#define consoleLINE_LENGTH		( 96 )
+
+/*-----------------------------------------------------------*/
+
+static size_t prvAppendString( char *pcLine, size_t uxPos, const char *pcString )
+{
+	while( ( *pcString != '\0' ) && ( uxPos < ( consoleLINE_LENGTH - 1 ) ) )
+	{
+		pcLine[ uxPos++ ] = *pcString++;
+	}
+
+	return uxPos;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvAppendUnsigned( char *pcLine, size_t uxPos, uint64_t ullValue )
+{
+char cDigits[ 20 ];
+size_t uxCount = 0;
+
+	do
+	{
+		cDigits[ uxCount++ ] = ( char ) ( '0' + ( ullValue % 10U ) );
+		ullValue /= 10U;
+	} while( ullValue != 0U );
+
+	while( ( uxCount > 0 ) && ( uxPos < ( consoleLINE_LENGTH - 1 ) ) )
+	{
+		pcLine[ uxPos++ ] = cDigits[ --uxCount ];
+	}
+
+	return uxPos;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvAppendName( char *pcLine, const char *pcPrefix, const char *pcName )
+{
+size_t uxPos = 0;
+
+	if( pcPrefix != NULL )
+	{
+		uxPos = prvAppendString( pcLine, uxPos, pcPrefix );
+		uxPos = prvAppendString( pcLine, uxPos, "." );
+	}
+
+	uxPos = prvAppendString( pcLine, uxPos, pcName );
+
+	return prvAppendString( pcLine, uxPos, " = " );
+}
+/*-----------------------------------------------------------*/
+
+void vConsoleWrite( const char *pcString )
+{
+	write( STDOUT_FILENO, pcString, strlen( pcString ) );
+}
+/*-----------------------------------------------------------*/
+
+void vConsoleWriteValue( const char *pcPrefix, const char *pcName, uint64_t ullValue )
+{
+char cLine[ consoleLINE_LENGTH ];
+size_t uxPos;
+
+	uxPos = prvAppendName( cLine, pcPrefix, pcName );
+	uxPos = prvAppendUnsigned( cLine, uxPos, ullValue );
+	uxPos = prvAppendString( cLine, uxPos, "\r\n" );
+
+	write( STDOUT_FILENO, cLine, uxPos );
+}
+/*-----------------------------------------------------------*/
+
+void vConsoleWriteIndexedValue( const char *pcPrefix, const char *pcName, uint32_t ulIndex, uint64_t ullValue )
+{
+char cLine[ consoleLINE_LENGTH ];
+size_t uxPos = 0;
+
+	if( pcPrefix != NULL )
+	{
+		uxPos = prvAppendString( cLine, uxPos, pcPrefix );
+		uxPos = prvAppendString( cLine, uxPos, "." );
+	}
+
+	uxPos = prvAppendString( cLine, uxPos, pcName );
+	uxPos = prvAppendString( cLine, uxPos, "[" );
+	uxPos = prvAppendUnsigned( cLine, uxPos, ulIndex );
+	uxPos = prvAppendString( cLine, uxPos, "] = " );
+	uxPos = prvAppendUnsigned( cLine, uxPos, ullValue );
+	uxPos = prvAppendString( cLine, uxPos, "\r\n" );
+
+	write( STDOUT_FILENO, cLine, uxPos );
+}
+/*-----------------------------------------------------------*/
+
+void vConsoleWriteRatio( const char *pcPrefix, const char *pcName, uint64_t ullValue, uint64_t ullTotal )
+{
+char cLine[ consoleLINE_LENGTH ];
+size_t uxPos;
+uint64_t ullPercent = 0;
+
+	if( ullTotal != 0U )
+	{
+		ullPercent = ( ullValue * 100U ) / ullTotal;
+	}
+
+	uxPos = prvAppendName( cLine, pcPrefix, pcName );
+	uxPos = prvAppendUnsigned( cLine, uxPos, ullValue );
+	uxPos = prvAppendString( cLine, uxPos, "/" );
+	uxPos = prvAppendUnsigned( cLine, uxPos, ullTotal );
+	uxPos = prvAppendString( cLine, uxPos, " (" );
+	uxPos = prvAppendUnsigned( cLine, uxPos, ullPercent );
+	uxPos = prvAppendString( cLine, uxPos, "%)\r\n" );
+
+	write( STDOUT_FILENO, cLine, uxPos );
+}
@@ -0,0 +1,31 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+/*
+ * Minimal formatted output on STDOUT_FILENO.
+ *
+ * printf() needs far more stack than the tasks of this demo have, so the
+ * benchmarks and the statistics use these helpers instead.  Every function
+ * builds the whole line on the stack and hands it to a single write() so
+ * that lines from different tasks do not interleave.
+ */
+
+#include <stdint.h>
+
+/* Writes a NUL terminated string as is. */
+void vConsoleWrite( const char *pcString );
+
+/* Writes "<pcPrefix>.<pcName> = <ullValue>\r\n".  pcPrefix may be NULL. */
+void vConsoleWriteValue( const char *pcPrefix, const char *pcName, uint64_t ullValue );
+
+/* Writes "<pcPrefix>.<pcName>[<ulIndex>] = <ullValue>\r\n", used for per hart
+or per size tables.  pcPrefix may be NULL. */
+void vConsoleWriteIndexedValue( const char *pcPrefix, const char *pcName, uint32_t ulIndex, uint64_t ullValue );
+
+/* Writes "<pcPrefix>.<pcName> = <ullValue>/<ullTotal> (<percent>%)\r\n". */
+void vConsoleWriteRatio( const char *pcPrefix, const char *pcName, uint64_t ullValue, uint64_t ullTotal );
+
+#endif /* CONSOLE_H */
@@ -0,0 +1,301 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "critical_profiler.h"
+#include "telemetry.h"
+#include "timestamp.h"
+
+#if( configUSE_CRITICAL_PROFILER == 1 )
+
+#if( configUSE_TELEMETRY != 1 )
+	#error The critical section profiler publishes through telemetry, set configUSE_TELEMETRY to 1
+#endif
+
+#if( configUSE_TICK_HOOK != 1 )
+	#error The tick latency is measured from the tick hook, set configUSE_TICK_HOOK to 1
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* The histogram counts durations below 64, 256, 1k... 256k cycles, and the
+longer ones in the last bucket. */
+#define criticalprofilerBUCKETS			( 8U )
+#define criticalprofilerFIRST_BUCKET_BITS	( 6U )
+
+/* Machine interrupt enable bit of mstatus. */
+#define criticalprofilerMSTATUS_MIE		( 1UL << 3 )
+
+/* mtimecmp of hart 0, and the amount the port adds to it on every tick. */
+#define criticalprofilerMTIMECMP		( configCLINT_BASE_ADDRESS + 0x4000UL )
+#define criticalprofilerTICK_INCREMENT	( ( uint64_t ) ( configCPU_CLOCK_HZ / configTICK_RATE_HZ ) )
+
+typedef struct
+{
+	uint64_t ullCount;
+	uint64_t ullMaxCycles;
+	uint64_t ullWorstCaller;		/* Return address of the code that started the longest. */
+	uint64_t ullHistogram[ criticalprofilerBUCKETS ];
+} SectionStats_t;
+
+typedef struct
+{
+	uint64_t ullTicks;
+	uint64_t ullMaxLatency;			/* In mtime periods. */
+	uint64_t ullTotalLatency;
+} TickStats_t;
+
+typedef telemetryBLOCK( SectionStats_t ) SectionTelemetry_t;
+
+/* A section being timed. */
+typedef struct
+{
+	uint64_t ullStart;
+	void *pvCaller;
+	BaseType_t xOpen;
+} SectionWindow_t;
+
+/* The wrapped kernel functions, see the linker --wrap option. */
+void __real_vTaskEnterCritical( void );
+void __real_vTaskExitCritical( void );
+void __real_vTaskSuspendAll( void );
+BaseType_t __real_xTaskResumeAll( void );
+
+void __wrap_vTaskEnterCritical( void );
+void __wrap_vTaskExitCritical( void );
+void __wrap_vTaskSuspendAll( void );
+BaseType_t __wrap_xTaskResumeAll( void );
+
+static const char * const pcSectionFields[] =
+{
+	"count", "max_cycles", "worst_caller",
+	"lt_64", "lt_256", "lt_1k", "lt_4k", "lt_16k", "lt_64k", "lt_256k", "ge_256k"
+};
+
+static const char * const pcTickFields[] = { "ticks", "max_mtime", "total_mtime" };
+
+/* Written with interrupts disabled on hart 0. */
+static SectionTelemetry_t xCriticalTelemetry;
+static SectionWindow_t xCriticalWindow;
+
+/* Written with the scheduler suspended, so by one task at a time. */
+static SectionTelemetry_t xSuspendTelemetry;
+static SectionWindow_t xSuspendWindow;
+static UBaseType_t uxSuspendDepth = 0;
+
+/* Written from the tick interrupt. */
+static telemetryBLOCK( TickStats_t ) xTickTelemetry;
+
+/*-----------------------------------------------------------*/
+
+static inline BaseType_t prvInterruptsEnabled( void )
+{
+unsigned long ulStatus;
+
+	__asm__ volatile( "csrr %0, mstatus" : "=r"( ulStatus ) );
+
+	return ( ( ulStatus & criticalprofilerMSTATUS_MIE ) != 0UL ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvBucket( uint64_t ullCycles )
+{
+uint32_t ulBits;
+
+	if( ullCycles < ( 1ULL << criticalprofilerFIRST_BUCKET_BITS ) )
+	{
+		return 0;
+	}
+
+	ulBits = 64U - ( uint32_t ) __builtin_clzll( ullCycles );
+	ulBits = ( ( ulBits - criticalprofilerFIRST_BUCKET_BITS - 1U ) / 2U ) + 1U;
+
+	return ( ulBits < criticalprofilerBUCKETS ) ? ulBits : ( criticalprofilerBUCKETS - 1U );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCloseWindow( SectionTelemetry_t *pxTelemetry, SectionWindow_t *pxWindow, uint64_t ullEnd )
+{
+SectionStats_t *pxStats = &( pxTelemetry->xStats );
+uint64_t ullCycles = ullEnd - pxWindow->ullStart;
+
+	pxWindow->xOpen = pdFALSE;
+
+	vTelemetryUpdateBegin( &( pxTelemetry->xBlock ) );
+
+	pxStats->ullCount++;
+	pxStats->ullHistogram[ prvBucket( ullCycles ) ]++;
+
+	if( ullCycles > pxStats->ullMaxCycles )
+	{
+		pxStats->ullMaxCycles = ullCycles;
+		pxStats->ullWorstCaller = ( uint64_t ) ( uintptr_t ) pxWindow->pvCaller;
+	}
+
+	vTelemetryUpdateEnd( &( pxTelemetry->xBlock ) );
+}
+/*-----------------------------------------------------------*/
+
+void __wrap_vTaskEnterCritical( void )
+{
+BaseType_t xOutermost = prvInterruptsEnabled();
+
+	__real_vTaskEnterCritical();
+
+	/* Before the scheduler starts the kernel leaves interrupts disabled on
+	exit, so the window would never close. */
+	if( ( xOutermost != pdFALSE ) && ( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED ) )
+	{
+		xCriticalWindow.pvCaller = __builtin_return_address( 0 );
+		xCriticalWindow.xOpen = pdTRUE;
+		xCriticalWindow.ullStart = ullTimestampCycles();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void __wrap_vTaskExitCritical( void )
+{
+uint64_t ullEnd = ullTimestampCycles();
+
+	__real_vTaskExitCritical();
+
+	/* The nesting count is in the TCB, so only the interrupt enable bit tells
+	the outermost exit.  Interrupts are off again while the window is closed,
+	as a context switch taken from here closes it too. */
+	if( prvInterruptsEnabled() != pdFALSE )
+	{
+		taskDISABLE_INTERRUPTS();
+
+		if( xCriticalWindow.xOpen != pdFALSE )
+		{
+			prvCloseWindow( &xCriticalTelemetry, &xCriticalWindow, ullEnd );
+		}
+
+		taskENABLE_INTERRUPTS();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void __wrap_vTaskSuspendAll( void )
+{
+	__real_vTaskSuspendAll();
+
+	if( uxSuspendDepth == 0U )
+	{
+		xSuspendWindow.pvCaller = __builtin_return_address( 0 );
+		xSuspendWindow.xOpen = pdTRUE;
+		xSuspendWindow.ullStart = ullTimestampCycles();
+	}
+
+	uxSuspendDepth++;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t __wrap_xTaskResumeAll( void )
+{
+	configASSERT( uxSuspendDepth > 0U );
+
+	uxSuspendDepth--;
+
+	if( uxSuspendDepth == 0U )
+	{
+		prvCloseWindow( &xSuspendTelemetry, &xSuspendWindow, ullTimestampCycles() );
+	}
+
+	return __real_xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalProfilerSwitchedOut( void )
+{
+	/* The task yielded inside a critical section (queue.c does, when it
+	unblocks a higher priority task), and the next one runs with interrupts
+	enabled: the masked time ends here. */
+	if( xCriticalWindow.xOpen != pdFALSE )
+	{
+		prvCloseWindow( &xCriticalTelemetry, &xCriticalWindow, ullTimestampCycles() );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalProfilerTick( void )
+{
+uint64_t ullNow = ullTimestampTime();
+uint64_t ullCompare;
+uint64_t ullLatency = 0;
+
+#if( __riscv_xlen == 64 )
+	ullCompare = *( volatile uint64_t * ) criticalprofilerMTIMECMP;
+#else
+	/* Only the tick interrupt writes mtimecmp, so the halves are stable. */
+	ullCompare = ( ( uint64_t ) *( volatile uint32_t * ) ( criticalprofilerMTIMECMP + 4UL ) << 32 ) |
+				 *( volatile uint32_t * ) criticalprofilerMTIMECMP;
+#endif
+
+	/* The port has already moved mtimecmp to the next tick, one increment
+	after the deadline that raised this interrupt. */
+	ullCompare -= criticalprofilerTICK_INCREMENT;
+
+	if( ullNow > ullCompare )
+	{
+		ullLatency = ullNow - ullCompare;
+	}
+
+	vTelemetryUpdateBegin( &( xTickTelemetry.xBlock ) );
+
+	xTickTelemetry.xStats.ullTicks++;
+	xTickTelemetry.xStats.ullTotalLatency += ullLatency;
+
+	if( ullLatency > xTickTelemetry.xStats.ullMaxLatency )
+	{
+		xTickTelemetry.xStats.ullMaxLatency = ullLatency;
+	}
+
+	vTelemetryUpdateEnd( &( xTickTelemetry.xBlock ) );
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalProfilerInit( void )
+{
+	telemetryREGISTER( xCriticalTelemetry, "critical", pcSectionFields );
+	telemetryREGISTER( xSuspendTelemetry, "suspend", pcSectionFields );
+	telemetryREGISTER( xTickTelemetry, "tick_latency", pcTickFields );
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#define criticalprofilerBENCH_SECTIONS	( 1000U )
+
+void vCriticalProfilerBenchmark( void )
+{
+uint64_t ullStart;
+uint32_t ulSection;
+
+	/* Cost of an empty section with the instrumentation, to subtract from
+	the durations recorded. */
+	ullStart = ullTimestampCycles();
+	for( ulSection = 0; ulSection < criticalprofilerBENCH_SECTIONS; ulSection++ )
+	{
+		taskENTER_CRITICAL();
+		taskEXIT_CRITICAL();
+	}
+	vBenchReport( "critical_profiler.critical", 0, ullTimestampCycles() - ullStart, criticalprofilerBENCH_SECTIONS );
+
+	ullStart = ullTimestampCycles();
+	for( ulSection = 0; ulSection < criticalprofilerBENCH_SECTIONS; ulSection++ )
+	{
+		vTaskSuspendAll();
+		( void ) xTaskResumeAll();
+	}
+	vBenchReport( "critical_profiler.suspend", 0, ullTimestampCycles() - ullStart, criticalprofilerBENCH_SECTIONS );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_CRITICAL_PROFILER */
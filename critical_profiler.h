@@ -0,0 +1,50 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef CRITICAL_PROFILER_H
+#define CRITICAL_PROFILER_H
+
+/*
+ * Critical section profiler.
+ *
+ * Built with "make CRITICAL_PROFILER=1", which defines
+ * configUSE_CRITICAL_PROFILER and has the linker wrap vTaskEnterCritical(),
+ * vTaskExitCritical(), vTaskSuspendAll() and xTaskResumeAll().  The wrappers
+ * time every outermost critical section and scheduler suspension and keep,
+ * for each kind, the count, the longest duration with the return address of
+ * the code that started it, and a histogram of durations in powers of 4
+ * cycles.
+ *
+ * The linker can only wrap calls between object files, so the sections
+ * that tasks.c opens on its own, and taskDISABLE_INTERRUPTS() which is an
+ * inline csrc, are not timed.  Their effect is caught by the third
+ * measurement: how late the tick interrupt runs compared to the mtimecmp
+ * deadline that raised it, which is the interrupt latency the masked time
+ * causes, whatever masked the interrupts.
+ *
+ * The results are published as the telemetry blocks "critical", "suspend"
+ * and "tick_latency".  A worst_caller address can be resolved with
+ * addr2line or the map file.
+ */
+
+#include "FreeRTOS.h"
+
+#if( configUSE_CRITICAL_PROFILER == 1 )
+
+/* Registers the telemetry blocks.  Call once, before the scheduler starts. */
+void vCriticalProfilerInit( void );
+
+/* Called from the tick hook to measure the tick latency. */
+void vCriticalProfilerTick( void );
+
+/* Called by traceTASK_SWITCHED_OUT() (trace_hooks.h), as a task can yield
+inside a critical section. */
+void vCriticalProfilerSwitchedOut( void );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vCriticalProfilerBenchmark( void );
+#endif
+
+#endif /* configUSE_CRITICAL_PROFILER */
+
+#endif /* CRITICAL_PROFILER_H */
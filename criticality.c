@@ -0,0 +1,372 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "criticality.h"
+
+#if( configUSE_CRITICALITY == 1 )
+
+#if( INCLUDE_xTimerPendFunctionCall != 1 )
+	#error The modes are changed in the timer task, set INCLUDE_xTimerPendFunctionCall to 1
+#endif
+
+#if( INCLUDE_vTaskSuspend != 1 ) || ( INCLUDE_eTaskGetState != 1 )
+	#error The high mode suspends tasks, set INCLUDE_vTaskSuspend and INCLUDE_eTaskGetState to 1
+#endif
+
+#if( configUSE_TELEMETRY == 1 )
+	#include "telemetry.h"
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+	#include "preempt_threshold.h"
+	#include "task_budget.h"
+#endif
+
+/* Triggers passed to the timer task. */
+#define criticalityTRIGGER_OVERRUN		( 0UL )
+#define criticalityTRIGGER_MISS			( 1UL )
+
+#if( configUSE_TELEMETRY == 1 )
+
+typedef struct
+{
+	uint64_t ullMode;				/* 1 in the high criticality mode. */
+	uint64_t ullToHigh;
+	uint64_t ullToLow;
+	uint64_t ullOverruns;
+	uint64_t ullDeadlineMisses;
+} CriticalityStats_t;
+
+static const char * const pcCriticalityFields[] = { "mode", "to_high", "to_low", "overruns", "deadline_misses" };
+
+/* Only written by the timer task. */
+static telemetryBLOCK( CriticalityStats_t ) xCriticalityTelemetry;
+
+#endif /* configUSE_TELEMETRY */
+
+/* Changed in critical sections and walked by the timer task, which no
+registering task preempts. */
+static CriticalityTask_t *pxTasks = NULL;
+
+static volatile BaseType_t xHighMode = pdFALSE;
+
+static TimerHandle_t xHoldTimer = NULL;
+static StaticTimer_t xHoldTimerBuffer;
+
+static void prvHoldExpired( TimerHandle_t xTimer );
+
+/*-----------------------------------------------------------*/
+
+void vCriticalityInit( void )
+{
+	xHoldTimer = xTimerCreateStatic( "Crit", pdMS_TO_TICKS( configCRITICALITY_HOLD_MS ), pdFALSE, NULL, prvHoldExpired, &xHoldTimerBuffer );
+	configASSERT( xHoldTimer != NULL );
+
+#if( configUSE_TELEMETRY == 1 )
+	telemetryREGISTER( xCriticalityTelemetry, "criticality", pcCriticalityFields );
+#endif
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalityRegister( CriticalityTask_t *pxEntry, TaskHandle_t xTask, Criticality_t eCriticality )
+{
+	configASSERT( xTask != NULL );
+
+	pxEntry->xTask = xTask;
+	pxEntry->eCriticality = eCriticality;
+	vTaskDemotionInit( &( pxEntry->xDemotion ) );
+	pxEntry->xSuspended = pdFALSE;
+
+	taskENTER_CRITICAL();
+	{
+		pxEntry->pxNext = pxTasks;
+		pxTasks = pxEntry;
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalityUnregister( CriticalityTask_t *pxEntry )
+{
+CriticalityTask_t **ppxLink;
+
+	taskENTER_CRITICAL();
+	{
+		for( ppxLink = &pxTasks; *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+		{
+			if( *ppxLink == pxEntry )
+			{
+				*ppxLink = pxEntry->pxNext;
+				break;
+			}
+		}
+
+		pxEntry->xSuspended = pdFALSE;
+	}
+	taskEXIT_CRITICAL();
+
+	vTaskDemotionDrop( &( pxEntry->xDemotion ) );
+}
+/*-----------------------------------------------------------*/
+
+/* Runs in the timer task. */
+static void prvEnterHighMode( void *pvTask, uint32_t ulTrigger )
+{
+CriticalityTask_t *pxEntry;
+
+	( void ) pvTask;
+
+#if( configUSE_TELEMETRY == 1 )
+	vTelemetryUpdateBegin( &( xCriticalityTelemetry.xBlock ) );
+
+	if( ulTrigger == criticalityTRIGGER_OVERRUN )
+	{
+		xCriticalityTelemetry.xStats.ullOverruns++;
+	}
+	else
+	{
+		xCriticalityTelemetry.xStats.ullDeadlineMisses++;
+	}
+
+	if( xHighMode == pdFALSE )
+	{
+		xCriticalityTelemetry.xStats.ullMode = 1;
+		xCriticalityTelemetry.xStats.ullToHigh++;
+	}
+
+	vTelemetryUpdateEnd( &( xCriticalityTelemetry.xBlock ) );
+#else
+	( void ) ulTrigger;
+#endif
+
+	if( xHighMode == pdFALSE )
+	{
+		xHighMode = pdTRUE;
+
+		for( pxEntry = pxTasks; pxEntry != NULL; pxEntry = pxEntry->pxNext )
+		{
+			if( pxEntry->eCriticality == criticalityLOW_SUSPEND )
+			{
+				/* Only the tasks suspended here are resumed when the mode
+				ends. */
+				if( eTaskGetState( pxEntry->xTask ) != eSuspended )
+				{
+					vTaskSuspend( pxEntry->xTask );
+					pxEntry->xSuspended = pdTRUE;
+				}
+			}
+			else if( pxEntry->eCriticality == criticalityLOW_DEGRADE )
+			{
+				vTaskDemotionStart( &( pxEntry->xDemotion ), pxEntry->xTask, tskIDLE_PRIORITY );
+			}
+		}
+	}
+
+	/* Every trigger extends the mode.  The timer task does not block on its
+	own queue. */
+	( void ) xTimerReset( xHoldTimer, 0 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvHoldExpired( TimerHandle_t xTimer )
+{
+CriticalityTask_t *pxEntry;
+
+	( void ) xTimer;
+
+	for( pxEntry = pxTasks; pxEntry != NULL; pxEntry = pxEntry->pxNext )
+	{
+		if( pxEntry->xSuspended != pdFALSE )
+		{
+			pxEntry->xSuspended = pdFALSE;
+			vTaskResume( pxEntry->xTask );
+		}
+		else if( pxEntry->eCriticality == criticalityLOW_DEGRADE )
+		{
+			vTaskDemotionEnd( &( pxEntry->xDemotion ) );
+		}
+	}
+
+	xHighMode = pdFALSE;
+
+#if( configUSE_TELEMETRY == 1 )
+	vTelemetryUpdateBegin( &( xCriticalityTelemetry.xBlock ) );
+	xCriticalityTelemetry.xStats.ullMode = 0;
+	xCriticalityTelemetry.xStats.ullToLow++;
+	vTelemetryUpdateEnd( &( xCriticalityTelemetry.xBlock ) );
+#endif
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalityBudgetOverrun( TaskHandle_t xTask )
+{
+	/* Budget handlers already run in the timer task. */
+	prvEnterHighMode( xTask, criticalityTRIGGER_OVERRUN );
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalityDeadlineMissed( TaskHandle_t xTask )
+{
+	/* Blocks until the timer queue has room, so not from the timer task. */
+	( void ) xTimerPendFunctionCall( prvEnterHighMode, xTask, criticalityTRIGGER_MISS, portMAX_DELAY );
+}
+/*-----------------------------------------------------------*/
+
+void vCriticalityDelayUntil( TickType_t *pxPreviousWakeTime, TickType_t xPeriod )
+{
+	if( ( TickType_t ) ( xTaskGetTickCount() - *pxPreviousWakeTime ) > xPeriod )
+	{
+		vCriticalityDeadlineMissed( xTaskGetCurrentTaskHandle() );
+	}
+
+	vTaskDelayUntil( pxPreviousWakeTime, xPeriod );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xCriticalityIsHighMode( void )
+{
+	return xHighMode;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 ) && ( configUSE_TASK_BUDGET == 1 )
+
+/*
+ * A task with a threshold, a budget lowering it to tskIDLE_PRIORITY and
+ * degraded in the high mode, as the manifest declares them, one priority
+ * above the benchmark task:
+ *  - it spins raised until its budget lowers it;
+ *  - the high mode degrades it as well, and it keeps trying to raise itself
+ *    every tick;
+ *  - the next period ends the demotion of the budget, but not the degrade;
+ *  - the end of the high mode gives it its own priority back, not its
+ *    threshold, and it raises itself again.
+ */
+#define criticalityMIXED_PERIOD_MS		( 20U )
+#define criticalityMIXED_BUDGET_US		( 2000U )
+
+static StaticTask_t xMixedTCB;
+static StackType_t uxMixedStack[ configMINIMAL_STACK_SIZE ];
+static TaskBudget_t xMixedBudget;
+static CriticalityTask_t xMixedEntry;
+static volatile BaseType_t xMixedSpin;
+static volatile UBaseType_t uxMixedRaised;
+
+static void prvMixedTask( void *pvParameters )
+{
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		vPreemptThresholdRaise();
+		uxMixedRaised = uxTaskPriorityGet( NULL );
+
+		while( xMixedSpin != pdFALSE )
+		{
+		}
+
+		vTaskDelay( 1 );
+	}
+}
+
+static void prvMixedCheck( void )
+{
+UBaseType_t uxPriority = uxTaskPriorityGet( NULL );
+TaskHandle_t xMixed;
+
+	xMixedSpin = pdTRUE;
+
+	vTaskSuspendAll();
+	{
+		xMixed = xTaskCreateStatic( prvMixedTask, "CritMix", configMINIMAL_STACK_SIZE, NULL, uxPriority + 1U, uxMixedStack, &xMixedTCB );
+		vPreemptThresholdSet( xMixed, uxPriority + 2U );
+		vTaskBudgetAttach( &xMixedBudget, xMixed, ullTaskBudgetCyclesFromUs( criticalityMIXED_BUDGET_US ),
+						   pdMS_TO_TICKS( criticalityMIXED_PERIOD_MS ), tskIDLE_PRIORITY, NULL );
+		vCriticalityRegister( &xMixedEntry, xMixed, criticalityLOW_DEGRADE );
+	}
+	( void ) xTaskResumeAll();
+
+	/* Only runs once the budget lowered the raised task. */
+	configASSERT( uxMixedRaised == uxPriority + 2U );
+	configASSERT( uxTaskPriorityGet( xMixed ) == tskIDLE_PRIORITY );
+	xMixedSpin = pdFALSE;
+
+	vCriticalityDeadlineMissed( xTaskGetCurrentTaskHandle() );
+	configASSERT( uxTaskPriorityGet( xMixed ) == tskIDLE_PRIORITY );
+
+	/* Lets a period end, well within configCRITICALITY_HOLD_MS.  Without
+	time slicing, the degraded task only runs when the idle task happens to
+	be switched out, so wait for its next attempt. */
+	vTaskDelay( pdMS_TO_TICKS( 2U * criticalityMIXED_PERIOD_MS ) );
+	uxMixedRaised = configMAX_PRIORITIES;
+
+	while( uxMixedRaised == configMAX_PRIORITIES )
+	{
+		vTaskDelay( 1 );
+	}
+
+	configASSERT( xCriticalityIsHighMode() != pdFALSE );
+	configASSERT( uxTaskPriorityGet( xMixed ) == tskIDLE_PRIORITY );
+	configASSERT( uxMixedRaised == tskIDLE_PRIORITY );
+
+	while( xCriticalityIsHighMode() != pdFALSE )
+	{
+		vTaskDelay( 1 );
+	}
+
+	uxMixedRaised = configMAX_PRIORITIES;
+
+	while( uxMixedRaised == configMAX_PRIORITIES )
+	{
+		vTaskDelay( 1 );
+	}
+
+	configASSERT( uxMixedRaised == uxPriority + 2U );
+	configASSERT( uxTaskPriorityGet( xMixed ) == uxPriority + 1U );
+
+	vCriticalityUnregister( &xMixedEntry );
+	vTaskBudgetDetach( &xMixedBudget );
+	vTaskDelete( xMixed );
+}
+
+#endif /* configUSE_PREEMPT_THRESHOLD && configUSE_TASK_BUDGET */
+
+void vCriticalityBenchmark( void )
+{
+uint64_t ullStart;
+uint64_t ullCycles;
+TickType_t xStart;
+
+	/* The timer task preempts the caller, so the tasks of the manifest are
+	degraded or suspended by the time the report returns. */
+	ullStart = ullTimestampCycles();
+	vCriticalityDeadlineMissed( xTaskGetCurrentTaskHandle() );
+	ullCycles = ullTimestampCycles() - ullStart;
+
+	vBenchReport( "criticality.to_high", ( uint32_t ) xCriticalityIsHighMode(), ullCycles, 1 );
+
+	xStart = xTaskGetTickCount();
+
+	while( xCriticalityIsHighMode() != pdFALSE )
+	{
+		vTaskDelay( 1 );
+	}
+
+	vBenchReport( "criticality.hold_ticks", configCRITICALITY_HOLD_MS, xTaskGetTickCount() - xStart, 1 );
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 ) && ( configUSE_TASK_BUDGET == 1 )
+	prvMixedCheck();
+#endif
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_CRITICALITY */
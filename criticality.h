@@ -0,0 +1,89 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef CRITICALITY_H
+#define CRITICALITY_H
+
+/*
+ * Mixed criticality modes.
+ *
+ * Each registered task is tagged with a criticality.  The system starts in
+ * the low criticality mode, where every task runs normally.  A budget overrun
+ * of a high criticality task (task_budget.h) or a deadline miss reported by
+ * any task switches it to the high criticality mode, where the low
+ * criticality tasks are either:
+ *  - degraded: lowered to tskIDLE_PRIORITY, so they only use spare time,
+ *    through task_demotion.h: a degraded task cannot raise itself to its
+ *    preemption threshold, and gets its own priority back even if it was
+ *    raised or demoted for its budget when the mode started, or
+ *  - suspended until the mode ends.  A task that was already suspended when
+ *    the mode started is left suspended.
+ * The system goes back to the low criticality mode, restoring those tasks,
+ * once configCRITICALITY_HOLD_MS go by without a new overrun or miss.
+ *
+ * The mode changes run in the timer task, one at a time, which should be
+ * above every registered task (configTIMER_TASK_PRIORITY).  The tasks of the
+ * manifest are registered with the criticality declared there.  With
+ * configUSE_TELEMETRY the "criticality" block holds the mode, the number of
+ * switches each way and the triggers seen.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "task_demotion.h"
+
+/* Criticality of a task.  Also used by the manifest when the modes are not
+enabled. */
+typedef enum
+{
+	criticalityHIGH = 0,		/* Runs in both modes. */
+	criticalityLOW_DEGRADE,		/* Lowered to tskIDLE_PRIORITY in the high mode. */
+	criticalityLOW_SUSPEND		/* Suspended in the high mode. */
+} Criticality_t;
+
+#if( configUSE_CRITICALITY == 1 )
+
+/* The members are private to criticality.c. */
+typedef struct xCRITICALITY_TASK
+{
+	TaskHandle_t xTask;
+	Criticality_t eCriticality;
+	TaskDemotion_t xDemotion;
+	BaseType_t xSuspended;			/* Suspended by the high mode. */
+	struct xCRITICALITY_TASK *pxNext;
+} CriticalityTask_t;
+
+/* Creates the timer that ends the high mode.  Call once, before the
+scheduler starts and before registering tasks. */
+void vCriticalityInit( void );
+
+/* Tags xTask.  pxEntry must stay valid until vCriticalityUnregister().  Can
+be called before the scheduler starts or from any task.  A task registered
+during the high mode is only held from the next one. */
+void vCriticalityRegister( CriticalityTask_t *pxEntry, TaskHandle_t xTask, Criticality_t eCriticality );
+
+/* Untags the task of pxEntry, before deleting it for instance.  If the high
+mode holds the task, it is left degraded or suspended.  Can be called from any
+task. */
+void vCriticalityUnregister( CriticalityTask_t *pxEntry );
+
+/* Triggers of the high mode, for tasks.  vCriticalityBudgetOverrun() is a
+TaskBudgetHandler_t, for the budgets of the high criticality tasks. */
+void vCriticalityBudgetOverrun( TaskHandle_t xTask );
+void vCriticalityDeadlineMissed( TaskHandle_t xTask );
+
+/* vTaskDelayUntil() that first reports a deadline miss if the job released at
+*pxPreviousWakeTime ran for more than xPeriod. */
+void vCriticalityDelayUntil( TickType_t *pxPreviousWakeTime, TickType_t xPeriod );
+
+/* pdTRUE while in the high criticality mode. */
+BaseType_t xCriticalityIsHighMode( void );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vCriticalityBenchmark( void );
+#endif
+
+#endif /* configUSE_CRITICALITY */
+
+#endif /* CRITICALITY_H */
@@ -0,0 +1,295 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "event_bus.h"
+
+#if( configUSE_EVENT_BUS == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/*-----------------------------------------------------------*/
+
+static inline EventBusHeader_t *prvHeader( const void *pvPayload )
+{
+	return ( EventBusHeader_t * ) ( ( uintptr_t ) pvPayload - eventbusHEADER_SIZE );
+}
+
+/* Notification values are the index of the block + 1, so that 0 is none. */
+static inline uint32_t prvIndex( const EventBus_t *pxBus, const void *pvPayload )
+{
+	return ( uint32_t ) ( ( ( const uint8_t * ) prvHeader( pvPayload ) - pxBus->pucStorage ) / pxBus->xBlockSize );
+}
+/*-----------------------------------------------------------*/
+
+void vEventBusInit( EventBus_t *pxBus, void *pvStorage, size_t xPayloadSize, uint32_t ulEvents )
+{
+	vBlockPoolInit( &( pxBus->xPool ), pvStorage, eventbusHEADER_SIZE + xPayloadSize, ulEvents );
+
+	pxBus->pucStorage = ( uint8_t * ) pvStorage;
+	pxBus->xBlockSize = blockpoolBLOCK_SIZE( eventbusHEADER_SIZE + xPayloadSize );
+	pxBus->ulPublished = 0;
+	pxBus->ulNoPayload = 0;
+}
+/*-----------------------------------------------------------*/
+
+void vEventBusTopicInit( EventBusTopic_t *pxTopic )
+{
+	pxTopic->pxSubscribers = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSubscribe( EventBusTopic_t *pxTopic, EventBusSubscriber_t *pxSubscriber, QueueHandle_t xQueue, TaskHandle_t xTask, uint32_t ulMask )
+{
+	pxSubscriber->xQueue = xQueue;
+	pxSubscriber->xTask = xTask;
+	pxSubscriber->ulMask = ulMask;
+	pxSubscriber->ulDelivered = 0;
+	pxSubscriber->ulDropped = 0;
+
+	/* The publishers walk the list without a lock, so the subscriber is
+	complete before it is linked. */
+	taskENTER_CRITICAL();
+	{
+		pxSubscriber->pxNext = pxTopic->pxSubscribers;
+		pxTopic->pxSubscribers = pxSubscriber;
+	}
+	taskEXIT_CRITICAL();
+}
+
+void vEventBusSubscribeQueue( EventBusTopic_t *pxTopic, EventBusSubscriber_t *pxSubscriber, QueueHandle_t xQueue, uint32_t ulMask )
+{
+	configASSERT( xQueue != NULL );
+
+	prvSubscribe( pxTopic, pxSubscriber, xQueue, NULL, ulMask );
+}
+
+void vEventBusSubscribeTask( EventBusTopic_t *pxTopic, EventBusSubscriber_t *pxSubscriber, TaskHandle_t xTask, uint32_t ulMask )
+{
+	configASSERT( xTask != NULL );
+
+	prvSubscribe( pxTopic, pxSubscriber, NULL, xTask, ulMask );
+}
+/*-----------------------------------------------------------*/
+
+void *pvEventBusAlloc( EventBus_t *pxBus )
+{
+uint8_t *pucBlock = ( uint8_t * ) pvBlockPoolAlloc( &( pxBus->xPool ) );
+EventBusHeader_t *pxHeader;
+
+	if( pucBlock == NULL )
+	{
+		__atomic_fetch_add( &( pxBus->ulNoPayload ), 1U, __ATOMIC_RELAXED );
+		return NULL;
+	}
+
+	pxHeader = ( EventBusHeader_t * ) pucBlock;
+	pxHeader->ulReferences = 1;
+	pxHeader->ulFlags = 0;
+
+	return pucBlock + eventbusHEADER_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+void vEventBusRelease( EventBus_t *pxBus, void *pvPayload )
+{
+EventBusHeader_t *pxHeader = prvHeader( pvPayload );
+
+	/* Acquire and release, so that the last holder sees the writes of the
+	others before the block is reused. */
+	if( __atomic_fetch_sub( &( pxHeader->ulReferences ), 1U, __ATOMIC_ACQ_REL ) == 1U )
+	{
+		vBlockPoolFree( &( pxBus->xPool ), pxHeader );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static UBaseType_t prvPublish( EventBus_t *pxBus, EventBusTopic_t *pxTopic, void *pvPayload, uint32_t ulFlags, BaseType_t *pxHigherPriorityTaskWoken )
+{
+EventBusHeader_t *pxHeader = prvHeader( pvPayload );
+EventBusSubscriber_t *pxSubscriber;
+UBaseType_t uxDelivered = 0;
+BaseType_t xSent;
+
+	pxHeader->ulFlags = ulFlags;
+
+	for( pxSubscriber = pxTopic->pxSubscribers; pxSubscriber != NULL; pxSubscriber = pxSubscriber->pxNext )
+	{
+		if( ( pxSubscriber->ulMask & ulFlags ) == 0U )
+		{
+			continue;
+		}
+
+		/* The reference is taken first, as the subscriber may run and
+		release it before the send returns. */
+		__atomic_fetch_add( &( pxHeader->ulReferences ), 1U, __ATOMIC_RELAXED );
+
+		if( pxSubscriber->xQueue != NULL )
+		{
+			if( pxHigherPriorityTaskWoken == NULL )
+			{
+				xSent = xQueueSend( pxSubscriber->xQueue, &pvPayload, 0 );
+			}
+			else
+			{
+				xSent = xQueueSendFromISR( pxSubscriber->xQueue, &pvPayload, pxHigherPriorityTaskWoken );
+			}
+		}
+		else
+		{
+			if( pxHigherPriorityTaskWoken == NULL )
+			{
+				xSent = xTaskNotify( pxSubscriber->xTask, prvIndex( pxBus, pvPayload ) + 1U, eSetValueWithoutOverwrite );
+			}
+			else
+			{
+				xSent = xTaskNotifyFromISR( pxSubscriber->xTask, prvIndex( pxBus, pvPayload ) + 1U, eSetValueWithoutOverwrite, pxHigherPriorityTaskWoken );
+			}
+		}
+
+		if( xSent == pdPASS )
+		{
+			__atomic_fetch_add( &( pxSubscriber->ulDelivered ), 1U, __ATOMIC_RELAXED );
+			uxDelivered++;
+		}
+		else
+		{
+			/* The publisher still holds a reference, so this is not the
+			last one. */
+			__atomic_fetch_sub( &( pxHeader->ulReferences ), 1U, __ATOMIC_RELAXED );
+			__atomic_fetch_add( &( pxSubscriber->ulDropped ), 1U, __ATOMIC_RELAXED );
+		}
+	}
+
+	__atomic_fetch_add( &( pxBus->ulPublished ), 1U, __ATOMIC_RELAXED );
+	vEventBusRelease( pxBus, pvPayload );
+
+	return uxDelivered;
+}
+
+UBaseType_t uxEventBusPublish( EventBus_t *pxBus, EventBusTopic_t *pxTopic, void *pvPayload, uint32_t ulFlags )
+{
+	return prvPublish( pxBus, pxTopic, pvPayload, ulFlags, NULL );
+}
+
+UBaseType_t uxEventBusPublishFromISR( EventBus_t *pxBus, EventBusTopic_t *pxTopic, void *pvPayload, uint32_t ulFlags, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	configASSERT( pxHigherPriorityTaskWoken != NULL );
+
+	return prvPublish( pxBus, pxTopic, pvPayload, ulFlags, pxHigherPriorityTaskWoken );
+}
+/*-----------------------------------------------------------*/
+
+void *pvEventBusReceive( EventBus_t *pxBus, TickType_t xTicksToWait )
+{
+uint32_t ulValue = 0;
+
+	/* Clearing the value on exit lets the next event in. */
+	if( ( xTaskNotifyWait( 0, UINT32_MAX, &ulValue, xTicksToWait ) != pdPASS ) || ( ulValue == 0U ) )
+	{
+		return NULL;
+	}
+
+	return pxBus->pucStorage + ( ( ulValue - 1U ) * pxBus->xBlockSize ) + eventbusHEADER_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulEventBusFlags( const void *pvPayload )
+{
+	return prvHeader( pvPayload )->ulFlags;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Cost of a publish to 1 to eventbusBENCH_SUBSCRIBERS queue subscribers,
+ * against sending a copy of the payload to as many queues.  The subscribers
+ * are drained by the benchmark task between the publishes, outside of the
+ * measure.
+ */
+#define eventbusBENCH_SUBSCRIBERS	( 32U )
+#define eventbusBENCH_PAYLOAD_SIZE	( 32U )
+#define eventbusBENCH_ROUNDS		( 32U )
+
+static eventbusSTORAGE( xBenchStorage, eventbusBENCH_PAYLOAD_SIZE, 2 );
+static EventBus_t xBenchBus;
+static EventBusTopic_t xBenchTopic;
+static EventBusSubscriber_t xBenchSubscribers[ eventbusBENCH_SUBSCRIBERS ];
+static QueueHandle_t xBenchQueues[ eventbusBENCH_SUBSCRIBERS ];
+static StaticQueue_t xBenchQueueBuffers[ eventbusBENCH_SUBSCRIBERS ];
+static void *pvBenchQueueStorage[ eventbusBENCH_SUBSCRIBERS ];
+static QueueHandle_t xBenchCopyQueues[ eventbusBENCH_SUBSCRIBERS ];
+static StaticQueue_t xBenchCopyQueueBuffers[ eventbusBENCH_SUBSCRIBERS ];
+static uint8_t ucBenchCopyQueueStorage[ eventbusBENCH_SUBSCRIBERS ][ eventbusBENCH_PAYLOAD_SIZE ];
+
+void vEventBusBenchmark( void )
+{
+uint8_t ucPayload[ eventbusBENCH_PAYLOAD_SIZE ] = { 0 };
+uint32_t ulSubscribers;
+uint32_t ulSubscriber;
+uint32_t ulRound;
+uint64_t ullPublish;
+uint64_t ullCopy;
+uint64_t ullStart;
+void *pvPayload;
+
+	vEventBusInit( &xBenchBus, xBenchStorage, eventbusBENCH_PAYLOAD_SIZE, 2 );
+
+	for( ulSubscriber = 0; ulSubscriber < eventbusBENCH_SUBSCRIBERS; ulSubscriber++ )
+	{
+		xBenchQueues[ ulSubscriber ] = xQueueCreateStatic( 1, sizeof( void * ), ( uint8_t * ) &pvBenchQueueStorage[ ulSubscriber ], &xBenchQueueBuffers[ ulSubscriber ] );
+		xBenchCopyQueues[ ulSubscriber ] = xQueueCreateStatic( 1, eventbusBENCH_PAYLOAD_SIZE, ucBenchCopyQueueStorage[ ulSubscriber ], &xBenchCopyQueueBuffers[ ulSubscriber ] );
+	}
+
+	for( ulSubscribers = 1; ulSubscribers <= eventbusBENCH_SUBSCRIBERS; ulSubscribers *= 2U )
+	{
+		vEventBusTopicInit( &xBenchTopic );
+
+		for( ulSubscriber = 0; ulSubscriber < ulSubscribers; ulSubscriber++ )
+		{
+			vEventBusSubscribeQueue( &xBenchTopic, &xBenchSubscribers[ ulSubscriber ], xBenchQueues[ ulSubscriber ], 1U );
+		}
+
+		ullPublish = 0;
+		ullCopy = 0;
+
+		for( ulRound = 0; ulRound < eventbusBENCH_ROUNDS; ulRound++ )
+		{
+			ullStart = ullTimestampCycles();
+			pvPayload = pvEventBusAlloc( &xBenchBus );
+			memcpy( pvPayload, ucPayload, sizeof( ucPayload ) );
+			( void ) uxEventBusPublish( &xBenchBus, &xBenchTopic, pvPayload, 1U );
+			ullPublish += ullTimestampCycles() - ullStart;
+
+			ullStart = ullTimestampCycles();
+			for( ulSubscriber = 0; ulSubscriber < ulSubscribers; ulSubscriber++ )
+			{
+				( void ) xQueueSend( xBenchCopyQueues[ ulSubscriber ], ucPayload, 0 );
+			}
+			ullCopy += ullTimestampCycles() - ullStart;
+
+			for( ulSubscriber = 0; ulSubscriber < ulSubscribers; ulSubscriber++ )
+			{
+				( void ) xQueueReceive( xBenchQueues[ ulSubscriber ], &pvPayload, 0 );
+				vEventBusRelease( &xBenchBus, pvPayload );
+				( void ) xQueueReceive( xBenchCopyQueues[ ulSubscriber ], ucPayload, 0 );
+			}
+		}
+
+		vBenchReport( "event_bus.publish", ulSubscribers, ullPublish, eventbusBENCH_ROUNDS );
+		vBenchReport( "event_bus.copy_send", ulSubscribers, ullCopy, eventbusBENCH_ROUNDS );
+	}
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_EVENT_BUS */
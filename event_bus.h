@@ -0,0 +1,139 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+/*
+ * Publish/subscribe event bus.
+ *
+ * A publisher takes a payload from the bus, fills it and posts it once to a
+ * topic.  Every subscriber of the topic whose mask shares a bit with the
+ * flags of the event gets a pointer to the same payload, without copy:
+ *  - through its own queue, of void * items, with
+ *    vEventBusSubscribeQueue(), then xQueueReceive();
+ *  - or through its task notification value, with
+ *    vEventBusSubscribeTask(), then pvEventBusReceive().  The value holds the
+ *    index of the payload, so a notified subscriber holds at most one event
+ *    at a time; the events that find it busy are dropped.
+ * A subscriber whose queue is full also loses the event.  The losses are
+ * counted per subscriber.
+ *
+ * The payloads come from a lock-free block pool (block_pool.h) and are
+ * reference counted: the publisher holds a reference until the publish
+ * returns, and each subscriber that got the event holds one until it calls
+ * vEventBusRelease().  The last release returns the payload to the pool, so
+ * a payload can be released from any task, interrupt or hart.
+ *
+ * Topics and subscriptions are static and permanent: subscribe before the
+ * publishers start, or at least before the first publish to the topic that
+ * must reach the new subscriber.
+ *
+ *	static eventbusSTORAGE( xStorage, sizeof( Reading_t ), 8 );
+ *	static EventBus_t xBus;
+ *	static EventBusTopic_t xReadings;
+ *	static EventBusSubscriber_t xLogger;
+ *
+ *	vEventBusInit( &xBus, xStorage, sizeof( Reading_t ), 8 );
+ *	vEventBusTopicInit( &xReadings );
+ *	vEventBusSubscribeQueue( &xReadings, &xLogger, xLoggerQueue, READING_ALARM );
+ *
+ *	pxReading = pvEventBusAlloc( &xBus );
+ *	uxEventBusPublish( &xBus, &xReadings, pxReading, READING_ALARM );
+ *
+ *	xQueueReceive( xLoggerQueue, &pxReading, portMAX_DELAY );
+ *	vEventBusRelease( &xBus, pxReading );
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "block_pool.h"
+
+#if( configUSE_EVENT_BUS == 1 )
+
+#if( configUSE_BLOCK_POOL != 1 )
+	#error The event payloads come from a block pool, set configUSE_BLOCK_POOL to 1
+#endif
+
+/* Header in front of each payload.  The members are private to
+event_bus.c. */
+typedef struct
+{
+	volatile uint32_t ulReferences;
+	uint32_t ulFlags;
+} EventBusHeader_t;
+
+#define eventbusHEADER_SIZE		blockpoolBLOCK_SIZE( sizeof( EventBusHeader_t ) )
+
+/* Declares the storage of ulEvents payloads of xPayloadSize bytes. */
+#define eventbusSTORAGE( xName, xPayloadSize, ulEvents )	\
+	blockpoolSTORAGE( xName, eventbusHEADER_SIZE + ( xPayloadSize ), ulEvents )
+
+/* The members are private to event_bus.c. */
+typedef struct xEVENT_BUS
+{
+	BlockPool_t xPool;
+	uint8_t *pucStorage;
+	size_t xBlockSize;
+	volatile uint32_t ulPublished;
+	volatile uint32_t ulNoPayload;		/* Allocations that found the pool empty. */
+} EventBus_t;
+
+typedef struct xEVENT_BUS_SUBSCRIBER
+{
+	QueueHandle_t xQueue;				/* NULL for a notified task. */
+	TaskHandle_t xTask;
+	uint32_t ulMask;
+	volatile uint32_t ulDelivered;
+	volatile uint32_t ulDropped;
+	struct xEVENT_BUS_SUBSCRIBER *pxNext;
+} EventBusSubscriber_t;
+
+typedef struct xEVENT_BUS_TOPIC
+{
+	EventBusSubscriber_t * volatile pxSubscribers;
+} EventBusTopic_t;
+
+/* pvStorage holds ulEvents payloads of xPayloadSize bytes, see
+eventbusSTORAGE(). */
+void vEventBusInit( EventBus_t *pxBus, void *pvStorage, size_t xPayloadSize, uint32_t ulEvents );
+
+void vEventBusTopicInit( EventBusTopic_t *pxTopic );
+
+/* Subscribes to the events of pxTopic with a flag in ulMask.  pxSubscriber
+must stay valid for the life of the system. */
+void vEventBusSubscribeQueue( EventBusTopic_t *pxTopic, EventBusSubscriber_t *pxSubscriber, QueueHandle_t xQueue, uint32_t ulMask );
+void vEventBusSubscribeTask( EventBusTopic_t *pxTopic, EventBusSubscriber_t *pxSubscriber, TaskHandle_t xTask, uint32_t ulMask );
+
+/* A payload with one reference, for the publisher, or NULL if all are in
+use.  Can be called from tasks, interrupts and any hart. */
+void *pvEventBusAlloc( EventBus_t *pxBus );
+
+/* Posts pvPayload, from pvEventBusAlloc(), to the subscribers of pxTopic
+that match ulFlags, and drops the reference of the publisher.  Returns the
+number of subscribers that got it. */
+UBaseType_t uxEventBusPublish( EventBus_t *pxBus, EventBusTopic_t *pxTopic, void *pvPayload, uint32_t ulFlags );
+UBaseType_t uxEventBusPublishFromISR( EventBus_t *pxBus, EventBusTopic_t *pxTopic, void *pvPayload, uint32_t ulFlags, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* The next payload of a task subscribed with vEventBusSubscribeTask(), or
+NULL if none came within xTicksToWait. */
+void *pvEventBusReceive( EventBus_t *pxBus, TickType_t xTicksToWait );
+
+/* The flags pvPayload was published with. */
+uint32_t ulEventBusFlags( const void *pvPayload );
+
+/* Drops a reference to pvPayload.  Can be called from tasks, interrupts and
+any hart. */
+void vEventBusRelease( EventBus_t *pxBus, void *pvPayload );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vEventBusBenchmark( void );
+#endif
+
+#endif /* configUSE_EVENT_BUS */
+
+#endif /* EVENT_BUS_H */
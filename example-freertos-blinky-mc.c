@@ -5,19 +5,19 @@
 
 /******************************************************************************
  *
- * main() creates one queue, and two tasks.  It then starts the
- * scheduler.
+ * main() creates one queue, and the two tasks declared in the task manifest
+ * (task_manifest.h).  It then starts the scheduler.
  *
  * The Queue Send Task:
- * The queue send task is implemented by the prvQueueSendTask() function in
- * this file.  prvQueueSendTask() sits in a loop that causes it to repeatedly
+ * The queue send task is implemented by the vQueueSendTask() function in
+ * this file.  vQueueSendTask() sits in a loop that causes it to repeatedly
  * block for 1000 milliseconds, before sending the value 100 to the queue that
  * was created within main().  Once the value is sent, the task loops
  * back around to block for another 1000 milliseconds...and so on.
  *
  * The Queue Receive Task:
- * The queue receive task is implemented by the prvQueueReceiveTask() function
- * in this file.  prvQueueReceiveTask() sits in a loop where it repeatedly
+ * The queue receive task is implemented by the vQueueReceiveTask() function
+ * in this file.  vQueueReceiveTask() sits in a loop where it repeatedly
  * blocks on attempts to read data from the queue that was created within
  * blinky().  When data is received, the task checks the value of the
  * data, and if the value equals the expected 100, writes 'Blink' to the UART
@@ -41,6 +41,27 @@
 #include "task.h"
 #include "queue.h"
 
+/* Application includes. */
+#include "bench.h"
+#include "block_ops.h"
+#include "cache_layout.h"
+#include "critical_profiler.h"
+#include "criticality.h"
+#include "flow_control.h"
+#include "hart_launch.h"
+#include "hart_local.h"
+#include "idle_sleep.h"
+#include "led_pattern.h"
+#include "lwtask.h"
+#include "preempt_threshold.h"
+#include "queue_monitor.h"
+#include "queue_stats.h"
+#include "task_budget.h"
+#include "task_manifest.h"
+#include "telemetry.h"
+#include "timer_wheel.h"
+#include "vec_kernels.h"
+
 /* Freedom metal includes. */
 #include <metal/machine.h>
 #include <metal/machine/platform.h>
@@ -56,13 +77,13 @@
 
 extern struct metal_led *led0_red, *led0_green, *led0_blue;
 
-/* Priorities used by the tasks. */
-#define mainQUEUE_RECEIVE_TASK_PRIORITY		( tskIDLE_PRIORITY + 2 )
-#define	mainQUEUE_SEND_TASK_PRIORITY		( tskIDLE_PRIORITY + 1 )
+/* The names, priorities and stacks of the tasks are declared in
+task_manifest.h. */
 
-/* The rate at which data is sent to the queue.  The 200ms value is converted
-to ticks using the pdMS_TO_TICKS() macro. */
-#define mainQUEUE_SEND_FREQUENCY_MS			pdMS_TO_TICKS( 1000 )
+/* The rate at which data is sent to the queue, declared with the send task in
+the manifest.  The value is converted to ticks using the pdMS_TO_TICKS()
+macro. */
+#define mainQUEUE_SEND_FREQUENCY_MS			pdMS_TO_TICKS( taskmanifestQUEUE_SEND_PERIOD_MS )
 
 /* The maximum number items the queue can hold.  The priority of the receiving
 task is above the priority of the sending task, so the receiving task will
@@ -79,16 +100,41 @@ find the queue full. */
  */
 static void prvSetupHardware( void );
 
+#if( configUSE_LED_PATTERN == 1 )
 /*
- * The tasks as described in the comments at the top of this file.
+ * Hands the green and blue LEDs to the LED pattern engine.
  */
-static void prvQueueReceiveTask( void *pvParameters );
-static void prvQueueSendTask( void *pvParameters );
+static void prvSetupLedPatterns( void );
+#endif
 
 /*-----------------------------------------------------------*/
 
+/* The item of the queue.  With configUSE_QUEUE_STATS it also carries the
+time it was sent (queue_stats.h). */
+typedef struct
+{
+#if( configUSE_QUEUE_STATS == 1 )
+	QueueStamp_t xStamp;
+#endif
+	uint32_t ulValue;
+} QueueMessage_t;
+
 /* The queue used by both tasks. */
 static QueueHandle_t xQueue = NULL;
+static StaticQueue_t xQueueBuffer;
+static uint8_t ucQueueStorage[ mainQUEUE_LENGTH * sizeof( QueueMessage_t ) ];
+
+#if( configUSE_QUEUE_STATS == 1 )
+/* Latency of the messages from the send task to the receive task. */
+static QueueStats_t xQueueStats;
+#endif
+
+#if( configUSE_FLOW_CONTROL == 1 )
+/* Flow control of the send task: if the receive task stalls, the oldest
+message gives way to the new one instead of the send failing. */
+static FlowControl_t xSendFlow;
+static QueueMessage_t xSendFlowBuffer;
+#endif
 
 struct metal_cpu *cpu0;
 struct metal_interrupt *cpu_intr, *tmr_intr;
@@ -96,17 +142,48 @@ struct metal_led *led0_red, *led0_green, *led0_blue;
 
 #define LED_ERROR ((led0_red == NULL) || (led0_green == NULL) || (led0_blue == NULL))
 
-METAL_LOCK_DECLARE(my_lock);
+#if( configUSE_LED_PATTERN == 1 )
+/* Pattern engine channel of the green LED, flashed on every received value. */
+static BaseType_t xGreenLedChannel = -1;
+#endif
+
+#if( configUSE_TELEMETRY == 1 )
+/* Counters of the two tasks, one block each as a block has a single writer. */
+typedef struct
+{
+	uint64_t ullSent;
+} SendStats_t;
+
+typedef struct
+{
+	uint64_t ullReceived;
+	uint64_t ullUnexpected;
+} ReceiveStats_t;
+
+static const char * const pcSendFields[] = { "sent" };
+static const char * const pcReceiveFields[] = { "received", "unexpected" };
+
+static telemetryBLOCK( SendStats_t ) xSendTelemetry;
+static telemetryBLOCK( ReceiveStats_t ) xReceiveTelemetry;
+#endif
+
+/* The lock, the start flag and the check-in count are spun on by every hart
+at boot: each is on a cache line of its own (cache_layout.h), so that the
+spinning harts do not take away the line of the globals next to them.  The
+lock is padded to a whole line, as the section METAL_LOCK_DECLARE() puts it
+in may hold other locks right after it. */
+__attribute__((section(".data.locks"))) cachelayoutLINE( struct metal_lock ) my_lock;
+cachelayoutASSERT_ISOLATED( __typeof__( my_lock ) );
 
 int main(void);
 int other_main();
 
 /* This flag tells the secondary harts when to start to make sure
  * that they wait until the lock is initialized */
-volatile int _start_other = 0;
+cachelayoutLINE( volatile int ) _start_other = { 0 };
 
 /* This is a count of the number of harts who have executed their main function */
-volatile int checkin_count = 0;
+cachelayoutLINE( volatile int ) checkin_count = { 0 };
 
 /* The secondary_main() function can be redefined to start execution
  * on secondary harts. We redefine it here to cause harts with
@@ -115,8 +192,13 @@ int secondary_main(void) {
 	const char * const pcFailMessage = "Failed to initialize my_lock\r\n";
 	int hartid = metal_cpu_get_current_hartid();
 
+#if( configUSE_HART_LOCAL == 1 )
+	/* Before anything that looks up the hart through tp. */
+	vHartLocalInit( hartid );
+#endif
+
 	if(hartid == 0) {
-		int rc = metal_lock_init(&my_lock);
+		int rc = metal_lock_init(&my_lock.xValue);
 		if(rc != 0) {
 			write( STDOUT_FILENO, pcFailMessage, strlen( pcFailMessage ) );
 			for( ;; );
@@ -126,7 +208,7 @@ int secondary_main(void) {
 		 * _start_other */
 		__asm__ ("fence rw,w"); /* Release semantics */
 
-		_start_other = 1;
+		_start_other.xValue = 1;
 
 		return main();
 	} else {
@@ -137,17 +219,30 @@ int secondary_main(void) {
 int other_main(int hartid) {
 	const char * const pcMessage = "Other Hart Init\r\n";
 
-	while(!_start_other) ;	
+	while(!_start_other.xValue) ;	
 
-	metal_lock_take(&my_lock);
+	metal_lock_take(&my_lock.xValue);
 	write( STDOUT_FILENO, pcMessage, strlen( pcMessage ) );
-	checkin_count += 1;
+	checkin_count.xValue += 1;
 
-	metal_lock_give(&my_lock);
+	metal_lock_give(&my_lock.xValue);
 
+#if( configUSE_IDLE_SLEEP == 1 )
+	vIdleSleepInit( hartid );
+#endif
+
+#if( configUSE_HART_LAUNCH == 1 )
+	/* Wait for work from hart 0. */
+	vHartLaunchSecondaryLoop( hartid );
+#elif( configUSE_IDLE_SLEEP == 1 )
+	while(1) {
+		vIdleSleep( hartid );
+	}
+#else
 	while(1) {
 		__asm__("wfi");
 	}
+#endif
 }
 
 /*-----------------------------------------------------------*/
@@ -159,20 +254,72 @@ int main( void )
 	write( STDOUT_FILENO, pcMessage, strlen( pcMessage ) );
 
 	/* Create the queue. */
-	xQueue = xQueueCreate( mainQUEUE_LENGTH, sizeof( uint32_t ) );
+	xQueue = xQueueCreateStatic( mainQUEUE_LENGTH, sizeof( QueueMessage_t ), ucQueueStorage, &xQueueBuffer );
 
 	if( xQueue != NULL )
 	{
+#if( configUSE_TASK_BUDGET == 1 )
+		/* Before the manifest, which turns the worst case execution times of
+		its tasks into budgets. */
+		vTaskBudgetInit();
+#endif
+
+#if( configUSE_CRITICALITY == 1 )
+		/* Before the manifest, which registers its tasks. */
+		vCriticalityInit();
+#endif
+
 		/* Start the two tasks as described in the comments at the top of this
-		file. */
-		xTaskCreate( prvQueueReceiveTask,				/* The function that implements the task. */
-					"Rx", 								/* The text name assigned to the task - for debug only as it is not used by the kernel. */
-					configMINIMAL_STACK_SIZE, 			/* The size of the stack to allocate to the task. */
-					NULL, 								/* The parameter passed to the task - not used in this case. */
-					mainQUEUE_RECEIVE_TASK_PRIORITY, 	/* The priority assigned to the task. */
-					NULL );								/* The task handle is not required, so NULL is passed. */
+		file, from the static buffers of the task manifest. */
+		vTaskManifestCreate();
+
+#if( configUSE_TELEMETRY == 1 )
+		telemetryREGISTER( xSendTelemetry, "tx", pcSendFields );
+		telemetryREGISTER( xReceiveTelemetry, "rx", pcReceiveFields );
+		vTelemetryInit();
+#endif
+
+#if( configUSE_QUEUE_STATS == 1 )
+		vQueueStatsRegister( &xQueueStats, xQueue, "queue" );
+#elif( configUSE_QUEUE_MONITOR == 1 )
+		vQueueMonitorSetName( xQueue, "queue" );
+#endif
+
+#if( configUSE_FLOW_CONTROL == 1 )
+		vFlowControlInit( &xSendFlow, xQueue, sizeof( QueueMessage_t ), flowcontrolDROP_OLDEST, 0, &xSendFlowBuffer, "tx_flow" );
+#endif
+
+#if( configUSE_CRITICAL_PROFILER == 1 )
+		vCriticalProfilerInit();
+#endif
+
+#if( configUSE_IDLE_SLEEP == 1 )
+		vIdleSleepInit( 0 );
+#endif
+
+#if( configUSE_TIMER_WHEEL == 1 )
+		vTimerWheelInit();
+#endif
+
+#if( configUSE_LED_PATTERN == 1 )
+		prvSetupLedPatterns();
+#endif
+
+#if( configUSE_LWTASK == 1 )
+		vLwTaskSchedulerInit();
+#endif
+
+#if( configUSE_BLOCK_OPS == 1 )
+		vBlockOpsInit();
+#endif
+
+#if( configUSE_VECTOR_KERNELS == 1 )
+		vVecKernelsInit();
+#endif
 
-		xTaskCreate( prvQueueSendTask, "TX", configMINIMAL_STACK_SIZE, NULL, mainQUEUE_SEND_TASK_PRIORITY, NULL );
+#if( configUSE_BENCHMARKS == 1 )
+		vBenchStart();
+#endif
 
 		/* Start the tasks and timer running. */
 		vTaskStartScheduler();
@@ -188,11 +335,14 @@ int main( void )
 }
 /*-----------------------------------------------------------*/
 
-static void prvQueueSendTask( void *pvParameters )
+void vQueueSendTask( void *pvParameters )
 {
 	TickType_t xNextWakeTime;
 	const unsigned long ulValueToSend = 100UL;
+	QueueMessage_t xMessage;
+#if( configUSE_FLOW_CONTROL == 0 )
 	BaseType_t xReturned;
+#endif
 
 	/* Remove compiler warning about unused parameter. */
 	( void ) pvParameters;
@@ -202,27 +352,58 @@ static void prvQueueSendTask( void *pvParameters )
 
 	for( ;; )
 	{
+#if( configUSE_LED_PATTERN == 0 )
 		if ( led0_green != NULL ) 
 		{
 			/* Switch off the Green led */
         	metal_led_on(led0_green);
 		}
+#endif
 
 		/* Place this task in the blocked state until it is time to run again. */
+#if( configUSE_CRITICALITY == 1 )
+		vCriticalityDelayUntil( &xNextWakeTime, mainQUEUE_SEND_FREQUENCY_MS );
+#else
 		vTaskDelayUntil( &xNextWakeTime, mainQUEUE_SEND_FREQUENCY_MS );
+#endif
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+		/* Rx, woken by the send below, waits for this task to block again
+		instead of preempting it (threshold in task_manifest.h). */
+		vPreemptThresholdRaise();
+#endif
 
+		xMessage.ulValue = ulValueToSend;
+#if( configUSE_QUEUE_STATS == 1 )
+		vQueueStatsStamp( &xMessage.xStamp );
+#endif
+
+#if( configUSE_FLOW_CONTROL == 1 )
+		/* Send to the queue - causing the queue receive task to unblock and
+		toggle the LED.  Should the receive task stall, its stale message is
+		replaced, and counted, rather than the system halting. */
+		( void ) xFlowControlSend( &xSendFlow, &xMessage );
+#else
 		/* Send to the queue - causing the queue receive task to unblock and
 		toggle the LED.  0 is used as the block time so the sending operation
 		will not block - it shouldn't need to block as the queue should always
 		be empty at this point in the code. */
-		xReturned = xQueueSend( xQueue, &ulValueToSend, 0U );
+		xReturned = xQueueSend( xQueue, &xMessage, 0U );
 		configASSERT( xReturned == pdPASS );
+#endif
+
+#if( configUSE_TELEMETRY == 1 )
+		vTelemetryUpdateBegin( &xSendTelemetry.xBlock );
+		xSendTelemetry.xStats.ullSent++;
+		vTelemetryUpdateEnd( &xSendTelemetry.xBlock );
+#endif
 	}
 }
 /*-----------------------------------------------------------*/
 
-static void prvQueueReceiveTask( void *pvParameters )
+void vQueueReceiveTask( void *pvParameters )
 {
+	QueueMessage_t xMessage;
 	unsigned long ulReceivedValue;
 	const unsigned long ulExpectedValue = 100UL;
 	const char * const pcPassMessage = "Blink\r\n";
@@ -236,20 +417,40 @@ static void prvQueueReceiveTask( void *pvParameters )
 		/* Wait until something arrives in the queue - this task will block
 		indefinitely provided INCLUDE_vTaskSuspend is set to 1 in
 		FreeRTOSConfig.h. */
-		xQueueReceive( xQueue, &ulReceivedValue, portMAX_DELAY );
+#if( configUSE_QUEUE_STATS == 1 )
+		xQueueStatsReceive( &xQueueStats, &xMessage, portMAX_DELAY );
+#else
+		xQueueReceive( xQueue, &xMessage, portMAX_DELAY );
+#endif
+		ulReceivedValue = xMessage.ulValue;
 
 		/*  To get here something must have been received from the queue, but
 		is it the expected value?  If it is, toggle the LED. */
+#if( configUSE_TELEMETRY == 1 )
+		vTelemetryUpdateBegin( &xReceiveTelemetry.xBlock );
+		xReceiveTelemetry.xStats.ullReceived++;
+		if( ulReceivedValue != ulExpectedValue )
+		{
+			xReceiveTelemetry.xStats.ullUnexpected++;
+		}
+		vTelemetryUpdateEnd( &xReceiveTelemetry.xBlock );
+#endif
+
 		if( ulReceivedValue == ulExpectedValue )
 		{
 			write( STDOUT_FILENO, pcPassMessage, strlen( pcPassMessage ) );
 			ulReceivedValue = 0U;
 
+#if( configUSE_LED_PATTERN == 1 )
+			/* Flash the Green led, the engine switches it off again */
+			vLedPatternPlay( xGreenLedChannel, &xLedPatternFlash );
+#else
 			if ( led0_green != NULL ) 
 			{
 				/* Switch on the Green led */
 				metal_led_off(led0_green);
 			}
+#endif
 		}
 		else
 		{
@@ -268,13 +469,13 @@ static void prvSetupHardware( void )
 
 	int num_harts = metal_cpu_get_num_harts();
 
-	metal_lock_take(&my_lock);
+	metal_lock_take(&my_lock.xValue);
 
-	checkin_count += 1;
+	checkin_count.xValue += 1;
 
-	metal_lock_give(&my_lock);
+	metal_lock_give(&my_lock.xValue);
 
-	while(checkin_count != num_harts) ;
+	while(checkin_count.xValue != num_harts) ;
 
 	cpu = metal_cpu_get(metal_cpu_get_current_hartid());
 	if (cpu == NULL) {
@@ -341,6 +542,21 @@ static void prvSetupHardware( void )
 }
 /*-----------------------------------------------------------*/
 
+#if( configUSE_LED_PATTERN == 1 )
+static void prvSetupLedPatterns( void )
+{
+	vLedPatternInit();
+
+	/* The red LED stays under direct control of the error hooks below. */
+	if ( !LED_ERROR )
+	{
+		xGreenLedChannel = xLedPatternAddLed( led0_green );
+		vLedPatternPlay( xLedPatternAddLed( led0_blue ), &xLedPatternBreathe );
+	}
+}
+/*-----------------------------------------------------------*/
+#endif
+
 
 void vApplicationMallocFailedHook( void )
 {
@@ -377,6 +593,10 @@ void vApplicationIdleHook( void )
 	important that vApplicationIdleHook() is permitted to return to its calling
 	function, because it is the responsibility of the idle task to clean up
 	memory allocated by the kernel to any task that has since been deleted. */
+
+#if( configUSE_IDLE_SLEEP == 1 )
+	vIdleSleepHook();
+#endif
 }
 /*-----------------------------------------------------------*/
 
@@ -407,9 +627,46 @@ void vApplicationStackOverflowHook( TaskHandle_t pxTask, char *pcTaskName )
 void vApplicationTickHook( void )
 {
 	/* The tests in the full demo expect some interaction with interrupts. */
+
+#if( configUSE_CRITICAL_PROFILER == 1 )
+	vCriticalProfilerTick();
+#endif
+
+#if( configUSE_TASK_BUDGET == 1 )
+	vTaskBudgetTick();
+#endif
 }
 /*-----------------------------------------------------------*/
 
+#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize )
+{
+static StaticTask_t xIdleTaskTCB;
+static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+	/* configSUPPORT_STATIC_ALLOCATION is set to 1, so the application must
+	provide the memory used by the idle task. */
+	*ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+	*ppxIdleTaskStackBuffer = uxIdleTaskStack;
+	*pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize )
+{
+static StaticTask_t xTimerTaskTCB;
+static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+	/* Same for the timer service task, as configUSE_TIMERS is set to 1. */
+	*ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+	*ppxTimerTaskStackBuffer = uxTimerTaskStack;
+	*pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configSUPPORT_STATIC_ALLOCATION */
+
 void vAssertCalled( void )
 {
 volatile uint32_t ulSetTo1ToExitFunction = 0;
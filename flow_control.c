@@ -0,0 +1,310 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "flow_control.h"
+
+#if( configUSE_FLOW_CONTROL == 1 )
+
+#if( configUSE_COUNTING_SEMAPHORES != 1 )
+	#error The credits are counting semaphores, set configUSE_COUNTING_SEMAPHORES to 1
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+#if( configUSE_TELEMETRY == 1 )
+
+static const char * const pcFlowControlFields[] =
+{
+	"sent", "dropped_newest", "dropped_oldest", "coalesced", "timeouts", "no_credit"
+};
+
+/* Only the producer counts, so the block has a single writer. */
+#define flowcontrolCOUNT( pxFlow, xCounter )								\
+	do {																	\
+		vTelemetryUpdateBegin( &( ( pxFlow )->xTelemetry.xBlock ) );		\
+		( pxFlow )->xTelemetry.xStats.xCounter++;							\
+		vTelemetryUpdateEnd( &( ( pxFlow )->xTelemetry.xBlock ) );			\
+	} while( 0 )
+
+#else
+
+#define flowcontrolCOUNT( pxFlow, xCounter )
+
+#endif /* configUSE_TELEMETRY */
+
+/*-----------------------------------------------------------*/
+
+void vFlowControlInit( FlowControl_t *pxFlow, QueueHandle_t xQueue, UBaseType_t uxItemSize, FlowControlPolicy_t ePolicy,
+					   TickType_t xTimeout, void *pvBuffer, const char *pcName )
+{
+	configASSERT( xQueue != NULL );
+	configASSERT( ( pvBuffer != NULL ) || ( ( ePolicy != flowcontrolDROP_OLDEST ) && ( ePolicy != flowcontrolCOALESCE ) ) );
+
+	pxFlow->xQueue = xQueue;
+	pxFlow->uxItemSize = uxItemSize;
+	pxFlow->ePolicy = ePolicy;
+	pxFlow->xTimeout = xTimeout;
+	pxFlow->pvBuffer = pvBuffer;
+	pxFlow->xPending = pdFALSE;
+	pxFlow->pxCoalesce = NULL;
+	pxFlow->xCredits = NULL;
+
+#if( configUSE_TELEMETRY == 1 )
+	memset( &( pxFlow->xTelemetry.xStats ), 0, sizeof( pxFlow->xTelemetry.xStats ) );
+
+	if( pcName != NULL )
+	{
+		telemetryREGISTER( pxFlow->xTelemetry, pcName, pcFlowControlFields );
+	}
+#else
+	( void ) pcName;
+#endif
+}
+/*-----------------------------------------------------------*/
+
+void vFlowControlSetCoalesce( FlowControl_t *pxFlow, FlowControlCoalesce_t pxCoalesce )
+{
+	pxFlow->pxCoalesce = pxCoalesce;
+}
+/*-----------------------------------------------------------*/
+
+void vFlowControlEnableCredits( FlowControl_t *pxFlow, UBaseType_t uxCredits )
+{
+	/* More credits than spaces would let the queue fill up again. */
+	configASSERT( ( uxCredits > 0U ) && ( uxCredits <= ( uxQueueSpacesAvailable( pxFlow->xQueue ) + uxQueueMessagesWaiting( pxFlow->xQueue ) ) ) );
+
+	pxFlow->xCredits = xSemaphoreCreateCountingStatic( uxCredits, uxCredits, &( pxFlow->xCreditsBuffer ) );
+}
+/*-----------------------------------------------------------*/
+
+static inline BaseType_t prvTakeCredit( FlowControl_t *pxFlow, TickType_t xTicksToWait )
+{
+	if( pxFlow->xCredits == NULL )
+	{
+		return pdPASS;
+	}
+
+	return xSemaphoreTake( pxFlow->xCredits, xTicksToWait );
+}
+
+static inline void prvGiveCredit( FlowControl_t *pxFlow )
+{
+	if( pxFlow->xCredits != NULL )
+	{
+		( void ) xSemaphoreGive( pxFlow->xCredits );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvKeepAside( FlowControl_t *pxFlow, const void *pvItem )
+{
+	if( ( pxFlow->xPending != pdFALSE ) && ( pxFlow->pxCoalesce != NULL ) )
+	{
+		pxFlow->pxCoalesce( pxFlow->pvBuffer, pvItem );
+	}
+	else
+	{
+		memcpy( pxFlow->pvBuffer, pvItem, pxFlow->uxItemSize );
+	}
+
+	if( pxFlow->xPending != pdFALSE )
+	{
+		flowcontrolCOUNT( pxFlow, ullCoalesced );
+	}
+
+	pxFlow->xPending = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xFlowControlFlush( FlowControl_t *pxFlow )
+{
+	if( pxFlow->xPending == pdFALSE )
+	{
+		return pdPASS;
+	}
+
+	if( prvTakeCredit( pxFlow, 0 ) == pdFAIL )
+	{
+		return pdFAIL;
+	}
+
+	if( xQueueSend( pxFlow->xQueue, pxFlow->pvBuffer, 0 ) != pdPASS )
+	{
+		prvGiveCredit( pxFlow );
+		return pdFAIL;
+	}
+
+	pxFlow->xPending = pdFALSE;
+	flowcontrolCOUNT( pxFlow, ullSent );
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xFlowControlSend( FlowControl_t *pxFlow, const void *pvItem )
+{
+TickType_t xTicksToWait = ( pxFlow->ePolicy == flowcontrolBLOCK ) ? pxFlow->xTimeout : 0;
+
+	/* The item kept aside goes first, or the new one joins it. */
+	if( xFlowControlFlush( pxFlow ) == pdFAIL )
+	{
+		prvKeepAside( pxFlow, pvItem );
+		return pdPASS;
+	}
+
+	if( prvTakeCredit( pxFlow, xTicksToWait ) == pdFAIL )
+	{
+		flowcontrolCOUNT( pxFlow, ullNoCredit );
+
+		if( pxFlow->ePolicy == flowcontrolCOALESCE )
+		{
+			prvKeepAside( pxFlow, pvItem );
+			return pdPASS;
+		}
+
+		return pdFAIL;
+	}
+
+	if( xQueueSend( pxFlow->xQueue, pvItem, xTicksToWait ) == pdPASS )
+	{
+		flowcontrolCOUNT( pxFlow, ullSent );
+		return pdPASS;
+	}
+
+	/* The queue is full. */
+	switch( pxFlow->ePolicy )
+	{
+		case flowcontrolDROP_OLDEST:
+			/* Another producer may take the room first, then the new item is
+			dropped after all. */
+			if( xQueueReceive( pxFlow->xQueue, pxFlow->pvBuffer, 0 ) == pdPASS )
+			{
+				flowcontrolCOUNT( pxFlow, ullDroppedOldest );
+
+				if( xQueueSend( pxFlow->xQueue, pvItem, 0 ) == pdPASS )
+				{
+					flowcontrolCOUNT( pxFlow, ullSent );
+					return pdPASS;
+				}
+			}
+			break;
+
+		case flowcontrolCOALESCE:
+			prvGiveCredit( pxFlow );
+			prvKeepAside( pxFlow, pvItem );
+			return pdPASS;
+
+		case flowcontrolBLOCK:
+			if( xTicksToWait != 0U )
+			{
+				flowcontrolCOUNT( pxFlow, ullTimeouts );
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	prvGiveCredit( pxFlow );
+	flowcontrolCOUNT( pxFlow, ullDroppedNewest );
+
+	return pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+void vFlowControlReturnCredit( FlowControl_t *pxFlow )
+{
+	configASSERT( pxFlow->xCredits != NULL );
+
+	( void ) xSemaphoreGive( pxFlow->xCredits );
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxFlowControlCredits( FlowControl_t *pxFlow )
+{
+	if( pxFlow->xCredits == NULL )
+	{
+		return uxQueueSpacesAvailable( pxFlow->xQueue );
+	}
+
+	return uxSemaphoreGetCount( pxFlow->xCredits );
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * A burst of flowcontrolBENCH_ITEMS items into a queue of
+ * flowcontrolBENCH_LENGTH with nobody receiving, under each policy that does
+ * not wait.  The parameter is the number of sends that returned pdPASS.  Then
+ * the cost of a send with credits, received and credited back at once.
+ */
+#define flowcontrolBENCH_LENGTH		( 4U )
+#define flowcontrolBENCH_ITEMS		( 64U )
+
+static StaticQueue_t xBenchQueueBuffer;
+static uint8_t ucBenchQueueStorage[ flowcontrolBENCH_LENGTH * sizeof( uint32_t ) ];
+static FlowControl_t xBenchFlow;
+
+static void prvBenchBurst( QueueHandle_t xQueue, FlowControlPolicy_t ePolicy, const char *pcName )
+{
+uint32_t ulBuffer;
+uint32_t ulItem;
+uint32_t ulPassed = 0;
+uint64_t ullStart;
+
+	( void ) xQueueReset( xQueue );
+	vFlowControlInit( &xBenchFlow, xQueue, sizeof( uint32_t ), ePolicy, 0, &ulBuffer, NULL );
+
+	ullStart = ullTimestampCycles();
+
+	for( ulItem = 0; ulItem < flowcontrolBENCH_ITEMS; ulItem++ )
+	{
+		if( xFlowControlSend( &xBenchFlow, &ulItem ) == pdPASS )
+		{
+			ulPassed++;
+		}
+	}
+
+	vBenchReport( pcName, ulPassed, ullTimestampCycles() - ullStart, flowcontrolBENCH_ITEMS );
+}
+
+void vFlowControlBenchmark( void )
+{
+QueueHandle_t xQueue = xQueueCreateStatic( flowcontrolBENCH_LENGTH, sizeof( uint32_t ), ucBenchQueueStorage, &xBenchQueueBuffer );
+uint32_t ulItem;
+uint32_t ulReceived;
+uint64_t ullStart;
+
+	prvBenchBurst( xQueue, flowcontrolDROP_NEWEST, "flow_control.drop_newest" );
+	prvBenchBurst( xQueue, flowcontrolDROP_OLDEST, "flow_control.drop_oldest" );
+	prvBenchBurst( xQueue, flowcontrolCOALESCE, "flow_control.coalesce" );
+
+	( void ) xQueueReset( xQueue );
+	vFlowControlInit( &xBenchFlow, xQueue, sizeof( uint32_t ), flowcontrolDROP_NEWEST, 0, NULL, NULL );
+	vFlowControlEnableCredits( &xBenchFlow, flowcontrolBENCH_LENGTH );
+
+	ullStart = ullTimestampCycles();
+
+	for( ulItem = 0; ulItem < flowcontrolBENCH_ITEMS; ulItem++ )
+	{
+		( void ) xFlowControlSend( &xBenchFlow, &ulItem );
+		( void ) xQueueReceive( xQueue, &ulReceived, 0 );
+		vFlowControlReturnCredit( &xBenchFlow );
+	}
+
+	vBenchReport( "flow_control.credits", flowcontrolBENCH_LENGTH, ullTimestampCycles() - ullStart, flowcontrolBENCH_ITEMS );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_FLOW_CONTROL */
@@ -0,0 +1,113 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef FLOW_CONTROL_H
+#define FLOW_CONTROL_H
+
+/*
+ * Producer side flow control.
+ *
+ * xFlowControlSend() sends an item to a queue and, when the queue is full,
+ * applies the policy of the producer instead of failing:
+ *  - flowcontrolBLOCK: waits up to xTimeout for room, then drops the item;
+ *  - flowcontrolDROP_NEWEST: drops the item;
+ *  - flowcontrolDROP_OLDEST: discards the oldest item of the queue to make
+ *    room, so the consumer always gets the latest items;
+ *  - flowcontrolCOALESCE: keeps the item aside, merged with the items kept
+ *    aside before it (pxCoalesce, or the latest wins), and sends it ahead of
+ *    the next item once there is room, or on vFlowControlFlush().
+ *
+ * With credits, the producer may only have uxCredits items in flight: each
+ * send takes a credit, waiting up to xTimeout with flowcontrolBLOCK, and the
+ * consumer returns it with vFlowControlReturnCredit() once it is done with
+ * the item.  A producer can then slow down by itself as
+ * uxFlowControlCredits() drops, before anything is lost.  Without a credit
+ * the item is dropped, or kept aside with flowcontrolCOALESCE.
+ *
+ * A FlowControl_t has a single producer task.  With configUSE_TELEMETRY it
+ * publishes the items sent, dropped, coalesced and refused for lack of
+ * credit as the telemetry block pcName.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "telemetry.h"
+
+#if( configUSE_FLOW_CONTROL == 1 )
+
+typedef enum
+{
+	flowcontrolBLOCK = 0,
+	flowcontrolDROP_NEWEST,
+	flowcontrolDROP_OLDEST,
+	flowcontrolCOALESCE
+} FlowControlPolicy_t;
+
+/* Merges pvNew into pvPending, both items of the queue. */
+typedef void ( *FlowControlCoalesce_t )( void *pvPending, const void *pvNew );
+
+typedef struct
+{
+	uint64_t ullSent;
+	uint64_t ullDroppedNewest;
+	uint64_t ullDroppedOldest;
+	uint64_t ullCoalesced;
+	uint64_t ullTimeouts;			/* flowcontrolBLOCK waits that ended without room. */
+	uint64_t ullNoCredit;
+} FlowControlStats_t;
+
+/* The members are private to flow_control.c. */
+typedef struct xFLOW_CONTROL
+{
+	QueueHandle_t xQueue;
+	UBaseType_t uxItemSize;
+	FlowControlPolicy_t ePolicy;
+	TickType_t xTimeout;
+	void *pvBuffer;						/* One item, for the oldest item dropped or the item kept aside. */
+	BaseType_t xPending;				/* pvBuffer holds an item kept aside. */
+	FlowControlCoalesce_t pxCoalesce;
+	SemaphoreHandle_t xCredits;			/* NULL without credits. */
+	StaticSemaphore_t xCreditsBuffer;
+#if( configUSE_TELEMETRY == 1 )
+	telemetryBLOCK( FlowControlStats_t ) xTelemetry;
+#endif
+} FlowControl_t;
+
+/* Sets up pxFlow for sending items of uxItemSize bytes to xQueue.  pvBuffer
+holds one item, and is needed by flowcontrolDROP_OLDEST and
+flowcontrolCOALESCE.  pcName, if not NULL, publishes the statistics; call
+once per pxFlow with a name. */
+void vFlowControlInit( FlowControl_t *pxFlow, QueueHandle_t xQueue, UBaseType_t uxItemSize, FlowControlPolicy_t ePolicy,
+					   TickType_t xTimeout, void *pvBuffer, const char *pcName );
+
+/* How flowcontrolCOALESCE merges items, NULL for the latest item. */
+void vFlowControlSetCoalesce( FlowControl_t *pxFlow, FlowControlCoalesce_t pxCoalesce );
+
+/* Limits the items in flight to uxCredits, at most the length of the queue.
+Call once, before the first send. */
+void vFlowControlEnableCredits( FlowControl_t *pxFlow, UBaseType_t uxCredits );
+
+/* Sends pvItem under the policy of pxFlow.  Returns pdPASS if the item was
+sent or kept aside, pdFAIL if it was dropped. */
+BaseType_t xFlowControlSend( FlowControl_t *pxFlow, const void *pvItem );
+
+/* Sends the item kept aside, if any and if there is room.  Returns pdPASS
+if nothing is left aside. */
+BaseType_t xFlowControlFlush( FlowControl_t *pxFlow );
+
+/* Called by the consumer once done with an item, with credits. */
+void vFlowControlReturnCredit( FlowControl_t *pxFlow );
+
+/* Credits left, or the free spaces of the queue without credits. */
+UBaseType_t uxFlowControlCredits( FlowControl_t *pxFlow );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vFlowControlBenchmark( void );
+#endif
+
+#endif /* configUSE_FLOW_CONTROL */
+
+#endif /* FLOW_CONTROL_H */
@@ -0,0 +1,153 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cache_layout.h"
+#include "hart_launch.h"
+#include "idle_sleep.h"
+
+#include <metal/machine.h>
+
+#if( configUSE_HART_LAUNCH == 1 )
+
+#ifndef configCLINT_BASE_ADDRESS
+	#error No CLINT Base Address defined
+#endif
+
+/* Machine software interrupt enable bit of mie. */
+#define hartlaunchMIE_MSIE		( 1UL << 3 )
+
+/* One msip register per hart at the base of the CLINT. */
+#define hartlaunchMSIP( ulHartId )	( ( volatile uint32_t * ) ( configCLINT_BASE_ADDRESS + ( 4UL * ( ulHartId ) ) ) )
+
+/* Each mailbox is written by hart 0 and by its own hart only, so they are
+kept on separate cache lines. */
+typedef struct cachelayoutALIGNED xHART_MAILBOX
+{
+	volatile HartFunction_t pxFunction;		/* NULL when the hart is idle. */
+	void * volatile pvArgument;
+	volatile uint32_t ulReady;				/* Set once the hart waits for work. */
+} HartMailbox_t;
+
+cachelayoutASSERT_ISOLATED( HartMailbox_t );
+
+static HartMailbox_t xMailboxes[ __METAL_DT_MAX_HARTS ];
+
+/*-----------------------------------------------------------*/
+
+void vHartLaunchSecondaryLoop( uint32_t ulHartId )
+{
+HartMailbox_t *pxMailbox = &( xMailboxes[ ulHartId ] );
+HartFunction_t pxFunction;
+
+	/* Let msip end wfi.  mstatus.MIE stays clear so no trap is taken. */
+	__asm__ volatile( "csrs mie, %0" :: "r"( hartlaunchMIE_MSIE ) );
+
+	pxMailbox->ulReady = 1;
+
+	for( ;; )
+	{
+		/* Acknowledge before looking at the mailbox, so that a post made
+		after the check leaves msip set and wfi returns at once. */
+		*hartlaunchMSIP( ulHartId ) = 0;
+		__asm__ volatile( "fence iorw, iorw" ::: "memory" );
+
+		pxFunction = pxMailbox->pxFunction;
+
+		if( pxFunction == NULL )
+		{
+		#if( configUSE_IDLE_SLEEP == 1 )
+			vIdleSleep( ulHartId );
+		#else
+			__asm__ volatile( "wfi" );
+		#endif
+			continue;
+		}
+
+		/* Acquire: see the argument written before the function. */
+		__asm__ volatile( "fence r, rw" ::: "memory" );
+
+		pxFunction( pxMailbox->pvArgument );
+
+		/* Release: publish what the function wrote before going idle. */
+		__asm__ volatile( "fence rw, w" ::: "memory" );
+		pxMailbox->pxFunction = NULL;
+	}
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xHartLaunch( uint32_t ulHartId, HartFunction_t pxFunction, void *pvArgument )
+{
+HartMailbox_t *pxMailbox;
+BaseType_t xReturn = pdFAIL;
+
+	configASSERT( pxFunction != NULL );
+
+	if( ( ulHartId == 0U ) || ( ulHartId >= __METAL_DT_MAX_HARTS ) )
+	{
+		return pdFAIL;
+	}
+
+	pxMailbox = &( xMailboxes[ ulHartId ] );
+
+	/* Serialises the tasks posting to the same hart. */
+	taskENTER_CRITICAL();
+	{
+		if( ( pxMailbox->ulReady != 0U ) && ( pxMailbox->pxFunction == NULL ) )
+		{
+			pxMailbox->pvArgument = pvArgument;
+			__asm__ volatile( "fence rw, w" ::: "memory" );
+			pxMailbox->pxFunction = pxFunction;
+
+			/* The mailbox must be visible before the interrupt. */
+			__asm__ volatile( "fence w, o" ::: "memory" );
+			*hartlaunchMSIP( ulHartId ) = 1;
+
+			xReturn = pdPASS;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xHartLaunchIsIdle( uint32_t ulHartId )
+{
+	if( ( ulHartId == 0U ) || ( ulHartId >= __METAL_DT_MAX_HARTS ) )
+	{
+		return pdFALSE;
+	}
+
+	if( ( xMailboxes[ ulHartId ].ulReady == 0U ) || ( xMailboxes[ ulHartId ].pxFunction != NULL ) )
+	{
+		return pdFALSE;
+	}
+
+	/* Acquire: see what the function wrote. */
+	__asm__ volatile( "fence r, rw" ::: "memory" );
+
+	return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulHartLaunchGetHartCount( void )
+{
+uint32_t ulHartId;
+uint32_t ulCount = 0;
+
+	for( ulHartId = 1; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+	{
+		if( xMailboxes[ ulHartId ].ulReady != 0U )
+		{
+			ulCount++;
+		}
+	}
+
+	return ulCount;
+}
+
+#endif /* configUSE_HART_LAUNCH */
@@ -0,0 +1,48 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef HART_LAUNCH_H
+#define HART_LAUNCH_H
+
+/*
+ * Running code on the secondary harts.
+ *
+ * The kernel only runs on hart 0.  Once they have checked in, the other harts
+ * enter vHartLaunchSecondaryLoop() and sleep in wfi until xHartLaunch(),
+ * called from hart 0, posts a function to their mailbox and raises their
+ * machine software interrupt through the CLINT msip register.  The interrupt
+ * is only used to leave wfi: it is enabled in mie but not in mstatus, so no
+ * trap is taken and the secondary harts need no interrupt handler.
+ *
+ * The function runs on the small stack the start-up code gave the hart
+ * (__stack_size in the Makefile) and must not use the kernel API.  It can
+ * run forever, as a worker loop does.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#if( configUSE_HART_LAUNCH == 1 )
+
+typedef void ( *HartFunction_t )( void *pvArgument );
+
+/* Called by the secondary harts at the end of their start-up, never
+returns. */
+void vHartLaunchSecondaryLoop( uint32_t ulHartId ) __attribute__( ( noreturn ) );
+
+/* Posts pxFunction( pvArgument ) to ulHartId.  Returns pdFAIL if the hart is
+not waiting in vHartLaunchSecondaryLoop() or still runs a function. */
+BaseType_t xHartLaunch( uint32_t ulHartId, HartFunction_t pxFunction, void *pvArgument );
+
+/* pdTRUE if ulHartId waits in vHartLaunchSecondaryLoop() with nothing to
+run. */
+BaseType_t xHartLaunchIsIdle( uint32_t ulHartId );
+
+/* Secondary harts parked in vHartLaunchSecondaryLoop(), whether idle or
+not. */
+uint32_t ulHartLaunchGetHartCount( void );
+
+#endif /* configUSE_HART_LAUNCH */
+
+#endif /* HART_LAUNCH_H */
@@ -0,0 +1,109 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+#include "hart_local.h"
+
+#include <metal/cpu.h>
+
+#if( configUSE_HART_LOCAL == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+static HartLocal_t xBlocks[ __METAL_DT_MAX_HARTS ];
+
+cachelayoutASSERT_ISOLATED( HartLocal_t );
+
+/*-----------------------------------------------------------*/
+
+void vHartLocalInit( uint32_t ulHartId )
+{
+HartLocal_t *pxLocal;
+
+	configASSERT( ulHartId < __METAL_DT_MAX_HARTS );
+
+	pxLocal = &( xBlocks[ ulHartId ] );
+	memset( pxLocal, 0, sizeof( HartLocal_t ) );
+	pxLocal->ulHartId = ulHartId;
+
+	__asm__ volatile( "mv tp, %0" :: "r"( pxLocal ) : "memory" );
+}
+/*-----------------------------------------------------------*/
+
+HartLocal_t *pxHartLocalOf( uint32_t ulHartId )
+{
+	configASSERT( ulHartId < __METAL_DT_MAX_HARTS );
+
+	return &( xBlocks[ ulHartId ] );
+}
+/*-----------------------------------------------------------*/
+
+uintptr_t uxHartLocalCounterSum( uint32_t ulIndex )
+{
+uint32_t ulHartId;
+uintptr_t uxSum = 0;
+
+	configASSERT( ulIndex < configHART_LOCAL_COUNTERS );
+
+	for( ulHartId = 0; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+	{
+		uxSum += xBlocks[ ulHartId ].uxCounters[ ulIndex ];
+	}
+
+	return uxSum;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * hartlocalBENCH_ROUNDS increments of a per hart counter, found by reading
+ * mhartid and indexing a global array, by calling
+ * metal_cpu_get_current_hartid(), then through tp.  The increments of the
+ * hart-local counter are taken back afterwards.
+ */
+#define hartlocalBENCH_ROUNDS		( 1000U )
+#define hartlocalBENCH_COUNTER		( configHART_LOCAL_COUNTERS - 1U )
+
+static volatile uintptr_t uxBenchCounters[ __METAL_DT_MAX_HARTS ];
+
+void vHartLocalBenchmark( void )
+{
+uint64_t ullStart;
+uint32_t ulRound, ulHartId;
+
+	ullStart = ullTimestampCycles();
+	for( ulRound = 0; ulRound < hartlocalBENCH_ROUNDS; ulRound++ )
+	{
+		__asm__ volatile( "csrr %0, mhartid" : "=r"( ulHartId ) );
+		uxBenchCounters[ ulHartId ] = uxBenchCounters[ ulHartId ] + 1U;
+	}
+	vBenchReport( "hart_local.mhartid_index", 0, ullTimestampCycles() - ullStart, hartlocalBENCH_ROUNDS );
+
+	ullStart = ullTimestampCycles();
+	for( ulRound = 0; ulRound < hartlocalBENCH_ROUNDS; ulRound++ )
+	{
+		ulHartId = ( uint32_t ) metal_cpu_get_current_hartid();
+		uxBenchCounters[ ulHartId ] = uxBenchCounters[ ulHartId ] + 1U;
+	}
+	vBenchReport( "hart_local.metal_index", 0, ullTimestampCycles() - ullStart, hartlocalBENCH_ROUNDS );
+
+	ullStart = ullTimestampCycles();
+	for( ulRound = 0; ulRound < hartlocalBENCH_ROUNDS; ulRound++ )
+	{
+		vHartLocalIncrement( hartlocalBENCH_COUNTER );
+	}
+	vBenchReport( "hart_local.tp", 0, ullTimestampCycles() - ullStart, hartlocalBENCH_ROUNDS );
+
+	vHartLocalAdd( hartlocalBENCH_COUNTER, ( uintptr_t ) 0U - hartlocalBENCH_ROUNDS );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_HART_LOCAL */
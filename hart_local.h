@@ -0,0 +1,123 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef HART_LOCAL_H
+#define HART_LOCAL_H
+
+/*
+ * Hart-local storage through the tp register.
+ *
+ * Each hart calls vHartLocalInit() at boot, which points its tp at its own
+ * HartLocal_t, one or more whole cache lines.  The hart then finds its id,
+ * its pointers (run queue, log buffer, ...) and its counters with a load
+ * from tp, instead of reading mhartid or calling
+ * metal_cpu_get_current_hartid() and indexing a global array.
+ *
+ * The FreeRTOS RISC-V port does not save tp with the context of the tasks,
+ * and no interrupt handler changes it, so the tasks of hart 0 all see the
+ * block of hart 0.  The application takes tp over from the ABI: __thread
+ * variables must not be used.
+ *
+ * The slots and counters are written by their own hart only.  Another hart
+ * reads them with uxHartLocalCounterOf() and pvHartLocalGetOf(), one aligned
+ * word at a time.  On hart 0 an increment is not atomic against preemption:
+ * a counter updated by several tasks is updated in a critical section.
+ * With configUSE_IDLE_SLEEP, slot configIDLE_SLEEP_HART_LOCAL_SLOT belongs to
+ * idle_sleep.c.
+ *
+ *	#define mainLOG_SLOT		0
+ *	#define mainJOBS_COUNTER	0
+ *
+ *	vHartLocalSet( mainLOG_SLOT, &xLogBuffer );
+ *	vHartLocalIncrement( mainJOBS_COUNTER );
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "cache_layout.h"
+
+#include <metal/machine.h>
+
+#if( configUSE_HART_LOCAL == 1 )
+
+/* The members are private to hart_local.c, read through the inline functions
+below. */
+typedef struct cachelayoutALIGNED xHART_LOCAL
+{
+	uint32_t ulHartId;
+	void * volatile pvSlots[ configHART_LOCAL_SLOTS ];
+	volatile uintptr_t uxCounters[ configHART_LOCAL_COUNTERS ];
+} HartLocal_t;
+
+/* Called once by each hart, on that hart, first thing after start-up. */
+void vHartLocalInit( uint32_t ulHartId );
+
+/* The block of another hart, to read its slots and counters. */
+HartLocal_t *pxHartLocalOf( uint32_t ulHartId );
+
+/* The block of the calling hart. */
+static inline HartLocal_t *pxHartLocal( void )
+{
+HartLocal_t *pxLocal;
+
+	/* volatile, so that the read is not moved above vHartLocalInit(). */
+	__asm__ volatile( "mv %0, tp" : "=r"( pxLocal ) );
+
+	return pxLocal;
+}
+
+static inline uint32_t ulHartLocalId( void )
+{
+	return pxHartLocal()->ulHartId;
+}
+
+static inline void *pvHartLocalGet( uint32_t ulIndex )
+{
+	return pxHartLocal()->pvSlots[ ulIndex ];
+}
+
+static inline void vHartLocalSet( uint32_t ulIndex, void *pvValue )
+{
+	pxHartLocal()->pvSlots[ ulIndex ] = pvValue;
+}
+
+static inline void vHartLocalIncrement( uint32_t ulIndex )
+{
+HartLocal_t *pxLocal = pxHartLocal();
+
+	pxLocal->uxCounters[ ulIndex ] = pxLocal->uxCounters[ ulIndex ] + 1U;
+}
+
+static inline void vHartLocalAdd( uint32_t ulIndex, uintptr_t uxValue )
+{
+HartLocal_t *pxLocal = pxHartLocal();
+
+	pxLocal->uxCounters[ ulIndex ] = pxLocal->uxCounters[ ulIndex ] + uxValue;
+}
+
+static inline uintptr_t uxHartLocalCounter( uint32_t ulIndex )
+{
+	return pxHartLocal()->uxCounters[ ulIndex ];
+}
+
+static inline void *pvHartLocalGetOf( uint32_t ulHartId, uint32_t ulIndex )
+{
+	return pxHartLocalOf( ulHartId )->pvSlots[ ulIndex ];
+}
+
+static inline uintptr_t uxHartLocalCounterOf( uint32_t ulHartId, uint32_t ulIndex )
+{
+	return pxHartLocalOf( ulHartId )->uxCounters[ ulIndex ];
+}
+
+/* The sum of counter ulIndex over the harts. */
+uintptr_t uxHartLocalCounterSum( uint32_t ulIndex );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vHartLocalBenchmark( void );
+#endif
+
+#endif /* configUSE_HART_LOCAL */
+
+#endif /* HART_LOCAL_H */
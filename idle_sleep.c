@@ -0,0 +1,187 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "idle_sleep.h"
+#include "telemetry.h"
+#include "timestamp.h"
+
+#include <metal/machine.h>
+
+#if( configUSE_IDLE_SLEEP == 1 )
+
+#if( configUSE_TELEMETRY != 1 )
+	#error The sleep accounting is published through telemetry, set configUSE_TELEMETRY to 1
+#endif
+
+#if( configUSE_IDLE_HOOK != 1 )
+	#error Hart 0 sleeps from the idle hook, set configUSE_IDLE_HOOK to 1
+#endif
+
+#if( configUSE_HART_LOCAL == 1 )
+	#include "hart_local.h"
+
+	#if( configIDLE_SLEEP_HART_LOCAL_SLOT >= configHART_LOCAL_SLOTS )
+		#error configHART_LOCAL_SLOTS must include configIDLE_SLEEP_HART_LOCAL_SLOT
+	#endif
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* "sleep" and up to three digits. */
+#define idlesleepNAME_LENGTH	( 9U )
+
+typedef struct
+{
+	uint64_t ullSleeps;
+	uint64_t ullSleepTime;
+	uint64_t ullElapsedTime;
+	uint64_t ullBusyPermille;
+	uint64_t ullAsleepSince;
+} SleepStats_t;
+
+typedef struct
+{
+	telemetryBLOCK( SleepStats_t ) xTelemetry;
+	uint64_t ullInitTime;
+	char cName[ idlesleepNAME_LENGTH ];
+} HartSleep_t;
+
+static const char * const pcSleepFields[] =
+{
+	"sleeps", "sleep_mtime", "elapsed_mtime", "busy_permille", "asleep_since"
+};
+
+/* Each entry is only written by its own hart. */
+static HartSleep_t xHarts[ __METAL_DT_MAX_HARTS ];
+
+/*-----------------------------------------------------------*/
+
+/* The entry of the calling hart: with configUSE_HART_LOCAL, one load through
+tp, set by vIdleSleepInit(). */
+static inline HartSleep_t *prvHart( uint32_t ulHartId )
+{
+#if( configUSE_HART_LOCAL == 1 )
+	( void ) ulHartId;
+
+	return ( HartSleep_t * ) pvHartLocalGet( configIDLE_SLEEP_HART_LOCAL_SLOT );
+#else
+	return &( xHarts[ ulHartId ] );
+#endif
+}
+/*-----------------------------------------------------------*/
+
+void vIdleSleepInit( uint32_t ulHartId )
+{
+HartSleep_t *pxHart = &( xHarts[ ulHartId ] );
+char cDigits[ 3 ];
+uint32_t ulDigits = 0;
+uint32_t ulIndex = 0;
+
+	configASSERT( ulHartId < __METAL_DT_MAX_HARTS );
+
+	do
+	{
+		cDigits[ ulDigits++ ] = ( char ) ( '0' + ( ulHartId % 10U ) );
+		ulHartId /= 10U;
+	} while( ( ulHartId != 0U ) && ( ulDigits < sizeof( cDigits ) ) );
+
+	for( ; ulIndex < 5U; ulIndex++ )
+	{
+		pxHart->cName[ ulIndex ] = "sleep"[ ulIndex ];
+	}
+
+	while( ulDigits > 0U )
+	{
+		pxHart->cName[ ulIndex++ ] = cDigits[ --ulDigits ];
+	}
+
+	pxHart->cName[ ulIndex ] = '\0';
+
+	pxHart->ullInitTime = ullTimestampTime();
+
+#if( configUSE_HART_LOCAL == 1 )
+	vHartLocalSet( configIDLE_SLEEP_HART_LOCAL_SLOT, pxHart );
+#endif
+
+	telemetryREGISTER( pxHart->xTelemetry, pxHart->cName, pcSleepFields );
+}
+/*-----------------------------------------------------------*/
+
+void vIdleSleep( uint32_t ulHartId )
+{
+HartSleep_t *pxHart = prvHart( ulHartId );
+SleepStats_t *pxStats = &( pxHart->xTelemetry.xStats );
+uint64_t ullStart;
+uint64_t ullEnd;
+uint64_t ullElapsed;
+
+	ullStart = ullTimestampTime();
+
+	vTelemetryUpdateBegin( &( pxHart->xTelemetry.xBlock ) );
+	pxStats->ullAsleepSince = ullStart;
+	vTelemetryUpdateEnd( &( pxHart->xTelemetry.xBlock ) );
+
+	__asm__ volatile( "wfi" ::: "memory" );
+
+	ullEnd = ullTimestampTime();
+	ullElapsed = ullEnd - pxHart->ullInitTime;
+
+	vTelemetryUpdateBegin( &( pxHart->xTelemetry.xBlock ) );
+
+	pxStats->ullSleeps++;
+	pxStats->ullSleepTime += ullEnd - ullStart;
+	pxStats->ullElapsedTime = ullElapsed;
+	pxStats->ullAsleepSince = 0;
+
+	if( ullElapsed != 0U )
+	{
+		pxStats->ullBusyPermille = ( ( ullElapsed - pxStats->ullSleepTime ) * 1000U ) / ullElapsed;
+	}
+
+	vTelemetryUpdateEnd( &( pxHart->xTelemetry.xBlock ) );
+}
+/*-----------------------------------------------------------*/
+
+void vIdleSleepHook( void )
+{
+	/* The idle task only runs when no other task is ready.  With interrupts
+	disabled, one raised since then still ends wfi at once, and is taken after
+	the sleep is accounted rather than in the middle of it. */
+	taskDISABLE_INTERRUPTS();
+	vIdleSleep( 0 );
+	taskENABLE_INTERRUPTS();
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+void vIdleSleepBenchmark( void )
+{
+uint64_t ullStats[ sizeof( SleepStats_t ) / sizeof( uint64_t ) ];
+SleepStats_t *pxStats = ( SleepStats_t * ) ullStats;
+uint32_t ulHartId;
+
+	/* Utilisation of every hart since it started, and the mean time asleep
+	per wake up in mtime periods. */
+	for( ulHartId = 0; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+	{
+		if( ( xHarts[ ulHartId ].ullInitTime == 0U ) ||
+			( xTelemetrySnapshot( &( xHarts[ ulHartId ].xTelemetry.xBlock ), ullStats ) == pdFAIL ) )
+		{
+			continue;
+		}
+
+		vBenchReport( "idle_sleep.busy_permille", ulHartId, pxStats->ullBusyPermille, 1 );
+		vBenchReport( "idle_sleep.mtime_per_sleep", ulHartId, pxStats->ullSleepTime, ( uint32_t ) pxStats->ullSleeps );
+	}
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_IDLE_SLEEP */
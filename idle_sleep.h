@@ -0,0 +1,54 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef IDLE_SLEEP_H
+#define IDLE_SLEEP_H
+
+/*
+ * Idle sleep with per hart accounting.
+ *
+ * Hart 0 sleeps in wfi from the idle hook instead of spinning in the idle
+ * task, and the secondary harts sleep through the same function while they
+ * wait for work.  Each hart accounts the mtime periods it spends asleep in
+ * its own telemetry block, "sleep<hart>":
+ *
+ *	sleeps			number of wfi that returned
+ *	sleep_mtime		time asleep
+ *	elapsed_mtime	time since vIdleSleepInit(), at the last wake up
+ *	busy_permille	share of elapsed_mtime spent awake, the utilisation
+ *	asleep_since	mtime when the current sleep started, 0 if awake, so
+ *					that a hart that never wakes is still accounted
+ *
+ * busy_permille is also the energy proxy: the core clock is gated in wfi on
+ * the FE310 and U54 cores.
+ *
+ * Another task at tskIDLE_PRIORITY still gets its time slices, but the idle
+ * task sleeps until the next tick instead of yielding to it early.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#if( configUSE_IDLE_SLEEP == 1 )
+
+/* Called once by each hart, on that hart, before it first sleeps, and after
+vHartLocalInit() with configUSE_HART_LOCAL. */
+void vIdleSleepInit( uint32_t ulHartId );
+
+/* Waits in wfi for an interrupt enabled in mie, and accounts the time asleep
+to ulHartId, the calling hart, which is found through tp instead with
+configUSE_HART_LOCAL.  Called with interrupts disabled in mstatus, so that the
+interrupt that ends the sleep is only taken once the caller enables them. */
+void vIdleSleep( uint32_t ulHartId );
+
+/* Sleeps hart 0 from vApplicationIdleHook(). */
+void vIdleSleepHook( void );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vIdleSleepBenchmark( void );
+#endif
+
+#endif /* configUSE_IDLE_SLEEP */
+
+#endif /* IDLE_SLEEP_H */
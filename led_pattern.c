@@ -0,0 +1,413 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "led_pattern.h"
+
+#if( configUSE_LED_PATTERN == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+typedef struct xLED_CHANNEL
+{
+	struct metal_led *pxLed;
+	const LedPattern_t *pxPattern;	/* NULL when the channel is idle. */
+	uint16_t usTicksLeft;
+	uint8_t ucStep;
+	uint8_t ucLit;
+} LedChannel_t;
+
+/*-----------------------------------------------------------*/
+
+static const LedPatternStep_t xBlinkSteps[] =
+{
+	{ ledpatternLEVEL_MAX, pdMS_TO_TICKS( 500 ) },
+	{ 0, pdMS_TO_TICKS( 500 ) }
+};
+
+static const LedPatternStep_t xFlashSteps[] =
+{
+	{ ledpatternLEVEL_MAX, pdMS_TO_TICKS( 50 ) }
+};
+
+static const LedPatternStep_t xBreatheSteps[] =
+{
+	{ 0, pdMS_TO_TICKS( 60 ) }, { 1, pdMS_TO_TICKS( 60 ) }, { 2, pdMS_TO_TICKS( 60 ) }, { 3, pdMS_TO_TICKS( 60 ) },
+	{ 4, pdMS_TO_TICKS( 60 ) }, { 5, pdMS_TO_TICKS( 60 ) }, { 6, pdMS_TO_TICKS( 60 ) }, { 7, pdMS_TO_TICKS( 60 ) },
+	{ 8, pdMS_TO_TICKS( 60 ) }, { 9, pdMS_TO_TICKS( 60 ) }, { 10, pdMS_TO_TICKS( 60 ) }, { 11, pdMS_TO_TICKS( 60 ) },
+	{ 12, pdMS_TO_TICKS( 60 ) }, { 13, pdMS_TO_TICKS( 60 ) }, { 14, pdMS_TO_TICKS( 60 ) }, { 15, pdMS_TO_TICKS( 60 ) },
+	{ 15, pdMS_TO_TICKS( 60 ) }, { 14, pdMS_TO_TICKS( 60 ) }, { 13, pdMS_TO_TICKS( 60 ) }, { 12, pdMS_TO_TICKS( 60 ) },
+	{ 11, pdMS_TO_TICKS( 60 ) }, { 10, pdMS_TO_TICKS( 60 ) }, { 9, pdMS_TO_TICKS( 60 ) }, { 8, pdMS_TO_TICKS( 60 ) },
+	{ 7, pdMS_TO_TICKS( 60 ) }, { 6, pdMS_TO_TICKS( 60 ) }, { 5, pdMS_TO_TICKS( 60 ) }, { 4, pdMS_TO_TICKS( 60 ) },
+	{ 3, pdMS_TO_TICKS( 60 ) }, { 2, pdMS_TO_TICKS( 60 ) }, { 1, pdMS_TO_TICKS( 60 ) }, { 0, pdMS_TO_TICKS( 60 ) }
+};
+
+static const LedPatternStep_t xHeartbeatSteps[] =
+{
+	{ ledpatternLEVEL_MAX, pdMS_TO_TICKS( 80 ) },
+	{ 0, pdMS_TO_TICKS( 120 ) },
+	{ ledpatternLEVEL_MAX, pdMS_TO_TICKS( 80 ) },
+	{ 0, pdMS_TO_TICKS( 720 ) }
+};
+
+static const LedPatternStep_t xChaseSteps0[] =
+{
+	{ ledpatternLEVEL_MAX, pdMS_TO_TICKS( 200 ) },
+	{ 0, pdMS_TO_TICKS( 400 ) }
+};
+
+static const LedPatternStep_t xChaseSteps1[] =
+{
+	{ 0, pdMS_TO_TICKS( 200 ) },
+	{ ledpatternLEVEL_MAX, pdMS_TO_TICKS( 200 ) },
+	{ 0, pdMS_TO_TICKS( 200 ) }
+};
+
+static const LedPatternStep_t xChaseSteps2[] =
+{
+	{ 0, pdMS_TO_TICKS( 400 ) },
+	{ ledpatternLEVEL_MAX, pdMS_TO_TICKS( 200 ) }
+};
+
+ledpatternDEFINE( xLedPatternBlink, xBlinkSteps, pdTRUE );
+ledpatternDEFINE( xLedPatternFlash, xFlashSteps, pdFALSE );
+ledpatternDEFINE( xLedPatternBreathe, xBreatheSteps, pdTRUE );
+ledpatternDEFINE( xLedPatternHeartbeat, xHeartbeatSteps, pdTRUE );
+
+const LedPattern_t xLedPatternChase[ 3 ] =
+{
+	{ xChaseSteps0, ( uint8_t ) ( sizeof( xChaseSteps0 ) / sizeof( xChaseSteps0[ 0 ] ) ), pdTRUE },
+	{ xChaseSteps1, ( uint8_t ) ( sizeof( xChaseSteps1 ) / sizeof( xChaseSteps1[ 0 ] ) ), pdTRUE },
+	{ xChaseSteps2, ( uint8_t ) ( sizeof( xChaseSteps2 ) / sizeof( xChaseSteps2[ 0 ] ) ), pdTRUE }
+};
+
+/*-----------------------------------------------------------*/
+
+static LedChannel_t xChannels[ configLED_PATTERN_MAX_LEDS ];
+static UBaseType_t uxChannelCount = 0;
+
+static TimerHandle_t xPatternTimer = NULL;
+static BaseType_t xTimerRunning = pdFALSE;
+static uint8_t ucPwmPhase = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvSetLit( LedChannel_t *pxChannel, uint8_t ucLit )
+{
+	if( ( pxChannel->ucLit != ucLit ) && ( pxChannel->pxLed != NULL ) )
+	{
+	#if( configLED_PATTERN_ACTIVE_LOW == 1 )
+		/* The LEDs of the supported boards light up when the pin is low,
+		see prvSetupHardware(). */
+		if( ucLit != 0U )
+		{
+			metal_led_off( pxChannel->pxLed );
+		}
+		else
+		{
+			metal_led_on( pxChannel->pxLed );
+		}
+	#else
+		if( ucLit != 0U )
+		{
+			metal_led_on( pxChannel->pxLed );
+		}
+		else
+		{
+			metal_led_off( pxChannel->pxLed );
+		}
+	#endif
+	}
+
+	pxChannel->ucLit = ucLit;
+}
+/*-----------------------------------------------------------*/
+
+static void prvLoadStep( LedChannel_t *pxChannel, uint8_t ucStep )
+{
+	pxChannel->ucStep = ucStep;
+	pxChannel->usTicksLeft = pxChannel->pxPattern->pxSteps[ ucStep ].usTicks;
+
+	if( pxChannel->usTicksLeft == 0U )
+	{
+		pxChannel->usTicksLeft = 1U;
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* Advances every channel by one tick.  Returns the number of channels still
+playing. */
+static UBaseType_t prvUpdateChannels( LedChannel_t *pxChannels, UBaseType_t uxCount, uint8_t ucPhase )
+{
+LedChannel_t *pxChannel;
+const LedPattern_t *pxPattern;
+UBaseType_t uxActive = 0;
+UBaseType_t ux;
+
+	for( ux = 0; ux < uxCount; ux++ )
+	{
+		pxChannel = &( pxChannels[ ux ] );
+		pxPattern = pxChannel->pxPattern;
+
+		if( pxPattern == NULL )
+		{
+			continue;
+		}
+
+		prvSetLit( pxChannel, ( ucPhase < pxPattern->pxSteps[ pxChannel->ucStep ].ucLevel ) ? 1U : 0U );
+
+		if( --( pxChannel->usTicksLeft ) == 0U )
+		{
+			if( ( pxChannel->ucStep + 1U ) < pxPattern->ucStepCount )
+			{
+				prvLoadStep( pxChannel, pxChannel->ucStep + 1U );
+			}
+			else if( pxPattern->ucRepeat != pdFALSE )
+			{
+				prvLoadStep( pxChannel, 0 );
+			}
+			else
+			{
+				pxChannel->pxPattern = NULL;
+				prvSetLit( pxChannel, 0 );
+				continue;
+			}
+		}
+
+		uxActive++;
+	}
+
+	return uxActive;
+}
+/*-----------------------------------------------------------*/
+
+/* The number of channels playing.  Called in a critical section. */
+static UBaseType_t prvCountChannels( void )
+{
+UBaseType_t uxActive = 0;
+UBaseType_t ux;
+
+	for( ux = 0; ux < uxChannelCount; ux++ )
+	{
+		if( xChannels[ ux ].pxPattern != NULL )
+		{
+			uxActive++;
+		}
+	}
+
+	return uxActive;
+}
+/*-----------------------------------------------------------*/
+
+/* Runs in the timer service task, once per tick while a pattern plays. */
+static void prvLedPatternTimerCallback( TimerHandle_t xTimer )
+{
+UBaseType_t uxActive;
+
+	ucPwmPhase++;
+	if( ucPwmPhase >= ledpatternLEVEL_MAX )
+	{
+		ucPwmPhase = 0;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		uxActive = prvUpdateChannels( xChannels, uxChannelCount, ucPwmPhase );
+	}
+	taskEXIT_CRITICAL();
+
+	if( uxActive != 0U )
+	{
+		return;
+	}
+
+	/* xTimerRunning stays set until the stop is queued, so a play from now
+	on does not queue a start that the stop would then cancel.  If the queue
+	is full, the next tick tries again. */
+	if( xTimerStop( xTimer, 0 ) == pdFAIL )
+	{
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		uxActive = prvCountChannels();
+
+		if( uxActive == 0U )
+		{
+			xTimerRunning = pdFALSE;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	/* A pattern was played while stopping: the start is queued after the
+	stop. */
+	if( uxActive != 0U )
+	{
+		if( xTimerStart( xTimer, 0 ) == pdFAIL )
+		{
+			taskENTER_CRITICAL();
+			{
+				xTimerRunning = pdFALSE;
+			}
+			taskEXIT_CRITICAL();
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vLedPatternInit( void )
+{
+	xPatternTimer = xTimerCreate( "LedPattern", 1, pdTRUE, NULL, prvLedPatternTimerCallback );
+	configASSERT( xPatternTimer != NULL );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xLedPatternAddLed( struct metal_led *pxLed )
+{
+BaseType_t xChannel = -1;
+
+	taskENTER_CRITICAL();
+	{
+		if( uxChannelCount < configLED_PATTERN_MAX_LEDS )
+		{
+			xChannel = ( BaseType_t ) uxChannelCount;
+			xChannels[ xChannel ].pxLed = pxLed;
+			xChannels[ xChannel ].pxPattern = NULL;
+			xChannels[ xChannel ].ucLit = 1U;
+			prvSetLit( &( xChannels[ xChannel ] ), 0 );
+			uxChannelCount++;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	return xChannel;
+}
+/*-----------------------------------------------------------*/
+
+void vLedPatternPlay( BaseType_t xChannel, const LedPattern_t *pxPattern )
+{
+BaseType_t xStartTimer = pdFALSE;
+
+	if( ( xChannel < 0 ) || ( ( UBaseType_t ) xChannel >= uxChannelCount ) || ( pxPattern->ucStepCount == 0U ) )
+	{
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		xChannels[ xChannel ].pxPattern = pxPattern;
+		prvLoadStep( &( xChannels[ xChannel ] ), 0 );
+
+		if( xTimerRunning == pdFALSE )
+		{
+			xTimerRunning = pdTRUE;
+			xStartTimer = pdTRUE;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if( xStartTimer != pdFALSE )
+	{
+		/* Not blocking, as the caller may be a timer callback.  If the
+		command queue is full, let the next play start the timer. */
+		if( xTimerStart( xPatternTimer, 0 ) == pdFAIL )
+		{
+			taskENTER_CRITICAL();
+			{
+				xTimerRunning = pdFALSE;
+			}
+			taskEXIT_CRITICAL();
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vLedPatternStop( BaseType_t xChannel )
+{
+	if( ( xChannel < 0 ) || ( ( UBaseType_t ) xChannel >= uxChannelCount ) )
+	{
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		xChannels[ xChannel ].pxPattern = NULL;
+		prvSetLit( &( xChannels[ xChannel ] ), 0 );
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#define ledpatternBENCH_TICKS		( 1000U )
+
+static TaskHandle_t xBenchLedTask = NULL;
+
+/* What a task per LED does for each toggle: wake up, drive the pin, block. */
+static void prvBenchLedTask( void *pvParameters )
+{
+struct metal_led *pxLed = ( struct metal_led * ) pvParameters;
+
+	for( ;; )
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+		if( pxLed != NULL )
+		{
+			metal_led_toggle( pxLed );
+		}
+	}
+}
+
+void vLedPatternBenchmark( void )
+{
+LedChannel_t xBenchChannels[ configLED_PATTERN_MAX_LEDS ];
+UBaseType_t ux;
+uint32_t ulTick;
+uint64_t ullStart;
+
+	/* A private copy of the channels, all breathing, so that the engine's
+	own timer is not disturbed.  Without LEDs, so that the pins the engine
+	drives are left alone: prvSetLit() still does the bookkeeping. */
+	for( ux = 0; ux < configLED_PATTERN_MAX_LEDS; ux++ )
+	{
+		xBenchChannels[ ux ].pxLed = NULL;
+		xBenchChannels[ ux ].pxPattern = &xLedPatternBreathe;
+		xBenchChannels[ ux ].ucLit = 0;
+		prvLoadStep( &( xBenchChannels[ ux ] ), 0 );
+	}
+
+	ullStart = ullTimestampCycles();
+	for( ulTick = 0; ulTick < ledpatternBENCH_TICKS; ulTick++ )
+	{
+		prvUpdateChannels( xBenchChannels, configLED_PATTERN_MAX_LEDS, ( uint8_t ) ( ulTick % ledpatternLEVEL_MAX ) );
+	}
+	vBenchReport( "led_pattern.tick", configLED_PATTERN_MAX_LEDS, ullTimestampCycles() - ullStart, ledpatternBENCH_TICKS );
+
+	/* One LED driven by its own task, one toggle per wake up.  Without the
+	LED either, to compare like with like. */
+	xTaskCreate( prvBenchLedTask, "BenchLed", configMINIMAL_STACK_SIZE, NULL, uxTaskPriorityGet( NULL ) + 1U, &xBenchLedTask );
+	configASSERT( xBenchLedTask != NULL );
+
+	ullStart = ullTimestampCycles();
+	for( ulTick = 0; ulTick < ledpatternBENCH_TICKS; ulTick++ )
+	{
+		xTaskNotifyGive( xBenchLedTask );
+	}
+	vBenchReport( "led_task.toggle", 1, ullTimestampCycles() - ullStart, ledpatternBENCH_TICKS );
+
+	vTaskDelete( xBenchLedTask );
+	xBenchLedTask = NULL;
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_LED_PATTERN */
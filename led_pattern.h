@@ -0,0 +1,78 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+/*
+ * LED pattern engine.
+ *
+ * Drives every LED from a single auto-reload software timer instead of one
+ * task (and one stack) per LED.  A pattern is a constant table of steps, each
+ * step holding a brightness level for a number of ticks.  Intermediate
+ * levels are produced with a software PWM of ledpatternLEVEL_MAX ticks, which
+ * is how breathe effects are made.
+ *
+ * The state kept per LED is 12 bytes on RV32 (24 on RV64), against a TCB and
+ * a configMINIMAL_STACK_SIZE stack for a task per LED.  The timer is stopped
+ * whenever no pattern is playing, so an idle engine costs no CPU time.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include <metal/led.h>
+
+#if( configUSE_LED_PATTERN == 1 )
+
+/* Brightness levels go from 0 (off) to ledpatternLEVEL_MAX (fully on).  The
+PWM period is ledpatternLEVEL_MAX ticks. */
+#define ledpatternLEVEL_MAX		( 15U )
+
+typedef struct xLED_PATTERN_STEP
+{
+	uint8_t ucLevel;
+	uint16_t usTicks;
+} LedPatternStep_t;
+
+typedef struct xLED_PATTERN
+{
+	const LedPatternStep_t *pxSteps;
+	uint8_t ucStepCount;
+	uint8_t ucRepeat;		/* pdTRUE to loop, pdFALSE to switch off after the last step. */
+} LedPattern_t;
+
+/* Declares a pattern from a constant array of steps. */
+#define ledpatternDEFINE( xName, xSteps, xRepeat ) \
+	const LedPattern_t xName = { ( xSteps ), ( uint8_t ) ( sizeof( xSteps ) / sizeof( ( xSteps )[ 0 ] ) ), ( xRepeat ) }
+
+/* Ready made patterns. */
+extern const LedPattern_t xLedPatternBlink;		/* 500ms on, 500ms off. */
+extern const LedPattern_t xLedPatternFlash;		/* One 50ms flash. */
+extern const LedPattern_t xLedPatternBreathe;	/* 2s fade in and out. */
+extern const LedPattern_t xLedPatternHeartbeat;	/* Two short flashes per second. */
+extern const LedPattern_t xLedPatternChase[ 3 ];	/* Play one per LED for a running light. */
+
+/* Creates the timer.  Call once before the scheduler starts. */
+void vLedPatternInit( void );
+
+/* Adds an LED to the engine.  Returns the channel used by the other
+functions, or -1 if configLED_PATTERN_MAX_LEDS channels are already used. */
+BaseType_t xLedPatternAddLed( struct metal_led *pxLed );
+
+/* Starts pxPattern on a channel from its first step, replacing whatever the
+channel was playing.  Can be called from any task.  If the command queue of
+the timer task is full, the pattern only starts with the next play. */
+void vLedPatternPlay( BaseType_t xChannel, const LedPattern_t *pxPattern );
+
+/* Switches the LED of a channel off. */
+void vLedPatternStop( BaseType_t xChannel );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vLedPatternBenchmark( void );
+#endif
+
+#endif /* configUSE_LED_PATTERN */
+
+#endif /* LED_PATTERN_H */
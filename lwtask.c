@@ -0,0 +1,518 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "lwtask.h"
+
+#if( configUSE_LWTASK == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+#define lwtaskSTATE_READY			( 0 )
+#define lwtaskSTATE_DELAYED			( 1 )
+#define lwtaskSTATE_POLLING			( 2 )
+#define lwtaskSTATE_WAIT_NOTIFY		( 3 )
+#define lwtaskSTATE_DONE			( 4 )
+
+/* Delayed lightweight tasks are hashed on their wake tick, so each tick only
+looks at 1/lwtaskDELAY_SLOTS of them. */
+#define lwtaskDELAY_SLOTS			( 64U )
+#define lwtaskDELAY_MASK			( ( TickType_t ) ( lwtaskDELAY_SLOTS - 1U ) )
+
+/* Wake ticks further than this are considered to be in the past. */
+#define lwtaskMAX_DELAY				( portMAX_DELAY >> 1 )
+
+/*-----------------------------------------------------------*/
+
+/* The ready list is also written by vLwTaskNotify() from other tasks and
+ISRs, so it is only accessed inside critical sections.  The delayed and
+polling lists belong to the scheduler task. */
+static LwTask_t *pxReadyHead = NULL;
+static LwTask_t *pxReadyTail = NULL;
+
+static LwTask_t *pxDelayed[ lwtaskDELAY_SLOTS ];
+static UBaseType_t uxDelayedCount = 0;
+static TickType_t xLastTick = 0;
+
+static LwTask_t *pxPolling = NULL;
+
+static TaskHandle_t xSchedulerTask = NULL;
+
+#if( configUSE_BENCHMARKS == 1 )
+	static uint64_t ullSchedulerCycles = 0;
+	static uint32_t ulActivations = 0;
+#endif
+
+static void prvLwTaskSchedulerTask( void *pvParameters );
+
+/*-----------------------------------------------------------*/
+
+/* Must be called inside a critical section. */
+static void prvAppendReady( LwTask_t *pxTask )
+{
+	pxTask->ucState = lwtaskSTATE_READY;
+	pxTask->pxNext = NULL;
+
+	if( pxReadyTail == NULL )
+	{
+		pxReadyHead = pxTask;
+	}
+	else
+	{
+		pxReadyTail->pxNext = pxTask;
+	}
+	pxReadyTail = pxTask;
+}
+/*-----------------------------------------------------------*/
+
+static void prvMakeReady( LwTask_t *pxTask )
+{
+	taskENTER_CRITICAL();
+	{
+		prvAppendReady( pxTask );
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+static void prvDelay( LwTask_t *pxTask, TickType_t xNow )
+{
+TickType_t xDelta = pxTask->xWait.xWakeTick - xNow;
+UBaseType_t uxSlot;
+
+	if( ( xDelta == 0U ) || ( xDelta > lwtaskMAX_DELAY ) )
+	{
+		prvMakeReady( pxTask );
+	}
+	else
+	{
+		uxSlot = ( UBaseType_t ) ( pxTask->xWait.xWakeTick & lwtaskDELAY_MASK );
+		pxTask->ucState = lwtaskSTATE_DELAYED;
+		pxTask->pxNext = pxDelayed[ uxSlot ];
+		pxDelayed[ uxSlot ] = pxTask;
+		uxDelayedCount++;
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* Moves the delayed lightweight tasks whose wake tick is in (xLastTick, xNow]
+to the ready list. */
+static void prvCheckDelayed( TickType_t xNow )
+{
+TickType_t xElapsed = xNow - xLastTick;
+UBaseType_t uxSlots;
+UBaseType_t uxSlot;
+LwTask_t **ppxLink;
+LwTask_t *pxTask;
+
+	uxSlots = ( xElapsed >= lwtaskDELAY_SLOTS ) ? lwtaskDELAY_SLOTS : ( UBaseType_t ) xElapsed;
+
+	while( uxSlots > 0U )
+	{
+		uxSlot = ( UBaseType_t ) ( ( xLastTick + uxSlots ) & lwtaskDELAY_MASK );
+		ppxLink = &( pxDelayed[ uxSlot ] );
+
+		while( ( pxTask = *ppxLink ) != NULL )
+		{
+			if( ( TickType_t ) ( xNow - pxTask->xWait.xWakeTick ) <= lwtaskMAX_DELAY )
+			{
+				*ppxLink = pxTask->pxNext;
+				uxDelayedCount--;
+				prvMakeReady( pxTask );
+			}
+			else
+			{
+				ppxLink = &( pxTask->pxNext );
+			}
+		}
+
+		uxSlots--;
+	}
+
+	xLastTick = xNow;
+}
+/*-----------------------------------------------------------*/
+
+/* Moves the lightweight tasks waiting on a queue that is no longer empty to
+the ready list.  The function retries the receive itself. */
+static void prvCheckPolling( void )
+{
+LwTask_t **ppxLink = &pxPolling;
+LwTask_t *pxTask;
+
+	while( ( pxTask = *ppxLink ) != NULL )
+	{
+		if( uxQueueMessagesWaiting( pxTask->xWait.xQueue ) != 0U )
+		{
+			*ppxLink = pxTask->pxNext;
+			prvMakeReady( pxTask );
+		}
+		else
+		{
+			ppxLink = &( pxTask->pxNext );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvRun( LwTask_t *pxTask )
+{
+BaseType_t xResult;
+
+	xResult = pxTask->pxFunction( pxTask );
+
+#if( configUSE_BENCHMARKS == 1 )
+	ulActivations++;
+#endif
+
+	switch( xResult )
+	{
+		case lwtaskWAIT_DELAY:
+			prvDelay( pxTask, xTaskGetTickCount() );
+			break;
+
+		case lwtaskWAIT_QUEUE:
+			pxTask->ucState = lwtaskSTATE_POLLING;
+			pxTask->pxNext = pxPolling;
+			pxPolling = pxTask;
+			break;
+
+		case lwtaskWAIT_NOTIFY:
+			taskENTER_CRITICAL();
+			{
+				/* A notification may have arrived since the function
+				looked. */
+				if( pxTask->ucNotifyPending != 0U )
+				{
+					prvAppendReady( pxTask );
+				}
+				else
+				{
+					pxTask->ucState = lwtaskSTATE_WAIT_NOTIFY;
+				}
+			}
+			taskEXIT_CRITICAL();
+			break;
+
+		case lwtaskDONE:
+			pxTask->ucState = lwtaskSTATE_DONE;
+			break;
+
+		default:
+			prvMakeReady( pxTask );
+			break;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvLwTaskSchedulerTask( void *pvParameters )
+{
+LwTask_t *pxBatch;
+LwTask_t *pxTask;
+TickType_t xWait;
+
+	/* Remove compiler warning about unused parameter. */
+	( void ) pvParameters;
+
+	xLastTick = xTaskGetTickCount();
+
+	for( ;; )
+	{
+	#if( configUSE_BENCHMARKS == 1 )
+		uint64_t ullStart = ullTimestampCycles();
+	#endif
+
+		prvCheckDelayed( xTaskGetTickCount() );
+		prvCheckPolling();
+
+		/* Run what is ready now.  Lightweight tasks made ready while this
+		batch runs wait for the next batch, so polling and delays are
+		checked between batches. */
+		taskENTER_CRITICAL();
+		{
+			pxBatch = pxReadyHead;
+			pxReadyHead = NULL;
+			pxReadyTail = NULL;
+		}
+		taskEXIT_CRITICAL();
+
+		while( pxBatch != NULL )
+		{
+			pxTask = pxBatch;
+			pxBatch = pxTask->pxNext;
+			prvRun( pxTask );
+		}
+
+		taskENTER_CRITICAL();
+		{
+			if( pxReadyHead != NULL )
+			{
+				xWait = 0;
+			}
+			else if( ( uxDelayedCount != 0U ) || ( pxPolling != NULL ) )
+			{
+				xWait = 1;
+			}
+			else
+			{
+				xWait = portMAX_DELAY;
+			}
+		}
+		taskEXIT_CRITICAL();
+
+	#if( configUSE_BENCHMARKS == 1 )
+		ullSchedulerCycles += ullTimestampCycles() - ullStart;
+	#endif
+
+		if( xWait != 0U )
+		{
+			ulTaskNotifyTake( pdTRUE, xWait );
+		}
+		else
+		{
+			/* Share the hart with tasks of the same priority. */
+			taskYIELD();
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vLwTaskSchedulerInit( void )
+{
+	configASSERT( xSchedulerTask == NULL );
+
+	xTaskCreate( prvLwTaskSchedulerTask, "LwSched", configLWTASK_SCHEDULER_STACK_DEPTH, NULL, configLWTASK_SCHEDULER_PRIORITY, &xSchedulerTask );
+	configASSERT( xSchedulerTask != NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vLwTaskStart( LwTask_t *pxTask, LwTaskFunction_t pxFunction )
+{
+	pxTask->pxFunction = pxFunction;
+	pxTask->usResume = 0;
+	pxTask->ulNotifiedValue = 0;
+	pxTask->ucNotifyPending = 0;
+
+	prvMakeReady( pxTask );
+
+	if( xTaskGetCurrentTaskHandle() != xSchedulerTask )
+	{
+		xTaskNotifyGive( xSchedulerTask );
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* Must be called inside a critical section.  Returns pdTRUE if the scheduler
+task has to be woken up. */
+static BaseType_t prvNotify( LwTask_t *pxTask, uint32_t ulBits )
+{
+	pxTask->ulNotifiedValue |= ulBits;
+	pxTask->ucNotifyPending = 1U;
+
+	if( pxTask->ucState == lwtaskSTATE_WAIT_NOTIFY )
+	{
+		prvAppendReady( pxTask );
+		return pdTRUE;
+	}
+
+	return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vLwTaskNotify( LwTask_t *pxTask, uint32_t ulBits )
+{
+BaseType_t xWake;
+
+	taskENTER_CRITICAL();
+	{
+		xWake = prvNotify( pxTask, ulBits );
+	}
+	taskEXIT_CRITICAL();
+
+	if( ( xWake != pdFALSE ) && ( xTaskGetCurrentTaskHandle() != xSchedulerTask ) )
+	{
+		xTaskNotifyGive( xSchedulerTask );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vLwTaskNotifyFromISR( LwTask_t *pxTask, uint32_t ulBits, BaseType_t *pxHigherPriorityTaskWoken )
+{
+BaseType_t xWake;
+UBaseType_t uxSavedInterruptStatus;
+
+	uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+	{
+		xWake = prvNotify( pxTask, ulBits );
+	}
+	taskEXIT_CRITICAL_FROM_ISR( uxSavedInterruptStatus );
+
+	if( xWake != pdFALSE )
+	{
+		vTaskNotifyGiveFromISR( xSchedulerTask, pxHigherPriorityTaskWoken );
+	}
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xLwTaskQueueSend( QueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait )
+{
+BaseType_t xReturn;
+
+	xReturn = xQueueSend( xQueue, pvItem, xTicksToWait );
+
+	if( ( xReturn == pdPASS ) && ( pxPolling != NULL ) && ( xTaskGetCurrentTaskHandle() != xSchedulerTask ) )
+	{
+		xTaskNotifyGive( xSchedulerTask );
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xLwTaskTakeNotification( LwTask_t *pxTask, uint32_t *pulValue )
+{
+BaseType_t xReturn = pdFALSE;
+
+	taskENTER_CRITICAL();
+	{
+		if( pxTask->ucNotifyPending != 0U )
+		{
+			if( pulValue != NULL )
+			{
+				*pulValue = pxTask->ulNotifiedValue;
+			}
+
+			pxTask->ulNotifiedValue = 0;
+			pxTask->ucNotifyPending = 0;
+			xReturn = pdTRUE;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xLwTaskIsDone( const LwTask_t *pxTask )
+{
+	return ( pxTask->ucState == lwtaskSTATE_DONE ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#define lwtaskBENCH_COUNT		( 1000U )
+#define lwtaskBENCH_RUNS		( 10U )
+#define lwtaskBENCH_PINGS		( 1000U )
+
+typedef struct xBENCH_ACTIVITY
+{
+	LwTask_t xTask;
+	uint16_t usRuns;
+	uint16_t usPeriod;
+	LwTask_t *pxPeer;
+} BenchActivity_t;
+
+static BenchActivity_t xBenchActivities[ lwtaskBENCH_COUNT ];
+
+static BaseType_t prvBenchPeriodic( LwTask_t *pxTask )
+{
+BenchActivity_t *pxActivity = ( BenchActivity_t * ) pxTask;
+
+	lwtaskBEGIN( pxTask );
+
+	while( pxActivity->usRuns < lwtaskBENCH_RUNS )
+	{
+		lwtaskAWAIT_DELAY( pxTask, pxActivity->usPeriod );
+		pxActivity->usRuns++;
+	}
+
+	lwtaskEND( pxTask );
+}
+
+static BaseType_t prvBenchPing( LwTask_t *pxTask )
+{
+BenchActivity_t *pxActivity = ( BenchActivity_t * ) pxTask;
+
+	lwtaskBEGIN( pxTask );
+
+	while( pxActivity->usRuns < lwtaskBENCH_PINGS )
+	{
+		vLwTaskNotify( pxActivity->pxPeer, 1U );
+		lwtaskAWAIT_NOTIFY( pxTask, NULL );
+		pxActivity->usRuns++;
+	}
+
+	lwtaskEND( pxTask );
+}
+
+static BaseType_t prvBenchPong( LwTask_t *pxTask )
+{
+BenchActivity_t *pxActivity = ( BenchActivity_t * ) pxTask;
+
+	lwtaskBEGIN( pxTask );
+
+	while( pxActivity->usRuns < lwtaskBENCH_PINGS )
+	{
+		lwtaskAWAIT_NOTIFY( pxTask, NULL );
+		pxActivity->usRuns++;
+		vLwTaskNotify( pxActivity->pxPeer, 1U );
+	}
+
+	lwtaskEND( pxTask );
+}
+
+static void prvBenchWait( UBaseType_t uxCount )
+{
+UBaseType_t ux;
+
+	for( ux = 0; ux < uxCount; ux++ )
+	{
+		while( xLwTaskIsDone( &( xBenchActivities[ ux ].xTask ) ) == pdFALSE )
+		{
+			vTaskDelay( 1 );
+		}
+	}
+}
+
+void vLwTaskBenchmark( void )
+{
+UBaseType_t ux;
+uint64_t ullStart;
+uint32_t ulStartActivations;
+
+	/* Many periodic activities, each one waking lwtaskBENCH_RUNS times. */
+	ullStart = ullSchedulerCycles;
+	ulStartActivations = ulActivations;
+	for( ux = 0; ux < lwtaskBENCH_COUNT; ux++ )
+	{
+		xBenchActivities[ ux ].usRuns = 0;
+		xBenchActivities[ ux ].usPeriod = ( uint16_t ) ( 1U + ( ux % 16U ) );
+		vLwTaskStart( &( xBenchActivities[ ux ].xTask ), prvBenchPeriodic );
+	}
+	prvBenchWait( lwtaskBENCH_COUNT );
+	vBenchReport( "lwtask.activation", lwtaskBENCH_COUNT, ullSchedulerCycles - ullStart, ulActivations - ulStartActivations );
+	vBenchReport( "lwtask.bytes", lwtaskBENCH_COUNT, ( uint64_t ) sizeof( LwTask_t ) * lwtaskBENCH_COUNT, 1 );
+
+	/* Two activities notifying each other: the cost of a switch. */
+	xBenchActivities[ 0 ].usRuns = 0;
+	xBenchActivities[ 0 ].pxPeer = &( xBenchActivities[ 1 ].xTask );
+	xBenchActivities[ 1 ].usRuns = 0;
+	xBenchActivities[ 1 ].pxPeer = &( xBenchActivities[ 0 ].xTask );
+
+	ullStart = ullSchedulerCycles;
+	vLwTaskStart( &( xBenchActivities[ 1 ].xTask ), prvBenchPong );
+	vLwTaskStart( &( xBenchActivities[ 0 ].xTask ), prvBenchPing );
+	prvBenchWait( 2 );
+	vBenchReport( "lwtask.notify", 2, ullSchedulerCycles - ullStart, lwtaskBENCH_PINGS * 2U );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_LWTASK */
@@ -0,0 +1,139 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef LWTASK_H
+#define LWTASK_H
+
+/*
+ * Stackless lightweight tasks.
+ *
+ * A lightweight task is a C function that is written as a protothread: its
+ * body sits between lwtaskBEGIN() and lwtaskEND(), and every lwtaskAWAIT_*()
+ * macro returns to a single scheduler task which calls the function again,
+ * at the same point, once the awaited event happened.  All the lightweight
+ * tasks share the stack of the scheduler task, so each one only costs its
+ * LwTask_t record (20 bytes on RV32), and thousands of simple activities fit
+ * in a few KB where the same number of tasks would need a stack each.
+ *
+ * The price is the usual protothread one:
+ *  - Local variables are not preserved across an await.  Keep the state in
+ *    a structure whose first member is the LwTask_t and cast the pointer
+ *    passed to the function back to it.
+ *  - An await can only be used in the body of the function itself, not in
+ *    functions it calls, and not inside a switch statement.
+ *  - Activities are cooperative: a function must not block on a kernel
+ *    object, it runs until it awaits or ends.
+ *
+ * Waiting for a delay or a notification is event driven.  Waiting on a
+ * queue polls the queue each time the scheduler runs, which is at least once
+ * per tick while such a wait is pending; producers that send with
+ * xLwTaskQueueSend() wake the scheduler immediately instead.
+ *
+ * This replaces the kernel co-routines (configUSE_CO_ROUTINES), which are
+ * scheduled from the idle task and cannot wait on task notifications.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#if( configUSE_LWTASK == 1 )
+
+/* What a lightweight task function returns to the scheduler. */
+#define lwtaskREADY				( 0 )	/* Yielded, run again soon. */
+#define lwtaskWAIT_DELAY		( 1 )
+#define lwtaskWAIT_QUEUE		( 2 )
+#define lwtaskWAIT_NOTIFY		( 3 )
+#define lwtaskDONE				( 4 )
+
+typedef struct xLW_TASK LwTask_t;
+
+typedef BaseType_t ( *LwTaskFunction_t )( LwTask_t *pxTask );
+
+/* The members are private to lwtask.c and to the macros below. */
+struct xLW_TASK
+{
+	LwTask_t *pxNext;
+	LwTaskFunction_t pxFunction;
+	union
+	{
+		TickType_t xWakeTick;
+		QueueHandle_t xQueue;
+	} xWait;
+	uint32_t ulNotifiedValue;
+	uint16_t usResume;
+	uint8_t ucState;
+	uint8_t ucNotifyPending;
+};
+
+#define lwtaskBEGIN( pxTask )		switch( ( pxTask )->usResume ) { case 0:
+
+#define lwtaskEND( pxTask )			} ( pxTask )->usResume = 0; return lwtaskDONE
+
+/* Lets the other lightweight tasks run. */
+#define lwtaskYIELD( pxTask )								\
+	do {													\
+		( pxTask )->usResume = __LINE__;					\
+		return lwtaskREADY;									\
+		case __LINE__:;										\
+	} while( 0 )
+
+#define lwtaskAWAIT_DELAY( pxTask, xTicks )					\
+	do {													\
+		( pxTask )->xWait.xWakeTick = xTaskGetTickCount() + ( xTicks );	\
+		( pxTask )->usResume = __LINE__;					\
+		return lwtaskWAIT_DELAY;							\
+		case __LINE__:;										\
+	} while( 0 )
+
+/* Receives one item from xQueue into pvBuffer, waiting as long as needed. */
+#define lwtaskAWAIT_QUEUE( pxTask, xQueueToWait, pvBuffer )	\
+	do {													\
+		( pxTask )->usResume = __LINE__;					\
+		case __LINE__:										\
+		if( xQueueReceive( ( xQueueToWait ), ( pvBuffer ), 0 ) != pdPASS )	\
+		{													\
+			( pxTask )->xWait.xQueue = ( xQueueToWait );	\
+			return lwtaskWAIT_QUEUE;						\
+		}													\
+	} while( 0 )
+
+/* Waits for vLwTaskNotify() and stores the accumulated bits in *pulValue. */
+#define lwtaskAWAIT_NOTIFY( pxTask, pulValue )				\
+	do {													\
+		( pxTask )->usResume = __LINE__;					\
+		case __LINE__:										\
+		if( xLwTaskTakeNotification( ( pxTask ), ( pulValue ) ) == pdFALSE )	\
+		{													\
+			return lwtaskWAIT_NOTIFY;						\
+		}													\
+	} while( 0 )
+
+/* Creates the scheduler task.  Call once, before the kernel scheduler starts. */
+void vLwTaskSchedulerInit( void );
+
+/* Makes pxTask runnable from the top of pxFunction.  pxTask must stay valid
+until the function ends. */
+void vLwTaskStart( LwTask_t *pxTask, LwTaskFunction_t pxFunction );
+
+/* ORs ulBits into the notification value of pxTask and wakes it if it is in
+lwtaskAWAIT_NOTIFY().  Can be used from tasks, lightweight tasks and ISRs. */
+void vLwTaskNotify( LwTask_t *pxTask, uint32_t ulBits );
+void vLwTaskNotifyFromISR( LwTask_t *pxTask, uint32_t ulBits, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* xQueueSend() that also wakes the scheduler, so lightweight tasks waiting on
+the queue run without waiting for the next poll. */
+BaseType_t xLwTaskQueueSend( QueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait );
+
+/* Used by lwtaskAWAIT_NOTIFY(). */
+BaseType_t xLwTaskTakeNotification( LwTask_t *pxTask, uint32_t *pulValue );
+
+BaseType_t xLwTaskIsDone( const LwTask_t *pxTask );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vLwTaskBenchmark( void );
+#endif
+
+#endif /* configUSE_LWTASK */
+
+#endif /* LWTASK_H */
@@ -0,0 +1,620 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "pipeline.h"
+#include "hart_launch.h"
+#include "timestamp.h"
+
+#if( configUSE_PIPELINE == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* Longest a task stage waits on a channel before it looks again, for the
+changes made by the harts, which cannot notify it. */
+#define pipelineWAIT_TICKS		( ( TickType_t ) 1 )
+
+/* Outcomes of a batch. */
+#define pipelineBATCH_RAN		( 0 )
+#define pipelineBATCH_EMPTY		( 1 )		/* Nothing to read. */
+#define pipelineBATCH_FULL		( 2 )		/* No room to write. */
+
+#if( configUSE_TELEMETRY == 1 )
+
+static const char * const pcPipelineFields[] =
+{
+	"batches", "items_in", "items_out", "dropped", "waits_empty", "waits_full", "depth", "peak", "busy_cycles"
+};
+
+#endif /* configUSE_TELEMETRY */
+
+/*-----------------------------------------------------------*/
+
+static inline uint8_t *prvSlot( const PipelineChannel_t *pxChannel, uint32_t ulIndex )
+{
+	return &( pxChannel->pucItems[ ( ulIndex & pxChannel->ulMask ) * pxChannel->xItemSize ] );
+}
+
+/* Items the consumer can read.  The index of the producer is only read again
+when the last one seen does not cover ulWanted, as its cache line is written
+by the other hart. */
+static uint32_t prvAvailable( PipelineChannel_t *pxChannel, uint32_t ulWanted )
+{
+PipelineChannelEnd_t *pxConsumer = &( pxChannel->xConsumer );
+uint32_t ulAvailable = pxConsumer->ulOtherIndex - pxConsumer->ulIndex;
+
+	if( ulAvailable < ulWanted )
+	{
+		pxConsumer->ulOtherIndex = pxChannel->xProducer.ulIndex;
+
+		/* Acquire: see the items written before the index. */
+		__asm__ volatile( "fence r, rw" ::: "memory" );
+
+		ulAvailable = pxConsumer->ulOtherIndex - pxConsumer->ulIndex;
+	}
+
+	return ulAvailable;
+}
+
+/* Slots the producer can write, the same way. */
+static uint32_t prvSpace( PipelineChannel_t *pxChannel, uint32_t ulWanted )
+{
+PipelineChannelEnd_t *pxProducer = &( pxChannel->xProducer );
+uint32_t ulSpace = ( pxChannel->ulMask + 1U ) - ( pxProducer->ulIndex - pxProducer->ulOtherIndex );
+
+	if( ulSpace < ulWanted )
+	{
+		pxProducer->ulOtherIndex = pxChannel->xConsumer.ulIndex;
+
+		/* Acquire: the consumer is done with the slots it gave back. */
+		__asm__ volatile( "fence r, rw" ::: "memory" );
+
+		ulSpace = ( pxChannel->ulMask + 1U ) - ( pxProducer->ulIndex - pxProducer->ulOtherIndex );
+	}
+
+	return ulSpace;
+}
+/*-----------------------------------------------------------*/
+
+/* Notifies the task stage at pxEnd if it waits.  Only from hart 0. */
+static void prvWake( PipelineChannelEnd_t *pxEnd, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	/* The index just published is ordered before the flag is read, and the
+	waiter sets the flag before it looks at the index again, so one of the
+	two sees the other. */
+	__asm__ volatile( "fence rw, rw" ::: "memory" );
+
+	if( pxEnd->ulWaiting != 0U )
+	{
+		if( pxHigherPriorityTaskWoken == NULL )
+		{
+			( void ) xTaskNotifyGive( pxEnd->xTask );
+		}
+		else
+		{
+			vTaskNotifyGiveFromISR( pxEnd->xTask, pxHigherPriorityTaskWoken );
+		}
+	}
+}
+
+/* Publishes the items written up to ulIndex. */
+static inline void prvProduced( PipelineChannel_t *pxChannel, uint32_t ulIndex, BaseType_t xWake, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	/* Release: the items are written before the index. */
+	__asm__ volatile( "fence rw, w" ::: "memory" );
+	pxChannel->xProducer.ulIndex = ulIndex;
+
+	if( xWake != pdFALSE )
+	{
+		prvWake( &( pxChannel->xConsumer ), pxHigherPriorityTaskWoken );
+	}
+}
+
+/* Gives back the slots read up to ulIndex. */
+static inline void prvConsumed( PipelineChannel_t *pxChannel, uint32_t ulIndex, BaseType_t xWake, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	/* Release: the items are read before the slots are given back. */
+	__asm__ volatile( "fence rw, w" ::: "memory" );
+	pxChannel->xConsumer.ulIndex = ulIndex;
+
+	if( xWake != pdFALSE )
+	{
+		prvWake( &( pxChannel->xProducer ), pxHigherPriorityTaskWoken );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPipelineChannelInit( PipelineChannel_t *pxChannel, void *pvStorage, size_t xItemSize, uint32_t ulCapacity )
+{
+	configASSERT( ( ulCapacity > 0U ) && ( ( ulCapacity & ( ulCapacity - 1U ) ) == 0U ) );
+	configASSERT( xItemSize > 0U );
+
+	memset( pxChannel, 0, sizeof( *pxChannel ) );
+
+	pxChannel->pucItems = ( uint8_t * ) pvStorage;
+	pxChannel->xItemSize = xItemSize;
+	pxChannel->ulMask = ulCapacity - 1U;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSend( PipelineChannel_t *pxChannel, const void *pvItem, BaseType_t *pxHigherPriorityTaskWoken )
+{
+uint32_t ulIndex = pxChannel->xProducer.ulIndex;
+
+	if( prvSpace( pxChannel, 1 ) == 0U )
+	{
+		return pdFAIL;
+	}
+
+	memcpy( prvSlot( pxChannel, ulIndex ), pvItem, pxChannel->xItemSize );
+	prvProduced( pxChannel, ulIndex + 1U, pdTRUE, pxHigherPriorityTaskWoken );
+
+	return pdPASS;
+}
+
+static BaseType_t prvReceive( PipelineChannel_t *pxChannel, void *pvBuffer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+uint32_t ulIndex = pxChannel->xConsumer.ulIndex;
+
+	if( prvAvailable( pxChannel, 1 ) == 0U )
+	{
+		return pdFAIL;
+	}
+
+	memcpy( pvBuffer, prvSlot( pxChannel, ulIndex ), pxChannel->xItemSize );
+	prvConsumed( pxChannel, ulIndex + 1U, pdTRUE, pxHigherPriorityTaskWoken );
+
+	return pdPASS;
+}
+
+BaseType_t xPipelineChannelSend( PipelineChannel_t *pxChannel, const void *pvItem )
+{
+	return prvSend( pxChannel, pvItem, NULL );
+}
+
+BaseType_t xPipelineChannelSendFromISR( PipelineChannel_t *pxChannel, const void *pvItem, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	configASSERT( pxHigherPriorityTaskWoken != NULL );
+
+	return prvSend( pxChannel, pvItem, pxHigherPriorityTaskWoken );
+}
+
+BaseType_t xPipelineChannelReceive( PipelineChannel_t *pxChannel, void *pvBuffer )
+{
+	return prvReceive( pxChannel, pvBuffer, NULL );
+}
+
+BaseType_t xPipelineChannelReceiveFromISR( PipelineChannel_t *pxChannel, void *pvBuffer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	configASSERT( pxHigherPriorityTaskWoken != NULL );
+
+	return prvReceive( pxChannel, pvBuffer, pxHigherPriorityTaskWoken );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulPipelineChannelDepth( const PipelineChannel_t *pxChannel )
+{
+	return pxChannel->xProducer.ulIndex - pxChannel->xConsumer.ulIndex;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRecordBatch( PipelineStage_t *pxStage, uint32_t ulTaken, uint32_t ulForwarded, uint32_t ulDepth, uint64_t ullCycles )
+{
+#if( configUSE_TELEMETRY == 1 )
+	if( pxStage->xNamed != pdFALSE )
+	{
+		vTelemetryUpdateBegin( &( pxStage->xTelemetry.xBlock ) );
+		pxStage->xTelemetry.xStats.ullBatches++;
+		pxStage->xTelemetry.xStats.ullItemsOut += ulForwarded;
+		pxStage->xTelemetry.xStats.ullDropped += ulTaken - ulForwarded;
+		pxStage->xTelemetry.xStats.ullBusyCycles += ullCycles;
+
+		if( pxStage->pxIn != NULL )
+		{
+			pxStage->xTelemetry.xStats.ullItemsIn += ulTaken;
+			pxStage->xTelemetry.xStats.ullDepth = ulDepth;
+
+			if( ulDepth > pxStage->xTelemetry.xStats.ullPeak )
+			{
+				pxStage->xTelemetry.xStats.ullPeak = ulDepth;
+			}
+		}
+		vTelemetryUpdateEnd( &( pxStage->xTelemetry.xBlock ) );
+	}
+#else
+	( void ) pxStage;
+	( void ) ulTaken;
+	( void ) ulForwarded;
+	( void ) ulDepth;
+	( void ) ullCycles;
+#endif
+}
+
+static void prvRecordWait( PipelineStage_t *pxStage, BaseType_t xBatch )
+{
+#if( configUSE_TELEMETRY == 1 )
+	if( pxStage->xNamed != pdFALSE )
+	{
+		vTelemetryUpdateBegin( &( pxStage->xTelemetry.xBlock ) );
+		if( xBatch == pipelineBATCH_EMPTY )
+		{
+			pxStage->xTelemetry.xStats.ullWaitsEmpty++;
+			pxStage->xTelemetry.xStats.ullDepth = 0;
+		}
+		else
+		{
+			pxStage->xTelemetry.xStats.ullWaitsFull++;
+		}
+		vTelemetryUpdateEnd( &( pxStage->xTelemetry.xBlock ) );
+	}
+#else
+	( void ) pxStage;
+	( void ) xBatch;
+#endif
+}
+/*-----------------------------------------------------------*/
+
+/* Runs the function on up to uxBatch items, in place in the rings, and
+publishes both indexes once. */
+static BaseType_t prvRunBatch( PipelineStage_t *pxStage )
+{
+PipelineChannel_t *pxIn = pxStage->pxIn;
+PipelineChannel_t *pxOut = pxStage->pxOut;
+BaseType_t xWake = ( pxStage->ulHartId == 0U ) ? pdTRUE : pdFALSE;
+uint32_t ulCount = ( uint32_t ) pxStage->uxBatch;
+uint32_t ulDepth = 0;
+uint32_t ulSpace;
+uint32_t ulInIndex = 0;
+uint32_t ulOutIndex = 0;
+uint32_t ulForwarded = 0;
+uint32_t ul;
+uint64_t ullStart;
+const void *pvIn = NULL;
+void *pvOut = NULL;
+
+	if( pxIn != NULL )
+	{
+		ulDepth = prvAvailable( pxIn, ulCount );
+
+		if( ulDepth == 0U )
+		{
+			return pipelineBATCH_EMPTY;
+		}
+
+		ulCount = ( ulDepth < ulCount ) ? ulDepth : ulCount;
+		ulInIndex = pxIn->xConsumer.ulIndex;
+	}
+
+	if( pxOut != NULL )
+	{
+		ulSpace = prvSpace( pxOut, ulCount );
+
+		if( ulSpace == 0U )
+		{
+			return pipelineBATCH_FULL;
+		}
+
+		ulCount = ( ulSpace < ulCount ) ? ulSpace : ulCount;
+		ulOutIndex = pxOut->xProducer.ulIndex;
+	}
+
+	ullStart = ullTimestampCycles();
+
+	for( ul = 0; ul < ulCount; ul++ )
+	{
+		if( pxIn != NULL )
+		{
+			pvIn = prvSlot( pxIn, ulInIndex + ul );
+		}
+
+		if( pxOut != NULL )
+		{
+			pvOut = prvSlot( pxOut, ulOutIndex + ulForwarded );
+		}
+
+		if( pxStage->pxFunction( pxStage->pvContext, pvIn, pvOut ) != pdFALSE )
+		{
+			ulForwarded++;
+		}
+	}
+
+	prvRecordBatch( pxStage, ulCount, ulForwarded, ulDepth, ullTimestampCycles() - ullStart );
+
+	if( pxIn != NULL )
+	{
+		prvConsumed( pxIn, ulInIndex + ulCount, xWake, NULL );
+	}
+
+	if( ( pxOut != NULL ) && ( ulForwarded != 0U ) )
+	{
+		prvProduced( pxOut, ulOutIndex + ulForwarded, xWake, NULL );
+	}
+
+	return pipelineBATCH_RAN;
+}
+/*-----------------------------------------------------------*/
+
+/* Blocks a task stage until the end it waits on changes, or for a tick. */
+static void prvWait( PipelineStage_t *pxStage, BaseType_t xBatch )
+{
+PipelineChannelEnd_t *pxEnd;
+uint32_t ulLeft;
+
+	pxEnd = ( xBatch == pipelineBATCH_EMPTY ) ? &( pxStage->pxIn->xConsumer ) : &( pxStage->pxOut->xProducer );
+	pxEnd->ulWaiting = 1;
+
+	/* See prvWake(). */
+	__asm__ volatile( "fence rw, rw" ::: "memory" );
+
+	ulLeft = ( xBatch == pipelineBATCH_EMPTY ) ? prvAvailable( pxStage->pxIn, 1 ) : prvSpace( pxStage->pxOut, 1 );
+
+	if( ( ulLeft == 0U ) && ( pxStage->ulStop == 0U ) )
+	{
+		( void ) ulTaskNotifyTake( pdTRUE, pipelineWAIT_TICKS );
+	}
+
+	pxEnd->ulWaiting = 0;
+}
+
+static void prvRun( PipelineStage_t *pxStage )
+{
+BaseType_t xBatch;
+BaseType_t xLast = pipelineBATCH_RAN;
+
+	while( pxStage->ulStop == 0U )
+	{
+		xBatch = prvRunBatch( pxStage );
+
+		if( xBatch != pipelineBATCH_RAN )
+		{
+			/* A hart stage polls, so only the start of a wait counts. */
+			if( xBatch != xLast )
+			{
+				prvRecordWait( pxStage, xBatch );
+			}
+
+			if( pxStage->ulHartId == 0U )
+			{
+				prvWait( pxStage, xBatch );
+			}
+		}
+
+		xLast = xBatch;
+	}
+
+	if( pxStage->pxIn != NULL )
+	{
+		pxStage->pxIn->xConsumer.xTask = NULL;
+	}
+
+	if( pxStage->pxOut != NULL )
+	{
+		pxStage->pxOut->xProducer.xTask = NULL;
+	}
+
+	__asm__ volatile( "fence rw, w" ::: "memory" );
+	pxStage->ulRunning = 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPipelineStageInit( PipelineStage_t *pxStage, const char *pcName, PipelineStageFunction_t pxFunction, void *pvContext,
+						 PipelineChannel_t *pxIn, PipelineChannel_t *pxOut, UBaseType_t uxBatch )
+{
+	configASSERT( pxFunction != NULL );
+	configASSERT( ( pxIn != NULL ) || ( pxOut != NULL ) );
+	configASSERT( uxBatch > 0U );
+
+	pxStage->pxFunction = pxFunction;
+	pxStage->pvContext = pvContext;
+	pxStage->pxIn = pxIn;
+	pxStage->pxOut = pxOut;
+	pxStage->uxBatch = uxBatch;
+	pxStage->pcName = pcName;
+	pxStage->ulHartId = 0;
+	pxStage->ulStop = 0;
+	pxStage->ulRunning = 0;
+
+#if( configUSE_TELEMETRY == 1 )
+	memset( &( pxStage->xTelemetry.xStats ), 0, sizeof( pxStage->xTelemetry.xStats ) );
+	pxStage->xNamed = ( pcName != NULL ) ? pdTRUE : pdFALSE;
+
+	if( pcName != NULL )
+	{
+		telemetryREGISTER( pxStage->xTelemetry, pcName, pcPipelineFields );
+	}
+#endif
+}
+/*-----------------------------------------------------------*/
+
+static void prvStageTask( void *pvParameters )
+{
+	prvRun( ( PipelineStage_t * ) pvParameters );
+
+	vTaskDelete( NULL );
+}
+
+void vPipelineStageStartTask( PipelineStage_t *pxStage, UBaseType_t uxPriority, StackType_t *puxStack, uint32_t ulStackDepth )
+{
+/* The handle of a statically allocated task is its TCB buffer, so the
+channels know it before the task can run. */
+TaskHandle_t xHandle = ( TaskHandle_t ) &( pxStage->xTaskBuffer );
+
+	configASSERT( pxStage->ulRunning == 0U );
+
+	if( pxStage->pxIn != NULL )
+	{
+		pxStage->pxIn->xConsumer.xTask = xHandle;
+	}
+
+	if( pxStage->pxOut != NULL )
+	{
+		pxStage->pxOut->xProducer.xTask = xHandle;
+	}
+
+	pxStage->ulHartId = 0;
+	pxStage->ulRunning = 1;
+
+	xHandle = xTaskCreateStatic( prvStageTask, ( pxStage->pcName != NULL ) ? pxStage->pcName : "Pipe", ulStackDepth,
+								 pxStage, uxPriority, puxStack, &( pxStage->xTaskBuffer ) );
+
+	/* Only fails if the buffers are NULL. */
+	configASSERT( xHandle != NULL );
+	( void ) xHandle;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_HART_LAUNCH == 1 )
+
+static void prvStageHart( void *pvArgument )
+{
+	prvRun( ( PipelineStage_t * ) pvArgument );
+}
+
+BaseType_t xPipelineStageStartHart( PipelineStage_t *pxStage, uint32_t ulHartId )
+{
+	configASSERT( pxStage->ulRunning == 0U );
+	configASSERT( ulHartId != 0U );
+
+	pxStage->ulHartId = ulHartId;
+	pxStage->ulRunning = 1;
+
+	/* xHartLaunch() publishes the stage before the hart runs. */
+	if( xHartLaunch( ulHartId, prvStageHart, pxStage ) == pdFAIL )
+	{
+		pxStage->ulRunning = 0;
+		return pdFAIL;
+	}
+
+	return pdPASS;
+}
+
+#endif /* configUSE_HART_LAUNCH */
+/*-----------------------------------------------------------*/
+
+void vPipelineStageStop( PipelineStage_t *pxStage )
+{
+	pxStage->ulStop = 1;
+	__asm__ volatile( "fence rw, rw" ::: "memory" );
+
+	while( pxStage->ulRunning != 0U )
+	{
+		vTaskDelay( 1 );
+	}
+
+	/* Acquire: see what the stage wrote. */
+	__asm__ volatile( "fence r, rw" ::: "memory" );
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Throughput of a one stage pipeline, fed and drained by the benchmark task,
+ * with the stage in a task of hart 0 and then on hart 1, one item at a time
+ * and in batches.  The parameter is the batch size, the cost is per item.
+ * Each run uses a stage of its own as a stopped task stage is not started
+ * again.
+ */
+#define pipelineBENCH_CAPACITY		( 16U )
+#define pipelineBENCH_ITEMS			( 1024U )
+#define pipelineBENCH_STACK_DEPTH	( configMINIMAL_STACK_SIZE * 2 )
+
+static pipelineCHANNEL_STORAGE( ucBenchInStorage, sizeof( uint32_t ), pipelineBENCH_CAPACITY );
+static pipelineCHANNEL_STORAGE( ucBenchOutStorage, sizeof( uint32_t ), pipelineBENCH_CAPACITY );
+static PipelineChannel_t xBenchIn;
+static PipelineChannel_t xBenchOut;
+static PipelineStage_t xBenchStages[ 4 ];
+static StackType_t uxBenchStacks[ 2 ][ pipelineBENCH_STACK_DEPTH ];
+
+static BaseType_t prvBenchSquare( void *pvContext, const void *pvIn, void *pvOut )
+{
+uint32_t ulIn = *( const uint32_t * ) pvIn;
+
+	( void ) pvContext;
+
+	*( uint32_t * ) pvOut = ulIn * ulIn;
+
+	return pdTRUE;
+}
+
+static PipelineStage_t *prvBenchStage( uint32_t ulStage, UBaseType_t uxBatch )
+{
+	vPipelineChannelInit( &xBenchIn, ucBenchInStorage, sizeof( uint32_t ), pipelineBENCH_CAPACITY );
+	vPipelineChannelInit( &xBenchOut, ucBenchOutStorage, sizeof( uint32_t ), pipelineBENCH_CAPACITY );
+	vPipelineStageInit( &xBenchStages[ ulStage ], NULL, prvBenchSquare, NULL, &xBenchIn, &xBenchOut, uxBatch );
+
+	return &xBenchStages[ ulStage ];
+}
+
+static void prvBenchRun( PipelineStage_t *pxStage, const char *pcName, UBaseType_t uxBatch )
+{
+uint32_t ulSent = 0;
+uint32_t ulReceived = 0;
+uint32_t ulItem;
+uint64_t ullStart = ullTimestampCycles();
+BaseType_t xProgress;
+
+	while( ulReceived < pipelineBENCH_ITEMS )
+	{
+		xProgress = pdFALSE;
+
+		while( ( ulSent < pipelineBENCH_ITEMS ) && ( xPipelineChannelSend( &xBenchIn, &ulSent ) == pdPASS ) )
+		{
+			ulSent++;
+			xProgress = pdTRUE;
+		}
+
+		while( xPipelineChannelReceive( &xBenchOut, &ulItem ) == pdPASS )
+		{
+			configASSERT( ulItem == ( ulReceived * ulReceived ) );
+			ulReceived++;
+			xProgress = pdTRUE;
+		}
+
+		/* Let a task stage of the same priority run. */
+		if( xProgress == pdFALSE )
+		{
+			taskYIELD();
+		}
+	}
+
+	vBenchReport( pcName, uxBatch, ullTimestampCycles() - ullStart, pipelineBENCH_ITEMS );
+
+	vPipelineStageStop( pxStage );
+}
+
+void vPipelineBenchmark( void )
+{
+UBaseType_t uxBatch;
+uint32_t ulRun = 0;
+PipelineStage_t *pxStage;
+
+	for( uxBatch = 1; uxBatch <= 8U; uxBatch *= 8U )
+	{
+		pxStage = prvBenchStage( 2U * ulRun, uxBatch );
+		vPipelineStageStartTask( pxStage, uxTaskPriorityGet( NULL ), uxBenchStacks[ ulRun ], pipelineBENCH_STACK_DEPTH );
+		prvBenchRun( pxStage, "pipeline.task", uxBatch );
+
+	#if( configUSE_HART_LAUNCH == 1 )
+		pxStage = prvBenchStage( ( 2U * ulRun ) + 1U, uxBatch );
+
+		if( xPipelineStageStartHart( pxStage, 1 ) == pdPASS )
+		{
+			prvBenchRun( pxStage, "pipeline.hart", uxBatch );
+		}
+	#endif
+
+		ulRun++;
+	}
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_PIPELINE */
@@ -0,0 +1,171 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/*
+ * Dataflow pipelines spanning the harts.
+ *
+ * A pipeline is a chain of stages connected by bounded channels.  Each stage
+ * is a function that turns one item of its input channel into at most one
+ * item of its output channel, and runs either in a task on hart 0 or alone on
+ * a secondary hart (hart_launch.h).  The first stage has no input channel and
+ * the last one no output channel.
+ *
+ * A channel is a single producer, single consumer ring of fixed size items,
+ * lock-free so that its two ends can be on different harts.  The stage
+ * function works on the items in place: it reads its input from the slot of
+ * the input ring and writes its output to the slot of the output ring, and
+ * returns pdFALSE to drop the item instead of forwarding it.  The stages take
+ * up to uxBatch items at a time and publish the ring indexes once per batch,
+ * which keeps the cache lines of the indexes from going back and forth
+ * between the harts for every item.
+ *
+ * A stage with nothing to read, or no room to write, waits: a task stage
+ * blocks on its notification, a hart stage spins.  That is the backpressure:
+ * a full channel stops its producer, and so on up to the first stage.  Only
+ * code on hart 0 can notify a task, so a task stage fed by, or feeding, a
+ * hart stage notices the change at the next tick at the latest.
+ *
+ * The channels can also be fed and drained by ordinary tasks and interrupts
+ * with xPipelineChannelSend() and xPipelineChannelReceive(), as long as each
+ * end has a single user.
+ *
+ * With configUSE_TELEMETRY, each stage named at its init publishes its
+ * throughput (batches, items in and out, cycles spent in the function), the
+ * waits on each side, and the current and peak depth of its input channel.
+ *
+ *	static pipelineCHANNEL_STORAGE( ucRawStorage, sizeof( Sample_t ), 16 );
+ *	static PipelineChannel_t xRaw;
+ *	static PipelineStage_t xAcquire, xFilter, xLog;
+ *
+ *	vPipelineChannelInit( &xRaw, ucRawStorage, sizeof( Sample_t ), 16 );
+ *	...
+ *	vPipelineStageInit( &xFilter, "filter", prvFilter, NULL, &xRaw, &xFiltered, 8 );
+ *	xPipelineStageStartHart( &xFilter, 1 );
+ *	vPipelineStageStartTask( &xLog, tskIDLE_PRIORITY + 1, uxLogStack, 256 );
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cache_layout.h"
+#include "telemetry.h"
+
+#if( configUSE_PIPELINE == 1 )
+
+#if( configSUPPORT_STATIC_ALLOCATION != 1 )
+	#error The task stages are created static, set configSUPPORT_STATIC_ALLOCATION to 1
+#endif
+
+/* Declares the storage of a channel of ulCapacity items of xItemSize
+bytes. */
+#define pipelineCHANNEL_STORAGE( xName, xItemSize, ulCapacity )	\
+	uint8_t cachelayoutALIGNED xName[ ( xItemSize ) * ( ulCapacity ) ]
+
+/* One end of a channel, on its own cache line as each end is written by its
+own hart.  The members are private to pipeline.c. */
+typedef struct cachelayoutALIGNED xPIPELINE_CHANNEL_END
+{
+	volatile uint32_t ulIndex;		/* Items written, or read, so far. */
+	uint32_t ulOtherIndex;			/* Last seen index of the other end. */
+	TaskHandle_t xTask;				/* To notify, NULL if not a task stage. */
+	volatile uint32_t ulWaiting;	/* Set while xTask waits on the channel. */
+} PipelineChannelEnd_t;
+
+/* The members are private to pipeline.c. */
+typedef struct xPIPELINE_CHANNEL
+{
+	PipelineChannelEnd_t xProducer;
+	PipelineChannelEnd_t xConsumer;
+	uint8_t *pucItems;
+	size_t xItemSize;
+	uint32_t ulMask;				/* Capacity - 1. */
+} PipelineChannel_t;
+
+/* Turns *pvIn into *pvOut and returns pdTRUE to forward it, or pdFALSE to
+drop it.  pvIn is NULL for the first stage and pvOut for the last one.  The
+functions of the hart stages must not use the kernel API. */
+typedef BaseType_t ( *PipelineStageFunction_t )( void *pvContext, const void *pvIn, void *pvOut );
+
+#if( configUSE_TELEMETRY == 1 )
+
+typedef struct
+{
+	uint64_t ullBatches;
+	uint64_t ullItemsIn;
+	uint64_t ullItemsOut;
+	uint64_t ullDropped;			/* Items the function did not forward. */
+	uint64_t ullWaitsEmpty;
+	uint64_t ullWaitsFull;
+	uint64_t ullDepth;				/* Of the input channel, at the last batch. */
+	uint64_t ullPeak;
+	uint64_t ullBusyCycles;			/* Spent in the function. */
+} PipelineStageStats_t;
+
+#endif /* configUSE_TELEMETRY */
+
+/* The members are private to pipeline.c. */
+typedef struct xPIPELINE_STAGE
+{
+	PipelineStageFunction_t pxFunction;
+	void *pvContext;
+	PipelineChannel_t *pxIn;
+	PipelineChannel_t *pxOut;
+	UBaseType_t uxBatch;
+	const char *pcName;
+	uint32_t ulHartId;
+	volatile uint32_t ulStop;
+	volatile uint32_t ulRunning;
+	StaticTask_t xTaskBuffer;
+
+#if( configUSE_TELEMETRY == 1 )
+	BaseType_t xNamed;				/* Publishes xTelemetry. */
+	telemetryBLOCK( PipelineStageStats_t ) xTelemetry;
+#endif
+} PipelineStage_t;
+
+/* pvStorage holds ulCapacity items of xItemSize bytes, see
+pipelineCHANNEL_STORAGE().  ulCapacity is a power of two. */
+void vPipelineChannelInit( PipelineChannel_t *pxChannel, void *pvStorage, size_t xItemSize, uint32_t ulCapacity );
+
+/* Copy an item in, or out, without waiting.  Return pdFAIL if the channel is
+full, or empty.  For the tasks and interrupts of hart 0 at the ends of a
+pipeline, one sender and one receiver per channel. */
+BaseType_t xPipelineChannelSend( PipelineChannel_t *pxChannel, const void *pvItem );
+BaseType_t xPipelineChannelSendFromISR( PipelineChannel_t *pxChannel, const void *pvItem, BaseType_t *pxHigherPriorityTaskWoken );
+BaseType_t xPipelineChannelReceive( PipelineChannel_t *pxChannel, void *pvBuffer );
+BaseType_t xPipelineChannelReceiveFromISR( PipelineChannel_t *pxChannel, void *pvBuffer, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* Items in the channel, as seen from any hart. */
+uint32_t ulPipelineChannelDepth( const PipelineChannel_t *pxChannel );
+
+/* pxIn or pxOut is NULL at the ends of the pipeline, not both.  A stage takes
+up to uxBatch items at a time.  pcName names the telemetry block, none if
+NULL. */
+void vPipelineStageInit( PipelineStage_t *pxStage, const char *pcName, PipelineStageFunction_t pxFunction, void *pvContext,
+						 PipelineChannel_t *pxIn, PipelineChannel_t *pxOut, UBaseType_t uxBatch );
+
+/* Runs the stage in a task of hart 0. */
+void vPipelineStageStartTask( PipelineStage_t *pxStage, UBaseType_t uxPriority, StackType_t *puxStack, uint32_t ulStackDepth );
+
+#if( configUSE_HART_LAUNCH == 1 )
+	/* Runs the stage on ulHartId.  Returns pdFAIL if the hart is not idle,
+	see xHartLaunch(). */
+	BaseType_t xPipelineStageStartHart( PipelineStage_t *pxStage, uint32_t ulHartId );
+#endif
+
+/* Stops the stage at the end of its batch and returns once it has: its task
+is deleted, or its hart goes back to idle.  Called from a task. */
+void vPipelineStageStop( PipelineStage_t *pxStage );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vPipelineBenchmark( void );
+#endif
+
+#endif /* configUSE_PIPELINE */
+
+#endif /* PIPELINE_H */
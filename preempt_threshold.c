@@ -0,0 +1,330 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "preempt_threshold.h"
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+
+#if( configUSE_TIME_SLICING == 1 )
+	#error A task woken at the threshold would preempt the raised task at the next tick, set configUSE_TIME_SLICING to 0
+#endif
+
+#if( configUSE_TRACE_FACILITY != 1 ) || ( configUSE_MUTEXES != 1 )
+	#error The own priority of a task is read with vTaskGetInfo(), set configUSE_TRACE_FACILITY to 1
+#endif
+
+#if( configUSE_TELEMETRY == 1 )
+	#include "telemetry.h"
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "queue.h"
+	#include "semphr.h"
+	#include "bench.h"
+#endif
+
+/* The thread local storage pointer of a task holds its threshold, its own
+priority while it is raised, the raised flag and the demoted flag.  0 for a
+task without a threshold. */
+#define preemptthresholdTHRESHOLD_MASK	( ( uintptr_t ) 0xFFU )
+#define preemptthresholdBASE_SHIFT		( 8U )
+#define preemptthresholdRAISED			( ( uintptr_t ) 1U << 16 )
+#define preemptthresholdDEMOTED			( ( uintptr_t ) 1U << 17 )
+
+#if( configUSE_TELEMETRY == 1 )
+
+typedef struct
+{
+	uint64_t ullRaises;
+	uint64_t ullSwitchesAvoided;
+} ThresholdStats_t;
+
+static const char * const pcThresholdFields[] = { "raises", "switches_avoided" };
+
+/* Written with interrupts disabled on hart 0: the kernel moves tasks to the
+ready lists inside critical sections or interrupts (xTaskAbortDelay() aside,
+which the demo does not use). */
+static telemetryBLOCK( ThresholdStats_t ) xThresholdTelemetry;
+static BaseType_t xThresholdRegistered = pdFALSE;
+
+#endif /* configUSE_TELEMETRY */
+
+/*-----------------------------------------------------------*/
+
+static inline uintptr_t prvGetState( TaskHandle_t xTask )
+{
+	return ( uintptr_t ) pvTaskGetThreadLocalStoragePointer( xTask, configPREEMPT_THRESHOLD_TLS_INDEX );
+}
+
+static inline void prvSetState( TaskHandle_t xTask, uintptr_t uxState )
+{
+	vTaskSetThreadLocalStoragePointer( xTask, configPREEMPT_THRESHOLD_TLS_INDEX, ( void * ) uxState );
+}
+
+/* The priority of xTask without the one it inherits from the mutexes it
+holds, which is the one to give back.  The kernel has no
+uxTaskBasePriorityGet(). */
+static UBaseType_t prvBasePriority( TaskHandle_t xTask )
+{
+TaskStatus_t xStatus;
+
+	/* The state passed is not looked at, and saves working it out. */
+	vTaskGetInfo( xTask, &xStatus, pdFALSE, eRunning );
+
+	return xStatus.uxBasePriority;
+}
+/*-----------------------------------------------------------*/
+
+void vPreemptThresholdSet( TaskHandle_t xTask, UBaseType_t uxThreshold )
+{
+	configASSERT( uxThreshold < configMAX_PRIORITIES );
+	configASSERT( ( prvGetState( xTask ) & preemptthresholdRAISED ) == 0U );
+
+#if( configUSE_TELEMETRY == 1 )
+	if( xThresholdRegistered == pdFALSE )
+	{
+		xThresholdRegistered = pdTRUE;
+		telemetryREGISTER( xThresholdTelemetry, "threshold", pcThresholdFields );
+	}
+#endif
+
+	prvSetState( xTask, ( uintptr_t ) uxThreshold | ( prvGetState( xTask ) & preemptthresholdDEMOTED ) );
+}
+/*-----------------------------------------------------------*/
+
+void vPreemptThresholdRaise( void )
+{
+uintptr_t uxState;
+UBaseType_t uxThreshold;
+UBaseType_t uxPriority;
+
+	/* The scheduler is suspended so that the timer task cannot demote the
+	task between the test and the raise. */
+	vTaskSuspendAll();
+	{
+		uxState = prvGetState( NULL );
+		uxThreshold = ( UBaseType_t ) ( uxState & preemptthresholdTHRESHOLD_MASK );
+		uxPriority = prvBasePriority( NULL );
+
+		if( ( ( uxState & ( preemptthresholdRAISED | preemptthresholdDEMOTED ) ) == 0U ) && ( uxThreshold > uxPriority ) )
+		{
+			/* Marked raised first, so that the task moving itself to its new
+			ready list is not counted as a switch avoided. */
+			taskENTER_CRITICAL();
+			{
+				prvSetState( NULL, uxThreshold | ( ( uintptr_t ) uxPriority << preemptthresholdBASE_SHIFT ) | preemptthresholdRAISED );
+
+			#if( configUSE_TELEMETRY == 1 )
+				vTelemetryUpdateBegin( &( xThresholdTelemetry.xBlock ) );
+				xThresholdTelemetry.xStats.ullRaises++;
+				vTelemetryUpdateEnd( &( xThresholdTelemetry.xBlock ) );
+			#endif
+			}
+			taskEXIT_CRITICAL();
+
+			/* Raising the priority of the running task never causes a
+			switch. */
+			vTaskPrioritySet( NULL, uxThreshold );
+		}
+	}
+	( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+void vPreemptThresholdLower( void )
+{
+uintptr_t uxState;
+
+	/* As for the raise.  The switch to the tasks deferred happens on the
+	resume. */
+	vTaskSuspendAll();
+	{
+		uxState = prvGetState( NULL );
+
+		if( ( uxState & preemptthresholdRAISED ) != 0U )
+		{
+			prvSetState( NULL, uxState & preemptthresholdTHRESHOLD_MASK );
+			vTaskPrioritySet( NULL, ( UBaseType_t ) ( ( uxState >> preemptthresholdBASE_SHIFT ) & preemptthresholdTHRESHOLD_MASK ) );
+		}
+	}
+	( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxPreemptThresholdDemote( TaskHandle_t xTask )
+{
+uintptr_t uxState = prvGetState( xTask );
+UBaseType_t uxPriority;
+
+	configASSERT( ( uxState & preemptthresholdDEMOTED ) == 0U );
+
+	if( ( uxState & preemptthresholdRAISED ) != 0U )
+	{
+		uxPriority = ( UBaseType_t ) ( ( uxState >> preemptthresholdBASE_SHIFT ) & preemptthresholdTHRESHOLD_MASK );
+	}
+	else
+	{
+		uxPriority = prvBasePriority( xTask );
+	}
+
+	/* The raise is dropped with the flag: the caller sets the priority. */
+	prvSetState( xTask, ( uxState & preemptthresholdTHRESHOLD_MASK ) | preemptthresholdDEMOTED );
+
+	return uxPriority;
+}
+/*-----------------------------------------------------------*/
+
+void vPreemptThresholdUndemote( TaskHandle_t xTask )
+{
+	prvSetState( xTask, prvGetState( xTask ) & ~preemptthresholdDEMOTED );
+}
+/*-----------------------------------------------------------*/
+
+void vPreemptThresholdBlocking( void )
+{
+	/* The scheduler is suspended, so lowering the priority only pends the
+	switch, which happens once the task is blocked. */
+	vPreemptThresholdLower();
+}
+/*-----------------------------------------------------------*/
+
+void vPreemptThresholdReady( const void *pvTask, unsigned long ulPriority )
+{
+#if( configUSE_TELEMETRY == 1 )
+TaskHandle_t xCurrent = xTaskGetCurrentTaskHandle();
+uintptr_t uxState;
+UBaseType_t uxBase;
+
+	/* Tasks are also made ready while they are created, maybe before there is
+	a current task. */
+	if( ( xCurrent == NULL ) || ( pvTask == ( const void * ) xCurrent ) )
+	{
+		return;
+	}
+
+	uxState = prvGetState( NULL );
+
+	if( ( uxState & preemptthresholdRAISED ) == 0U )
+	{
+		return;
+	}
+
+	uxBase = ( UBaseType_t ) ( ( uxState >> preemptthresholdBASE_SHIFT ) & preemptthresholdTHRESHOLD_MASK );
+
+	if( ( ulPriority > uxBase ) && ( ulPriority <= ( uxState & preemptthresholdTHRESHOLD_MASK ) ) )
+	{
+		vTelemetryUpdateBegin( &( xThresholdTelemetry.xBlock ) );
+		xThresholdTelemetry.xStats.ullSwitchesAvoided++;
+		vTelemetryUpdateEnd( &( xThresholdTelemetry.xBlock ) );
+	}
+#else
+	( void ) pvTask;
+	( void ) ulPriority;
+#endif
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * The producer (the benchmark task) sends preemptthresholdBENCH_BATCH items
+ * to a consumer one priority above, then waits for the consumer to signal
+ * the end of the batch.  Without threshold, every send switches to the
+ * consumer and back.  With a threshold at the priority of the consumer, the
+ * consumer runs once per batch, when the producer blocks.
+ */
+#define preemptthresholdBENCH_BATCH		( 8U )
+#define preemptthresholdBENCH_ROUNDS	( 100U )
+
+static QueueHandle_t xBenchQueue = NULL;
+static SemaphoreHandle_t xBenchDone = NULL;
+
+static void prvBenchConsumerTask( void *pvParameters )
+{
+uint32_t ulItem;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		xQueueReceive( xBenchQueue, &ulItem, portMAX_DELAY );
+
+		if( ulItem == ( preemptthresholdBENCH_BATCH - 1U ) )
+		{
+			xSemaphoreGive( xBenchDone );
+		}
+	}
+}
+
+static uint64_t prvBenchRun( BaseType_t xRaise )
+{
+uint64_t ullStart = ullTimestampCycles();
+uint32_t ulRound;
+uint32_t ulItem;
+
+	for( ulRound = 0; ulRound < preemptthresholdBENCH_ROUNDS; ulRound++ )
+	{
+		if( xRaise != pdFALSE )
+		{
+			vPreemptThresholdRaise();
+		}
+
+		for( ulItem = 0; ulItem < preemptthresholdBENCH_BATCH; ulItem++ )
+		{
+			xQueueSend( xBenchQueue, &ulItem, portMAX_DELAY );
+		}
+
+		xSemaphoreTake( xBenchDone, portMAX_DELAY );
+	}
+
+	return ullTimestampCycles() - ullStart;
+}
+
+void vPreemptThresholdBenchmark( void )
+{
+UBaseType_t uxPriority = uxTaskPriorityGet( NULL );
+TaskHandle_t xConsumer = NULL;
+uint64_t ullCycles;
+
+	xBenchQueue = xQueueCreate( preemptthresholdBENCH_BATCH, sizeof( uint32_t ) );
+	xBenchDone = xSemaphoreCreateBinary();
+
+	if( ( xBenchQueue == NULL ) || ( xBenchDone == NULL ) ||
+		( xTaskCreate( prvBenchConsumerTask, "ThrCons", configMINIMAL_STACK_SIZE, NULL, uxPriority + 1U, &xConsumer ) != pdPASS ) )
+	{
+		vBenchReport( "preempt_threshold.no_memory", 0, 0, 1 );
+	}
+	else
+	{
+		ullCycles = prvBenchRun( pdFALSE );
+		vBenchReport( "preempt_threshold.preemptive", preemptthresholdBENCH_BATCH, ullCycles, preemptthresholdBENCH_ROUNDS * preemptthresholdBENCH_BATCH );
+
+		vPreemptThresholdSet( NULL, uxPriority + 1U );
+		ullCycles = prvBenchRun( pdTRUE );
+		vPreemptThresholdSet( NULL, 0 );
+		vBenchReport( "preempt_threshold.threshold", preemptthresholdBENCH_BATCH, ullCycles, preemptthresholdBENCH_ROUNDS * preemptthresholdBENCH_BATCH );
+	}
+
+	if( xConsumer != NULL )
+	{
+		vTaskDelete( xConsumer );
+	}
+
+	if( xBenchDone != NULL )
+	{
+		vSemaphoreDelete( xBenchDone );
+	}
+
+	if( xBenchQueue != NULL )
+	{
+		vQueueDelete( xBenchQueue );
+	}
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_PREEMPT_THRESHOLD */
@@ -0,0 +1,79 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef PREEMPT_THRESHOLD_H
+#define PREEMPT_THRESHOLD_H
+
+/*
+ * Preemption threshold.
+ *
+ * A task with a threshold above its priority is dispatched at its priority,
+ * but once it runs only the tasks above its threshold can preempt it.  The
+ * tasks between the two that it wakes, as the Tx task wakes Rx with
+ * xQueueSend(), run when it blocks instead of preempting it at once, which
+ * saves a switch back to it per wake up.
+ *
+ * The kernel has no such notion, so it is built from priorities:
+ *  - vPreemptThresholdRaise(), called by the task when its job starts, sets
+ *    its priority to the threshold;
+ *  - the kernel trace macros of the blocking calls (trace_hooks.h) give the
+ *    task its own priority back before it blocks, with the scheduler still
+ *    suspended, so that it waits and is woken at its own priority and the
+ *    tasks it deferred run as soon as it blocks;
+ *  - configUSE_TIME_SLICING is 0, as otherwise a task woken at the threshold
+ *    itself, sharing the priority of the raised task, would preempt it at
+ *    the next tick.  Tasks of equal priority then only take turns when one
+ *    blocks or yields.
+ *
+ * That covers vTaskDelay(), vTaskDelayUntil(), the queues, semaphores and
+ * mutexes, and the event groups.  The task notifications block inside a
+ * critical section where the priority cannot be changed: call
+ * vPreemptThresholdLower() before blocking on one.
+ *
+ * The threshold of each task is kept in its thread local storage pointer
+ * configPREEMPT_THRESHOLD_TLS_INDEX.  The tasks of the manifest get the one
+ * declared there.  With configUSE_TELEMETRY the "threshold" block counts the
+ * raises and the context switches avoided: the wake ups of a task that would
+ * have preempted the raised one.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+
+#if( configNUM_THREAD_LOCAL_STORAGE_POINTERS <= configPREEMPT_THRESHOLD_TLS_INDEX )
+	#error configNUM_THREAD_LOCAL_STORAGE_POINTERS must leave room for configPREEMPT_THRESHOLD_TLS_INDEX
+#endif
+
+/* Declares the threshold of xTask, or of the calling task if NULL.  A
+threshold at or below the priority of the task disables it.  Not while the
+task is raised. */
+void vPreemptThresholdSet( TaskHandle_t xTask, UBaseType_t uxThreshold );
+
+/* Runs the calling task at its threshold until it blocks.  Does nothing if it
+has none, is already raised, or is demoted. */
+void vPreemptThresholdRaise( void );
+
+/* Gives the calling task its own priority back, which lets the tasks it
+deferred run. */
+void vPreemptThresholdLower( void );
+
+/* For task_demotion.c, from the timer task: uxPreemptThresholdDemote()
+undoes the raise of xTask, keeps it from raising until
+vPreemptThresholdUndemote(), and returns its own priority.  The caller sets
+the priority of the task. */
+UBaseType_t uxPreemptThresholdDemote( TaskHandle_t xTask );
+void vPreemptThresholdUndemote( TaskHandle_t xTask );
+
+/* Called by the trace macros, see trace_hooks.h. */
+void vPreemptThresholdBlocking( void );
+void vPreemptThresholdReady( const void *pvTask, unsigned long ulPriority );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vPreemptThresholdBenchmark( void );
+#endif
+
+#endif /* configUSE_PREEMPT_THRESHOLD */
+
+#endif /* PREEMPT_THRESHOLD_H */
@@ -0,0 +1,397 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "prio_queue.h"
+
+#if( configUSE_PRIO_QUEUE == 1 )
+
+#if( configUSE_COUNTING_SEMAPHORES != 1 )
+	#error The priority queue waits on counting semaphores, set configUSE_COUNTING_SEMAPHORES to 1
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "queue.h"
+	#include "bench.h"
+#endif
+
+/*-----------------------------------------------------------*/
+
+/* pdTRUE if pxA leaves before pxB: higher priority, or sent earlier. */
+static inline BaseType_t prvBefore( const PrioQueueNode_t *pxA, const PrioQueueNode_t *pxB )
+{
+	if( pxA->ulPriority != pxB->ulPriority )
+	{
+		return ( pxA->ulPriority > pxB->ulPriority ) ? pdTRUE : pdFALSE;
+	}
+
+	/* The sequence wraps around, but the heap never holds items 2^31 sends
+	apart. */
+	return ( ( int32_t ) ( pxA->ulSequence - pxB->ulSequence ) < 0 ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vPrioQueueInit( PrioQueue_t *pxQueue, void *pvStorage, UBaseType_t uxCapacity, UBaseType_t uxItemSize )
+{
+UBaseType_t uxSlot;
+
+	configASSERT( ( uxCapacity > 0U ) && ( uxItemSize > 0U ) );
+
+	/* The layout of prioqueueSTORAGE(): the items need no alignment, so
+	follow the nodes without padding. */
+	pxQueue->pxNodes = ( PrioQueueNode_t * ) pvStorage;
+	pxQueue->pucItems = ( uint8_t * ) &( pxQueue->pxNodes[ uxCapacity ] );
+	pxQueue->uxCapacity = uxCapacity;
+	pxQueue->uxItemSize = uxItemSize;
+	pxQueue->uxCount = 0;
+	pxQueue->ulNextSequence = 0;
+
+	/* The nodes past the heap hold the free slots. */
+	for( uxSlot = 0; uxSlot < uxCapacity; uxSlot++ )
+	{
+		pxQueue->pxNodes[ uxSlot ].uxSlot = uxSlot;
+	}
+
+	pxQueue->xItems = xSemaphoreCreateCountingStatic( uxCapacity, 0, &( pxQueue->xItemsBuffer ) );
+	pxQueue->xSpaces = xSemaphoreCreateCountingStatic( uxCapacity, uxCapacity, &( pxQueue->xSpacesBuffer ) );
+}
+/*-----------------------------------------------------------*/
+
+/* Called in a critical section, with a space taken. */
+static void prvPush( PrioQueue_t *pxQueue, const void *pvItem, uint32_t ulPriority )
+{
+PrioQueueNode_t *pxNodes = pxQueue->pxNodes;
+PrioQueueNode_t xNew;
+UBaseType_t uxIndex = pxQueue->uxCount;
+UBaseType_t uxParent;
+
+	xNew.ulPriority = ulPriority;
+	xNew.ulSequence = pxQueue->ulNextSequence++;
+	xNew.uxSlot = pxNodes[ uxIndex ].uxSlot;
+
+	memcpy( &( pxQueue->pucItems[ xNew.uxSlot * pxQueue->uxItemSize ] ), pvItem, pxQueue->uxItemSize );
+
+	while( uxIndex > 0U )
+	{
+		uxParent = ( uxIndex - 1U ) / 2U;
+
+		if( prvBefore( &xNew, &pxNodes[ uxParent ] ) == pdFALSE )
+		{
+			break;
+		}
+
+		pxNodes[ uxIndex ] = pxNodes[ uxParent ];
+		uxIndex = uxParent;
+	}
+
+	pxNodes[ uxIndex ] = xNew;
+	pxQueue->uxCount++;
+}
+/*-----------------------------------------------------------*/
+
+/* Called in a critical section, with an item taken. */
+static void prvPop( PrioQueue_t *pxQueue, void *pvBuffer, uint32_t *pulPriority )
+{
+PrioQueueNode_t *pxNodes = pxQueue->pxNodes;
+PrioQueueNode_t xLast;
+UBaseType_t uxFreed = pxNodes[ 0 ].uxSlot;
+UBaseType_t uxCount;
+UBaseType_t uxIndex = 0;
+UBaseType_t uxChild;
+
+	memcpy( pvBuffer, &( pxQueue->pucItems[ uxFreed * pxQueue->uxItemSize ] ), pxQueue->uxItemSize );
+
+	if( pulPriority != NULL )
+	{
+		*pulPriority = pxNodes[ 0 ].ulPriority;
+	}
+
+	uxCount = --( pxQueue->uxCount );
+	xLast = pxNodes[ uxCount ];
+
+	/* Sift the last node down from the root. */
+	for( ;; )
+	{
+		uxChild = ( 2U * uxIndex ) + 1U;
+
+		if( uxChild >= uxCount )
+		{
+			break;
+		}
+
+		if( ( ( uxChild + 1U ) < uxCount ) && ( prvBefore( &pxNodes[ uxChild + 1U ], &pxNodes[ uxChild ] ) != pdFALSE ) )
+		{
+			uxChild++;
+		}
+
+		if( prvBefore( &pxNodes[ uxChild ], &xLast ) == pdFALSE )
+		{
+			break;
+		}
+
+		pxNodes[ uxIndex ] = pxNodes[ uxChild ];
+		uxIndex = uxChild;
+	}
+
+	pxNodes[ uxIndex ] = xLast;
+
+	/* The node just past the heap keeps the slot freed. */
+	pxNodes[ uxCount ].uxSlot = uxFreed;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPrioQueueSend( PrioQueue_t *pxQueue, const void *pvItem, uint32_t ulPriority, TickType_t xTicksToWait )
+{
+	if( xSemaphoreTake( pxQueue->xSpaces, xTicksToWait ) != pdPASS )
+	{
+		return pdFAIL;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		prvPush( pxQueue, pvItem, ulPriority );
+	}
+	taskEXIT_CRITICAL();
+
+	( void ) xSemaphoreGive( pxQueue->xItems );
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPrioQueueSendFromISR( PrioQueue_t *pxQueue, const void *pvItem, uint32_t ulPriority, BaseType_t *pxHigherPriorityTaskWoken )
+{
+UBaseType_t uxSavedInterruptStatus;
+
+	if( xSemaphoreTakeFromISR( pxQueue->xSpaces, NULL ) != pdPASS )
+	{
+		return pdFAIL;
+	}
+
+	uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+	{
+		prvPush( pxQueue, pvItem, ulPriority );
+	}
+	taskEXIT_CRITICAL_FROM_ISR( uxSavedInterruptStatus );
+
+	( void ) xSemaphoreGiveFromISR( pxQueue->xItems, pxHigherPriorityTaskWoken );
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPrioQueueReceive( PrioQueue_t *pxQueue, void *pvBuffer, uint32_t *pulPriority, TickType_t xTicksToWait )
+{
+	if( xSemaphoreTake( pxQueue->xItems, xTicksToWait ) != pdPASS )
+	{
+		return pdFAIL;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		prvPop( pxQueue, pvBuffer, pulPriority );
+	}
+	taskEXIT_CRITICAL();
+
+	( void ) xSemaphoreGive( pxQueue->xSpaces );
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPrioQueueReceiveFromISR( PrioQueue_t *pxQueue, void *pvBuffer, uint32_t *pulPriority, BaseType_t *pxHigherPriorityTaskWoken )
+{
+UBaseType_t uxSavedInterruptStatus;
+
+	if( xSemaphoreTakeFromISR( pxQueue->xItems, NULL ) != pdPASS )
+	{
+		return pdFAIL;
+	}
+
+	uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+	{
+		prvPop( pxQueue, pvBuffer, pulPriority );
+	}
+	taskEXIT_CRITICAL_FROM_ISR( uxSavedInterruptStatus );
+
+	( void ) xSemaphoreGiveFromISR( pxQueue->xSpaces, pxHigherPriorityTaskWoken );
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxPrioQueueMessagesWaiting( const PrioQueue_t *pxQueue )
+{
+	return pxQueue->uxCount;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Latency of urgent messages through a saturated queue, from their send to
+ * their receive, with a kernel FIFO queue and with the priority queue.  Three
+ * tasks above the benchmark task:
+ *  - a receiver, which blocks on the queue and spends
+ *    prioqueueBENCH_WORK_CYCLES on each bulk message;
+ *  - a bulk producer above it, which refills the queue as soon as a slot
+ *    frees, so the queue stays full;
+ *  - an urgent sender above both, which sends one urgent message per tick
+ *    and waits for the receiver to get it.
+ * The FIFO latency is the whole backlog of bulk messages, the priority queue
+ * latency is one message at most: the one being processed when the urgent
+ * message is sent.
+ */
+#define prioqueueBENCH_CAPACITY		( 16U )
+#define prioqueueBENCH_ROUNDS		( 100U )
+#define prioqueueBENCH_WORK_CYCLES	( 1000U )
+#define prioqueueBENCH_BULK			( 0UL )
+#define prioqueueBENCH_URGENT		( 0xFFFFFFFFUL )
+
+static prioqueueSTORAGE( prioqueueBENCH_CAPACITY, sizeof( uint32_t ) ) xBenchStorage;
+static PrioQueue_t xBenchPrioQueue;
+static StaticQueue_t xBenchFifoBuffer;
+static uint8_t ucBenchFifoStorage[ prioqueueBENCH_CAPACITY * sizeof( uint32_t ) ];
+
+/* The queue measured: the kernel FIFO queue, or the priority queue if NULL. */
+static QueueHandle_t xBenchFifo = NULL;
+
+static TaskHandle_t xBenchSender = NULL;
+static volatile BaseType_t xBenchStop;
+static volatile uint64_t ullBenchSent;
+static uint64_t ullBenchLatency;
+static uint32_t ulBenchRounds;
+
+static void prvBenchSend( uint32_t ulItem, uint32_t ulPriority )
+{
+	if( xBenchFifo != NULL )
+	{
+		( void ) xQueueSend( xBenchFifo, &ulItem, portMAX_DELAY );
+	}
+	else
+	{
+		( void ) xPrioQueueSend( &xBenchPrioQueue, &ulItem, ulPriority, portMAX_DELAY );
+	}
+}
+
+static void prvBenchReceiver( void *pvParameters )
+{
+uint32_t ulItem;
+uint64_t ullStart;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		if( xBenchFifo != NULL )
+		{
+			( void ) xQueueReceive( xBenchFifo, &ulItem, portMAX_DELAY );
+		}
+		else
+		{
+			( void ) xPrioQueueReceive( &xBenchPrioQueue, &ulItem, NULL, portMAX_DELAY );
+		}
+
+		if( ulItem == prioqueueBENCH_URGENT )
+		{
+			ullBenchLatency += ullTimestampCycles() - ullBenchSent;
+			ulBenchRounds++;
+
+			if( ulBenchRounds == prioqueueBENCH_ROUNDS )
+			{
+				xBenchStop = pdTRUE;
+			}
+
+			xTaskNotifyGive( xBenchSender );
+		}
+		else
+		{
+			ullStart = ullTimestampCycles();
+
+			while( ( ullTimestampCycles() - ullStart ) < prioqueueBENCH_WORK_CYCLES )
+			{
+			}
+		}
+	}
+}
+
+static void prvBenchProducer( void *pvParameters )
+{
+	( void ) pvParameters;
+
+	while( xBenchStop == pdFALSE )
+	{
+		prvBenchSend( prioqueueBENCH_BULK, 0 );
+	}
+
+	vTaskSuspend( NULL );
+}
+
+static void prvBenchSender( void *pvParameters )
+{
+	( void ) pvParameters;
+
+	while( xBenchStop == pdFALSE )
+	{
+		vTaskDelay( 1 );
+
+		ullBenchSent = ullTimestampCycles();
+		prvBenchSend( prioqueueBENCH_URGENT, 1 );
+		( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	}
+
+	vTaskSuspend( NULL );
+}
+
+static void prvBenchRun( const char *pcName )
+{
+UBaseType_t uxPriority = uxTaskPriorityGet( NULL );
+TaskHandle_t xReceiver = NULL;
+TaskHandle_t xProducer = NULL;
+
+	xBenchStop = pdFALSE;
+	ullBenchLatency = 0;
+	ulBenchRounds = 0;
+
+	xTaskCreate( prvBenchReceiver, "BenchRx", configMINIMAL_STACK_SIZE, NULL, uxPriority + 1U, &xReceiver );
+	xTaskCreate( prvBenchProducer, "BenchBulk", configMINIMAL_STACK_SIZE, NULL, uxPriority + 2U, &xProducer );
+	xTaskCreate( prvBenchSender, "BenchUrgent", configMINIMAL_STACK_SIZE, NULL, uxPriority + 3U, &xBenchSender );
+	configASSERT( ( xReceiver != NULL ) && ( xProducer != NULL ) && ( xBenchSender != NULL ) );
+
+	/* Only runs once the three tasks are blocked or suspended, the queue
+	drained. */
+	while( xBenchStop == pdFALSE )
+	{
+		vTaskDelay( 1 );
+	}
+
+	vTaskDelete( xBenchSender );
+	vTaskDelete( xProducer );
+	vTaskDelete( xReceiver );
+	xBenchSender = NULL;
+
+	vBenchReport( pcName, prioqueueBENCH_CAPACITY, ullBenchLatency, ulBenchRounds );
+}
+
+void vPrioQueueBenchmark( void )
+{
+	configASSERT( ( uxTaskPriorityGet( NULL ) + 3U ) < configMAX_PRIORITIES );
+
+	xBenchFifo = xQueueCreateStatic( prioqueueBENCH_CAPACITY, sizeof( uint32_t ), ucBenchFifoStorage, &xBenchFifoBuffer );
+	configASSERT( xBenchFifo != NULL );
+	prvBenchRun( "prio_queue.fifo_urgent" );
+
+	xBenchFifo = NULL;
+	vPrioQueueInit( &xBenchPrioQueue, &xBenchStorage, prioqueueBENCH_CAPACITY, sizeof( uint32_t ) );
+	prvBenchRun( "prio_queue.prio_urgent" );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_PRIO_QUEUE */
@@ -0,0 +1,93 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef PRIO_QUEUE_H
+#define PRIO_QUEUE_H
+
+/*
+ * Priority ordered message queue.
+ *
+ * Each item is sent with a priority and the receivers get the item of the
+ * highest priority first, and the items of the same priority in the order
+ * they were sent, so urgent messages overtake the bulk traffic queued ahead
+ * of them.  The send and receive calls block like xQueueSend() and
+ * xQueueReceive(), and can be called from interrupts with the FromISR
+ * variants.
+ *
+ * The items are kept in a binary heap of fixed capacity, in static storage
+ * declared with prioqueueSTORAGE().  The heap only moves small nodes
+ * (priority, order, slot); the items stay in their slot and are copied in
+ * and out in a critical section, like the kernel queues do, so keep them
+ * small.  The tasks wait on two counting semaphores, of the items and of the
+ * free slots, as the kernel event lists are private to tasks.c.
+ *
+ *	static prioqueueSTORAGE( 16, sizeof( Message_t ) ) xStorage;
+ *	static PrioQueue_t xQueue;
+ *
+ *	vPrioQueueInit( &xQueue, &xStorage, 16, sizeof( Message_t ) );
+ *	xPrioQueueSend( &xQueue, &xMessage, 3, portMAX_DELAY );
+ *	xPrioQueueReceive( &xQueue, &xMessage, NULL, portMAX_DELAY );
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#if( configUSE_PRIO_QUEUE == 1 )
+
+/* A node of the heap.  The members are private to prio_queue.c. */
+typedef struct
+{
+	uint32_t ulPriority;
+	uint32_t ulSequence;			/* Order of the sends, for equal priorities. */
+	UBaseType_t uxSlot;				/* Of the item. */
+} PrioQueueNode_t;
+
+/* The type of the storage of a queue of uxCapacity items of uxItemSize
+bytes. */
+#define prioqueueSTORAGE( uxCapacity, uxItemSize )			\
+	struct													\
+	{														\
+		PrioQueueNode_t xNodes[ uxCapacity ];				\
+		uint8_t ucItems[ ( uxCapacity ) * ( uxItemSize ) ];	\
+	}
+
+/* The members are private to prio_queue.c. */
+typedef struct xPRIO_QUEUE
+{
+	PrioQueueNode_t *pxNodes;		/* The heap, then the free slots. */
+	uint8_t *pucItems;
+	UBaseType_t uxCapacity;
+	UBaseType_t uxItemSize;
+	UBaseType_t uxCount;
+	uint32_t ulNextSequence;
+	SemaphoreHandle_t xItems;
+	SemaphoreHandle_t xSpaces;
+	StaticSemaphore_t xItemsBuffer;
+	StaticSemaphore_t xSpacesBuffer;
+} PrioQueue_t;
+
+/* pvStorage is declared with prioqueueSTORAGE( uxCapacity, uxItemSize ). */
+void vPrioQueueInit( PrioQueue_t *pxQueue, void *pvStorage, UBaseType_t uxCapacity, UBaseType_t uxItemSize );
+
+/* Return pdPASS once the item is queued, or pdFAIL if xTicksToWait expired
+first. */
+BaseType_t xPrioQueueSend( PrioQueue_t *pxQueue, const void *pvItem, uint32_t ulPriority, TickType_t xTicksToWait );
+BaseType_t xPrioQueueSendFromISR( PrioQueue_t *pxQueue, const void *pvItem, uint32_t ulPriority, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* Return pdPASS once the item of the highest priority is copied to pvBuffer,
+and its priority to *pulPriority if not NULL, or pdFAIL if xTicksToWait
+expired first. */
+BaseType_t xPrioQueueReceive( PrioQueue_t *pxQueue, void *pvBuffer, uint32_t *pulPriority, TickType_t xTicksToWait );
+BaseType_t xPrioQueueReceiveFromISR( PrioQueue_t *pxQueue, void *pvBuffer, uint32_t *pulPriority, BaseType_t *pxHigherPriorityTaskWoken );
+
+UBaseType_t uxPrioQueueMessagesWaiting( const PrioQueue_t *pxQueue );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vPrioQueueBenchmark( void );
+#endif
+
+#endif /* configUSE_PRIO_QUEUE */
+
+#endif /* PRIO_QUEUE_H */
@@ -0,0 +1,285 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "queue_monitor.h"
+#include "telemetry.h"
+
+#if( configUSE_QUEUE_MONITOR == 1 )
+
+#if( configUSE_TELEMETRY != 1 )
+	#error The queue monitor publishes through telemetry, set configUSE_TELEMETRY to 1
+#endif
+
+#if( configUSE_TRACE_FACILITY != 1 )
+	#error The queue monitor keeps its slots in the queue numbers, set configUSE_TRACE_FACILITY to 1
+#endif
+
+#if( configQUEUE_REGISTRY_SIZE == 0 )
+	#error The queue monitor has one slot per entry of the queue registry, set configQUEUE_REGISTRY_SIZE above 0
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* Default names are "queue" and the slot. */
+#define queuemonitorPREFIX		"queue"
+
+typedef struct
+{
+	uint64_t ullLength;
+	uint64_t ullDepth;
+	uint64_t ullPeak;
+	uint64_t ullItems;				/* Sent. */
+	uint64_t ullBlockedFull;
+	uint64_t ullBlockedEmpty;
+} QueueMonitorStats_t;
+
+typedef struct
+{
+	void *pvQueue;					/* NULL while the slot is free. */
+	BaseType_t xRegistered;
+	char cName[ configMAX_TASK_NAME_LEN ];
+	telemetryBLOCK( QueueMonitorStats_t ) xTelemetry;
+} QueueMonitorSlot_t;
+
+static const char * const pcQueueMonitorFields[] = { "length", "depth", "peak", "items", "blocked_full", "blocked_empty" };
+
+/* Slot n is queue number n + 1, 0 is for the queues not monitored.  Written
+in the critical sections of the kernel. */
+static QueueMonitorSlot_t xSlots[ configQUEUE_REGISTRY_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+static inline QueueMonitorSlot_t *prvGetSlot( UBaseType_t uxNumber )
+{
+	/* 0 wraps around, and so is rejected too. */
+	if( ( uxNumber - 1U ) < ( UBaseType_t ) configQUEUE_REGISTRY_SIZE )
+	{
+		return &xSlots[ uxNumber - 1U ];
+	}
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvDefaultName( char *pcName, UBaseType_t uxSlot )
+{
+char cDigits[ 4 ];
+UBaseType_t uxDigits = 0;
+UBaseType_t uxLength = sizeof( queuemonitorPREFIX ) - 1U;
+
+	memcpy( pcName, queuemonitorPREFIX, uxLength );
+
+	do
+	{
+		cDigits[ uxDigits++ ] = ( char ) ( '0' + ( uxSlot % 10U ) );
+		uxSlot /= 10U;
+	} while( ( uxSlot != 0U ) && ( uxDigits < sizeof( cDigits ) ) );
+
+	while( uxDigits > 0U )
+	{
+		pcName[ uxLength++ ] = cDigits[ --uxDigits ];
+	}
+
+	pcName[ uxLength ] = '\0';
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxQueueMonitorCreate( void *pvQueue, UBaseType_t uxLength )
+{
+QueueMonitorSlot_t *pxSlot = NULL;
+UBaseType_t uxSlot;
+
+	taskENTER_CRITICAL();
+	{
+		for( uxSlot = 0; uxSlot < ( UBaseType_t ) configQUEUE_REGISTRY_SIZE; uxSlot++ )
+		{
+			if( xSlots[ uxSlot ].pvQueue == NULL )
+			{
+				pxSlot = &xSlots[ uxSlot ];
+				pxSlot->pvQueue = pvQueue;
+				break;
+			}
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if( pxSlot == NULL )
+	{
+		return 0;
+	}
+
+	/* The queue is not in use yet, so nothing else updates the slot. */
+	vTelemetryUpdateBegin( &( pxSlot->xTelemetry.xBlock ) );
+	memset( &( pxSlot->xTelemetry.xStats ), 0, sizeof( pxSlot->xTelemetry.xStats ) );
+	pxSlot->xTelemetry.xStats.ullLength = uxLength;
+	prvDefaultName( pxSlot->cName, uxSlot );
+	vTelemetryUpdateEnd( &( pxSlot->xTelemetry.xBlock ) );
+
+	if( pxSlot->xRegistered == pdFALSE )
+	{
+		pxSlot->xRegistered = pdTRUE;
+		telemetryREGISTER( pxSlot->xTelemetry, pxSlot->cName, pcQueueMonitorFields );
+	}
+
+	vQueueAddToRegistry( ( QueueHandle_t ) pvQueue, pxSlot->cName );
+
+	return uxSlot + 1U;
+}
+/*-----------------------------------------------------------*/
+
+void vQueueMonitorDelete( UBaseType_t uxNumber )
+{
+QueueMonitorSlot_t *pxSlot = prvGetSlot( uxNumber );
+
+	/* vQueueDelete() takes the queue out of the registry itself. */
+	if( pxSlot != NULL )
+	{
+		pxSlot->pvQueue = NULL;
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vQueueMonitorSetName( QueueHandle_t xQueue, const char *pcName )
+{
+QueueMonitorSlot_t *pxSlot = prvGetSlot( uxQueueGetQueueNumber( xQueue ) );
+
+	if( pxSlot == NULL )
+	{
+		vQueueAddToRegistry( xQueue, pcName );
+		return;
+	}
+
+	vQueueUnregisterQueue( xQueue );
+	strncpy( pxSlot->cName, pcName, sizeof( pxSlot->cName ) - 1U );
+	pxSlot->cName[ sizeof( pxSlot->cName ) - 1U ] = '\0';
+	vQueueAddToRegistry( xQueue, pxSlot->cName );
+}
+/*-----------------------------------------------------------*/
+
+void vQueueMonitorSend( UBaseType_t uxNumber, UBaseType_t uxWaiting, UBaseType_t uxLength )
+{
+QueueMonitorSlot_t *pxSlot = prvGetSlot( uxNumber );
+QueueMonitorStats_t *pxStats;
+
+	if( pxSlot == NULL )
+	{
+		return;
+	}
+
+	pxStats = &( pxSlot->xTelemetry.xStats );
+
+	vTelemetryUpdateBegin( &( pxSlot->xTelemetry.xBlock ) );
+
+	/* Called before the kernel counts the item, which an overwrite of a full
+	queue does not add. */
+	pxStats->ullDepth = ( uxWaiting < uxLength ) ? ( uxWaiting + 1U ) : uxWaiting;
+	pxStats->ullItems++;
+
+	if( pxStats->ullDepth > pxStats->ullPeak )
+	{
+		pxStats->ullPeak = pxStats->ullDepth;
+	}
+
+	vTelemetryUpdateEnd( &( pxSlot->xTelemetry.xBlock ) );
+}
+/*-----------------------------------------------------------*/
+
+void vQueueMonitorReceive( UBaseType_t uxNumber, UBaseType_t uxWaiting )
+{
+QueueMonitorSlot_t *pxSlot = prvGetSlot( uxNumber );
+
+	if( pxSlot == NULL )
+	{
+		return;
+	}
+
+	/* Called before the kernel removes the item. */
+	vTelemetryUpdateBegin( &( pxSlot->xTelemetry.xBlock ) );
+	pxSlot->xTelemetry.xStats.ullDepth = uxWaiting - 1U;
+	vTelemetryUpdateEnd( &( pxSlot->xTelemetry.xBlock ) );
+}
+/*-----------------------------------------------------------*/
+
+void vQueueMonitorBlocking( UBaseType_t uxNumber, BaseType_t xFull )
+{
+QueueMonitorSlot_t *pxSlot = prvGetSlot( uxNumber );
+
+	if( pxSlot == NULL )
+	{
+		return;
+	}
+
+	/* The kernel only suspends the scheduler around this one, and interrupts
+	may send to or receive from the same queue. */
+	taskENTER_CRITICAL();
+	{
+		vTelemetryUpdateBegin( &( pxSlot->xTelemetry.xBlock ) );
+
+		if( xFull != pdFALSE )
+		{
+			pxSlot->xTelemetry.xStats.ullBlockedFull++;
+		}
+		else
+		{
+			pxSlot->xTelemetry.xStats.ullBlockedEmpty++;
+		}
+
+		vTelemetryUpdateEnd( &( pxSlot->xTelemetry.xBlock ) );
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Cost of a send and a receive that do not block, which include the
+ * monitor.  The queue is then named and left for the telemetry dump, where
+ * its peak shows the burst.
+ */
+#define queuemonitorBENCH_LENGTH		( 4U )
+#define queuemonitorBENCH_ROUNDS		( 250U )
+
+static StaticQueue_t xBenchQueueBuffer;
+static uint8_t ucBenchQueueStorage[ queuemonitorBENCH_LENGTH * sizeof( uint32_t ) ];
+
+void vQueueMonitorBenchmark( void )
+{
+QueueHandle_t xQueue = xQueueCreateStatic( queuemonitorBENCH_LENGTH, sizeof( uint32_t ), ucBenchQueueStorage, &xBenchQueueBuffer );
+uint64_t ullStart;
+uint32_t ulRound;
+uint32_t ulItem;
+uint32_t ulValue;
+
+	vQueueMonitorSetName( xQueue, "bench_monitor" );
+
+	ullStart = ullTimestampCycles();
+
+	for( ulRound = 0; ulRound < queuemonitorBENCH_ROUNDS; ulRound++ )
+	{
+		for( ulItem = 0; ulItem < queuemonitorBENCH_LENGTH; ulItem++ )
+		{
+			xQueueSend( xQueue, &ulItem, 0 );
+		}
+
+		for( ulItem = 0; ulItem < queuemonitorBENCH_LENGTH; ulItem++ )
+		{
+			xQueueReceive( xQueue, &ulValue, 0 );
+		}
+	}
+
+	vBenchReport( "queue_monitor.send_receive", queuemonitorBENCH_LENGTH, ullTimestampCycles() - ullStart, queuemonitorBENCH_ROUNDS * queuemonitorBENCH_LENGTH );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_QUEUE_MONITOR */
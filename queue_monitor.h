@@ -0,0 +1,55 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef QUEUE_MONITOR_H
+#define QUEUE_MONITOR_H
+
+/*
+ * Live depth of every queue.
+ *
+ * The kernel trace macros (trace_hooks.h) give every queue created, by the
+ * application or by the kernel, and every semaphore and mutex, which are
+ * queues too, one of configQUEUE_REGISTRY_SIZE slots.  The number of the slot
+ * is kept in the queue number of the queue (uxQueueGetQueueNumber()), so it
+ * must not be changed with vQueueSetQueueNumber().  The queue is added to the
+ * queue registry as "queue<slot>", a name vQueueMonitorSetName() can replace.
+ * The queues created once the slots are all taken are not monitored.
+ *
+ * Each slot is published as the telemetry block of the name of its queue,
+ * with the length of the queue, the items in it, the most items it held,
+ * the items sent to it, and how many times a task blocked because it was full
+ * or empty.  A peak that never reaches the length means the queue could be
+ * shorter; blocking on full means it may be too short.
+ *
+ * The counters are updated where the kernel updates the queue, inside its
+ * critical sections, so on hart 0 only.  The blocks of deleted queues stay
+ * registered and are reused by the next queues created.
+ *
+ * The kernel names the queue of the timer task "TmrQ" after creating it;
+ * kernels before V10.4 then list it twice in the registry.
+ */
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#if( configUSE_QUEUE_MONITOR == 1 )
+
+/* Names xQueue in the queue registry and its telemetry block.  pcName is
+copied, truncated to configMAX_TASK_NAME_LEN characters.  Call before the
+scheduler starts, or at least before the telemetry is dumped. */
+void vQueueMonitorSetName( QueueHandle_t xQueue, const char *pcName );
+
+/* Called by the trace macros, see trace_hooks.h. */
+UBaseType_t uxQueueMonitorCreate( void *pvQueue, UBaseType_t uxLength );
+void vQueueMonitorDelete( UBaseType_t uxNumber );
+void vQueueMonitorSend( UBaseType_t uxNumber, UBaseType_t uxWaiting, UBaseType_t uxLength );
+void vQueueMonitorReceive( UBaseType_t uxNumber, UBaseType_t uxWaiting );
+void vQueueMonitorBlocking( UBaseType_t uxNumber, BaseType_t xFull );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vQueueMonitorBenchmark( void );
+#endif
+
+#endif /* configUSE_QUEUE_MONITOR */
+
+#endif /* QUEUE_MONITOR_H */
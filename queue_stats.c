@@ -0,0 +1,195 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#include "queue_stats.h"
+#include "queue_monitor.h"
+
+#if( configUSE_QUEUE_STATS == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+#define queuestatsFIRST_BUCKET_BITS		( 2U )
+#define queuestatsNAME_SUFFIX			"_lat"
+
+static const char * const pcQueueStatsFields[] =
+{
+	"messages", "max_residency", "total_residency", "max_wake", "total_wake",
+	"res_lt_4", "res_lt_16", "res_lt_64", "res_lt_256", "res_lt_1k", "res_lt_4k", "res_lt_16k", "res_ge_16k",
+	"wake_lt_4", "wake_lt_16", "wake_lt_64", "wake_lt_256", "wake_lt_1k", "wake_lt_4k", "wake_lt_16k", "wake_ge_16k"
+};
+
+_Static_assert( ( sizeof( pcQueueStatsFields ) / sizeof( pcQueueStatsFields[ 0 ] ) ) <= configTELEMETRY_MAX_FIELDS,
+				"configTELEMETRY_MAX_FIELDS is too small for the queue statistics" );
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvBucket( uint64_t ullTime )
+{
+uint32_t ulBits;
+
+	if( ullTime < ( 1ULL << queuestatsFIRST_BUCKET_BITS ) )
+	{
+		return 0;
+	}
+
+	ulBits = 64U - ( uint32_t ) __builtin_clzll( ullTime );
+	ulBits = ( ( ulBits - queuestatsFIRST_BUCKET_BITS - 1U ) / 2U ) + 1U;
+
+	return ( ulBits < queuestatsBUCKETS ) ? ulBits : ( queuestatsBUCKETS - 1U );
+}
+/*-----------------------------------------------------------*/
+
+void vQueueStatsRegister( QueueStats_t *pxStats, QueueHandle_t xQueue, const char *pcName )
+{
+static const char cSuffix[] = queuestatsNAME_SUFFIX;
+size_t xLength = 0;
+size_t xSuffix;
+
+	configASSERT( xQueue != NULL );
+
+	while( ( pcName[ xLength ] != '\0' ) && ( xLength < ( queuestatsNAME_LENGTH - sizeof( cSuffix ) ) ) )
+	{
+		pxStats->cName[ xLength ] = pcName[ xLength ];
+		xLength++;
+	}
+
+	/* The terminator too. */
+	for( xSuffix = 0; xSuffix < sizeof( cSuffix ); xSuffix++ )
+	{
+		pxStats->cName[ xLength + xSuffix ] = cSuffix[ xSuffix ];
+	}
+
+	pxStats->xQueue = xQueue;
+
+#if( configUSE_QUEUE_MONITOR == 1 )
+	/* Replaces the name the monitor gave the queue. */
+	vQueueMonitorSetName( xQueue, pcName );
+#else
+	vQueueAddToRegistry( xQueue, pcName );
+#endif
+	telemetryREGISTER( pxStats->xTelemetry, pxStats->cName, pcQueueStatsFields );
+}
+/*-----------------------------------------------------------*/
+
+void vQueueStatsRecord( QueueStats_t *pxStats, const QueueStamp_t *pxStamp, uint64_t ullWaitStart )
+{
+QueueLatencyStats_t *pxLatency = &( pxStats->xTelemetry.xStats );
+uint64_t ullNow = ullTimestampTime();
+uint64_t ullResidency = ullNow - pxStamp->ullSentTime;
+uint64_t ullWake;
+
+	/* The receiver only had to be woken for the part of the residency it
+	spent waiting. */
+	if( pxStamp->ullSentTime > ullWaitStart )
+	{
+		ullWake = ullResidency;
+	}
+	else
+	{
+		ullWake = ullNow - ullWaitStart;
+	}
+
+	vTelemetryUpdateBegin( &( pxStats->xTelemetry.xBlock ) );
+
+	pxLatency->ullMessages++;
+	pxLatency->ullTotalResidency += ullResidency;
+	pxLatency->ullTotalWake += ullWake;
+	pxLatency->ullResidency[ prvBucket( ullResidency ) ]++;
+	pxLatency->ullWake[ prvBucket( ullWake ) ]++;
+
+	if( ullResidency > pxLatency->ullMaxResidency )
+	{
+		pxLatency->ullMaxResidency = ullResidency;
+	}
+
+	if( ullWake > pxLatency->ullMaxWake )
+	{
+		pxLatency->ullMaxWake = ullWake;
+	}
+
+	vTelemetryUpdateEnd( &( pxStats->xTelemetry.xBlock ) );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueStatsSend( QueueHandle_t xQueue, void *pvItem, TickType_t xTicksToWait )
+{
+	vQueueStatsStamp( ( QueueStamp_t * ) pvItem );
+
+	return xQueueSend( xQueue, pvItem, xTicksToWait );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xQueueStatsReceive( QueueStats_t *pxStats, void *pvBuffer, TickType_t xTicksToWait )
+{
+uint64_t ullWaitStart = ullTimestampTime();
+BaseType_t xReturn;
+
+	xReturn = xQueueReceive( pxStats->xQueue, pvBuffer, xTicksToWait );
+
+	if( xReturn == pdPASS )
+	{
+		vQueueStatsRecord( pxStats, ( const QueueStamp_t * ) pvBuffer, ullWaitStart );
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Cost of the stamping and accounting: a message is sent and received by the
+ * benchmark task itself, so the queue never blocks, first with the plain
+ * queue API then with the stamped one.
+ */
+#define queuestatsBENCH_MESSAGES		( 1000U )
+
+typedef struct
+{
+	QueueStamp_t xStamp;
+	uint32_t ulValue;
+} BenchMessage_t;
+
+static StaticQueue_t xBenchQueueBuffer;
+static uint8_t ucBenchQueueStorage[ sizeof( BenchMessage_t ) ];
+static QueueStats_t xBenchStats;
+
+void vQueueStatsBenchmark( void )
+{
+QueueHandle_t xQueue = xQueueCreateStatic( 1, sizeof( BenchMessage_t ), ucBenchQueueStorage, &xBenchQueueBuffer );
+BenchMessage_t xMessage = { { 0 }, 0 };
+uint64_t ullStart;
+uint32_t ulMessage;
+
+	vQueueStatsRegister( &xBenchStats, xQueue, "bench_queue" );
+
+	ullStart = ullTimestampCycles();
+
+	for( ulMessage = 0; ulMessage < queuestatsBENCH_MESSAGES; ulMessage++ )
+	{
+		xQueueSend( xQueue, &xMessage, 0 );
+		xQueueReceive( xQueue, &xMessage, 0 );
+	}
+
+	vBenchReport( "queue_stats.plain", sizeof( BenchMessage_t ), ullTimestampCycles() - ullStart, queuestatsBENCH_MESSAGES );
+
+	ullStart = ullTimestampCycles();
+
+	for( ulMessage = 0; ulMessage < queuestatsBENCH_MESSAGES; ulMessage++ )
+	{
+		xQueueStatsSend( xQueue, &xMessage, 0 );
+		xQueueStatsReceive( &xBenchStats, &xMessage, 0 );
+	}
+
+	vBenchReport( "queue_stats.stamped", sizeof( BenchMessage_t ), ullTimestampCycles() - ullStart, queuestatsBENCH_MESSAGES );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_QUEUE_STATS */
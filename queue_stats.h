@@ -0,0 +1,115 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+/*
+ * Message latency through queues.
+ *
+ * A stamped message starts with a QueueStamp_t, which the send path fills
+ * with mtime (timestamp.h) just before the message is copied into the queue.
+ * The receive path notes mtime when it starts waiting and when it gets the
+ * message, and accounts two latencies, in mtime periods, since mtime is
+ * shared by the harts:
+ *  - residency: from the send to the receive, the whole hop;
+ *  - wake: from the moment both the message and the receiver were there
+ *    (the later of the send and the start of the wait) to the receive, the
+ *    time the receiver took to be scheduled.
+ * A residency much above the wake latency means messages wait in a backlog
+ * for a slow receiver; a high wake latency means the receiver is ready but
+ * kept from running.
+ *
+ * Each queue is added to the queue registry under its name, and its counts,
+ * sums, maxima and histograms (powers of 4 mtime periods) are published as
+ * the telemetry block of that name followed by "_lat", so that they stay
+ * apart from the block of the queue monitor.  The block has one writer: only
+ * one task may receive from a queue with statistics.
+ *
+ *	typedef struct { QueueStamp_t xStamp; uint32_t ulValue; } Message_t;
+ *	static QueueStats_t xStats;
+ *
+ *	vQueueStatsRegister( &xStats, xQueue, "rxq" );
+ *	xQueueStatsSend( xQueue, &xMessage, portMAX_DELAY );
+ *	xQueueStatsReceive( &xStats, &xMessage, portMAX_DELAY );
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "telemetry.h"
+#include "timestamp.h"
+
+#if( configUSE_QUEUE_STATS == 1 )
+
+#if( configUSE_TELEMETRY != 1 )
+	#error The queue statistics are published through telemetry, set configUSE_TELEMETRY to 1
+#endif
+
+#if( configQUEUE_REGISTRY_SIZE == 0 )
+	#error The queues with statistics are named in the queue registry, set configQUEUE_REGISTRY_SIZE above 0
+#endif
+
+/* The histograms count latencies below 4, 16, 64... 16k mtime periods, and
+the longer ones in the last bucket. */
+#define queuestatsBUCKETS		( 8U )
+
+/* The name of the telemetry block, suffix and terminator included.  Longer
+names are cut. */
+#define queuestatsNAME_LENGTH	( configMAX_TASK_NAME_LEN + 4U )
+
+/* First member of a stamped message. */
+typedef struct
+{
+	uint64_t ullSentTime;
+} QueueStamp_t;
+
+typedef struct
+{
+	uint64_t ullMessages;
+	uint64_t ullMaxResidency;
+	uint64_t ullTotalResidency;
+	uint64_t ullMaxWake;
+	uint64_t ullTotalWake;
+	uint64_t ullResidency[ queuestatsBUCKETS ];
+	uint64_t ullWake[ queuestatsBUCKETS ];
+} QueueLatencyStats_t;
+
+/* The members are private to queue_stats.c. */
+typedef struct xQUEUE_STATS
+{
+	QueueHandle_t xQueue;
+	char cName[ queuestatsNAME_LENGTH ];
+	telemetryBLOCK( QueueLatencyStats_t ) xTelemetry;
+} QueueStats_t;
+
+/* Names xQueue in the queue registry and publishes its statistics under
+pcName with "_lat" appended.  pxStats and pcName must stay valid for the life
+of the system. */
+void vQueueStatsRegister( QueueStats_t *pxStats, QueueHandle_t xQueue, const char *pcName );
+
+/* Stamps a message about to be sent, for senders that call the queue API
+themselves (xQueueSendFromISR(), xQueueSendToFront()...). */
+static inline void vQueueStatsStamp( QueueStamp_t *pxStamp )
+{
+	pxStamp->ullSentTime = ullTimestampTime();
+}
+
+/* Accounts a message received, for receivers that call the queue API
+themselves.  ullWaitStart is mtime when the receiver started to wait. */
+void vQueueStatsRecord( QueueStats_t *pxStats, const QueueStamp_t *pxStamp, uint64_t ullWaitStart );
+
+/* xQueueSend() of pvItem, which starts with a QueueStamp_t, stamped. */
+BaseType_t xQueueStatsSend( QueueHandle_t xQueue, void *pvItem, TickType_t xTicksToWait );
+
+/* xQueueReceive() from the queue of pxStats, accounting the message. */
+BaseType_t xQueueStatsReceive( QueueStats_t *pxStats, void *pvBuffer, TickType_t xTicksToWait );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vQueueStatsBenchmark( void );
+#endif
+
+#endif /* configUSE_QUEUE_STATS */
+
+#endif /* QUEUE_STATS_H */
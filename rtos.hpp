@@ -0,0 +1,288 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef RTOS_HPP
+#define RTOS_HPP
+
+/*
+ * Header-only C++ layer over the kernel API.
+ *
+ * Every object owns its storage (StaticQueue_t, StaticTask_t, stack), has a
+ * constexpr constructor so that it is placed in .bss without any static
+ * initialisation code, and is brought to life by an explicit create() or
+ * start() that maps onto a single xQueueCreateStatic() or
+ * xTaskCreateStatic() call.  The kernel returns the address of the static
+ * control block as the handle, so the objects do not store the handle but
+ * use that address as a link time constant.  The methods are thin inline
+ * forwards, so the generated code is no larger than the equivalent C; "make
+ * size-compare" checks this with the two versions in size_compare/.
+ *
+ * Item types, stack sizes and priorities are template parameters, which
+ * moves the usual run time mistakes to compile time:
+ *  - queue items must be trivially copyable (they are copied with memcpy);
+ *  - priorities must be below configMAX_PRIORITIES;
+ *  - stacks must be at least configMINIMAL_STACK_SIZE words;
+ *  - each object, and any group of objects passed to ram_usage(), must fit
+ *    in configSTATIC_RAM_BUDGET.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+/* Freedom metal includes. */
+extern "C" {
+#include <metal/lock.h>
+}
+
+#if( configSUPPORT_STATIC_ALLOCATION != 1 )
+	#error rtos.hpp needs configSUPPORT_STATIC_ALLOCATION set to 1 in FreeRTOSConfig.h
+#endif
+
+namespace rtos {
+
+/* RAM that the statically allocated objects of the application may use. */
+constexpr size_t ram_budget = configSTATIC_RAM_BUDGET;
+
+/* Total RAM reserved by a set of objects, to be checked with
+static_assert( rtos::ram_usage< A, B, C >() <= rtos::ram_budget, "..." ). */
+template <typename... Objects>
+constexpr size_t ram_usage()
+{
+	return ( Objects::ram_bytes + ... + 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+template <typename T, size_t Length>
+class Queue
+{
+	static_assert( Length > 0, "a queue holds at least one item" );
+	static_assert( std::is_trivially_copyable<T>::value, "queue items are copied with memcpy" );
+
+public:
+	static constexpr size_t ram_bytes = sizeof( StaticQueue_t ) + ( sizeof( T ) * Length );
+	static_assert( ram_bytes <= ram_budget, "queue exceeds configSTATIC_RAM_BUDGET" );
+
+	constexpr Queue() : control_(), storage_() {}
+
+	Queue( const Queue & ) = delete;
+	Queue &operator=( const Queue & ) = delete;
+
+	QueueHandle_t create()
+	{
+		return xQueueCreateStatic( Length, sizeof( T ), storage_, &control_ );
+	}
+
+	bool send( const T &item, TickType_t ticks_to_wait = 0 )
+	{
+		return xQueueSend( handle(), &item, ticks_to_wait ) == pdPASS;
+	}
+
+	bool send_from_isr( const T &item, BaseType_t *higher_priority_task_woken )
+	{
+		return xQueueSendFromISR( handle(), &item, higher_priority_task_woken ) == pdPASS;
+	}
+
+	bool receive( T &item, TickType_t ticks_to_wait = portMAX_DELAY )
+	{
+		return xQueueReceive( handle(), &item, ticks_to_wait ) == pdPASS;
+	}
+
+	UBaseType_t waiting() const
+	{
+		return uxQueueMessagesWaiting( handle() );
+	}
+
+	/* Valid once create() has been called. */
+	QueueHandle_t handle() const
+	{
+		return reinterpret_cast<QueueHandle_t>( const_cast<StaticQueue_t *>( &control_ ) );
+	}
+
+private:
+	StaticQueue_t control_;
+	uint8_t storage_[ sizeof( T ) * Length ];
+};
+
+/*-----------------------------------------------------------*/
+
+template <size_t StackWords, UBaseType_t Priority>
+class Task
+{
+	static_assert( Priority < configMAX_PRIORITIES, "priority must be below configMAX_PRIORITIES" );
+	static_assert( StackWords >= configMINIMAL_STACK_SIZE, "stack is smaller than configMINIMAL_STACK_SIZE" );
+
+public:
+	static constexpr size_t ram_bytes = sizeof( StaticTask_t ) + ( sizeof( StackType_t ) * StackWords );
+	static_assert( ram_bytes <= ram_budget, "task exceeds configSTATIC_RAM_BUDGET" );
+
+	static constexpr UBaseType_t priority = Priority;
+	static constexpr size_t stack_words = StackWords;
+
+	constexpr Task() : tcb_(), stack_() {}
+
+	Task( const Task & ) = delete;
+	Task &operator=( const Task & ) = delete;
+
+	/* Starts Function( arg ) with a typed argument:
+	task.start< prvWorker >( "Worker", xContext ) for void prvWorker( Context_t & ). */
+	template <auto Function, typename Arg>
+	TaskHandle_t start( const char *name, Arg &arg )
+	{
+		static_assert( std::is_invocable<decltype( Function ), Arg &>::value, "Function must take an Arg &" );
+
+		return xTaskCreateStatic( &trampoline<Function, Arg>, name, StackWords, &arg, Priority, stack_, &tcb_ );
+	}
+
+	/* Starts a plain kernel task function. */
+	TaskHandle_t start( TaskFunction_t function, const char *name, void *parameters = nullptr )
+	{
+		return xTaskCreateStatic( function, name, StackWords, parameters, Priority, stack_, &tcb_ );
+	}
+
+	/* Valid once start() has been called. */
+	TaskHandle_t handle() const
+	{
+		return reinterpret_cast<TaskHandle_t>( const_cast<StaticTask_t *>( &tcb_ ) );
+	}
+
+private:
+	template <auto Function, typename Arg>
+	static void trampoline( void *parameters )
+	{
+		Function( *static_cast<Arg *>( parameters ) );
+	}
+
+	StaticTask_t tcb_;
+	StackType_t stack_[ StackWords ];
+};
+
+/*-----------------------------------------------------------*/
+
+class Mutex
+{
+public:
+	static constexpr size_t ram_bytes = sizeof( StaticSemaphore_t );
+
+	constexpr Mutex() : control_() {}
+
+	Mutex( const Mutex & ) = delete;
+	Mutex &operator=( const Mutex & ) = delete;
+
+	SemaphoreHandle_t create()
+	{
+		return xSemaphoreCreateMutexStatic( &control_ );
+	}
+
+	bool lock( TickType_t ticks_to_wait = portMAX_DELAY )
+	{
+		return xSemaphoreTake( handle(), ticks_to_wait ) == pdPASS;
+	}
+
+	void unlock()
+	{
+		xSemaphoreGive( handle() );
+	}
+
+	/* Valid once create() has been called. */
+	SemaphoreHandle_t handle() const
+	{
+		return reinterpret_cast<SemaphoreHandle_t>( const_cast<StaticSemaphore_t *>( &control_ ) );
+	}
+
+private:
+	StaticSemaphore_t control_;
+};
+
+/*-----------------------------------------------------------*/
+
+/* Holds a lockable object (Mutex, or anything with lock() and unlock()) for
+the lifetime of the guard. */
+template <typename Lockable>
+class LockGuard
+{
+public:
+	explicit LockGuard( Lockable &lockable ) : lockable_( lockable )
+	{
+		lockable_.lock();
+	}
+
+	~LockGuard()
+	{
+		lockable_.unlock();
+	}
+
+	LockGuard( const LockGuard & ) = delete;
+	LockGuard &operator=( const LockGuard & ) = delete;
+
+private:
+	Lockable &lockable_;
+};
+
+/* taskENTER_CRITICAL() / taskEXIT_CRITICAL() for the lifetime of the object. */
+class CriticalSection
+{
+public:
+	CriticalSection()
+	{
+		taskENTER_CRITICAL();
+	}
+
+	~CriticalSection()
+	{
+		taskEXIT_CRITICAL();
+	}
+
+	CriticalSection( const CriticalSection & ) = delete;
+	CriticalSection &operator=( const CriticalSection & ) = delete;
+};
+
+/* vTaskSuspendAll() / xTaskResumeAll() for the lifetime of the object. */
+class SchedulerLock
+{
+public:
+	SchedulerLock()
+	{
+		vTaskSuspendAll();
+	}
+
+	~SchedulerLock()
+	{
+		( void ) xTaskResumeAll();
+	}
+
+	SchedulerLock( const SchedulerLock & ) = delete;
+	SchedulerLock &operator=( const SchedulerLock & ) = delete;
+};
+
+/* Holds a metal_lock, the spin lock shared with the other harts (my_lock). */
+class HartLockGuard
+{
+public:
+	explicit HartLockGuard( struct metal_lock &lock ) : lock_( lock )
+	{
+		metal_lock_take( &lock_ );
+	}
+
+	~HartLockGuard()
+	{
+		metal_lock_give( &lock_ );
+	}
+
+	HartLockGuard( const HartLockGuard & ) = delete;
+	HartLockGuard &operator=( const HartLockGuard & ) = delete;
+
+private:
+	struct metal_lock &lock_;
+};
+
+} /* namespace rtos */
+
+#endif /* RTOS_HPP */
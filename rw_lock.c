@@ -0,0 +1,408 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "rw_lock.h"
+
+#if( configUSE_RW_LOCK == 1 )
+
+#if( configSUPPORT_STATIC_ALLOCATION != 1 )
+	#error The RW lock needs configSUPPORT_STATIC_ALLOCATION set to 1 in FreeRTOSConfig.h
+#endif
+
+#if( configUSE_COUNTING_SEMAPHORES != 1 )
+	#error The RW lock needs configUSE_COUNTING_SEMAPHORES set to 1 in FreeRTOSConfig.h
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+	#include "seqlock.h"
+#endif
+
+/* Bound of the gate semaphores, more than the number of tasks. */
+#define rwlockMAX_WAITING		( ( UBaseType_t ) 0xFFFF )
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Called in a critical section when the lock has no owner: hands it to one
+ * waiting writer, or else to all the waiting readers.  Returns the number of
+ * gives to do on each gate once out of the critical section.
+ */
+static void prvHandOver( RwLock_t *pxLock, UBaseType_t *puxWriters, UBaseType_t *puxReaders )
+{
+	*puxWriters = 0;
+	*puxReaders = 0;
+
+	if( pxLock->uxWaitingWriters > 0U )
+	{
+		pxLock->uxWaitingWriters--;
+		pxLock->xWriter = pdTRUE;
+		*puxWriters = 1;
+	}
+	else if( pxLock->uxWaitingReaders > 0U )
+	{
+		*puxReaders = pxLock->uxWaitingReaders;
+		pxLock->uxReaders += pxLock->uxWaitingReaders;
+		pxLock->uxWaitingReaders = 0;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvOpenGates( RwLock_t *pxLock, UBaseType_t uxWriters, UBaseType_t uxReaders )
+{
+	if( uxWriters > 0U )
+	{
+		xSemaphoreGive( pxLock->xWriteGate );
+	}
+
+	while( uxReaders > 0U )
+	{
+		xSemaphoreGive( pxLock->xReadGate );
+		uxReaders--;
+	}
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Called after a wait on a gate timed out.  The task is still counted in
+ * *puxWaiting unless a release handed it the lock meanwhile, in which case
+ * the gate has been given (or is about to be) and is taken to match.  The
+ * waiters are interchangeable, so any of them can be the one uncounted.
+ */
+static BaseType_t prvWaitTimedOut( RwLock_t *pxLock, UBaseType_t *puxWaiting, SemaphoreHandle_t xGate, BaseType_t xWriter )
+{
+BaseType_t xHandedOver;
+UBaseType_t uxWriters = 0;
+UBaseType_t uxReaders = 0;
+
+	taskENTER_CRITICAL();
+	{
+		if( *puxWaiting > 0U )
+		{
+			( *puxWaiting )--;
+			xHandedOver = pdFALSE;
+
+			/* The last waiting writer gives up: the readers it held back can
+			come in if no writer holds the lock. */
+			if( ( xWriter != pdFALSE ) && ( pxLock->uxWaitingWriters == 0U ) && ( pxLock->xWriter == pdFALSE ) )
+			{
+				prvHandOver( pxLock, &uxWriters, &uxReaders );
+			}
+		}
+		else
+		{
+			xHandedOver = pdTRUE;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if( xHandedOver != pdFALSE )
+	{
+		xSemaphoreTake( xGate, portMAX_DELAY );
+		return pdPASS;
+	}
+
+	prvOpenGates( pxLock, uxWriters, uxReaders );
+
+	return pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+void vRwLockInit( RwLock_t *pxLock )
+{
+	pxLock->uxReaders = 0;
+	pxLock->uxWaitingReaders = 0;
+	pxLock->uxWaitingWriters = 0;
+	pxLock->xWriter = pdFALSE;
+	pxLock->xReadGate = xSemaphoreCreateCountingStatic( rwlockMAX_WAITING, 0, &( pxLock->xReadGateBuffer ) );
+	pxLock->xWriteGate = xSemaphoreCreateCountingStatic( rwlockMAX_WAITING, 0, &( pxLock->xWriteGateBuffer ) );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xRwLockReadTake( RwLock_t *pxLock, TickType_t xTicksToWait )
+{
+BaseType_t xAcquired = pdFALSE;
+
+	taskENTER_CRITICAL();
+	{
+		/* Queue behind a waiting writer as well, for the writer preference. */
+		if( ( pxLock->xWriter == pdFALSE ) && ( pxLock->uxWaitingWriters == 0U ) )
+		{
+			pxLock->uxReaders++;
+			xAcquired = pdTRUE;
+		}
+		else if( xTicksToWait != 0U )
+		{
+			pxLock->uxWaitingReaders++;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if( xAcquired != pdFALSE )
+	{
+		return pdPASS;
+	}
+
+	if( xTicksToWait == 0U )
+	{
+		return pdFAIL;
+	}
+
+	if( xSemaphoreTake( pxLock->xReadGate, xTicksToWait ) == pdPASS )
+	{
+		/* The releasing task counted this reader already. */
+		return pdPASS;
+	}
+
+	return prvWaitTimedOut( pxLock, &( pxLock->uxWaitingReaders ), pxLock->xReadGate, pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xRwLockWriteTake( RwLock_t *pxLock, TickType_t xTicksToWait )
+{
+BaseType_t xAcquired = pdFALSE;
+
+	taskENTER_CRITICAL();
+	{
+		if( ( pxLock->xWriter == pdFALSE ) && ( pxLock->uxReaders == 0U ) )
+		{
+			pxLock->xWriter = pdTRUE;
+			xAcquired = pdTRUE;
+		}
+		else if( xTicksToWait != 0U )
+		{
+			pxLock->uxWaitingWriters++;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if( xAcquired != pdFALSE )
+	{
+		return pdPASS;
+	}
+
+	if( xTicksToWait == 0U )
+	{
+		return pdFAIL;
+	}
+
+	if( xSemaphoreTake( pxLock->xWriteGate, xTicksToWait ) == pdPASS )
+	{
+		return pdPASS;
+	}
+
+	return prvWaitTimedOut( pxLock, &( pxLock->uxWaitingWriters ), pxLock->xWriteGate, pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+void vRwLockReadGive( RwLock_t *pxLock )
+{
+UBaseType_t uxWriters = 0;
+UBaseType_t uxReaders = 0;
+
+	taskENTER_CRITICAL();
+	{
+		configASSERT( pxLock->uxReaders > 0U );
+		pxLock->uxReaders--;
+
+		/* Readers only wait while a writer waits, so the last reader out
+		always hands the lock to a writer. */
+		if( pxLock->uxReaders == 0U )
+		{
+			prvHandOver( pxLock, &uxWriters, &uxReaders );
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	prvOpenGates( pxLock, uxWriters, uxReaders );
+}
+/*-----------------------------------------------------------*/
+
+void vRwLockWriteGive( RwLock_t *pxLock )
+{
+UBaseType_t uxWriters;
+UBaseType_t uxReaders;
+
+	taskENTER_CRITICAL();
+	{
+		configASSERT( pxLock->xWriter != pdFALSE );
+		pxLock->xWriter = pdFALSE;
+		prvHandOver( pxLock, &uxWriters, &uxReaders );
+	}
+	taskEXIT_CRITICAL();
+
+	prvOpenGates( pxLock, uxWriters, uxReaders );
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Workers of the same priority share a structure, with one write every
+ * "ratio" operations and the rest reads.  Each operation holds the lock for
+ * rwlockBENCH_HOLD_CYCLES, long enough for the tick to preempt holders and
+ * make the workers contend.  The same runs are done with a kernel mutex,
+ * which serialises the readers, and the cost of a seqlock read is measured
+ * on its own.
+ */
+#define rwlockBENCH_WORKERS			( 3U )
+#define rwlockBENCH_OPERATIONS		( 200U )
+#define rwlockBENCH_HOLD_CYCLES		( 5000U )
+#define rwlockBENCH_SEQLOCK_READS	( 1000U )
+
+typedef struct
+{
+	uint32_t ulValues[ 8 ];
+} BenchShared_t;
+
+static RwLock_t xBenchLock;
+static SemaphoreHandle_t xBenchMutex = NULL;
+static BaseType_t xBenchUseMutex = pdFALSE;
+static uint32_t ulBenchRatio = 1;
+static TaskHandle_t xBenchTask = NULL;
+static BenchShared_t xBenchShared;
+
+static void prvBenchHold( void )
+{
+uint64_t ullStart = ullTimestampCycles();
+
+	while( ( ullTimestampCycles() - ullStart ) < rwlockBENCH_HOLD_CYCLES )
+	{
+	}
+}
+
+static void prvBenchWorker( void *pvParameters )
+{
+uint32_t ulOperation;
+BaseType_t xWrite;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+		for( ulOperation = 0; ulOperation < rwlockBENCH_OPERATIONS; ulOperation++ )
+		{
+			xWrite = ( ( ulOperation % ulBenchRatio ) == 0U ) ? pdTRUE : pdFALSE;
+
+			if( xBenchUseMutex != pdFALSE )
+			{
+				xSemaphoreTake( xBenchMutex, portMAX_DELAY );
+			}
+			else if( xWrite != pdFALSE )
+			{
+				xRwLockWriteTake( &xBenchLock, portMAX_DELAY );
+			}
+			else
+			{
+				xRwLockReadTake( &xBenchLock, portMAX_DELAY );
+			}
+
+			if( xWrite != pdFALSE )
+			{
+				xBenchShared.ulValues[ ulOperation & 7U ]++;
+			}
+			prvBenchHold();
+
+			if( xBenchUseMutex != pdFALSE )
+			{
+				xSemaphoreGive( xBenchMutex );
+			}
+			else if( xWrite != pdFALSE )
+			{
+				vRwLockWriteGive( &xBenchLock );
+			}
+			else
+			{
+				vRwLockReadGive( &xBenchLock );
+			}
+		}
+
+		xTaskNotifyGive( xBenchTask );
+	}
+}
+
+static void prvBenchRun( TaskHandle_t *pxWorkers, const char *pcName, uint32_t ulRatio, BaseType_t xUseMutex )
+{
+UBaseType_t ux;
+uint64_t ullStart;
+
+	ulBenchRatio = ulRatio;
+	xBenchUseMutex = xUseMutex;
+
+	ullStart = ullTimestampCycles();
+	for( ux = 0; ux < rwlockBENCH_WORKERS; ux++ )
+	{
+		xTaskNotifyGive( pxWorkers[ ux ] );
+	}
+	for( ux = 0; ux < rwlockBENCH_WORKERS; ux++ )
+	{
+		ulTaskNotifyTake( pdFALSE, portMAX_DELAY );
+	}
+
+	vBenchReport( pcName, ulRatio, ullTimestampCycles() - ullStart, rwlockBENCH_WORKERS * rwlockBENCH_OPERATIONS );
+}
+
+void vRwLockBenchmark( void )
+{
+static const uint32_t ulRatios[] = { 1, 4, 16, 64 };
+static Seqlock_t xBenchSeqlock = seqlockINIT;
+TaskHandle_t xWorkers[ rwlockBENCH_WORKERS ];
+BenchShared_t xCopy;
+UBaseType_t ux;
+uint32_t ulRatio;
+uint64_t ullStart;
+
+	xBenchTask = xTaskGetCurrentTaskHandle();
+	vRwLockInit( &xBenchLock );
+	xBenchMutex = xSemaphoreCreateMutex();
+	configASSERT( xBenchMutex != NULL );
+
+	/* The workers run above this task, which only wakes up to count them
+	done. */
+	for( ux = 0; ux < rwlockBENCH_WORKERS; ux++ )
+	{
+		xWorkers[ ux ] = NULL;
+		xTaskCreate( prvBenchWorker, "RwBench", configMINIMAL_STACK_SIZE, NULL, uxTaskPriorityGet( NULL ) + 1U, &xWorkers[ ux ] );
+		configASSERT( xWorkers[ ux ] != NULL );
+	}
+
+	/* Cycles per operation for 1 write every ratio operations. */
+	for( ulRatio = 0; ulRatio < ( sizeof( ulRatios ) / sizeof( ulRatios[ 0 ] ) ); ulRatio++ )
+	{
+		prvBenchRun( xWorkers, "rw_lock.op", ulRatios[ ulRatio ], pdFALSE );
+		prvBenchRun( xWorkers, "rw_mutex.op", ulRatios[ ulRatio ], pdTRUE );
+	}
+
+	for( ux = 0; ux < rwlockBENCH_WORKERS; ux++ )
+	{
+		vTaskDelete( xWorkers[ ux ] );
+	}
+	vSemaphoreDelete( xBenchMutex );
+
+	ullStart = ullTimestampCycles();
+	for( ux = 0; ux < rwlockBENCH_SEQLOCK_READS; ux++ )
+	{
+		seqlockREAD( &xBenchSeqlock, &xCopy, &xBenchShared );
+	}
+	vBenchReport( "seqlock.read", sizeof( xCopy ), ullTimestampCycles() - ullStart, rwlockBENCH_SEQLOCK_READS );
+
+	ullStart = ullTimestampCycles();
+	for( ux = 0; ux < rwlockBENCH_SEQLOCK_READS; ux++ )
+	{
+		vSeqlockWriteBegin( &xBenchSeqlock );
+		xBenchShared.ulValues[ ux & 7U ]++;
+		vSeqlockWriteEnd( &xBenchSeqlock );
+	}
+	vBenchReport( "seqlock.write", sizeof( xCopy ), ullTimestampCycles() - ullStart, rwlockBENCH_SEQLOCK_READS );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_RW_LOCK */
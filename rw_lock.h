@@ -0,0 +1,65 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef RW_LOCK_H
+#define RW_LOCK_H
+
+/*
+ * Reader-writer lock.
+ *
+ * Any number of tasks can hold the lock for reading at the same time, or a
+ * single task for writing.  Writers have the preference: once a writer
+ * waits, new readers queue behind it, so a steady flow of readers cannot
+ * starve the writers.
+ *
+ * The lock is handed over on release rather than contended for: the
+ * releasing task updates the counts for the tasks it wakes, and only then
+ * gives them the gate semaphore they wait on.  A woken task therefore owns
+ * the lock already, and a higher priority task cannot take it in between.
+ * When the last reader or the writer leaves, a waiting writer is woken
+ * first, otherwise all the waiting readers are let in at once.
+ *
+ * The kernel event lists are private to tasks.c, so the waiting tasks block
+ * on two statically allocated semaphores instead.  There is no priority
+ * inheritance: keep the sections short, or use the lock between tasks of
+ * the same priority.
+ *
+ * Only tasks can use the lock.  For data read from interrupts, see
+ * seqlock.h.
+ */
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#if( configUSE_RW_LOCK == 1 )
+
+/* The members are private to rw_lock.c. */
+typedef struct xRW_LOCK
+{
+	UBaseType_t uxReaders;			/* Readers holding the lock. */
+	UBaseType_t uxWaitingReaders;
+	UBaseType_t uxWaitingWriters;
+	BaseType_t xWriter;				/* pdTRUE while a writer holds the lock. */
+	SemaphoreHandle_t xReadGate;	/* Counting, one give per reader let in. */
+	SemaphoreHandle_t xWriteGate;	/* Counting, one give per writer let in. */
+	StaticSemaphore_t xReadGateBuffer;
+	StaticSemaphore_t xWriteGateBuffer;
+} RwLock_t;
+
+void vRwLockInit( RwLock_t *pxLock );
+
+/* Return pdPASS once the lock is held, or pdFAIL if xTicksToWait expired
+first. */
+BaseType_t xRwLockReadTake( RwLock_t *pxLock, TickType_t xTicksToWait );
+BaseType_t xRwLockWriteTake( RwLock_t *pxLock, TickType_t xTicksToWait );
+
+void vRwLockReadGive( RwLock_t *pxLock );
+void vRwLockWriteGive( RwLock_t *pxLock );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vRwLockBenchmark( void );
+#endif
+
+#endif /* configUSE_RW_LOCK */
+
+#endif /* RW_LOCK_H */
@@ -0,0 +1,106 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+/*
+ * Sequence lock for small structures written by one side and read from
+ * anywhere: tasks, interrupts and the other harts.
+ *
+ * The writer makes the sequence odd, updates the data and makes it even
+ * again.  Readers never block and never write: they copy the data and retry
+ * if the sequence was odd or changed during the copy.  Reads therefore cost
+ * a copy and two loads of the sequence, whatever the number of readers.
+ *
+ * A reader that interrupts the writer on the same hart would spin forever,
+ * so the writer runs with interrupts masked: use vSeqlockWriteBegin() and
+ * vSeqlockWriteEnd() from a task and the FromISR versions from an interrupt
+ * (interrupts do not nest on this port).  There must be one writer at a
+ * time; serialise the writers if there are several.
+ *
+ *	Seqlock_t xLock = seqlockINIT;
+ *	Config_t xConfig, xCopy;
+ *
+ *	vSeqlockWriteBegin( &xLock );		seqlockREAD( &xLock, &xCopy, &xConfig );
+ *	xConfig.ulRate = 10;
+ *	vSeqlockWriteEnd( &xLock );
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct xSEQLOCK
+{
+	volatile uint32_t ulSequence;
+} Seqlock_t;
+
+#define seqlockINIT		{ 0 }
+
+/* Orders the accesses on both sides of the sequence updates.  Also a
+compiler barrier. */
+#define seqlockFENCE_WRITE()	__asm__ volatile( "fence w,w" ::: "memory" )
+#define seqlockFENCE_READ()		__asm__ volatile( "fence r,r" ::: "memory" )
+
+static inline void vSeqlockWriteBeginFromISR( Seqlock_t *pxLock )
+{
+	pxLock->ulSequence++;
+	seqlockFENCE_WRITE();
+}
+
+static inline void vSeqlockWriteEndFromISR( Seqlock_t *pxLock )
+{
+	seqlockFENCE_WRITE();
+	pxLock->ulSequence++;
+}
+
+static inline void vSeqlockWriteBegin( Seqlock_t *pxLock )
+{
+	taskENTER_CRITICAL();
+	vSeqlockWriteBeginFromISR( pxLock );
+}
+
+static inline void vSeqlockWriteEnd( Seqlock_t *pxLock )
+{
+	vSeqlockWriteEndFromISR( pxLock );
+	taskEXIT_CRITICAL();
+}
+
+/* Waits for a write in progress on another hart to end, and returns the
+sequence to pass to xSeqlockReadRetry(). */
+static inline uint32_t ulSeqlockReadBegin( const Seqlock_t *pxLock )
+{
+uint32_t ulSequence;
+
+	do
+	{
+		ulSequence = pxLock->ulSequence;
+	} while( ( ulSequence & 1U ) != 0U );
+
+	seqlockFENCE_READ();
+
+	return ulSequence;
+}
+
+/* pdTRUE if the data read since ulSeqlockReadBegin() may be torn. */
+static inline BaseType_t xSeqlockReadRetry( const Seqlock_t *pxLock, uint32_t ulSequence )
+{
+	seqlockFENCE_READ();
+
+	return ( pxLock->ulSequence != ulSequence ) ? pdTRUE : pdFALSE;
+}
+
+/* Copies *pxSource to *pxDestination, both of the same type, consistently. */
+#define seqlockREAD( pxLock, pxDestination, pxSource )									\
+	do {																				\
+		uint32_t ulSeqlockSequence;														\
+		do {																			\
+			ulSeqlockSequence = ulSeqlockReadBegin( pxLock );							\
+			memcpy( ( pxDestination ), ( const void * ) ( pxSource ), sizeof( *( pxDestination ) ) );	\
+		} while( xSeqlockReadRetry( ( pxLock ), ulSeqlockSequence ) != pdFALSE );		\
+	} while( 0 )
+
+#endif /* SEQLOCK_H */
@@ -0,0 +1,76 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * C half of "make size-compare": a statically allocated queue of samples
+ * and the task that consumes them, written against the kernel API.
+ * size_compare.cpp is the same program written with rtos.hpp.
+ */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#define sizecompareQUEUE_LENGTH		( 8 )
+#define sizecompareTASK_PRIORITY	( tskIDLE_PRIORITY + 2 )
+#define sizecompareTASK_STACK_SIZE	( configMINIMAL_STACK_SIZE )
+
+typedef struct
+{
+	uint16_t usChannel;
+	uint16_t usValue;
+} Sample_t;
+
+typedef struct
+{
+	uint32_t ulTotal[ 4 ];
+} Accumulator_t;
+
+void vSizeCompareStart( void );
+BaseType_t xSizeCompareSend( uint16_t usChannel, uint16_t usValue );
+
+static StaticQueue_t xQueueBuffer;
+static uint8_t ucQueueStorage[ sizecompareQUEUE_LENGTH * sizeof( Sample_t ) ];
+static QueueHandle_t xQueue = NULL;
+
+static StaticTask_t xTaskBuffer;
+static StackType_t uxTaskStack[ sizecompareTASK_STACK_SIZE ];
+
+static Accumulator_t xAccumulator;
+
+/*-----------------------------------------------------------*/
+
+static void prvConsumerTask( void *pvParameters )
+{
+Accumulator_t *pxAccumulator = ( Accumulator_t * ) pvParameters;
+Sample_t xSample;
+
+	for( ;; )
+	{
+		if( xQueueReceive( xQueue, &xSample, portMAX_DELAY ) == pdPASS )
+		{
+			taskENTER_CRITICAL();
+			pxAccumulator->ulTotal[ xSample.usChannel & 3U ] += xSample.usValue;
+			taskEXIT_CRITICAL();
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vSizeCompareStart( void )
+{
+	xQueue = xQueueCreateStatic( sizecompareQUEUE_LENGTH, sizeof( Sample_t ), ucQueueStorage, &xQueueBuffer );
+	xTaskCreateStatic( prvConsumerTask, "Consumer", sizecompareTASK_STACK_SIZE, &xAccumulator, sizecompareTASK_PRIORITY, uxTaskStack, &xTaskBuffer );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xSizeCompareSend( uint16_t usChannel, uint16_t usValue )
+{
+Sample_t xSample;
+
+	xSample.usChannel = usChannel;
+	xSample.usValue = usValue;
+
+	return ( xQueueSend( xQueue, &xSample, 0 ) == pdPASS ) ? pdTRUE : pdFALSE;
+}
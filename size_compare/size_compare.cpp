@@ -0,0 +1,61 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * C++ half of "make size-compare": size_compare.c written with rtos.hpp.
+ * Both files export the same two functions so their objects can be
+ * compared section by section.
+ */
+
+#include "rtos.hpp"
+
+namespace {
+
+constexpr size_t queue_length = 8;
+
+struct Sample
+{
+	uint16_t channel;
+	uint16_t value;
+};
+
+struct Accumulator
+{
+	uint32_t total[ 4 ];
+};
+
+using SampleQueue = rtos::Queue<Sample, queue_length>;
+using ConsumerTask = rtos::Task<configMINIMAL_STACK_SIZE, tskIDLE_PRIORITY + 2>;
+
+static_assert( rtos::ram_usage<SampleQueue, ConsumerTask>() <= rtos::ram_budget, "size comparison exceeds the RAM budget" );
+
+SampleQueue queue;
+ConsumerTask consumer;
+Accumulator accumulator;
+
+void consume( Accumulator &acc )
+{
+	Sample sample;
+
+	for( ;; )
+	{
+		if( queue.receive( sample ) )
+		{
+			rtos::CriticalSection section;
+			acc.total[ sample.channel & 3U ] += sample.value;
+		}
+	}
+}
+
+} /* namespace */
+
+extern "C" void vSizeCompareStart( void )
+{
+	queue.create();
+	consumer.start<consume>( "Consumer", accumulator );
+}
+
+extern "C" BaseType_t xSizeCompareSend( uint16_t usChannel, uint16_t usValue )
+{
+	return queue.send( Sample{ usChannel, usValue } ) ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,351 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "task_budget.h"
+#include "timestamp.h"
+
+#if( configUSE_TASK_BUDGET == 1 )
+
+#if( configUSE_TICK_HOOK != 1 )
+	#error Budgets are checked from the tick hook, set configUSE_TICK_HOOK to 1
+#endif
+
+#if( INCLUDE_xTimerPendFunctionCall != 1 )
+	#error Overruns are handled through the timer task, set INCLUDE_xTimerPendFunctionCall to 1
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* mtime periods counted by vTaskBudgetInit(), about 8 ms.  configCPU_CLOCK_HZ
+is the rate of mtime, as for the port. */
+#define taskbudgetCALIBRATION_TIME	( ( uint64_t ) configCPU_CLOCK_HZ / 128U )
+
+/* Actions passed to the timer task. */
+#define taskbudgetACTION_OVERRUN	( 0UL )
+#define taskbudgetACTION_RESTORE	( 1UL )
+
+/* Budgets are only changed in critical sections, and walked from the tick
+interrupt. */
+static TaskBudget_t *pxBudgets = NULL;
+
+/* mcycle when the running task was switched in, or last charged. */
+static uint64_t ullSwitchedIn = 0;
+
+static uint64_t ullCyclesPerSecond = 0;
+
+#if( configUSE_TELEMETRY == 1 )
+	static const char * const pcBudgetFields[] = { "periods", "overruns", "max_cycles", "budget_cycles" };
+#endif
+
+/*-----------------------------------------------------------*/
+
+void vTaskBudgetInit( void )
+{
+uint64_t ullStartTime = ullTimestampTime();
+uint64_t ullStartCycles = ullTimestampCycles();
+uint64_t ullTime;
+
+	do
+	{
+		ullTime = ullTimestampTime() - ullStartTime;
+	} while( ullTime < taskbudgetCALIBRATION_TIME );
+
+	ullCyclesPerSecond = ( ( ullTimestampCycles() - ullStartCycles ) * ( uint64_t ) configCPU_CLOCK_HZ ) / ullTime;
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullTaskBudgetCyclesFromUs( uint32_t ulMicroseconds )
+{
+	configASSERT( ullCyclesPerSecond != 0U );
+
+	return ( ( uint64_t ) ulMicroseconds * ullCyclesPerSecond ) / 1000000U;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskBudgetAttach( TaskBudget_t *pxBudget, TaskHandle_t xTask, uint64_t ullBudgetCycles, TickType_t xPeriod,
+						UBaseType_t uxOverrunPriority, TaskBudgetHandler_t pxHandler )
+{
+	configASSERT( ( xTask != NULL ) && ( xPeriod > 0U ) );
+	configASSERT( uxOverrunPriority <= taskbudgetKEEP_PRIORITY );
+
+	pxBudget->xTask = xTask;
+	pxBudget->ullBudgetCycles = ullBudgetCycles;
+	pxBudget->ullConsumed = 0;
+	pxBudget->xPeriod = xPeriod;
+	pxBudget->xPeriodStart = xTaskGetTickCount();
+	pxBudget->uxOverrunPriority = uxOverrunPriority;
+	pxBudget->pxHandler = pxHandler;
+	pxBudget->xOverrun = pdFALSE;
+	pxBudget->xActionPending = pdFALSE;
+	pxBudget->xActionTaken = pdFALSE;
+	pxBudget->xRestorePending = pdFALSE;
+	vTaskDemotionInit( &( pxBudget->xDemotion ) );
+	pxBudget->xAttached = pdTRUE;
+
+#if( configUSE_TELEMETRY == 1 )
+	pxBudget->xTelemetry.xStats.ullPeriods = 0;
+	pxBudget->xTelemetry.xStats.ullOverruns = 0;
+	pxBudget->xTelemetry.xStats.ullMaxCycles = 0;
+	pxBudget->xTelemetry.xStats.ullBudgetCycles = ullBudgetCycles;
+#endif
+
+	taskENTER_CRITICAL();
+	{
+		pxBudget->pxNext = pxBudgets;
+		pxBudgets = pxBudget;
+		vTaskSetThreadLocalStoragePointer( xTask, configTASK_BUDGET_TLS_INDEX, pxBudget );
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_TELEMETRY == 1 )
+
+void vTaskBudgetPublish( TaskBudget_t *pxBudget )
+{
+	configASSERT( pxBudget->xAttached != pdFALSE );
+
+	telemetryREGISTER( pxBudget->xTelemetry, pcTaskGetName( pxBudget->xTask ), pcBudgetFields );
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_TELEMETRY */
+
+void vTaskBudgetDetach( TaskBudget_t *pxBudget )
+{
+TaskBudget_t **ppxLink;
+
+	taskENTER_CRITICAL();
+	{
+		for( ppxLink = &pxBudgets; *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+		{
+			if( *ppxLink == pxBudget )
+			{
+				*ppxLink = pxBudget->pxNext;
+				break;
+			}
+		}
+
+		/* Actions already queued to the timer task are ignored. */
+		pxBudget->xAttached = pdFALSE;
+
+		vTaskSetThreadLocalStoragePointer( pxBudget->xTask, configTASK_BUDGET_TLS_INDEX, NULL );
+	}
+	taskEXIT_CRITICAL();
+
+	vTaskDemotionDrop( &( pxBudget->xDemotion ) );
+}
+/*-----------------------------------------------------------*/
+
+/* Runs in the timer task. */
+static void prvBudgetAction( void *pvBudget, uint32_t ulAction )
+{
+TaskBudget_t *pxBudget = ( TaskBudget_t * ) pvBudget;
+
+	if( pxBudget->xAttached == pdFALSE )
+	{
+		return;
+	}
+
+	if( ulAction == taskbudgetACTION_RESTORE )
+	{
+		vTaskDemotionEnd( &( pxBudget->xDemotion ) );
+		return;
+	}
+
+	if( pxBudget->uxOverrunPriority != taskbudgetKEEP_PRIORITY )
+	{
+		vTaskDemotionStart( &( pxBudget->xDemotion ), pxBudget->xTask, pxBudget->uxOverrunPriority );
+	}
+
+	if( pxBudget->pxHandler != NULL )
+	{
+		pxBudget->pxHandler( pxBudget->xTask );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvCharge( uint64_t ullNow )
+{
+TaskBudget_t *pxBudget = ( TaskBudget_t * ) pvTaskGetThreadLocalStoragePointer( NULL, configTASK_BUDGET_TLS_INDEX );
+
+	if( pxBudget != NULL )
+	{
+		pxBudget->ullConsumed += ullNow - ullSwitchedIn;
+
+		if( ( pxBudget->ullConsumed > pxBudget->ullBudgetCycles ) && ( pxBudget->xOverrun == pdFALSE ) )
+		{
+			pxBudget->xOverrun = pdTRUE;
+			pxBudget->xActionPending = pdTRUE;
+		}
+	}
+
+	ullSwitchedIn = ullNow;
+}
+/*-----------------------------------------------------------*/
+
+static void prvNewPeriod( TaskBudget_t *pxBudget, TickType_t xNow )
+{
+#if( configUSE_TELEMETRY == 1 )
+	vTelemetryUpdateBegin( &( pxBudget->xTelemetry.xBlock ) );
+
+	pxBudget->xTelemetry.xStats.ullPeriods++;
+
+	if( pxBudget->xOverrun != pdFALSE )
+	{
+		pxBudget->xTelemetry.xStats.ullOverruns++;
+	}
+
+	if( pxBudget->ullConsumed > pxBudget->xTelemetry.xStats.ullMaxCycles )
+	{
+		pxBudget->xTelemetry.xStats.ullMaxCycles = pxBudget->ullConsumed;
+	}
+
+	vTelemetryUpdateEnd( &( pxBudget->xTelemetry.xBlock ) );
+#endif
+
+	/* Skips the periods that went by while the task was not running. */
+	pxBudget->xPeriodStart += ( ( TickType_t ) ( xNow - pxBudget->xPeriodStart ) / pxBudget->xPeriod ) * pxBudget->xPeriod;
+
+	/* An overrun not yet passed to the timer task is dropped with its
+	period. */
+	if( pxBudget->xActionTaken != pdFALSE )
+	{
+		pxBudget->xRestorePending = pdTRUE;
+	}
+
+	pxBudget->ullConsumed = 0;
+	pxBudget->xOverrun = pdFALSE;
+	pxBudget->xActionPending = pdFALSE;
+	pxBudget->xActionTaken = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskBudgetTick( void )
+{
+TickType_t xNow = xTaskGetTickCountFromISR();
+TaskBudget_t *pxBudget;
+
+	/* Charge the running task, which may never be switched out. */
+	prvCharge( ullTimestampCycles() );
+
+	for( pxBudget = pxBudgets; pxBudget != NULL; pxBudget = pxBudget->pxNext )
+	{
+		if( ( TickType_t ) ( xNow - pxBudget->xPeriodStart ) >= pxBudget->xPeriod )
+		{
+			prvNewPeriod( pxBudget, xNow );
+		}
+
+		/* Both retried on the next tick if the timer queue is full, the
+		restore first. */
+		if( ( pxBudget->xRestorePending != pdFALSE ) &&
+			( xTimerPendFunctionCallFromISR( prvBudgetAction, pxBudget, taskbudgetACTION_RESTORE, NULL ) == pdPASS ) )
+		{
+			pxBudget->xRestorePending = pdFALSE;
+		}
+
+		if( ( pxBudget->xActionPending != pdFALSE ) && ( pxBudget->xRestorePending == pdFALSE ) &&
+			( xTimerPendFunctionCallFromISR( prvBudgetAction, pxBudget, taskbudgetACTION_OVERRUN, NULL ) == pdPASS ) )
+		{
+			pxBudget->xActionPending = pdFALSE;
+			pxBudget->xActionTaken = pdTRUE;
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vTaskBudgetSwitchedOut( void )
+{
+	prvCharge( ullTimestampCycles() );
+}
+/*-----------------------------------------------------------*/
+
+void vTaskBudgetSwitchedIn( void )
+{
+	ullSwitchedIn = ullTimestampCycles();
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * A hog one priority above the benchmark task spins forever, with a budget of
+ * a quarter of each period.  The benchmark task measures how long it waits
+ * for vTaskDelay( 1 ) to return: at most about the budget of the hog, plus
+ * the tick it takes to notice the overrun.  The budget of the hog is not
+ * published, as the hog is deleted at the end.
+ */
+#define taskbudgetBENCH_PERIOD_MS		( 20U )
+#define taskbudgetBENCH_BUDGET_US		( 5000U )
+#define taskbudgetBENCH_DELAYS			( 50U )
+
+static StaticTask_t xBenchHogTCB;
+static StackType_t uxBenchHogStack[ configMINIMAL_STACK_SIZE ];
+static TaskBudget_t xBenchHogBudget;
+
+static void prvBenchHogTask( void *pvParameters )
+{
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+	}
+}
+
+void vTaskBudgetBenchmark( void )
+{
+UBaseType_t uxPriority = uxTaskPriorityGet( NULL );
+TaskHandle_t xHog;
+uint64_t ullStart;
+uint64_t ullWait;
+uint64_t ullWorstWait = 0;
+uint32_t ulDelay;
+
+	/* Cost of the accounting at a context switch. */
+	ullStart = ullTimestampCycles();
+	for( ulDelay = 0; ulDelay < taskbudgetBENCH_DELAYS; ulDelay++ )
+	{
+		vTaskBudgetSwitchedIn();
+		vTaskBudgetSwitchedOut();
+	}
+	vBenchReport( "task_budget.switch_accounting", 0, ullTimestampCycles() - ullStart, taskbudgetBENCH_DELAYS );
+
+	/* Created suspended until the budget is attached. */
+	vTaskSuspendAll();
+	{
+		xHog = xTaskCreateStatic( prvBenchHogTask, "BudgetHog", configMINIMAL_STACK_SIZE, NULL, uxPriority + 1U, uxBenchHogStack, &xBenchHogTCB );
+		vTaskBudgetAttach( &xBenchHogBudget, xHog, ullTaskBudgetCyclesFromUs( taskbudgetBENCH_BUDGET_US ),
+						   pdMS_TO_TICKS( taskbudgetBENCH_PERIOD_MS ), tskIDLE_PRIORITY, NULL );
+	}
+	( void ) xTaskResumeAll();
+
+	for( ulDelay = 0; ulDelay < taskbudgetBENCH_DELAYS; ulDelay++ )
+	{
+		ullStart = ullTimestampCycles();
+		vTaskDelay( 1 );
+		ullWait = ullTimestampCycles() - ullStart;
+
+		if( ullWait > ullWorstWait )
+		{
+			ullWorstWait = ullWait;
+		}
+	}
+
+	/* Runs while the hog is demoted, where the detach leaves it. */
+	vTaskBudgetDetach( &xBenchHogBudget );
+	vTaskDelete( xHog );
+
+	vBenchReport( "task_budget.victim_worst_wait", taskbudgetBENCH_BUDGET_US, ullWorstWait, 1 );
+	vBenchReport( "task_budget.budget", taskbudgetBENCH_BUDGET_US, ullTaskBudgetCyclesFromUs( taskbudgetBENCH_BUDGET_US ), 1 );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_TASK_BUDGET */
@@ -0,0 +1,124 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef TASK_BUDGET_H
+#define TASK_BUDGET_H
+
+/*
+ * Per task execution budgets.
+ *
+ * A task with a budget may run for a number of cycles per period.  The
+ * cycles are accounted with mcycle at every context switch
+ * (traceTASK_SWITCHED_OUT and traceTASK_SWITCHED_IN, trace_hooks.h) and on
+ * every tick for the running task, so the interrupts it suffers are charged
+ * to it too.  When a task exceeds its budget, the tick hook asks the timer
+ * task (xTimerPendFunctionCallFromISR()) to:
+ *  - lower the task to uxOverrunPriority until its next period, so that it
+ *    can no longer delay the tasks between the two priorities, through
+ *    task_demotion.h, so that the task gets its own priority back even if it
+ *    was raised to its preemption threshold;
+ *  - then call pxHandler, if not NULL.
+ * The budget is restored at the start of every period.  An overrun is
+ * detected within a tick, and acted on once the timer task runs, which is
+ * why configTIMER_TASK_PRIORITY should be above every task with a budget.
+ *
+ * The budget of each task is reached through its thread local storage
+ * pointer configTASK_BUDGET_TLS_INDEX.  The periodic tasks of the manifest
+ * get their period and worst case execution time as budget.  With
+ * configUSE_TELEMETRY, vTaskBudgetPublish() publishes a block named after
+ * the task with the periods, the overruns and the most cycles used in a
+ * period, as the manifest does for its tasks.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if( configUSE_TELEMETRY == 1 )
+	#include "telemetry.h"
+#endif
+
+#include "task_demotion.h"
+
+#if( configUSE_TASK_BUDGET == 1 )
+
+#if( configNUM_THREAD_LOCAL_STORAGE_POINTERS <= configTASK_BUDGET_TLS_INDEX )
+	#error configNUM_THREAD_LOCAL_STORAGE_POINTERS must leave room for configTASK_BUDGET_TLS_INDEX
+#endif
+
+/* uxOverrunPriority that leaves the priority of the task alone. */
+#define taskbudgetKEEP_PRIORITY		( ( UBaseType_t ) configMAX_PRIORITIES )
+
+/* Called from the timer task on every overrun. */
+typedef void ( *TaskBudgetHandler_t )( TaskHandle_t xTask );
+
+typedef struct
+{
+	uint64_t ullPeriods;
+	uint64_t ullOverruns;
+	uint64_t ullMaxCycles;		/* Most cycles used in one period. */
+	uint64_t ullBudgetCycles;
+} TaskBudgetStats_t;
+
+/* The members are private to task_budget.c. */
+typedef struct xTASK_BUDGET
+{
+	TaskHandle_t xTask;
+	uint64_t ullBudgetCycles;
+	uint64_t ullConsumed;				/* In the current period. */
+	TickType_t xPeriod;
+	TickType_t xPeriodStart;
+	UBaseType_t uxOverrunPriority;
+	TaskBudgetHandler_t pxHandler;
+	BaseType_t xOverrun;				/* Detected in the current period. */
+	BaseType_t xActionPending;			/* Detected, not yet passed to the timer task. */
+	BaseType_t xActionTaken;			/* Passed to the timer task in the current period. */
+	BaseType_t xRestorePending;			/* Period over, restore not yet passed to the timer task. */
+	TaskDemotion_t xDemotion;
+	BaseType_t xAttached;
+	struct xTASK_BUDGET *pxNext;
+#if( configUSE_TELEMETRY == 1 )
+	telemetryBLOCK( TaskBudgetStats_t ) xTelemetry;
+#endif
+} TaskBudget_t;
+
+/* Measures the rate of mcycle against mtime, for
+ullTaskBudgetCyclesFromUs().  Call once before the scheduler starts, it
+spins for about 8 ms. */
+void vTaskBudgetInit( void );
+
+/* Cycles of the core in ulMicroseconds. */
+uint64_t ullTaskBudgetCyclesFromUs( uint32_t ulMicroseconds );
+
+/* Gives xTask a budget of ullBudgetCycles every xPeriod ticks.  pxBudget
+must stay valid until vTaskBudgetDetach(). */
+void vTaskBudgetAttach( TaskBudget_t *pxBudget, TaskHandle_t xTask, uint64_t ullBudgetCycles, TickType_t xPeriod,
+						UBaseType_t uxOverrunPriority, TaskBudgetHandler_t pxHandler );
+
+#if( configUSE_TELEMETRY == 1 )
+	/* Publishes the telemetry block of pxBudget, attached, under the name of its
+	task.  Blocks cannot be removed from the registry: only for the budgets of
+	tasks that are never deleted. */
+	void vTaskBudgetPublish( TaskBudget_t *pxBudget );
+#endif
+
+/* Removes the budget, before the task is deleted for instance.  The task
+keeps its current priority, even if demoted.  pxBudget must stay valid until
+the timer task has run, as it may still hold actions for it. */
+void vTaskBudgetDetach( TaskBudget_t *pxBudget );
+
+/* Called from the tick hook. */
+void vTaskBudgetTick( void );
+
+/* Called by the trace macros, see trace_hooks.h. */
+void vTaskBudgetSwitchedIn( void );
+void vTaskBudgetSwitchedOut( void );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vTaskBudgetBenchmark( void );
+#endif
+
+#endif /* configUSE_TASK_BUDGET */
+
+#endif /* TASK_BUDGET_H */
@@ -0,0 +1,186 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "task_demotion.h"
+#include "preempt_threshold.h"
+
+#if( configUSE_TASK_BUDGET == 1 ) || ( configUSE_CRITICALITY == 1 )
+
+#if( configUSE_TRACE_FACILITY != 1 ) || ( configUSE_MUTEXES != 1 )
+	#error The own priority of a task is read with vTaskGetInfo(), set configUSE_TRACE_FACILITY to 1
+#endif
+
+/* The active demotions.  Changed by the timer task, which no other task
+preempts, and by vTaskDemotionDrop() in a critical section. */
+static TaskDemotion_t *pxDemotions = NULL;
+
+/*-----------------------------------------------------------*/
+
+#if( configUSE_PREEMPT_THRESHOLD != 1 )
+
+/* Without the inherited priority, as preempt_threshold.c does. */
+static UBaseType_t prvBasePriority( TaskHandle_t xTask )
+{
+TaskStatus_t xStatus;
+
+	vTaskGetInfo( xTask, &xStatus, pdFALSE, eRunning );
+
+	return xStatus.uxBasePriority;
+}
+
+#endif
+
+static TaskDemotion_t *prvFind( TaskHandle_t xTask )
+{
+TaskDemotion_t *pxDemotion;
+
+	for( pxDemotion = pxDemotions; pxDemotion != NULL; pxDemotion = pxDemotion->pxNext )
+	{
+		if( pxDemotion->xTask == xTask )
+		{
+			break;
+		}
+	}
+
+	return pxDemotion;
+}
+
+/* The lowest of uxPriority and the priorities of the demotions of xTask. */
+static UBaseType_t prvLowest( TaskHandle_t xTask, UBaseType_t uxPriority )
+{
+TaskDemotion_t *pxDemotion;
+
+	for( pxDemotion = pxDemotions; pxDemotion != NULL; pxDemotion = pxDemotion->pxNext )
+	{
+		if( ( pxDemotion->xTask == xTask ) && ( pxDemotion->uxPriority < uxPriority ) )
+		{
+			uxPriority = pxDemotion->uxPriority;
+		}
+	}
+
+	return uxPriority;
+}
+
+/* Called in a critical section, or from the timer task. */
+static void prvUnlink( TaskDemotion_t *pxDemotion )
+{
+TaskDemotion_t **ppxLink;
+
+	for( ppxLink = &pxDemotions; *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+	{
+		if( *ppxLink == pxDemotion )
+		{
+			*ppxLink = pxDemotion->pxNext;
+			break;
+		}
+	}
+
+	pxDemotion->xActive = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDemotionInit( TaskDemotion_t *pxDemotion )
+{
+	pxDemotion->xTask = NULL;
+	pxDemotion->uxPriority = 0;
+	pxDemotion->uxBasePriority = 0;
+	pxDemotion->pxNext = NULL;
+	pxDemotion->xActive = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDemotionStart( TaskDemotion_t *pxDemotion, TaskHandle_t xTask, UBaseType_t uxPriority )
+{
+TaskDemotion_t *pxOther;
+
+	configASSERT( uxPriority < configMAX_PRIORITIES );
+
+	if( pxDemotion->xActive != pdFALSE )
+	{
+		return;
+	}
+
+	pxOther = prvFind( xTask );
+
+	if( pxOther != NULL )
+	{
+		pxDemotion->uxBasePriority = pxOther->uxBasePriority;
+	}
+	else
+	{
+	#if( configUSE_PREEMPT_THRESHOLD == 1 )
+		pxDemotion->uxBasePriority = uxPreemptThresholdDemote( xTask );
+	#else
+		pxDemotion->uxBasePriority = prvBasePriority( xTask );
+	#endif
+	}
+
+	pxDemotion->xTask = xTask;
+	pxDemotion->uxPriority = uxPriority;
+
+	taskENTER_CRITICAL();
+	{
+		pxDemotion->pxNext = pxDemotions;
+		pxDemotions = pxDemotion;
+		pxDemotion->xActive = pdTRUE;
+	}
+	taskEXIT_CRITICAL();
+
+	vTaskPrioritySet( xTask, prvLowest( xTask, pxDemotion->uxBasePriority ) );
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDemotionEnd( TaskDemotion_t *pxDemotion )
+{
+	if( pxDemotion->xActive == pdFALSE )
+	{
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	{
+		prvUnlink( pxDemotion );
+	}
+	taskEXIT_CRITICAL();
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+	if( prvFind( pxDemotion->xTask ) == NULL )
+	{
+		vPreemptThresholdUndemote( pxDemotion->xTask );
+	}
+#endif
+
+	vTaskPrioritySet( pxDemotion->xTask, prvLowest( pxDemotion->xTask, pxDemotion->uxBasePriority ) );
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDemotionDrop( TaskDemotion_t *pxDemotion )
+{
+BaseType_t xLast = pdFALSE;
+
+	taskENTER_CRITICAL();
+	{
+		if( pxDemotion->xActive != pdFALSE )
+		{
+			prvUnlink( pxDemotion );
+			xLast = ( prvFind( pxDemotion->xTask ) == NULL ) ? pdTRUE : pdFALSE;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+	if( xLast != pdFALSE )
+	{
+		vPreemptThresholdUndemote( pxDemotion->xTask );
+	}
+#else
+	( void ) xLast;
+#endif
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_TASK_BUDGET || configUSE_CRITICALITY */
@@ -0,0 +1,59 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef TASK_DEMOTION_H
+#define TASK_DEMOTION_H
+
+/*
+ * Demotions of tasks below their own priority.
+ *
+ * task_budget.c lowers a task that overran its budget until its next period,
+ * and criticality.c lowers the low criticality tasks during the high mode.
+ * Both may hold the same task at once, and the task may be raised to its
+ * preemption threshold (preempt_threshold.h) when either starts.  So they go
+ * through here, which:
+ *  - records the own priority of the task when its first demotion starts,
+ *    not the threshold it may be raised to;
+ *  - runs the task at the lowest priority of its demotions while it has
+ *    some, and gives it its own priority back when the last one ends;
+ *  - with configUSE_PREEMPT_THRESHOLD, undoes the raise of the task and keeps
+ *    it from raising itself until then.
+ *
+ * Each module embeds one TaskDemotion_t per task it may demote.  Start and
+ * end are called from the timer task, which is above every demoted task.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if( configUSE_TASK_BUDGET == 1 ) || ( configUSE_CRITICALITY == 1 )
+
+/* The members are private to task_demotion.c. */
+typedef struct xTASK_DEMOTION
+{
+	TaskHandle_t xTask;
+	UBaseType_t uxPriority;
+	UBaseType_t uxBasePriority;		/* Own priority of the task. */
+	struct xTASK_DEMOTION *pxNext;	/* In the list of the active demotions. */
+	BaseType_t xActive;
+} TaskDemotion_t;
+
+/* Called once, before the first start. */
+void vTaskDemotionInit( TaskDemotion_t *pxDemotion );
+
+/* Lowers xTask to uxPriority, or less if another demotion holds it lower,
+until vTaskDemotionEnd().  Does nothing if pxDemotion is already active. */
+void vTaskDemotionStart( TaskDemotion_t *pxDemotion, TaskHandle_t xTask, UBaseType_t uxPriority );
+
+/* Ends pxDemotion: the task goes to the lowest priority of its other
+demotions, or to its own priority if none is left.  Does nothing if
+pxDemotion is not active. */
+void vTaskDemotionEnd( TaskDemotion_t *pxDemotion );
+
+/* Forgets pxDemotion without changing the priority of its task, before the
+task is deleted for instance.  Can be called from any task. */
+void vTaskDemotionDrop( TaskDemotion_t *pxDemotion );
+
+#endif /* configUSE_TASK_BUDGET || configUSE_CRITICALITY */
+
+#endif /* TASK_DEMOTION_H */
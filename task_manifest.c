@@ -0,0 +1,145 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "task_manifest.h"
+#include "preempt_threshold.h"
+#include "task_budget.h"
+
+#if( configSUPPORT_STATIC_ALLOCATION != 1 )
+	#error The task manifest needs configSUPPORT_STATIC_ALLOCATION set to 1 in FreeRTOSConfig.h
+#endif
+
+typedef struct xTASK_MANIFEST_ENTRY
+{
+	TaskFunction_t pxFunction;
+	const char *pcName;
+	StackType_t *puxStack;
+	uint32_t ulStackDepth;
+	UBaseType_t uxPriority;
+	UBaseType_t uxThreshold;
+	Criticality_t eCriticality;
+	uint32_t ulPeriodUs;
+	uint32_t ulWcetUs;
+} TaskManifestEntry_t;
+
+/*-----------------------------------------------------------*/
+
+/* Build time checks of each entry. */
+#define taskmanifestCHECK( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	\
+	_Static_assert( ( uxPriority ) < configMAX_PRIORITIES, "priority of task " #xId " is not below configMAX_PRIORITIES" );	\
+	_Static_assert( ( ( uxThreshold ) >= ( uxPriority ) ) && ( ( uxThreshold ) < configMAX_PRIORITIES ), "threshold of task " #xId " is below its priority or not below configMAX_PRIORITIES" );	\
+	_Static_assert( ( usStackDepth ) >= configMINIMAL_STACK_SIZE, "stack of task " #xId " is smaller than configMINIMAL_STACK_SIZE" );	\
+	_Static_assert( sizeof( pcName ) <= configMAX_TASK_NAME_LEN, "name of task " #xId " is longer than configMAX_TASK_NAME_LEN" );	\
+	_Static_assert( ( ulWcetUs ) <= ( ulPeriodUs ) || ( ulPeriodUs ) == 0UL, "task " #xId " runs longer than its period" );
+
+taskmanifestTASKS( taskmanifestCHECK )
+
+/* RAM used by the stacks and TCBs of the manifest, in bytes. */
+#define taskmanifestRAM( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	\
+	+ ( ( usStackDepth ) * sizeof( StackType_t ) ) + sizeof( StaticTask_t )
+
+#define taskmanifestRAM_BYTES	( 0 taskmanifestTASKS( taskmanifestRAM ) )
+
+_Static_assert( taskmanifestRAM_BYTES <= configSTATIC_RAM_BUDGET, "the task manifest exceeds configSTATIC_RAM_BUDGET" );
+
+/*-----------------------------------------------------------*/
+
+/* One stack per task, each of its own size. */
+#define taskmanifestSTACK( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	\
+	static StackType_t uxStack##xId[ usStackDepth ];
+
+taskmanifestTASKS( taskmanifestSTACK )
+
+static StaticTask_t xTaskBuffers[ taskmanifestTASK_COUNT ];
+
+#if( configUSE_TASK_BUDGET == 1 )
+	static TaskBudget_t xBudgets[ taskmanifestTASK_COUNT ];
+#endif
+
+#if( configUSE_CRITICALITY == 1 )
+	static CriticalityTask_t xCriticality[ taskmanifestTASK_COUNT ];
+#endif
+
+#define taskmanifestENTRY( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	\
+	{ pxFunction, pcName, uxStack##xId, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs },
+
+static const TaskManifestEntry_t xManifest[ taskmanifestTASK_COUNT ] =
+{
+	taskmanifestTASKS( taskmanifestENTRY )
+};
+
+/*-----------------------------------------------------------*/
+
+void vTaskManifestCreate( void )
+{
+UBaseType_t uxIndex;
+TaskHandle_t xHandle;
+
+	for( uxIndex = 0; uxIndex < ( UBaseType_t ) taskmanifestTASK_COUNT; uxIndex++ )
+	{
+		xHandle = xTaskCreateStatic( xManifest[ uxIndex ].pxFunction,
+									 xManifest[ uxIndex ].pcName,
+									 xManifest[ uxIndex ].ulStackDepth,
+									 NULL,
+									 xManifest[ uxIndex ].uxPriority,
+									 xManifest[ uxIndex ].puxStack,
+									 &xTaskBuffers[ uxIndex ] );
+
+		/* Only fails if the buffers are NULL, which they are not. */
+		configASSERT( xHandle != NULL );
+
+		( void ) xHandle;
+
+	#if( configUSE_PREEMPT_THRESHOLD == 1 )
+		if( xManifest[ uxIndex ].uxThreshold > xManifest[ uxIndex ].uxPriority )
+		{
+			vPreemptThresholdSet( xHandle, xManifest[ uxIndex ].uxThreshold );
+		}
+	#endif
+
+	#if( configUSE_CRITICALITY == 1 )
+		vCriticalityRegister( &xCriticality[ uxIndex ], xHandle, xManifest[ uxIndex ].eCriticality );
+	#endif
+
+	#if( configUSE_TASK_BUDGET == 1 )
+		if( xManifest[ uxIndex ].ulPeriodUs != 0UL )
+		{
+		#if( configUSE_CRITICALITY == 1 )
+			/* A high criticality task keeps running on an overrun, the low
+			criticality tasks make room for it instead. */
+			if( xManifest[ uxIndex ].eCriticality == criticalityHIGH )
+			{
+				vTaskBudgetAttach( &xBudgets[ uxIndex ], xHandle,
+								   ullTaskBudgetCyclesFromUs( xManifest[ uxIndex ].ulWcetUs ),
+								   pdMS_TO_TICKS( xManifest[ uxIndex ].ulPeriodUs / 1000UL ),
+								   taskbudgetKEEP_PRIORITY, vCriticalityBudgetOverrun );
+			}
+			else
+		#endif
+			{
+				vTaskBudgetAttach( &xBudgets[ uxIndex ], xHandle,
+								   ullTaskBudgetCyclesFromUs( xManifest[ uxIndex ].ulWcetUs ),
+								   pdMS_TO_TICKS( xManifest[ uxIndex ].ulPeriodUs / 1000UL ),
+								   taskmanifestOVERRUN_PRIORITY, NULL );
+			}
+
+		#if( configUSE_TELEMETRY == 1 )
+			vTaskBudgetPublish( &xBudgets[ uxIndex ] );
+		#endif
+		}
+	#endif
+	}
+}
+/*-----------------------------------------------------------*/
+
+TaskHandle_t xTaskManifestGetHandle( TaskManifestId_t eId )
+{
+	configASSERT( eId < taskmanifestTASK_COUNT );
+
+	/* The handle of a statically allocated task is its TCB buffer. */
+	return ( TaskHandle_t ) &xTaskBuffers[ eId ];
+}
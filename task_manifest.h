@@ -0,0 +1,110 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef TASK_MANIFEST_H
+#define TASK_MANIFEST_H
+
+/*
+ * Task manifest.
+ *
+ * The application tasks are declared once, in taskmanifestTASKS below, and
+ * vTaskManifestCreate() creates all of them at boot with
+ * xTaskCreateStatic(), so no task uses the kernel heap.  The same table is
+ * checked when building:
+ *  - task_manifest.c checks every priority against configMAX_PRIORITIES,
+ *    every stack against configMINIMAL_STACK_SIZE and every name against
+ *    configMAX_TASK_NAME_LEN, and checks that the stacks and TCBs together
+ *    fit in configSTATIC_RAM_BUDGET;
+ *  - task_manifest_rta.cpp runs a response time analysis of the periodic
+ *    tasks (fixed priorities, deadline equal to the period) and fails the
+ *    build if one of them can miss its deadline.
+ * With configUSE_TASK_BUDGET, the worst case execution time of each periodic
+ * task is also enforced at run time as its budget per period, so that the
+ * analysis still holds when one of them misbehaves.  With
+ * configUSE_CRITICALITY as well, an overrun of a high criticality task
+ * switches the system to the high criticality mode instead of demoting it.
+ *
+ * Each entry is
+ *   X( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )
+ * where xId is used to build the identifiers of the task, usStackDepth is in
+ * words, uxThreshold is the preemption threshold of the task (equal to
+ * uxPriority for none, see preempt_threshold.h), eCriticality is the
+ * criticality of the task (see criticality.h), ulPeriodUs is the period (or
+ * minimum inter-arrival time) of the task and ulWcetUs its worst case
+ * execution time per period.  A period of 0 declares a task that is not
+ * periodic: it is created but not analysed, and it must run below every
+ * periodic task.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "criticality.h"
+
+/* Period of the demo send task, which is also the rate at which the receive
+task is released. */
+#define taskmanifestQUEUE_SEND_PERIOD_MS	( 1000 )
+
+#define taskmanifestTASKS( X )																										\
+	X( QueueReceive,	vQueueReceiveTask,	"Rx",	configMINIMAL_STACK_SIZE,	tskIDLE_PRIORITY + 2,	tskIDLE_PRIORITY + 2,	criticalityHIGH,		taskmanifestQUEUE_SEND_PERIOD_MS * 1000UL,	1000UL )	\
+	X( QueueSend,		vQueueSendTask,		"TX",	configMINIMAL_STACK_SIZE,	tskIDLE_PRIORITY + 1,	tskIDLE_PRIORITY + 2,	criticalityLOW_DEGRADE,	taskmanifestQUEUE_SEND_PERIOD_MS * 1000UL,	200UL )
+
+/* The threshold in effect: without configUSE_PREEMPT_THRESHOLD every task
+can be preempted by any task above its priority. */
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+	#define taskmanifestTHRESHOLD( uxPriority, uxThreshold )	( uxThreshold )
+#else
+	#define taskmanifestTHRESHOLD( uxPriority, uxThreshold )	( uxPriority )
+#endif
+
+/* With configUSE_TASK_BUDGET, a periodic task that runs longer than its
+worst case execution time in a period is lowered to this priority for the
+rest of the period (task_budget.h). */
+#define taskmanifestOVERRUN_PRIORITY		( tskIDLE_PRIORITY )
+
+/* Costs added by the kernel to the analysis: the worst case of the tick
+interrupt, which preempts every task once per tick, and of a context switch,
+charged twice per job. */
+#define taskmanifestTICK_WCET_US		( 10UL )
+#define taskmanifestSWITCH_WCET_US		( 5UL )
+
+/* The kernel tasks, above every task of the manifest, which the analysis
+counts as interference: the timer task, which runs the software timers, the
+pended functions and the budget and criticality handlers, and with
+configUSE_TIMER_WHEEL the timer wheel task.  Each may run once per tick, for
+at most its worst case execution time. */
+#define taskmanifestTIMER_TASK_WCET_US		( 50UL )
+#define taskmanifestTIMER_TASK_PERIOD_US	( 1000000UL / configTICK_RATE_HZ )
+#define taskmanifestTIMER_WHEEL_WCET_US		( 50UL )
+#define taskmanifestTIMER_WHEEL_PERIOD_US	( 1000000UL / configTICK_RATE_HZ )
+
+/* taskmanifestID_<xId>, the index of each task in the manifest. */
+#define taskmanifestENUM( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	taskmanifestID_##xId,
+
+typedef enum
+{
+	taskmanifestTASKS( taskmanifestENUM )
+	taskmanifestTASK_COUNT
+} TaskManifestId_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The functions implementing the tasks. */
+#define taskmanifestDECLARE( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	void pxFunction( void *pvParameters );
+
+taskmanifestTASKS( taskmanifestDECLARE )
+
+/* Creates every task of the manifest.  Call once, before the scheduler
+starts. */
+void vTaskManifestCreate( void );
+
+/* Handle of a task created by vTaskManifestCreate(). */
+TaskHandle_t xTaskManifestGetHandle( TaskManifestId_t eId );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TASK_MANIFEST_H */
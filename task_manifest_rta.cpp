@@ -0,0 +1,161 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/*
+ * Build time response time analysis of the task manifest.
+ *
+ * For each periodic task i, the worst case response time is the smallest
+ * fixed point of
+ *
+ *   R = B(i) + C(i) + ceil( R / Ttick ) * Ctick + sum over j of ceil( R / T(j) ) * C(j)
+ *
+ * where j goes over the other tasks of higher or equal priority (equal
+ * priority tasks share time slices so they delay i as well), and over the
+ * timer task and the timer wheel task, declared in task_manifest.h with a
+ * period and a worst case execution time of their own.  C includes two
+ * context switches per job.  B(i) is the longest job of the lower
+ * priority tasks whose preemption threshold (preempt_threshold.h) is at or
+ * above the priority of i: one of them may have started and cannot be
+ * preempted by i.  Counting every higher priority job as interference, even
+ * those that cannot preempt i once it has started, keeps the bound safe.
+ * The build fails if R exceeds the period of a task, or if a task that is
+ * not periodic runs at or above the priority of a periodic one, as its
+ * interference could not be bounded.
+ *
+ * This file only holds compile time checks and generates no code.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "task_manifest.h"
+
+namespace {
+
+struct TaskTiming
+{
+	uint64_t priority;
+	uint64_t threshold;
+	uint64_t period_us;
+	uint64_t wcet_us;
+};
+
+#define taskmanifestTIMING( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	\
+	TaskTiming{ ( uxPriority ), taskmanifestTHRESHOLD( uxPriority, uxThreshold ), ( ulPeriodUs ), ( ulWcetUs ) },
+
+constexpr TaskTiming tasks[] = { taskmanifestTASKS( taskmanifestTIMING ) };
+constexpr size_t task_count = sizeof( tasks ) / sizeof( tasks[ 0 ] );
+
+/* Only interfere, they are not checked. */
+constexpr TaskTiming kernel_tasks[] =
+{
+	TaskTiming{ configTIMER_TASK_PRIORITY, configTIMER_TASK_PRIORITY, taskmanifestTIMER_TASK_PERIOD_US, taskmanifestTIMER_TASK_WCET_US },
+#if( configUSE_TIMER_WHEEL == 1 )
+	TaskTiming{ configTIMER_WHEEL_TASK_PRIORITY, configTIMER_WHEEL_TASK_PRIORITY, taskmanifestTIMER_WHEEL_PERIOD_US, taskmanifestTIMER_WHEEL_WCET_US },
+#endif
+};
+constexpr size_t kernel_task_count = sizeof( kernel_tasks ) / sizeof( kernel_tasks[ 0 ] );
+
+constexpr uint64_t tick_period_us = 1000000UL / configTICK_RATE_HZ;
+constexpr uint64_t unbounded = UINT64_MAX;
+
+constexpr uint64_t ceil_div( uint64_t dividend, uint64_t divisor )
+{
+	return ( dividend + divisor - 1U ) / divisor;
+}
+
+constexpr uint64_t job_cost( const TaskTiming &task )
+{
+	return task.wcet_us + ( 2U * taskmanifestSWITCH_WCET_US );
+}
+
+/* Longest job of a lower priority task that tasks[ index ] cannot preempt. */
+constexpr uint64_t blocking( size_t index )
+{
+	const TaskTiming &task = tasks[ index ];
+	uint64_t longest = 0;
+
+	for( size_t other = 0; other < task_count; other++ )
+	{
+		if( ( tasks[ other ].priority < task.priority ) &&
+			( tasks[ other ].threshold >= task.priority ) &&
+			( job_cost( tasks[ other ] ) > longest ) )
+		{
+			longest = job_cost( tasks[ other ] );
+		}
+	}
+
+	return longest;
+}
+
+/* Worst case response time of tasks[ index ], in microseconds.  The iteration
+stops as soon as the deadline is exceeded. */
+constexpr uint64_t response_time( size_t index )
+{
+	const TaskTiming &task = tasks[ index ];
+	uint64_t response = blocking( index ) + job_cost( task );
+
+	for( ;; )
+	{
+		uint64_t next = blocking( index ) + job_cost( task ) + ( ceil_div( response, tick_period_us ) * taskmanifestTICK_WCET_US );
+
+		for( size_t other = 0; other < task_count; other++ )
+		{
+			if( ( other == index ) || ( tasks[ other ].priority < task.priority ) )
+			{
+				continue;
+			}
+
+			if( tasks[ other ].period_us == 0U )
+			{
+				return unbounded;
+			}
+
+			next += ceil_div( response, tasks[ other ].period_us ) * job_cost( tasks[ other ] );
+		}
+
+		for( size_t other = 0; other < kernel_task_count; other++ )
+		{
+			if( kernel_tasks[ other ].priority >= task.priority )
+			{
+				next += ceil_div( response, kernel_tasks[ other ].period_us ) * job_cost( kernel_tasks[ other ] );
+			}
+		}
+
+		if( ( next == response ) || ( next > task.period_us ) )
+		{
+			return next;
+		}
+
+		response = next;
+	}
+}
+
+constexpr bool meets_deadline( size_t index )
+{
+	return ( tasks[ index ].period_us == 0U ) || ( response_time( index ) <= tasks[ index ].period_us );
+}
+
+static_assert( tick_period_us > taskmanifestTICK_WCET_US, "the tick interrupt alone saturates the CPU" );
+
+constexpr bool kernel_tasks_periodic()
+{
+	for( size_t index = 0; index < kernel_task_count; index++ )
+	{
+		if( kernel_tasks[ index ].period_us == 0U )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert( kernel_tasks_periodic(), "the kernel tasks need a period (task_manifest.h)" );
+
+#define taskmanifestRTA_CHECK( xId, pxFunction, pcName, usStackDepth, uxPriority, uxThreshold, eCriticality, ulPeriodUs, ulWcetUs )	\
+	static_assert( meets_deadline( taskmanifestID_##xId ), "task " #xId " can miss its deadline (task_manifest.h)" );
+
+taskmanifestTASKS( taskmanifestRTA_CHECK )
+
+} /* namespace */
@@ -0,0 +1,193 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "telemetry.h"
+#include "console.h"
+
+#if( configUSE_TELEMETRY == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+#define telemetryTASK_PRIORITY		( tskIDLE_PRIORITY + 1 )
+#define telemetryTASK_STACK_SIZE	( configMINIMAL_STACK_SIZE )
+
+/* Blocks are only ever added, at the head, so readers can walk the list
+without a lock. */
+TelemetryBlock_t * volatile pxTelemetryBlocks = NULL;
+
+#if( configTELEMETRY_DUMP_PERIOD_MS > 0 )
+	static void prvTelemetryTask( void *pvParameters );
+#endif
+
+/*-----------------------------------------------------------*/
+
+void vTelemetryRegister( TelemetryBlock_t *pxBlock, const char *pcName, const char * const *ppcFieldNames, uint64_t *pullFields, uint32_t ulFieldCount )
+{
+TelemetryBlock_t *pxHead;
+
+	configASSERT( ( ulFieldCount > 0U ) && ( ulFieldCount <= configTELEMETRY_MAX_FIELDS ) );
+
+	pxBlock->xLock.ulSequence = 0;
+	pxBlock->pcName = pcName;
+	pxBlock->ppcFieldNames = ppcFieldNames;
+	pxBlock->pullFields = pullFields;
+	pxBlock->ulFieldCount = ulFieldCount;
+
+	/* Lock-free push, as the other harts may register at the same time.  The
+	release ordering publishes the block before it becomes reachable. */
+	pxHead = pxTelemetryBlocks;
+	do
+	{
+		pxBlock->pxNext = pxHead;
+	} while( __atomic_compare_exchange_n( &pxTelemetryBlocks, &pxHead, pxBlock, pdFALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED ) == 0 );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTelemetrySnapshot( const TelemetryBlock_t *pxBlock, uint64_t *pullBuffer )
+{
+uint32_t ulTry;
+uint32_t ulSequence;
+uint32_t ulField;
+
+	for( ulTry = 0; ulTry < configTELEMETRY_SNAPSHOT_RETRIES; ulTry++ )
+	{
+		ulSequence = pxBlock->xLock.ulSequence;
+
+		if( ( ulSequence & 1U ) != 0U )
+		{
+			/* Update in progress. */
+			continue;
+		}
+
+		seqlockFENCE_READ();
+
+		for( ulField = 0; ulField < pxBlock->ulFieldCount; ulField++ )
+		{
+			pullBuffer[ ulField ] = pxBlock->pullFields[ ulField ];
+		}
+
+		if( xSeqlockReadRetry( &( pxBlock->xLock ), ulSequence ) == pdFALSE )
+		{
+			return pdPASS;
+		}
+	}
+
+	return pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+void vTelemetryDump( void )
+{
+const TelemetryBlock_t *pxBlock;
+uint64_t ullFields[ configTELEMETRY_MAX_FIELDS ];
+uint32_t ulField;
+
+	for( pxBlock = pxTelemetryBlocks; pxBlock != NULL; pxBlock = pxBlock->pxNext )
+	{
+		if( xTelemetrySnapshot( pxBlock, ullFields ) == pdFAIL )
+		{
+			vConsoleWriteValue( pxBlock->pcName, "busy", 1 );
+			continue;
+		}
+
+		for( ulField = 0; ulField < pxBlock->ulFieldCount; ulField++ )
+		{
+			vConsoleWriteValue( pxBlock->pcName, pxBlock->ppcFieldNames[ ulField ], ullFields[ ulField ] );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vTelemetryInit( void )
+{
+#if( configTELEMETRY_DUMP_PERIOD_MS > 0 )
+	xTaskCreate( prvTelemetryTask, "Telemetry", telemetryTASK_STACK_SIZE, NULL, telemetryTASK_PRIORITY, NULL );
+#endif
+}
+/*-----------------------------------------------------------*/
+
+#if( configTELEMETRY_DUMP_PERIOD_MS > 0 )
+
+static void prvTelemetryTask( void *pvParameters )
+{
+TickType_t xNextWakeTime;
+
+	/* Remove compiler warning about unused parameter. */
+	( void ) pvParameters;
+
+	xNextWakeTime = xTaskGetTickCount();
+
+	for( ;; )
+	{
+		vTaskDelayUntil( &xNextWakeTime, pdMS_TO_TICKS( configTELEMETRY_DUMP_PERIOD_MS ) );
+		vTelemetryDump();
+	}
+}
+
+#endif /* configTELEMETRY_DUMP_PERIOD_MS */
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#define telemetryBENCH_UPDATES		( 1000U )
+
+typedef struct
+{
+	uint64_t ullEvents;
+	uint64_t ullBytes;
+	uint64_t ullErrors;
+	uint64_t ullCycles;
+} BenchStats_t;
+
+static const char * const pcBenchFields[] = { "events", "bytes", "errors", "cycles" };
+
+static telemetryBLOCK( BenchStats_t ) xBenchTelemetry;
+static BenchStats_t xBenchLocked;
+
+/* Cost added to a hot path by publishing its counters, against the same
+counters protected by a critical section, and cost of a snapshot. */
+void vTelemetryBenchmark( void )
+{
+uint64_t ullFields[ sizeof( BenchStats_t ) / sizeof( uint64_t ) ];
+uint32_t ulUpdate;
+uint64_t ullStart;
+
+	telemetryREGISTER( xBenchTelemetry, "bench_telemetry", pcBenchFields );
+
+	ullStart = ullTimestampCycles();
+	for( ulUpdate = 0; ulUpdate < telemetryBENCH_UPDATES; ulUpdate++ )
+	{
+		vTelemetryUpdateBegin( &xBenchTelemetry.xBlock );
+		xBenchTelemetry.xStats.ullEvents++;
+		xBenchTelemetry.xStats.ullBytes += ulUpdate;
+		vTelemetryUpdateEnd( &xBenchTelemetry.xBlock );
+	}
+	vBenchReport( "telemetry.update", 2, ullTimestampCycles() - ullStart, telemetryBENCH_UPDATES );
+
+	ullStart = ullTimestampCycles();
+	for( ulUpdate = 0; ulUpdate < telemetryBENCH_UPDATES; ulUpdate++ )
+	{
+		taskENTER_CRITICAL();
+		xBenchLocked.ullEvents++;
+		xBenchLocked.ullBytes += ulUpdate;
+		taskEXIT_CRITICAL();
+	}
+	vBenchReport( "critical.update", 2, ullTimestampCycles() - ullStart, telemetryBENCH_UPDATES );
+
+	ullStart = ullTimestampCycles();
+	for( ulUpdate = 0; ulUpdate < telemetryBENCH_UPDATES; ulUpdate++ )
+	{
+		( void ) xTelemetrySnapshot( &xBenchTelemetry.xBlock, ullFields );
+	}
+	vBenchReport( "telemetry.snapshot", xBenchTelemetry.xBlock.ulFieldCount, ullTimestampCycles() - ullStart, telemetryBENCH_UPDATES );
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_TELEMETRY */
@@ -0,0 +1,109 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/*
+ * Telemetry blocks.
+ *
+ * Each subsystem owns a block: a structure of uint64_t counters, aligned on
+ * and padded to a cache line so that the blocks written by different harts
+ * never share a line, and published through a sequence lock (seqlock.h).
+ *
+ * The owner updates its counters between vTelemetryUpdateBegin() and
+ * vTelemetryUpdateEnd(), which only add two increments and two fences to the
+ * hot path: no lock, no critical section.  Tasks, interrupts, the other
+ * harts, and a debugger walking pxTelemetryBlocks, take consistent copies
+ * with xTelemetrySnapshot(), which never blocks the owner.  A snapshot that
+ * keeps finding an update in progress (an interrupt that preempted the owner,
+ * for instance) gives up after configTELEMETRY_SNAPSHOT_RETRIES tries rather
+ * than spinning.
+ *
+ * A block must have one writer at a time: per hart blocks, or writers that
+ * hold a common lock.
+ *
+ *	typedef struct { uint64_t ullSent; uint64_t ullDropped; } TxStats_t;
+ *	static const char * const pcTxFields[] = { "sent", "dropped" };
+ *	static telemetryBLOCK( TxStats_t ) xTxTelemetry;
+ *
+ *	telemetryREGISTER( xTxTelemetry, "tx", pcTxFields );
+ *
+ *	vTelemetryUpdateBegin( &xTxTelemetry.xBlock );
+ *	xTxTelemetry.xStats.ullSent++;
+ *	vTelemetryUpdateEnd( &xTxTelemetry.xBlock );
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "cache_layout.h"
+#include "seqlock.h"
+
+#if( configUSE_TELEMETRY == 1 )
+
+/* Header of a block.  The members are private to telemetry.c. */
+typedef struct xTELEMETRY_BLOCK
+{
+	Seqlock_t xLock;
+	uint32_t ulFieldCount;
+	const char *pcName;
+	const char * const *ppcFieldNames;	/* ulFieldCount names. */
+	uint64_t *pullFields;
+	struct xTELEMETRY_BLOCK *pxNext;
+} TelemetryBlock_t;
+
+/* The type of a block holding a structure xStatsType of uint64_t counters. */
+#define telemetryBLOCK( xStatsType )			\
+	struct cachelayoutALIGNED						\
+	{											\
+		TelemetryBlock_t xBlock;				\
+		xStatsType xStats;						\
+	}
+
+/* Publishes xTelemetry, declared with telemetryBLOCK(), under pcName.
+ppcFieldNames names every counter of the structure, in order. */
+#define telemetryREGISTER( xTelemetry, pcName, ppcFieldNames )									\
+	do {																						\
+		_Static_assert( ( sizeof( ( xTelemetry ).xStats ) % sizeof( uint64_t ) ) == 0U,			\
+						"telemetry blocks only hold uint64_t counters" );						\
+		vTelemetryRegister( &( ( xTelemetry ).xBlock ), ( pcName ), ( ppcFieldNames ),			\
+							( uint64_t * ) &( ( xTelemetry ).xStats ),							\
+							( uint32_t ) ( sizeof( ( xTelemetry ).xStats ) / sizeof( uint64_t ) ) );	\
+	} while( 0 )
+
+/* Head of the list of the registered blocks, for debuggers. */
+extern TelemetryBlock_t * volatile pxTelemetryBlocks;
+
+/* Can be called from any hart, before or after the scheduler starts. */
+void vTelemetryRegister( TelemetryBlock_t *pxBlock, const char *pcName, const char * const *ppcFieldNames, uint64_t *pullFields, uint32_t ulFieldCount );
+
+static inline void vTelemetryUpdateBegin( TelemetryBlock_t *pxBlock )
+{
+	vSeqlockWriteBeginFromISR( &( pxBlock->xLock ) );
+}
+
+static inline void vTelemetryUpdateEnd( TelemetryBlock_t *pxBlock )
+{
+	vSeqlockWriteEndFromISR( &( pxBlock->xLock ) );
+}
+
+/* Copies the counters of pxBlock to pullBuffer, which holds as many counters.
+Returns pdFAIL if every try found an update in progress. */
+BaseType_t xTelemetrySnapshot( const TelemetryBlock_t *pxBlock, uint64_t *pullBuffer );
+
+/* Writes every counter of every block as "<block>.<field> = <value>". */
+void vTelemetryDump( void );
+
+/* Creates the task that calls vTelemetryDump() every
+configTELEMETRY_DUMP_PERIOD_MS, if that is not 0. */
+void vTelemetryInit( void );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vTelemetryBenchmark( void );
+#endif
+
+#endif /* configUSE_TELEMETRY */
+
+#endif /* TELEMETRY_H */
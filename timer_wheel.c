@@ -0,0 +1,601 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "timer_wheel.h"
+
+#if( configUSE_TIMER_WHEEL == 1 )
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* 4 levels of 64 slots cover 2^24 ticks (4.6 hours at 1 kHz).  Longer delays
+are parked in the last slot of the top level and filed again when they get
+there. */
+#define timerwheelSLOT_BITS		( 6 )
+#define timerwheelSLOTS			( 1U << timerwheelSLOT_BITS )
+#define timerwheelSLOT_MASK		( ( TickType_t ) ( timerwheelSLOTS - 1U ) )
+#define timerwheelLEVELS		( 4 )
+#define timerwheelRANGE			( ( TickType_t ) 1 << ( timerwheelSLOT_BITS * timerwheelLEVELS ) )
+
+/* Delays above this value are considered to be in the past. */
+#define timerwheelMAX_DELAY		( portMAX_DELAY >> 1 )
+
+/*-----------------------------------------------------------*/
+
+/* Each slot is a NULL terminated list.  ullOccupied has one bit per slot so
+that the next occupied slot is found with a single count trailing zeros. */
+static TimerWheelTimer_t *pxSlots[ timerwheelLEVELS ][ timerwheelSLOTS ];
+static uint64_t ullOccupied[ timerwheelLEVELS ];
+
+/* The last tick processed by the service task. */
+static TickType_t xWheelTick = 0;
+
+/* Timers that expired but whose callback has not run yet, in expiry order. */
+static TimerWheelTimer_t *pxExpired = NULL;
+static TimerWheelTimer_t **ppxExpiredTail = &pxExpired;
+
+/* The tick at which the service task will look at the wheel next, so that
+starting a timer only wakes the service task when it would otherwise be late. */
+static TickType_t xServiceWake = 0;
+static BaseType_t xServiceWaitsForever = pdTRUE;
+static TaskHandle_t xServiceTask = NULL;
+
+static TimerWheelStats_t xStats;
+
+#if( configUSE_BENCHMARKS == 1 )
+	static uint64_t ullServiceCycles = 0;
+#endif
+
+static void prvTimerWheelTask( void *pvParameters );
+
+/*-----------------------------------------------------------*/
+
+static void prvUnlink( TimerWheelTimer_t *pxTimer )
+{
+	*( pxTimer->ppxPrevNext ) = pxTimer->pxNext;
+
+	if( pxTimer->pxNext != NULL )
+	{
+		pxTimer->pxNext->ppxPrevNext = pxTimer->ppxPrevNext;
+	}
+	else if( ppxExpiredTail == &( pxTimer->pxNext ) )
+	{
+		/* Last timer of the pending batch. */
+		ppxExpiredTail = pxTimer->ppxPrevNext;
+	}
+
+	pxTimer->ppxPrevNext = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvClearSlotIfEmpty( UBaseType_t uxLevel, UBaseType_t uxSlot )
+{
+	if( pxSlots[ uxLevel ][ uxSlot ] == NULL )
+	{
+		ullOccupied[ uxLevel ] &= ~( ( uint64_t ) 1U << uxSlot );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvInsert( TimerWheelTimer_t *pxTimer )
+{
+TickType_t xDelta = pxTimer->xExpiry - xWheelTick;
+TickType_t xFileAt = pxTimer->xExpiry;
+UBaseType_t uxLevel = 0;
+UBaseType_t uxSlot;
+TimerWheelTimer_t **ppxHead;
+
+	if( ( xDelta == 0U ) || ( xDelta > timerwheelMAX_DELAY ) )
+	{
+		/* The tick has already been processed, run it at the next one. */
+		pxTimer->xExpiry = xWheelTick + 1U;
+		xFileAt = pxTimer->xExpiry;
+		xDelta = 1U;
+	}
+	else if( xDelta >= timerwheelRANGE )
+	{
+		/* Beyond the top level, park it as far as possible. */
+		xFileAt = xWheelTick + timerwheelRANGE - 1U;
+		xDelta = timerwheelRANGE - 1U;
+	}
+
+	while( xDelta >= ( ( TickType_t ) 1 << ( timerwheelSLOT_BITS * ( uxLevel + 1U ) ) ) )
+	{
+		uxLevel++;
+	}
+
+	uxSlot = ( UBaseType_t ) ( ( xFileAt >> ( timerwheelSLOT_BITS * uxLevel ) ) & timerwheelSLOT_MASK );
+	ppxHead = &( pxSlots[ uxLevel ][ uxSlot ] );
+
+	pxTimer->pxNext = *ppxHead;
+	pxTimer->ppxPrevNext = ppxHead;
+	if( *ppxHead != NULL )
+	{
+		( *ppxHead )->ppxPrevNext = &( pxTimer->pxNext );
+	}
+	*ppxHead = pxTimer;
+
+	ullOccupied[ uxLevel ] |= ( uint64_t ) 1U << uxSlot;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRemove( TimerWheelTimer_t *pxTimer )
+{
+UBaseType_t uxLevel;
+UBaseType_t uxSlot;
+TimerWheelTimer_t **ppxPrevNext = pxTimer->ppxPrevNext;
+
+	prvUnlink( pxTimer );
+
+	/* If the timer was the head of a slot, clear the slot bit when it
+	becomes empty.  Timers in the pending batch are not in any slot. */
+	for( uxLevel = 0; uxLevel < timerwheelLEVELS; uxLevel++ )
+	{
+		if( ( ppxPrevNext >= &( pxSlots[ uxLevel ][ 0 ] ) ) && ( ppxPrevNext < &( pxSlots[ uxLevel ][ timerwheelSLOTS ] ) ) )
+		{
+			uxSlot = ( UBaseType_t ) ( ppxPrevNext - &( pxSlots[ uxLevel ][ 0 ] ) );
+			prvClearSlotIfEmpty( uxLevel, uxSlot );
+			break;
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvAppendExpired( TimerWheelTimer_t *pxTimer )
+{
+	pxTimer->pxNext = NULL;
+	pxTimer->ppxPrevNext = ppxExpiredTail;
+	*ppxExpiredTail = pxTimer;
+	ppxExpiredTail = &( pxTimer->pxNext );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCascade( UBaseType_t uxLevel, UBaseType_t uxSlot )
+{
+TimerWheelTimer_t *pxTimer;
+
+	while( ( pxTimer = pxSlots[ uxLevel ][ uxSlot ] ) != NULL )
+	{
+		prvUnlink( pxTimer );
+
+		if( pxTimer->xExpiry == xWheelTick )
+		{
+			/* Due on the boundary tick being processed. */
+			prvAppendExpired( pxTimer );
+		}
+		else
+		{
+			prvInsert( pxTimer );
+		}
+
+		xStats.ulCascaded++;
+	}
+
+	prvClearSlotIfEmpty( uxLevel, uxSlot );
+}
+/*-----------------------------------------------------------*/
+
+/* Processes one tick: moves the timers due soon down one level at the 64 tick
+boundaries, then queues the timers of the level 0 slot for their callback. */
+static void prvProcessTick( void )
+{
+UBaseType_t uxLevel;
+UBaseType_t uxSlot;
+TimerWheelTimer_t *pxTimer;
+
+	xWheelTick++;
+
+	if( ( xWheelTick & timerwheelSLOT_MASK ) == 0U )
+	{
+		for( uxLevel = 1; uxLevel < timerwheelLEVELS; uxLevel++ )
+		{
+			uxSlot = ( UBaseType_t ) ( ( xWheelTick >> ( timerwheelSLOT_BITS * uxLevel ) ) & timerwheelSLOT_MASK );
+			prvCascade( uxLevel, uxSlot );
+
+			if( uxSlot != 0U )
+			{
+				break;
+			}
+		}
+	}
+
+	uxSlot = ( UBaseType_t ) ( xWheelTick & timerwheelSLOT_MASK );
+	while( ( pxTimer = pxSlots[ 0 ][ uxSlot ] ) != NULL )
+	{
+		prvUnlink( pxTimer );
+		prvAppendExpired( pxTimer );
+	}
+	prvClearSlotIfEmpty( 0, uxSlot );
+}
+/*-----------------------------------------------------------*/
+
+/* Number of ticks from xWheelTick to the next tick that has work to do, either
+an occupied level 0 slot or a boundary where higher levels cascade.  Returns 0
+when the wheel is empty. */
+static TickType_t prvTicksToNextEvent( void )
+{
+UBaseType_t uxCurrent = ( UBaseType_t ) ( xWheelTick & timerwheelSLOT_MASK );
+uint64_t ullAhead;
+UBaseType_t uxLevel;
+
+	/* Occupied level 0 slots between now and the next boundary.  Shifting
+	2 by 63 gives 0, which correctly selects no slot. */
+	ullAhead = ullOccupied[ 0 ] & ~( ( ( uint64_t ) 2U << uxCurrent ) - 1U );
+	if( ullAhead != 0U )
+	{
+		return ( TickType_t ) ( ( UBaseType_t ) __builtin_ctzll( ullAhead ) - uxCurrent );
+	}
+
+	for( uxLevel = 0; uxLevel < timerwheelLEVELS; uxLevel++ )
+	{
+		if( ullOccupied[ uxLevel ] != 0U )
+		{
+			return ( TickType_t ) ( timerwheelSLOTS - uxCurrent );
+		}
+	}
+
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+/* Brings the wheel up to xNow, skipping the ticks that have nothing to do. */
+static void prvAdvance( TickType_t xNow )
+{
+TickType_t xRemaining;
+TickType_t xStep;
+
+	while( ( xRemaining = xNow - xWheelTick ) != 0U )
+	{
+		xStep = prvTicksToNextEvent();
+
+		if( ( xStep == 0U ) || ( xStep > xRemaining ) )
+		{
+			/* Nothing to do before xNow. */
+			xWheelTick = xNow;
+			break;
+		}
+
+		xWheelTick += xStep - 1U;
+		prvProcessTick();
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* Called with interrupts masked.  Returns pdTRUE if the service task has to
+be woken up to honour the new expiry time. */
+static BaseType_t prvStart( TimerWheelTimer_t *pxTimer, TickType_t xDelay, TickType_t xPeriod, TickType_t xNow )
+{
+	if( pxTimer->ppxPrevNext != NULL )
+	{
+		prvRemove( pxTimer );
+	}
+
+	pxTimer->xExpiry = xNow + xDelay;
+	pxTimer->xPeriod = xPeriod;
+	prvInsert( pxTimer );
+
+	return ( xServiceWaitsForever != pdFALSE ) ||
+		   ( ( pxTimer->xExpiry - xWheelTick ) < ( xServiceWake - xWheelTick ) );
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelInit( void )
+{
+	configASSERT( xServiceTask == NULL );
+
+	xWheelTick = xTaskGetTickCount();
+
+	xTaskCreate( prvTimerWheelTask, "TmrWheel", configTIMER_WHEEL_TASK_STACK_DEPTH, NULL, configTIMER_WHEEL_TASK_PRIORITY, &xServiceTask );
+	configASSERT( xServiceTask != NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelTimerInit( TimerWheelTimer_t *pxTimer, TimerWheelCallback_t pxCallback, void *pvContext )
+{
+	pxTimer->pxNext = NULL;
+	pxTimer->ppxPrevNext = NULL;
+	pxTimer->xExpiry = 0;
+	pxTimer->xPeriod = 0;
+	pxTimer->pxCallback = pxCallback;
+	pxTimer->pvContext = pvContext;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelStart( TimerWheelTimer_t *pxTimer, TickType_t xDelay, TickType_t xPeriod )
+{
+BaseType_t xWake;
+
+	taskENTER_CRITICAL();
+	{
+		xWake = prvStart( pxTimer, xDelay, xPeriod, xTaskGetTickCount() );
+	}
+	taskEXIT_CRITICAL();
+
+	if( xWake != pdFALSE )
+	{
+		xTaskNotifyGive( xServiceTask );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelStartFromISR( TimerWheelTimer_t *pxTimer, TickType_t xDelay, TickType_t xPeriod, BaseType_t *pxHigherPriorityTaskWoken )
+{
+BaseType_t xWake;
+UBaseType_t uxSavedInterruptStatus;
+
+	uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+	{
+		xWake = prvStart( pxTimer, xDelay, xPeriod, xTaskGetTickCountFromISR() );
+	}
+	taskEXIT_CRITICAL_FROM_ISR( uxSavedInterruptStatus );
+
+	if( xWake != pdFALSE )
+	{
+		vTaskNotifyGiveFromISR( xServiceTask, pxHigherPriorityTaskWoken );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelStop( TimerWheelTimer_t *pxTimer )
+{
+	taskENTER_CRITICAL();
+	{
+		if( pxTimer->ppxPrevNext != NULL )
+		{
+			prvRemove( pxTimer );
+		}
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelStopFromISR( TimerWheelTimer_t *pxTimer )
+{
+UBaseType_t uxSavedInterruptStatus;
+
+	uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+	{
+		if( pxTimer->ppxPrevNext != NULL )
+		{
+			prvRemove( pxTimer );
+		}
+	}
+	taskEXIT_CRITICAL_FROM_ISR( uxSavedInterruptStatus );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xTimerWheelIsActive( const TimerWheelTimer_t *pxTimer )
+{
+	return ( pxTimer->ppxPrevNext != NULL ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelGetStats( TimerWheelStats_t *pxStats )
+{
+	taskENTER_CRITICAL();
+	{
+		*pxStats = xStats;
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/* Runs the callbacks of the pending batch.  Each timer is taken off the batch
+in its own short critical section so that callbacks can start and stop timers,
+and interrupts are not masked for the whole batch. */
+static void prvRunExpired( void )
+{
+TimerWheelTimer_t *pxTimer;
+TimerWheelCallback_t pxCallback;
+uint32_t ulCount = 0;
+
+	for( ;; )
+	{
+		taskENTER_CRITICAL();
+		{
+			pxTimer = pxExpired;
+			if( pxTimer != NULL )
+			{
+				prvUnlink( pxTimer );
+
+				if( pxTimer->xPeriod != 0U )
+				{
+					/* Re-arm from the previous expiry so that periodic
+					timers do not drift. */
+					pxTimer->xExpiry += pxTimer->xPeriod;
+					prvInsert( pxTimer );
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		if( pxTimer == NULL )
+		{
+			break;
+		}
+
+		pxCallback = pxTimer->pxCallback;
+		pxCallback( pxTimer );
+		ulCount++;
+	}
+
+	if( ulCount != 0U )
+	{
+		xStats.ulExpired += ulCount;
+		xStats.ulBatches++;
+		if( ulCount > xStats.ulMaxBatch )
+		{
+			xStats.ulMaxBatch = ulCount;
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTimerWheelTask( void *pvParameters )
+{
+TickType_t xWait;
+
+	/* Remove compiler warning about unused parameter. */
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+	#if( configUSE_BENCHMARKS == 1 )
+		uint64_t ullStart = ullTimestampCycles();
+	#endif
+
+		taskENTER_CRITICAL();
+		{
+			prvAdvance( xTaskGetTickCount() );
+		}
+		taskEXIT_CRITICAL();
+
+		prvRunExpired();
+
+		taskENTER_CRITICAL();
+		{
+			/* Callbacks may have taken a while, catch up before deciding
+			how long to sleep. */
+			prvAdvance( xTaskGetTickCount() );
+
+			if( pxExpired != NULL )
+			{
+				xWait = 0;
+			}
+			else
+			{
+				xWait = prvTicksToNextEvent();
+				if( xWait == 0U )
+				{
+					xWait = portMAX_DELAY;
+				}
+			}
+
+			xServiceWaitsForever = ( xWait == portMAX_DELAY ) ? pdTRUE : pdFALSE;
+			xServiceWake = xWheelTick + xWait;
+		}
+		taskEXIT_CRITICAL();
+
+	#if( configUSE_BENCHMARKS == 1 )
+		ullServiceCycles += ullTimestampCycles() - ullStart;
+	#endif
+
+		if( xWait != 0U )
+		{
+			ulTaskNotifyTake( pdTRUE, xWait );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+#define timerwheelBENCH_MAX_TIMERS		( 1000 )
+
+static TimerWheelTimer_t xBenchTimers[ timerwheelBENCH_MAX_TIMERS ];
+static volatile uint32_t ulBenchFired;
+
+#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+	static StaticTimer_t xBenchOsTimerBuffers[ timerwheelBENCH_MAX_TIMERS ];
+	static TimerHandle_t xBenchOsTimers[ timerwheelBENCH_MAX_TIMERS ];
+#endif
+
+static void prvBenchCallback( TimerWheelTimer_t *pxTimer )
+{
+	( void ) pxTimer;
+	ulBenchFired++;
+}
+
+#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+	static void prvBenchOsCallback( TimerHandle_t xTimer )
+	{
+		( void ) xTimer;
+	}
+#endif
+
+/* Spreads the timers over the future so that the sorted list of the kernel
+timers is exercised, and far enough that none expires while measuring. */
+static TickType_t prvBenchDelay( uint32_t ulIndex, uint32_t ulCount )
+{
+	return pdMS_TO_TICKS( 1000 ) + ( TickType_t ) ( ( ulIndex * 7919U ) % ( ulCount * 4U ) );
+}
+
+void vTimerWheelBenchmark( void )
+{
+static const uint32_t ulSizes[] = { 10, 100, 1000 };
+uint32_t ulSize;
+uint32_t ulIndex;
+uint32_t ulCount;
+uint64_t ullStart;
+uint64_t ullServiceStart;
+
+	for( ulSize = 0; ulSize < ( sizeof( ulSizes ) / sizeof( ulSizes[ 0 ] ) ); ulSize++ )
+	{
+		ulCount = ulSizes[ ulSize ];
+
+		for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+		{
+			vTimerWheelTimerInit( &xBenchTimers[ ulIndex ], prvBenchCallback, NULL );
+		}
+
+		ullStart = ullTimestampCycles();
+		for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+		{
+			vTimerWheelStart( &xBenchTimers[ ulIndex ], prvBenchDelay( ulIndex, ulCount ), 0 );
+		}
+		vBenchReport( "timer_wheel.start", ulCount, ullTimestampCycles() - ullStart, ulCount );
+
+		ullStart = ullTimestampCycles();
+		for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+		{
+			vTimerWheelStop( &xBenchTimers[ ulIndex ] );
+		}
+		vBenchReport( "timer_wheel.stop", ulCount, ullTimestampCycles() - ullStart, ulCount );
+
+		/* Expiry cost: all the timers fire within 64 ticks, the service task
+		time is accounted in ullServiceCycles. */
+		ulBenchFired = 0;
+		ullServiceStart = ullServiceCycles;
+		for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+		{
+			vTimerWheelStart( &xBenchTimers[ ulIndex ], 1U + ( ulIndex % 64U ), 0 );
+		}
+		while( ulBenchFired != ulCount )
+		{
+			vTaskDelay( 1 );
+		}
+		vBenchReport( "timer_wheel.expire", ulCount, ullServiceCycles - ullServiceStart, ulCount );
+
+	#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+		/* Same start and stop sequence on the kernel software timers. */
+		for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+		{
+			xBenchOsTimers[ ulIndex ] = xTimerCreateStatic( "Bench", prvBenchDelay( ulIndex, ulCount ), pdFALSE, NULL, prvBenchOsCallback, &xBenchOsTimerBuffers[ ulIndex ] );
+		}
+
+		ullStart = ullTimestampCycles();
+		for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+		{
+			xTimerStart( xBenchOsTimers[ ulIndex ], portMAX_DELAY );
+		}
+		vBenchReport( "os_timer.start", ulCount, ullTimestampCycles() - ullStart, ulCount );
+
+		ullStart = ullTimestampCycles();
+		for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+		{
+			xTimerStop( xBenchOsTimers[ ulIndex ], portMAX_DELAY );
+		}
+		vBenchReport( "os_timer.stop", ulCount, ullTimestampCycles() - ullStart, ulCount );
+	#endif
+	}
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_TIMER_WHEEL */
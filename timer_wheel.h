@@ -0,0 +1,92 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/*
+ * Hierarchical timer wheel.
+ *
+ * The kernel software timers keep the active timers in a sorted list, so
+ * starting a timer costs O(n) in the number of active timers and every start
+ * or stop goes through the timer command queue.  This module is an optional
+ * alternative for applications that run hundreds of timeouts:
+ *
+ *  - Start and stop are O(1) and are done directly by the caller inside a
+ *    short critical section (no command queue).
+ *  - The wheel has timerwheelLEVELS levels of 64 slots.  A timer is filed in
+ *    the lowest level that covers its delay and is moved down one level at a
+ *    time as its expiry gets closer, so each timer is touched at most once
+ *    per level.
+ *  - One service task sleeps until the next occupied slot.  When it wakes it
+ *    collects every timer that expired since the last run into one batch and
+ *    runs their callbacks back to back, re-arming the periodic ones.
+ *
+ * Timers are allocated by the caller (statically or as part of a bigger
+ * object), the wheel never allocates memory after vTimerWheelInit().
+ *
+ * Callbacks run in the service task, at configTIMER_WHEEL_TASK_PRIORITY, and
+ * must not block.  They may start or stop any timer, including their own.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if( configUSE_TIMER_WHEEL == 1 )
+
+typedef struct xTIMER_WHEEL_TIMER TimerWheelTimer_t;
+
+typedef void ( *TimerWheelCallback_t )( TimerWheelTimer_t *pxTimer );
+
+/* The members are private to timer_wheel.c, they are only visible so that
+timers can be allocated statically. */
+struct xTIMER_WHEEL_TIMER
+{
+	TimerWheelTimer_t *pxNext;
+	TimerWheelTimer_t **ppxPrevNext;	/* NULL when the timer is not active. */
+	TickType_t xExpiry;
+	TickType_t xPeriod;					/* 0 for a one-shot timer. */
+	TimerWheelCallback_t pxCallback;
+	void *pvContext;
+};
+
+typedef struct xTIMER_WHEEL_STATS
+{
+	uint32_t ulExpired;		/* Callbacks run. */
+	uint32_t ulBatches;		/* Service task wake ups that ran callbacks. */
+	uint32_t ulMaxBatch;	/* Largest number of callbacks run in one wake up. */
+	uint32_t ulCascaded;	/* Timers moved down one level. */
+} TimerWheelStats_t;
+
+/* Creates the service task.  Call once, before any other function of this
+module. */
+void vTimerWheelInit( void );
+
+/* Prepares a timer.  pvContext is handed back through pvTimerWheelGetContext(). */
+void vTimerWheelTimerInit( TimerWheelTimer_t *pxTimer, TimerWheelCallback_t pxCallback, void *pvContext );
+
+/* Starts, or restarts, a timer that expires xDelay ticks from now and then
+every xPeriod ticks.  Use an xPeriod of 0 for a one-shot timer. */
+void vTimerWheelStart( TimerWheelTimer_t *pxTimer, TickType_t xDelay, TickType_t xPeriod );
+void vTimerWheelStartFromISR( TimerWheelTimer_t *pxTimer, TickType_t xDelay, TickType_t xPeriod, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* Stops a timer.  Stopping an inactive timer has no effect. */
+void vTimerWheelStop( TimerWheelTimer_t *pxTimer );
+void vTimerWheelStopFromISR( TimerWheelTimer_t *pxTimer );
+
+BaseType_t xTimerWheelIsActive( const TimerWheelTimer_t *pxTimer );
+
+static inline void *pvTimerWheelGetContext( const TimerWheelTimer_t *pxTimer )
+{
+	return pxTimer->pvContext;
+}
+
+void vTimerWheelGetStats( TimerWheelStats_t *pxStats );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vTimerWheelBenchmark( void );
+#endif
+
+#endif /* configUSE_TIMER_WHEEL */
+
+#endif /* TIMER_WHEEL_H */
@@ -0,0 +1,66 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+/*
+ * Raw time sources used by the benchmarks and the instrumentation.
+ *
+ * ullTimestampCycles() reads mcycle.  It has the best resolution but it is
+ * private to the hart that reads it, so only compare values taken on the
+ * same hart.
+ *
+ * ullTimestampTime() reads the CLINT mtime register.  It is shared by all
+ * harts and ticks at MTIME_RATE_HZ, so use it for anything measured across
+ * harts.
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#ifndef configCLINT_BASE_ADDRESS
+	#error No CLINT Base Address defined
+#endif
+
+static inline uint64_t ullTimestampCycles( void )
+{
+#if (__riscv_xlen == 64)
+	uint64_t ullCycles;
+
+	__asm__ __volatile__ ("csrr %0, mcycle" : "=r"(ullCycles));
+
+	return ullCycles;
+#elif (__riscv_xlen == 32)
+	uint32_t lo, hi, hi2;
+
+	/* Guard against rollover when reading */
+	do {
+		__asm__ __volatile__ ("csrr %0, mcycleh" : "=r"(hi));
+		__asm__ __volatile__ ("csrr %0, mcycle" : "=r"(lo));
+		__asm__ __volatile__ ("csrr %0, mcycleh" : "=r"(hi2));
+	} while (hi != hi2);
+
+	return ( ( uint64_t ) hi << 32 ) | lo;
+#endif
+}
+
+static inline uint64_t ullTimestampTime( void )
+{
+#if (__riscv_xlen == 64)
+	return *(( volatile uint64_t * ) ( configCLINT_BASE_ADDRESS + 0xBFF8) );
+#elif (__riscv_xlen == 32)
+	uint32_t lo, hi;
+
+	/* Guard against rollover when reading */
+	do {
+		hi = *(( volatile uint32_t * ) ( configCLINT_BASE_ADDRESS + 0xBFFC) );
+		lo = *(( volatile uint32_t * ) ( configCLINT_BASE_ADDRESS + 0xBFF8) );
+	} while ( *(( volatile uint32_t * ) ( configCLINT_BASE_ADDRESS + 0xBFFC)) != hi);
+
+	return ( ( uint64_t ) hi << 32 ) | lo;
+#endif
+}
+
+#endif /* TIMESTAMP_H */
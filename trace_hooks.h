@@ -0,0 +1,161 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef TRACE_HOOKS_H
+#define TRACE_HOOKS_H
+
+/*
+ * Kernel trace macros used by the application modules.
+ *
+ * Included at the end of FreeRTOSConfig.h, so it is seen by the kernel
+ * sources.  Each module that needs a trace point defines its own
+ * tracehook<MODULE>_<POINT>() macro, empty when the module is disabled, and
+ * the trace macro of the kernel calls all of them in turn.
+ */
+
+#if( configUSE_CRITICAL_PROFILER == 1 )
+	void vCriticalProfilerSwitchedOut( void );
+	#define tracehookCRITICAL_SWITCHED_OUT()	vCriticalProfilerSwitchedOut()
+#else
+	#define tracehookCRITICAL_SWITCHED_OUT()
+#endif
+
+#if( configUSE_TASK_BUDGET == 1 )
+	void vTaskBudgetSwitchedIn( void );
+	void vTaskBudgetSwitchedOut( void );
+	#define tracehookBUDGET_SWITCHED_IN()		vTaskBudgetSwitchedIn()
+	#define tracehookBUDGET_SWITCHED_OUT()		vTaskBudgetSwitchedOut()
+#else
+	#define tracehookBUDGET_SWITCHED_IN()
+	#define tracehookBUDGET_SWITCHED_OUT()
+#endif
+
+#if( configUSE_VECTOR_KERNELS == 1 )
+	void vVecKernelsSwitchedIn( void );
+	#define tracehookVECTOR_SWITCHED_IN()		vVecKernelsSwitchedIn()
+#else
+	#define tracehookVECTOR_SWITCHED_IN()
+#endif
+
+#if( configUSE_PREEMPT_THRESHOLD == 1 )
+	void vPreemptThresholdBlocking( void );
+	void vPreemptThresholdReady( const void *pvTask, unsigned long ulPriority );
+	#define tracehookTHRESHOLD_BLOCKING()		vPreemptThresholdBlocking()
+	#define tracehookTHRESHOLD_READY( pxTCB )	vPreemptThresholdReady( ( pxTCB ), ( pxTCB )->uxPriority )
+#else
+	#define tracehookTHRESHOLD_BLOCKING()
+	#define tracehookTHRESHOLD_READY( pxTCB )
+#endif
+
+/* Expanded in queue.c, where pxQueue is a Queue_t. */
+#if( configUSE_QUEUE_MONITOR == 1 )
+	unsigned long uxQueueMonitorCreate( void *pvQueue, unsigned long uxLength );
+	void vQueueMonitorDelete( unsigned long uxNumber );
+	void vQueueMonitorSend( unsigned long uxNumber, unsigned long uxWaiting, unsigned long uxLength );
+	void vQueueMonitorReceive( unsigned long uxNumber, unsigned long uxWaiting );
+	void vQueueMonitorBlocking( unsigned long uxNumber, long xFull );
+	#define tracehookMONITOR_CREATE( pxQueue )		( pxQueue )->uxQueueNumber = uxQueueMonitorCreate( ( pxQueue ), ( pxQueue )->uxLength )
+	#define tracehookMONITOR_DELETE( pxQueue )		vQueueMonitorDelete( ( pxQueue )->uxQueueNumber )
+	#define tracehookMONITOR_SEND( pxQueue )		vQueueMonitorSend( ( pxQueue )->uxQueueNumber, ( pxQueue )->uxMessagesWaiting, ( pxQueue )->uxLength )
+	#define tracehookMONITOR_RECEIVE( pxQueue )		vQueueMonitorReceive( ( pxQueue )->uxQueueNumber, ( pxQueue )->uxMessagesWaiting )
+	#define tracehookMONITOR_BLOCKING( pxQueue, xFull )	vQueueMonitorBlocking( ( pxQueue )->uxQueueNumber, ( xFull ) )
+#else
+	#define tracehookMONITOR_CREATE( pxQueue )
+	#define tracehookMONITOR_DELETE( pxQueue )
+	#define tracehookMONITOR_SEND( pxQueue )
+	#define tracehookMONITOR_RECEIVE( pxQueue )
+	#define tracehookMONITOR_BLOCKING( pxQueue, xFull )
+#endif
+
+/*-----------------------------------------------------------*/
+
+#define traceTASK_SWITCHED_OUT()			\
+	do {									\
+		tracehookCRITICAL_SWITCHED_OUT();	\
+		tracehookBUDGET_SWITCHED_OUT();		\
+	} while( 0 )
+
+#define traceTASK_SWITCHED_IN()				\
+	do {									\
+		tracehookBUDGET_SWITCHED_IN();		\
+		tracehookVECTOR_SWITCHED_IN();		\
+	} while( 0 )
+
+/* Expanded in tasks.c, where pxTCB is a TCB_t. */
+#define traceMOVED_TASK_TO_READY_STATE( pxTCB )	\
+	do {										\
+		tracehookTHRESHOLD_READY( pxTCB );		\
+	} while( 0 )
+
+/* The blocking calls, with the scheduler suspended and before the calling
+task leaves the ready list. */
+#define traceTASK_DELAY()							\
+	do {											\
+		tracehookTHRESHOLD_BLOCKING();				\
+	} while( 0 )
+
+#define traceTASK_DELAY_UNTIL( xTimeToWake )		\
+	do {											\
+		tracehookTHRESHOLD_BLOCKING();				\
+	} while( 0 )
+
+#define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue )	\
+	do {											\
+		tracehookMONITOR_BLOCKING( pxQueue, 0 );	\
+		tracehookTHRESHOLD_BLOCKING();				\
+	} while( 0 )
+
+#define traceBLOCKING_ON_QUEUE_PEEK( pxQueue )		\
+	do {											\
+		tracehookTHRESHOLD_BLOCKING();				\
+	} while( 0 )
+
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue )		\
+	do {											\
+		tracehookMONITOR_BLOCKING( pxQueue, 1 );	\
+		tracehookTHRESHOLD_BLOCKING();				\
+	} while( 0 )
+
+#define traceEVENT_GROUP_WAIT_BITS_BLOCK( xEventGroup, uxBitsToWaitFor )				\
+	do {																				\
+		tracehookTHRESHOLD_BLOCKING();													\
+	} while( 0 )
+
+#define traceEVENT_GROUP_SYNC_BLOCK( xEventGroup, uxBitsToSet, uxBitsToWaitFor )		\
+	do {																				\
+		tracehookTHRESHOLD_BLOCKING();													\
+	} while( 0 )
+
+/* The queue operations, in the critical sections of the kernel, before it
+updates uxMessagesWaiting. */
+#define traceQUEUE_CREATE( pxNewQueue )				\
+	do {											\
+		tracehookMONITOR_CREATE( pxNewQueue );		\
+	} while( 0 )
+
+#define traceQUEUE_DELETE( pxQueue )				\
+	do {											\
+		tracehookMONITOR_DELETE( pxQueue );			\
+	} while( 0 )
+
+#define traceQUEUE_SEND( pxQueue )					\
+	do {											\
+		tracehookMONITOR_SEND( pxQueue );			\
+	} while( 0 )
+
+#define traceQUEUE_SEND_FROM_ISR( pxQueue )			\
+	do {											\
+		tracehookMONITOR_SEND( pxQueue );			\
+	} while( 0 )
+
+#define traceQUEUE_RECEIVE( pxQueue )				\
+	do {											\
+		tracehookMONITOR_RECEIVE( pxQueue );		\
+	} while( 0 )
+
+#define traceQUEUE_RECEIVE_FROM_ISR( pxQueue )		\
+	do {											\
+		tracehookMONITOR_RECEIVE( pxQueue );		\
+	} while( 0 )
+
+#endif /* TRACE_HOOKS_H */
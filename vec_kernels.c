@@ -0,0 +1,690 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "vec_kernels.h"
+#include "block_ops.h"
+#include "cache_layout.h"
+
+#if( configUSE_VECTOR_KERNELS == 1 )
+
+#if( configNUM_THREAD_LOCAL_STORAGE_POINTERS <= configVECTOR_TLS_INDEX )
+	#error configNUM_THREAD_LOCAL_STORAGE_POINTERS must include configVECTOR_TLS_INDEX
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+/* 'V' in misa, and the VS field of mstatus (Initial to turn the unit on). */
+#define veckernelsMISA_V			( 1UL << 21 )
+#define veckernelsMSTATUS_VS		( 3UL << 9 )
+#define veckernelsMSTATUS_VS_INITIAL	( 1UL << 9 )
+
+/* The widening byte sum adds at most this many bytes into 16 bits. */
+#define veckernelsSUM_STRIP			( 256U )
+
+static BaseType_t xAvailable = pdFALSE;
+
+/* The context whose registers are in the vector unit. */
+static VecContext_t *pxOwner = NULL;
+
+/*-----------------------------------------------------------*/
+
+static void prvMemcpyScalar( uint8_t *pucDestination, const uint8_t *pucSource, size_t xLength )
+{
+	memcpy( pucDestination, pucSource, xLength );
+}
+
+static uint32_t prvChecksumScalar( const uint8_t *pucData, size_t xLength )
+{
+uint32_t ulSum = 0;
+
+	while( xLength-- > 0U )
+	{
+		ulSum += *pucData++;
+	}
+
+	return ulSum;
+}
+
+static void prvMinMaxScalar( const int32_t *plValues, size_t xCount, int32_t *plMin, int32_t *plMax )
+{
+int32_t lMin = INT32_MAX;
+int32_t lMax = INT32_MIN;
+
+	while( xCount-- > 0U )
+	{
+		if( *plValues < lMin )
+		{
+			lMin = *plValues;
+		}
+
+		if( *plValues > lMax )
+		{
+			lMax = *plValues;
+		}
+
+		plValues++;
+	}
+
+	*plMin = lMin;
+	*plMax = lMax;
+}
+
+/* Rounds to nearest, ties up, and saturates, as vnclip with vxrm = 0. */
+static void prvFirQ15Scalar( const int16_t *psInput, int16_t *psOutput, size_t xOutputs, const int16_t *psTaps, size_t xTaps )
+{
+size_t xOutput, xTap;
+int32_t lAccumulator;
+
+	for( xOutput = 0; xOutput < xOutputs; xOutput++ )
+	{
+		lAccumulator = 0;
+
+		for( xTap = 0; xTap < xTaps; xTap++ )
+		{
+			lAccumulator += ( int32_t ) psTaps[ xTap ] * psInput[ xOutput + xTap ];
+		}
+
+		lAccumulator = ( int32_t ) ( ( ( int64_t ) lAccumulator + ( 1L << 14 ) ) >> 15 );
+
+		if( lAccumulator > INT16_MAX )
+		{
+			lAccumulator = INT16_MAX;
+		}
+		else if( lAccumulator < INT16_MIN )
+		{
+			lAccumulator = INT16_MIN;
+		}
+
+		psOutput[ xOutput ] = ( int16_t ) lAccumulator;
+	}
+}
+/*-----------------------------------------------------------*/
+
+#if defined( __riscv_vector )
+
+/* Strip-mined over LMUL = 8 register groups.  Each asm statement sets vl and
+vtype itself, and the compiler keeps nothing in the vector registers across
+them. */
+
+static void prvMemcpyVector( uint8_t *pucDestination, const uint8_t *pucSource, size_t xLength )
+{
+size_t xVl;
+
+	__asm__ volatile(
+		"1:\n"
+		"	vsetvli %[vl], %[n], e8, m8, ta, ma\n"
+		"	vle8.v v0, (%[s])\n"
+		"	vse8.v v0, (%[d])\n"
+		"	add %[s], %[s], %[vl]\n"
+		"	add %[d], %[d], %[vl]\n"
+		"	sub %[n], %[n], %[vl]\n"
+		"	bnez %[n], 1b\n"
+		: [d] "+r"( pucDestination ), [s] "+r"( pucSource ), [n] "+r"( xLength ), [vl] "=&r"( xVl )
+		:
+		: "memory", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7" );
+}
+
+/* vwredsumu adds the bytes of a strip into 16 bits, zero extended before
+they go to the 32 bit sum. */
+static uint32_t prvChecksumVector( const uint8_t *pucData, size_t xLength )
+{
+size_t xSum = 0, xVl, xAvl, xPart, xMask, xStrip;
+
+	__asm__ volatile(
+		"	vsetivli zero, 1, e16, m1, ta, ma\n"
+		"	vmv.s.x v24, zero\n"
+		"	li %[mask], 0xFFFF\n"
+		"	li %[strip], %[max]\n"
+		"1:\n"
+		"	mv %[avl], %[n]\n"
+		"	bleu %[avl], %[strip], 2f\n"
+		"	mv %[avl], %[strip]\n"
+		"2:\n"
+		"	vsetvli %[vl], %[avl], e8, m8, ta, ma\n"
+		"	vle8.v v0, (%[p])\n"
+		"	vwredsumu.vs v16, v0, v24\n"
+		"	vsetivli zero, 1, e16, m1, ta, ma\n"
+		"	vmv.x.s %[part], v16\n"
+		"	and %[part], %[part], %[mask]\n"
+		"	add %[sum], %[sum], %[part]\n"
+		"	add %[p], %[p], %[vl]\n"
+		"	sub %[n], %[n], %[vl]\n"
+		"	bnez %[n], 1b\n"
+		: [p] "+r"( pucData ), [n] "+r"( xLength ), [sum] "+r"( xSum ), [vl] "=&r"( xVl ), [avl] "=&r"( xAvl ),
+		  [part] "=&r"( xPart ), [mask] "=&r"( xMask ), [strip] "=&r"( xStrip )
+		: [max] "i"( veckernelsSUM_STRIP )
+		: "memory", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v16", "v24" );
+
+	return ( uint32_t ) xSum;
+}
+
+static void prvMinMaxVector( const int32_t *plValues, size_t xCount, int32_t *plMin, int32_t *plMax )
+{
+long lMin = INT32_MAX, lMax = INT32_MIN;
+size_t xVl, xBytes;
+
+	__asm__ volatile(
+		"	vsetivli zero, 1, e32, m1, ta, ma\n"
+		"	vmv.s.x v16, %[min]\n"
+		"	vmv.s.x v24, %[max]\n"
+		"1:\n"
+		"	vsetvli %[vl], %[n], e32, m8, ta, ma\n"
+		"	vle32.v v0, (%[p])\n"
+		"	vredmin.vs v16, v0, v16\n"
+		"	vredmax.vs v24, v0, v24\n"
+		"	slli %[bytes], %[vl], 2\n"
+		"	add %[p], %[p], %[bytes]\n"
+		"	sub %[n], %[n], %[vl]\n"
+		"	bnez %[n], 1b\n"
+		"	vmv.x.s %[min], v16\n"
+		"	vmv.x.s %[max], v24\n"
+		: [p] "+r"( plValues ), [n] "+r"( xCount ), [min] "+r"( lMin ), [max] "+r"( lMax ), [vl] "=&r"( xVl ), [bytes] "=&r"( xBytes )
+		:
+		: "memory", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v16", "v24" );
+
+	*plMin = ( int32_t ) lMin;
+	*plMax = ( int32_t ) lMax;
+}
+
+/* vl outputs at a time: the first tap is a widening multiply into the 32 bit
+accumulators, the others widening multiply-adds of the input shifted by one
+sample, then vnclip rounds (vxrm = 0) and saturates back to 16 bits. */
+static void prvFirQ15Vector( const int16_t *psInput, int16_t *psOutput, size_t xOutputs, const int16_t *psTaps, size_t xTaps )
+{
+size_t xVl, xBytes, xLeft;
+const int16_t *psSample, *psTap;
+long lTap;
+
+	__asm__ volatile(
+		"	csrwi vxrm, 0\n"
+		"1:\n"
+		"	vsetvli %[vl], %[n], e16, m4, ta, ma\n"
+		"	mv %[x], %[in]\n"
+		"	mv %[h], %[taps]\n"
+		"	addi %[left], %[ntaps], -1\n"
+		"	lh %[tap], 0(%[h])\n"
+		"	vle16.v v0, (%[x])\n"
+		"	vwmul.vx v8, v0, %[tap]\n"
+		"	beqz %[left], 3f\n"
+		"2:\n"
+		"	addi %[x], %[x], 2\n"
+		"	addi %[h], %[h], 2\n"
+		"	lh %[tap], 0(%[h])\n"
+		"	vle16.v v0, (%[x])\n"
+		"	vwmacc.vx v8, %[tap], v0\n"
+		"	addi %[left], %[left], -1\n"
+		"	bnez %[left], 2b\n"
+		"3:\n"
+		"	vnclip.wi v0, v8, 15\n"
+		"	vse16.v v0, (%[out])\n"
+		"	slli %[bytes], %[vl], 1\n"
+		"	add %[in], %[in], %[bytes]\n"
+		"	add %[out], %[out], %[bytes]\n"
+		"	sub %[n], %[n], %[vl]\n"
+		"	bnez %[n], 1b\n"
+		: [in] "+r"( psInput ), [out] "+r"( psOutput ), [n] "+r"( xOutputs ), [vl] "=&r"( xVl ), [bytes] "=&r"( xBytes ),
+		  [left] "=&r"( xLeft ), [x] "=&r"( psSample ), [h] "=&r"( psTap ), [tap] "=&r"( lTap )
+		: [taps] "r"( psTaps ), [ntaps] "r"( xTaps )
+		: "memory", "v0", "v1", "v2", "v3", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15" );
+}
+/*-----------------------------------------------------------*/
+
+/* v0 to v31 in four groups of eight, then the state of the unit.  vstart is
+read first and cleared, as it applies to the stores. */
+static void prvSaveContext( VecContext_t *pxContext )
+{
+uint8_t *pucRegisters = pxContext->ucRegisters;
+size_t xGroupSize;
+
+	__asm__ volatile( "csrr %0, vstart" : "=r"( pxContext->uxVstart ) );
+	__asm__ volatile( "csrr %0, vl" : "=r"( pxContext->uxVl ) );
+	__asm__ volatile( "csrr %0, vtype" : "=r"( pxContext->uxVtype ) );
+	__asm__ volatile( "csrr %0, vcsr" : "=r"( pxContext->uxVcsr ) );
+
+	__asm__ volatile(
+		"	csrw vstart, zero\n"
+		"	vsetvli %[size], zero, e8, m8, ta, ma\n"
+		"	vse8.v v0, (%[p])\n"
+		"	add %[p], %[p], %[size]\n"
+		"	vse8.v v8, (%[p])\n"
+		"	add %[p], %[p], %[size]\n"
+		"	vse8.v v16, (%[p])\n"
+		"	add %[p], %[p], %[size]\n"
+		"	vse8.v v24, (%[p])\n"
+		: [p] "+r"( pucRegisters ), [size] "=&r"( xGroupSize )
+		:
+		: "memory" );
+}
+
+static void prvRestoreContext( const VecContext_t *pxContext )
+{
+const uint8_t *pucRegisters = pxContext->ucRegisters;
+size_t xGroupSize;
+
+	__asm__ volatile(
+		"	vsetvli %[size], zero, e8, m8, ta, ma\n"
+		"	vle8.v v0, (%[p])\n"
+		"	add %[p], %[p], %[size]\n"
+		"	vle8.v v8, (%[p])\n"
+		"	add %[p], %[p], %[size]\n"
+		"	vle8.v v16, (%[p])\n"
+		"	add %[p], %[p], %[size]\n"
+		"	vle8.v v24, (%[p])\n"
+		: [p] "+r"( pucRegisters ), [size] "=&r"( xGroupSize )
+		:
+		: "memory", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
+		  "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+		  "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23",
+		  "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31" );
+
+	/* vsetvl gives back the same vl, being at most VLMAX of vtype. */
+	__asm__ volatile( "vsetvl zero, %0, %1" : : "r"( pxContext->uxVl ), "r"( pxContext->uxVtype ) );
+	__asm__ volatile( "csrw vcsr, %0" : : "r"( pxContext->uxVcsr ) );
+	__asm__ volatile( "csrw vstart, %0" : : "r"( pxContext->uxVstart ) );
+}
+
+static void prvUnitOn( void )
+{
+	__asm__ volatile( "csrs mstatus, %0" : : "r"( veckernelsMSTATUS_VS_INITIAL ) );
+}
+
+static void prvUnitOff( void )
+{
+	__asm__ volatile( "csrc mstatus, %0" : : "r"( veckernelsMSTATUS_VS ) );
+}
+
+#endif /* __riscv_vector */
+/*-----------------------------------------------------------*/
+
+void vVecKernelsInit( void )
+{
+	vBlockOpsCrc32Init();
+
+	#if defined( __riscv_vector )
+	{
+	UBaseType_t uxMisa, uxVlenb;
+
+		/* misa may read as 0, then V is not assumed. */
+		__asm__ volatile( "csrr %0, misa" : "=r"( uxMisa ) );
+
+		if( ( uxMisa & veckernelsMISA_V ) != 0U )
+		{
+			/* vlenb is only readable with the unit on. */
+			prvUnitOn();
+			__asm__ volatile( "csrr %0, vlenb" : "=r"( uxVlenb ) );
+			prvUnitOff();
+
+			configASSERT( uxVlenb <= configVECTOR_VLENB_MAX );
+			xAvailable = pdTRUE;
+		}
+	}
+	#endif
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xVecKernelsAvailable( void )
+{
+	return xAvailable;
+}
+/*-----------------------------------------------------------*/
+
+void vVecKernelsTaskEnable( VecContext_t *pxContext )
+{
+	if( xAvailable == pdFALSE )
+	{
+		return;
+	}
+
+	#if defined( __riscv_vector )
+	{
+		taskENTER_CRITICAL();
+		{
+			/* The unit is on from now on for this task alone: mstatus is
+			saved with its context. */
+			prvUnitOn();
+
+			if( pxOwner != NULL )
+			{
+				prvSaveContext( pxOwner );
+			}
+
+			pxOwner = pxContext;
+			vTaskSetThreadLocalStoragePointer( NULL, configVECTOR_TLS_INDEX, pxContext );
+		}
+		taskEXIT_CRITICAL();
+	}
+	#else
+	{
+		( void ) pxContext;
+	}
+	#endif
+}
+/*-----------------------------------------------------------*/
+
+void vVecKernelsTaskDisable( void )
+{
+VecContext_t *pxContext = ( VecContext_t * ) pvTaskGetThreadLocalStoragePointer( NULL, configVECTOR_TLS_INDEX );
+
+	if( pxContext == NULL )
+	{
+		return;
+	}
+
+	#if defined( __riscv_vector )
+	{
+		taskENTER_CRITICAL();
+		{
+			if( pxOwner == pxContext )
+			{
+				pxOwner = NULL;
+			}
+
+			vTaskSetThreadLocalStoragePointer( NULL, configVECTOR_TLS_INDEX, NULL );
+			prvUnitOff();
+		}
+		taskEXIT_CRITICAL();
+	}
+	#endif
+}
+/*-----------------------------------------------------------*/
+
+void vVecKernelsSwitchedIn( void )
+{
+	#if defined( __riscv_vector )
+	{
+	VecContext_t *pxContext = ( VecContext_t * ) pvTaskGetThreadLocalStoragePointer( NULL, configVECTOR_TLS_INDEX );
+
+		if( ( pxContext != NULL ) && ( pxContext != pxOwner ) )
+		{
+			/* In the trap, mstatus is still that of the task switched out,
+			which may have the unit off.  The one of the task switched in is
+			restored on the way out. */
+			prvUnitOn();
+
+			if( pxOwner != NULL )
+			{
+				prvSaveContext( pxOwner );
+			}
+
+			prvRestoreContext( pxContext );
+			pxOwner = pxContext;
+		}
+	}
+	#endif
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvUseVector( void )
+{
+	return ( BaseType_t ) ( ( xAvailable != pdFALSE ) &&
+							( pvTaskGetThreadLocalStoragePointer( NULL, configVECTOR_TLS_INDEX ) != NULL ) );
+}
+/*-----------------------------------------------------------*/
+
+void vVecKernelsMemcpy( void *pvDestination, const void *pvSource, size_t xLength )
+{
+	#if defined( __riscv_vector )
+		if( ( xLength > 0U ) && ( prvUseVector() != pdFALSE ) )
+		{
+			prvMemcpyVector( ( uint8_t * ) pvDestination, ( const uint8_t * ) pvSource, xLength );
+			return;
+		}
+	#endif
+
+	prvMemcpyScalar( ( uint8_t * ) pvDestination, ( const uint8_t * ) pvSource, xLength );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulVecKernelsCrc32( uint32_t ulCrc, const void *pvData, size_t xLength )
+{
+	return ulBlockOpsCrc32Update( ulCrc, pvData, xLength );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulVecKernelsChecksum( const void *pvData, size_t xLength )
+{
+	#if defined( __riscv_vector )
+		if( ( xLength > 0U ) && ( prvUseVector() != pdFALSE ) )
+		{
+			return prvChecksumVector( ( const uint8_t * ) pvData, xLength );
+		}
+	#endif
+
+	return prvChecksumScalar( ( const uint8_t * ) pvData, xLength );
+}
+/*-----------------------------------------------------------*/
+
+void vVecKernelsMinMax( const int32_t *plValues, size_t xCount, int32_t *plMin, int32_t *plMax )
+{
+	configASSERT( xCount > 0U );
+
+	#if defined( __riscv_vector )
+		if( prvUseVector() != pdFALSE )
+		{
+			prvMinMaxVector( plValues, xCount, plMin, plMax );
+			return;
+		}
+	#endif
+
+	prvMinMaxScalar( plValues, xCount, plMin, plMax );
+}
+/*-----------------------------------------------------------*/
+
+void vVecKernelsFirQ15( const int16_t *psInput, int16_t *psOutput, size_t xOutputs, const int16_t *psTaps, size_t xTaps )
+{
+	configASSERT( xTaps > 0U );
+
+	#if defined( __riscv_vector )
+		if( ( xOutputs > 0U ) && ( prvUseVector() != pdFALSE ) )
+		{
+			prvFirQ15Vector( psInput, psOutput, xOutputs, psTaps, xTaps );
+			return;
+		}
+	#endif
+
+	prvFirQ15Scalar( psInput, psOutput, xOutputs, psTaps, xTaps );
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * Each kernel on veckernelsBENCH_MIN to veckernelsBENCH_SIZE bytes of data,
+ * scalar then vector when the unit is there, in cycles per byte (per output
+ * sample for the FIR, of veckernelsBENCH_TAPS taps).  Run on QEMU with
+ * -cpu rv64,v=true for the vector side: a build without V, or a core without
+ * it, only reports the scalar one.  CRC-32 has the scalar loop only.
+ */
+#define veckernelsBENCH_MIN			( 256U )
+#define veckernelsBENCH_SIZE		( 4096U )
+#define veckernelsBENCH_TAPS		( 16U )
+
+/* Offset and shortening of the checked copies and filters, so that they
+start unaligned and end on a partial strip. */
+#define veckernelsBENCH_ODD			( 3U )
+
+typedef enum
+{
+	veckernelsBENCH_MEMCPY,
+	veckernelsBENCH_MINMAX,
+	veckernelsBENCH_CHECKSUM,
+	veckernelsBENCH_FIR_Q15,
+	veckernelsBENCH_CRC32,
+	veckernelsBENCH_KERNELS
+} VecKernelsBench_t;
+
+static const char * const pcBenchScalar[ veckernelsBENCH_KERNELS ] =
+{
+	"vec_kernels.memcpy_scalar",
+	"vec_kernels.minmax_scalar",
+	"vec_kernels.checksum_scalar",
+	"vec_kernels.fir_q15_scalar",
+	"vec_kernels.crc32_scalar"
+};
+
+static const char * const pcBenchVector[ veckernelsBENCH_KERNELS ] =
+{
+	"vec_kernels.memcpy_vector",
+	"vec_kernels.minmax_vector",
+	"vec_kernels.checksum_vector",
+	"vec_kernels.fir_q15_vector",
+	NULL
+};
+
+static uint8_t ucBenchSource[ veckernelsBENCH_SIZE + ( 2U * veckernelsBENCH_TAPS ) ] cachelayoutALIGNED;
+static uint8_t ucBenchDestination[ veckernelsBENCH_SIZE ] cachelayoutALIGNED;
+static uint8_t ucBenchReference[ veckernelsBENCH_SIZE ] cachelayoutALIGNED;
+static int16_t sBenchTaps[ veckernelsBENCH_TAPS ];
+static VecContext_t xBenchContext;
+
+/* The dispatching calls go the vector way, as the benchmark task is
+enabled. */
+static void prvBenchKernel( VecKernelsBench_t eKernel, size_t xLength, BaseType_t xVector )
+{
+const int32_t *plValues = ( const int32_t * ) ucBenchSource;
+const int16_t *psSamples = ( const int16_t * ) ucBenchSource;
+int16_t *psFiltered = ( int16_t * ) ucBenchDestination;
+size_t xCount;
+int32_t lMin, lMax;
+volatile uint32_t ulSink;
+
+	switch( eKernel )
+	{
+		case veckernelsBENCH_MEMCPY:
+			if( xVector != pdFALSE )
+			{
+				vVecKernelsMemcpy( ucBenchDestination, ucBenchSource, xLength );
+			}
+			else
+			{
+				prvMemcpyScalar( ucBenchDestination, ucBenchSource, xLength );
+			}
+			break;
+
+		case veckernelsBENCH_MINMAX:
+			xCount = xLength / sizeof( int32_t );
+
+			if( xVector != pdFALSE )
+			{
+				vVecKernelsMinMax( plValues, xCount, &lMin, &lMax );
+			}
+			else
+			{
+				prvMinMaxScalar( plValues, xCount, &lMin, &lMax );
+			}
+
+			ulSink = ( uint32_t ) ( lMin ^ lMax );
+			break;
+
+		case veckernelsBENCH_CHECKSUM:
+			ulSink = ( xVector != pdFALSE ) ? ulVecKernelsChecksum( ucBenchSource, xLength ) : prvChecksumScalar( ucBenchSource, xLength );
+			break;
+
+		case veckernelsBENCH_FIR_Q15:
+			xCount = xLength / sizeof( int16_t );
+
+			if( xVector != pdFALSE )
+			{
+				vVecKernelsFirQ15( psSamples, psFiltered, xCount, sBenchTaps, veckernelsBENCH_TAPS );
+			}
+			else
+			{
+				prvFirQ15Scalar( psSamples, psFiltered, xCount, sBenchTaps, veckernelsBENCH_TAPS );
+			}
+			break;
+
+		default:
+			ulSink = ulVecKernelsCrc32( 0, ucBenchSource, xLength );
+			break;
+	}
+
+	( void ) ulSink;
+}
+
+static void prvBenchReport( const char *pcName, VecKernelsBench_t eKernel, size_t xLength, BaseType_t xVector )
+{
+uint64_t ullStart = ullTimestampCycles();
+uint32_t ulOperations = ( uint32_t ) xLength;
+
+	prvBenchKernel( eKernel, xLength, xVector );
+
+	if( eKernel == veckernelsBENCH_FIR_Q15 )
+	{
+		ulOperations /= sizeof( int16_t );
+	}
+
+	vBenchReport( pcName, ( uint32_t ) xLength, ullTimestampCycles() - ullStart, ulOperations );
+}
+
+void vVecKernelsBenchmark( void )
+{
+VecKernelsBench_t eKernel;
+BaseType_t xVector;
+size_t xLength;
+uint32_t ul;
+size_t xCount;
+int32_t lMin, lMax, lScalarMin, lScalarMax;
+
+	for( ul = 0; ul < sizeof( ucBenchSource ); ul++ )
+	{
+		ucBenchSource[ ul ] = ( uint8_t ) ( ul * 7U );
+	}
+
+	for( ul = 0; ul < veckernelsBENCH_TAPS; ul++ )
+	{
+		sBenchTaps[ ul ] = ( int16_t ) ( 2048 - ( int32_t ) ( ul * 128U ) );
+	}
+
+	vVecKernelsTaskEnable( &xBenchContext );
+	xVector = prvUseVector();
+
+	if( xVector != pdFALSE )
+	{
+		/* Both ways must agree before they are compared. */
+		configASSERT( ulVecKernelsChecksum( ucBenchSource, veckernelsBENCH_SIZE ) == prvChecksumScalar( ucBenchSource, veckernelsBENCH_SIZE ) );
+		vVecKernelsMinMax( ( const int32_t * ) ucBenchSource, veckernelsBENCH_SIZE / sizeof( int32_t ), &lMin, &lMax );
+		prvMinMaxScalar( ( const int32_t * ) ucBenchSource, veckernelsBENCH_SIZE / sizeof( int32_t ), &lScalarMin, &lScalarMax );
+		configASSERT( ( lMin == lScalarMin ) && ( lMax == lScalarMax ) );
+
+		/* The rounding and saturation of the FIR (vwmacc, vnclip with
+		vxrm = 0), sample for sample. */
+		xCount = ( veckernelsBENCH_SIZE / sizeof( int16_t ) ) - veckernelsBENCH_ODD;
+		vVecKernelsFirQ15( ( const int16_t * ) ucBenchSource, ( int16_t * ) ucBenchDestination, xCount, sBenchTaps, veckernelsBENCH_TAPS );
+		prvFirQ15Scalar( ( const int16_t * ) ucBenchSource, ( int16_t * ) ucBenchReference, xCount, sBenchTaps, veckernelsBENCH_TAPS );
+		configASSERT( memcmp( ucBenchDestination, ucBenchReference, xCount * sizeof( int16_t ) ) == 0 );
+
+		/* The copy, and nothing past its end. */
+		xCount = veckernelsBENCH_SIZE - ( 2U * veckernelsBENCH_ODD );
+		memset( ucBenchDestination, 0, veckernelsBENCH_SIZE );
+		vVecKernelsMemcpy( ucBenchDestination, &( ucBenchSource[ veckernelsBENCH_ODD ] ), xCount );
+		configASSERT( memcmp( ucBenchDestination, &( ucBenchSource[ veckernelsBENCH_ODD ] ), xCount ) == 0 );
+		configASSERT( ucBenchDestination[ xCount ] == 0U );
+	}
+
+	for( xLength = veckernelsBENCH_MIN; xLength <= veckernelsBENCH_SIZE; xLength *= 2U )
+	{
+		for( eKernel = veckernelsBENCH_MEMCPY; eKernel < veckernelsBENCH_KERNELS; eKernel++ )
+		{
+			prvBenchReport( pcBenchScalar[ eKernel ], eKernel, xLength, pdFALSE );
+
+			if( ( xVector != pdFALSE ) && ( pcBenchVector[ eKernel ] != NULL ) )
+			{
+				prvBenchReport( pcBenchVector[ eKernel ], eKernel, xLength, pdTRUE );
+			}
+		}
+	}
+
+	vVecKernelsTaskDisable();
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_VECTOR_KERNELS */
@@ -0,0 +1,99 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef VEC_KERNELS_H
+#define VEC_KERNELS_H
+
+/*
+ * Signal processing and buffer kernels on the RISC-V vector extension, with a
+ * scalar fallback.
+ *
+ * The vector versions are compiled with make VECTOR=1, which builds this
+ * file, and only this file, for V (the compiler defines __riscv_vector), and
+ * are used when misa reports V at vVecKernelsInit() and the calling task
+ * enabled the vector unit with vVecKernelsTaskEnable().  Otherwise each call
+ * runs the scalar loop, so the results are the same everywhere.
+ *
+ * The vector unit is off (mstatus.VS) in every task but the enabled ones, so
+ * only they have vector registers to switch.  The registers are switched
+ * lazily: they stay in the unit while tasks that do not use it run, and are
+ * saved to the VecContext_t of their owner only when another enabled task is
+ * switched in.  The port keeps mstatus in the context of each task, so a
+ * vector instruction in a task that is not enabled traps as an illegal
+ * instruction.
+ *
+ * An interrupt taken while an enabled task runs finds the unit on, with the
+ * live registers of the task, which are not saved on interrupt entry.  What
+ * keeps them intact is that no other code has vector instructions: the rest
+ * of the tree, libmetal and libc are built for a RISCV_ARCH without V (the
+ * Makefile refuses one with V), and this file is compiled without
+ * autovectorization and with the string functions left to libc.  Interrupt
+ * handlers must not call the kernels.
+ *
+ * CRC-32 has no vector version: without the carry-less multiply of Zvbc it
+ * remains the table lookup of block_ops.c (ulBlockOpsCrc32Update()).
+ *
+ *	static VecContext_t xVecContext;
+ *
+ *	vVecKernelsTaskEnable( &xVecContext );
+ *	vVecKernelsFirQ15( psSamples, psFiltered, xCount, psTaps, xTaps );
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#if( configUSE_VECTOR_KERNELS == 1 )
+
+/* The vector registers of an enabled task, while another enabled task owns
+the unit.  The members are private to vec_kernels.c. */
+typedef struct xVEC_CONTEXT
+{
+	uint8_t ucRegisters[ 32U * configVECTOR_VLENB_MAX ];
+	UBaseType_t uxVl;
+	UBaseType_t uxVtype;
+	UBaseType_t uxVcsr;
+	UBaseType_t uxVstart;
+} VecContext_t;
+
+/* Builds the CRC table and detects the vector unit.  Call once from main(),
+before the scheduler starts.  vlenb must not exceed configVECTOR_VLENB_MAX. */
+void vVecKernelsInit( void );
+
+/* pdTRUE if the vector kernels are compiled in and misa reports V. */
+BaseType_t xVecKernelsAvailable( void );
+
+/* Turns the vector unit on for the calling task, which keeps its registers in
+pxContext while it is switched out, until vVecKernelsTaskDisable().  The
+context must stay valid until then, and the task must call
+vVecKernelsTaskDisable() before it is deleted. */
+void vVecKernelsTaskEnable( VecContext_t *pxContext );
+void vVecKernelsTaskDisable( void );
+
+/* The kernels, called from tasks only. */
+void vVecKernelsMemcpy( void *pvDestination, const void *pvSource, size_t xLength );
+uint32_t ulVecKernelsCrc32( uint32_t ulCrc, const void *pvData, size_t xLength );
+
+/* The sum of the bytes, modulo 2^32. */
+uint32_t ulVecKernelsChecksum( const void *pvData, size_t xLength );
+
+/* The smallest and largest of xCount > 0 values. */
+void vVecKernelsMinMax( const int32_t *plValues, size_t xCount, int32_t *plMin, int32_t *plMax );
+
+/* psOutput[ n ] = sum( psTaps[ k ] * psInput[ n + k ] ), for n below xOutputs
+and k below xTaps > 0, in Q15: accumulated on 32 bits, rounded and saturated
+to 16 bits.  psInput holds xOutputs + xTaps - 1 samples, so store the taps
+reversed for a convolution. */
+void vVecKernelsFirQ15( const int16_t *psInput, int16_t *psOutput, size_t xOutputs, const int16_t *psTaps, size_t xTaps );
+
+/* Called from traceTASK_SWITCHED_IN() (trace_hooks.h). */
+void vVecKernelsSwitchedIn( void );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vVecKernelsBenchmark( void );
+#endif
+
+#endif /* configUSE_VECTOR_KERNELS */
+
+#endif /* VEC_KERNELS_H */
@@ -0,0 +1,494 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "work_steal.h"
+#include "cache_layout.h"
+#include "hart_launch.h"
+#include "hart_local.h"
+
+#include <metal/machine.h>
+
+#if( configUSE_WORK_STEAL == 1 )
+
+#if( ( configWORK_STEAL_DEQUE_SIZE & ( configWORK_STEAL_DEQUE_SIZE - 1 ) ) != 0 )
+	#error configWORK_STEAL_DEQUE_SIZE must be a power of two
+#endif
+
+#if( configUSE_BENCHMARKS == 1 )
+	#include "bench.h"
+#endif
+
+#define workstealMASK			( ( uintptr_t ) configWORK_STEAL_DEQUE_SIZE - 1U )
+
+#if( __riscv_xlen == 64 )
+	#define workstealLR		"lr.d.aq"
+	#define workstealSC		"sc.d.rl"
+#else
+	#define workstealLR		"lr.w.aq"
+	#define workstealSC		"sc.w.rl"
+#endif
+
+/* The top is moved by the thieves and the bottom by the owner, so each has
+a cache line of its own. */
+typedef struct xWORK_DEQUE
+{
+	struct cachelayoutALIGNED
+	{
+		volatile uintptr_t uxTop;
+	} xThieves;
+
+	struct cachelayoutALIGNED
+	{
+		volatile uintptr_t uxBottom;
+		uint32_t ulSeed;					/* Picks the victims. */
+		WorkJob_t * volatile pxJobs[ configWORK_STEAL_DEQUE_SIZE ];
+	} xOwner;
+} WorkDeque_t;
+
+static WorkDeque_t xDeques[ __METAL_DT_MAX_HARTS ];
+
+static BaseType_t xLaunched[ __METAL_DT_MAX_HARTS ];
+static volatile uint32_t ulStop;
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvHartId( void )
+{
+#if( configUSE_HART_LOCAL == 1 )
+	return ulHartLocalId();
+#else
+uint32_t ulHartId;
+
+	__asm__ volatile( "csrr %0, mhartid" : "=r"( ulHartId ) );
+
+	return ulHartId;
+#endif
+}
+
+/* Stores uxDesired in *puxTarget if it holds uxExpected, see block_pool.c. */
+static inline BaseType_t prvCompareAndSwap( volatile uintptr_t *puxTarget, uintptr_t uxExpected, uintptr_t uxDesired )
+{
+uintptr_t uxPrevious;
+uintptr_t uxFailed;
+
+	__asm__ volatile(
+		"1:	" workstealLR "	%0, (%2)\n"
+		"	bne	%0, %3, 2f\n"
+		"	" workstealSC "	%1, %4, (%2)\n"
+		"	bnez	%1, 1b\n"
+		"2:\n"
+		: "=&r"( uxPrevious ), "=&r"( uxFailed )
+		: "r"( puxTarget ), "r"( uxExpected ), "r"( uxDesired )
+		: "memory" );
+
+	return ( uxPrevious == uxExpected ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+/* Owner only.  Returns pdFAIL if the deque is full. */
+static BaseType_t prvPush( WorkDeque_t *pxDeque, WorkJob_t *pxJob )
+{
+uintptr_t uxBottom = pxDeque->xOwner.uxBottom;
+
+	/* An old top only makes the deque look fuller than it is. */
+	if( ( uxBottom - pxDeque->xThieves.uxTop ) > workstealMASK )
+	{
+		return pdFAIL;
+	}
+
+	pxDeque->xOwner.pxJobs[ uxBottom & workstealMASK ] = pxJob;
+
+	/* Release: the job and its slot are written before the thieves see
+	them. */
+	__asm__ volatile( "fence rw, w" ::: "memory" );
+	pxDeque->xOwner.uxBottom = uxBottom + 1U;
+
+	return pdPASS;
+}
+
+/* Owner only.  The last job goes to whichever of the owner and a thief moves
+the top first. */
+static WorkJob_t *prvPop( WorkDeque_t *pxDeque )
+{
+uintptr_t uxBottom = pxDeque->xOwner.uxBottom - 1U;
+uintptr_t uxTop;
+WorkJob_t *pxJob;
+
+	pxDeque->xOwner.uxBottom = uxBottom;
+
+	/* The thieves must see the bottom taken before the top is read. */
+	__asm__ volatile( "fence rw, rw" ::: "memory" );
+	uxTop = pxDeque->xThieves.uxTop;
+
+	if( ( intptr_t ) ( uxBottom - uxTop ) < 0 )
+	{
+		/* Empty. */
+		pxDeque->xOwner.uxBottom = uxTop;
+		return NULL;
+	}
+
+	pxJob = pxDeque->xOwner.pxJobs[ uxBottom & workstealMASK ];
+
+	if( uxBottom != uxTop )
+	{
+		return pxJob;
+	}
+
+	if( prvCompareAndSwap( &( pxDeque->xThieves.uxTop ), uxTop, uxTop + 1U ) == pdFALSE )
+	{
+		pxJob = NULL;
+	}
+
+	pxDeque->xOwner.uxBottom = uxTop + 1U;
+
+	return pxJob;
+}
+
+/* Any hart.  NULL if the deque is empty or another thief won. */
+static WorkJob_t *prvSteal( WorkDeque_t *pxDeque )
+{
+uintptr_t uxTop = pxDeque->xThieves.uxTop;
+uintptr_t uxBottom;
+WorkJob_t *pxJob;
+
+	__asm__ volatile( "fence rw, rw" ::: "memory" );
+	uxBottom = pxDeque->xOwner.uxBottom;
+
+	if( ( intptr_t ) ( uxBottom - uxTop ) <= 0 )
+	{
+		return NULL;
+	}
+
+	/* Acquire: see the job pushed before the bottom. */
+	__asm__ volatile( "fence r, rw" ::: "memory" );
+	pxJob = pxDeque->xOwner.pxJobs[ uxTop & workstealMASK ];
+
+	if( prvCompareAndSwap( &( pxDeque->xThieves.uxTop ), uxTop, uxTop + 1U ) == pdFALSE )
+	{
+		return NULL;
+	}
+
+	return pxJob;
+}
+/*-----------------------------------------------------------*/
+
+/* The tasks of hart 0 share its deque, so they must not be switched in the
+middle of an operation. */
+static BaseType_t prvOwnerPush( uint32_t ulHartId, WorkJob_t *pxJob )
+{
+BaseType_t xReturn;
+
+	if( ulHartId != 0U )
+	{
+		return prvPush( &xDeques[ ulHartId ], pxJob );
+	}
+
+	taskENTER_CRITICAL();
+	{
+		xReturn = prvPush( &xDeques[ 0 ], pxJob );
+	}
+	taskEXIT_CRITICAL();
+
+	return xReturn;
+}
+
+static WorkJob_t *prvOwnerPop( uint32_t ulHartId )
+{
+WorkJob_t *pxJob;
+
+	if( ulHartId != 0U )
+	{
+		return prvPop( &xDeques[ ulHartId ] );
+	}
+
+	taskENTER_CRITICAL();
+	{
+		pxJob = prvPop( &xDeques[ 0 ] );
+	}
+	taskEXIT_CRITICAL();
+
+	return pxJob;
+}
+/*-----------------------------------------------------------*/
+
+/* A job of the own deque, or else one stolen from the others, starting at a
+random victim so that the thieves spread. */
+static WorkJob_t *prvFind( uint32_t ulHartId )
+{
+WorkDeque_t *pxOwn = &xDeques[ ulHartId ];
+WorkJob_t *pxJob = prvOwnerPop( ulHartId );
+uint32_t ulVictim;
+uint32_t ul;
+
+	if( pxJob != NULL )
+	{
+		return pxJob;
+	}
+
+	/* xorshift32. */
+	pxOwn->xOwner.ulSeed ^= pxOwn->xOwner.ulSeed << 13;
+	pxOwn->xOwner.ulSeed ^= pxOwn->xOwner.ulSeed >> 17;
+	pxOwn->xOwner.ulSeed ^= pxOwn->xOwner.ulSeed << 5;
+	ulVictim = pxOwn->xOwner.ulSeed % __METAL_DT_MAX_HARTS;
+
+	for( ul = 0; ( ul < __METAL_DT_MAX_HARTS ) && ( pxJob == NULL ); ul++ )
+	{
+		if( ulVictim != ulHartId )
+		{
+			pxJob = prvSteal( &xDeques[ ulVictim ] );
+		}
+
+		ulVictim = ( ulVictim + 1U ) % __METAL_DT_MAX_HARTS;
+	}
+
+	return pxJob;
+}
+
+static void prvRunJob( WorkJob_t *pxJob )
+{
+WorkGroup_t *pxGroup = pxJob->pxGroup;
+
+	pxJob->pxFunction( pxJob->pvArgument );
+
+	/* Release: the results are written before the join can see the job
+	done. */
+	__atomic_fetch_sub( &( pxGroup->ulPending ), 1U, __ATOMIC_RELEASE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWorker( void *pvArgument )
+{
+uint32_t ulHartId = prvHartId();
+WorkJob_t *pxJob;
+
+	( void ) pvArgument;
+
+	xDeques[ ulHartId ].xOwner.ulSeed = ulHartId + 1U;
+
+	while( ulStop == 0U )
+	{
+		pxJob = prvFind( ulHartId );
+
+		if( pxJob != NULL )
+		{
+			prvRunJob( pxJob );
+		}
+	}
+}
+
+uint32_t ulWorkStealStart( uint32_t ulMaxWorkers )
+{
+uint32_t ulHartId;
+uint32_t ulWorkers = 0;
+
+	ulStop = 0;
+	xDeques[ 0 ].xOwner.ulSeed = 1;
+
+	for( ulHartId = 1; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+	{
+		if( ( ulMaxWorkers != 0U ) && ( ulWorkers == ulMaxWorkers ) )
+		{
+			break;
+		}
+
+		/* xHartLaunch() publishes ulStop before the worker runs. */
+		xLaunched[ ulHartId ] = xHartLaunch( ulHartId, prvWorker, NULL );
+
+		if( xLaunched[ ulHartId ] == pdPASS )
+		{
+			ulWorkers++;
+		}
+	}
+
+	return ulWorkers;
+}
+
+void vWorkStealStop( void )
+{
+uint32_t ulHartId;
+
+	ulStop = 1;
+	__asm__ volatile( "fence rw, rw" ::: "memory" );
+
+	for( ulHartId = 1; ulHartId < __METAL_DT_MAX_HARTS; ulHartId++ )
+	{
+		while( ( xLaunched[ ulHartId ] == pdPASS ) && ( xHartLaunchIsIdle( ulHartId ) == pdFALSE ) )
+		{
+			vTaskDelay( 1 );
+		}
+
+		xLaunched[ ulHartId ] = pdFALSE;
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vWorkStealGroupInit( WorkGroup_t *pxGroup )
+{
+	pxGroup->ulPending = 0;
+}
+
+void vWorkStealFork( WorkGroup_t *pxGroup, WorkJob_t *pxJob, WorkFunction_t pxFunction, void *pvArgument )
+{
+	pxJob->pxFunction = pxFunction;
+	pxJob->pvArgument = pvArgument;
+	pxJob->pxGroup = pxGroup;
+
+	__atomic_fetch_add( &( pxGroup->ulPending ), 1U, __ATOMIC_RELAXED );
+
+	if( prvOwnerPush( prvHartId(), pxJob ) == pdFAIL )
+	{
+		prvRunJob( pxJob );
+	}
+}
+
+void vWorkStealJoin( WorkGroup_t *pxGroup )
+{
+uint32_t ulHartId = prvHartId();
+WorkJob_t *pxJob;
+
+	/* Acquire: see what the jobs wrote. */
+	while( __atomic_load_n( &( pxGroup->ulPending ), __ATOMIC_ACQUIRE ) != 0U )
+	{
+		pxJob = prvFind( ulHartId );
+
+		if( pxJob != NULL )
+		{
+			prvRunJob( pxJob );
+		}
+		else if( ulHartId == 0U )
+		{
+			taskYIELD();
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+typedef struct xWORK_RANGE
+{
+	uint32_t ulBegin;
+	uint32_t ulEnd;
+	uint32_t ulGrain;
+	WorkRangeFunction_t pxBody;
+	void *pvContext;
+} WorkRange_t;
+
+/* Forks the upper half and runs the lower one, down to the grain. */
+static void prvRange( void *pvArgument )
+{
+WorkRange_t *pxRange = ( WorkRange_t * ) pvArgument;
+WorkRange_t xLower;
+WorkRange_t xUpper;
+WorkGroup_t xGroup;
+WorkJob_t xJob;
+uint32_t ulMiddle;
+
+	if( ( pxRange->ulEnd - pxRange->ulBegin ) <= pxRange->ulGrain )
+	{
+		pxRange->pxBody( pxRange->pvContext, pxRange->ulBegin, pxRange->ulEnd );
+		return;
+	}
+
+	ulMiddle = pxRange->ulBegin + ( ( pxRange->ulEnd - pxRange->ulBegin ) / 2U );
+
+	xLower = *pxRange;
+	xLower.ulEnd = ulMiddle;
+	xUpper = *pxRange;
+	xUpper.ulBegin = ulMiddle;
+
+	vWorkStealGroupInit( &xGroup );
+	vWorkStealFork( &xGroup, &xJob, prvRange, &xUpper );
+	prvRange( &xLower );
+	vWorkStealJoin( &xGroup );
+}
+
+void vWorkStealParallelFor( uint32_t ulBegin, uint32_t ulEnd, uint32_t ulGrain, WorkRangeFunction_t pxBody, void *pvContext )
+{
+WorkRange_t xRange = { ulBegin, ulEnd, ( ulGrain > 0U ) ? ulGrain : 1U, pxBody, pvContext };
+
+	if( ulEnd > ulBegin )
+	{
+		prvRange( &xRange );
+	}
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_BENCHMARKS == 1 )
+
+/*
+ * A parallel for over workstealBENCH_ITEMS indexes of workstealBENCH_ROUNDS
+ * rounds of xorshift each, on hart 0 alone, then with one more worker at a
+ * time while there are idle harts (the -smp count under QEMU).  The parameter
+ * is the number of harts; the speedup is against hart 0 alone, in percent.
+ */
+#define workstealBENCH_ITEMS		( 4096U )
+#define workstealBENCH_GRAIN		( 64U )
+#define workstealBENCH_ROUNDS		( 64U )
+
+static void prvBenchBody( void *pvContext, uint32_t ulBegin, uint32_t ulEnd )
+{
+uint32_t ulSum = 0;
+uint32_t ulIndex;
+uint32_t ulValue;
+uint32_t ulRound;
+
+	for( ulIndex = ulBegin; ulIndex < ulEnd; ulIndex++ )
+	{
+		ulValue = ulIndex + 1U;
+
+		for( ulRound = 0; ulRound < workstealBENCH_ROUNDS; ulRound++ )
+		{
+			ulValue ^= ulValue << 13;
+			ulValue ^= ulValue >> 17;
+			ulValue ^= ulValue << 5;
+		}
+
+		ulSum += ulValue;
+	}
+
+	__atomic_fetch_add( ( uint32_t * ) pvContext, ulSum, __ATOMIC_RELAXED );
+}
+
+void vWorkStealBenchmark( void )
+{
+uint32_t ulHarts;
+uint32_t ulSum;
+uint32_t ulExpected = 0;
+uint64_t ullCycles;
+uint64_t ullAlone = 0;
+uint64_t ullStart;
+
+	for( ulHarts = 1; ulHarts <= __METAL_DT_MAX_HARTS; ulHarts++ )
+	{
+		if( ( ulHarts > 1U ) && ( ulWorkStealStart( ulHarts - 1U ) != ( ulHarts - 1U ) ) )
+		{
+			vWorkStealStop();
+			break;
+		}
+
+		ulSum = 0;
+		ullStart = ullTimestampCycles();
+		vWorkStealParallelFor( 0, workstealBENCH_ITEMS, workstealBENCH_GRAIN, prvBenchBody, &ulSum );
+		ullCycles = ullTimestampCycles() - ullStart;
+
+		vWorkStealStop();
+
+		if( ulHarts == 1U )
+		{
+			ullAlone = ullCycles;
+			ulExpected = ulSum;
+		}
+
+		configASSERT( ulSum == ulExpected );
+
+		vBenchReport( "work_steal.parallel_for", ulHarts, ullCycles, workstealBENCH_ITEMS );
+		vBenchReport( "work_steal.speedup_pct", ulHarts, ( ullAlone * 100U ) / ullCycles, 1 );
+	}
+}
+
+#endif /* configUSE_BENCHMARKS */
+
+#endif /* configUSE_WORK_STEAL */
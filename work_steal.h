@@ -0,0 +1,93 @@
+/* Copyright 2019 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef WORK_STEAL_H
+#define WORK_STEAL_H
+
+/*
+ * Work-stealing fork/join pool on the secondary harts.
+ *
+ * ulWorkStealStart() turns the harts parked in vHartLaunchSecondaryLoop() into
+ * workers.  Each hart, hart 0 included, owns a deque of jobs (Chase-Lev): it
+ * pushes the jobs it forks and pops them back at the bottom, while the idle
+ * harts steal from the top with LR/SC.  A burst of work forked from hart 0
+ * therefore spreads to the harts that are free, and a job that forks more
+ * keeps its own hart busy first.
+ *
+ * Fork and join are called from the tasks of hart 0 and from the jobs
+ * themselves.  A join runs the jobs it finds, its own first, until its group
+ * is done: on hart 0 it yields to the tasks of the same priority when there
+ * is nothing to run, but keeps the lower priorities out.  The jobs run on the
+ * small stacks of the harts and must not use the kernel API.  A fork that
+ * finds its deque full runs the job at once.
+ *
+ * The tasks of hart 0 share its deque, each push and pop in a critical
+ * section.  The workers poll for jobs until vWorkStealStop().
+ *
+ *	static void prvScale( void *pvContext, uint32_t ulBegin, uint32_t ulEnd );
+ *
+ *	ulWorkStealStart( 0 );
+ *	vWorkStealParallelFor( 0, 4096, 256, prvScale, pfSamples );
+ *	vWorkStealStop();
+ */
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#if( configUSE_WORK_STEAL == 1 )
+
+#if( configUSE_HART_LAUNCH != 1 )
+	#error The workers are launched on the secondary harts, set configUSE_HART_LAUNCH to 1
+#endif
+
+typedef void ( *WorkFunction_t )( void *pvArgument );
+
+/* Body of a parallel for, over [ ulBegin, ulEnd ). */
+typedef void ( *WorkRangeFunction_t )( void *pvContext, uint32_t ulBegin, uint32_t ulEnd );
+
+/* The jobs forked before a join.  The members are private to
+work_steal.c. */
+typedef struct xWORK_GROUP
+{
+	volatile uint32_t ulPending;
+} WorkGroup_t;
+
+/* The storage of a forked job, valid until its group is joined.  The members
+are private to work_steal.c. */
+typedef struct xWORK_JOB
+{
+	WorkFunction_t pxFunction;
+	void *pvArgument;
+	WorkGroup_t *pxGroup;
+} WorkJob_t;
+
+/* Launches a worker on each idle secondary hart, at most ulMaxWorkers, or
+all of them if 0.  Returns the number of workers. */
+uint32_t ulWorkStealStart( uint32_t ulMaxWorkers );
+
+/* Returns once the workers are back in vHartLaunchSecondaryLoop().  The
+groups must all have been joined. */
+void vWorkStealStop( void );
+
+void vWorkStealGroupInit( WorkGroup_t *pxGroup );
+
+/* Queues pxFunction( pvArgument ) in pxGroup, using pxJob as storage. */
+void vWorkStealFork( WorkGroup_t *pxGroup, WorkJob_t *pxJob, WorkFunction_t pxFunction, void *pvArgument );
+
+/* Runs jobs until every job of pxGroup has run. */
+void vWorkStealJoin( WorkGroup_t *pxGroup );
+
+/* Calls pxBody on ranges of ulGrain indexes or fewer covering
+[ ulBegin, ulEnd ), in parallel, and returns once all have run.  The range is
+split in halves, so the stack of a hart needs about log2( count / ulGrain )
+frames of a few dozen bytes. */
+void vWorkStealParallelFor( uint32_t ulBegin, uint32_t ulEnd, uint32_t ulGrain, WorkRangeFunction_t pxBody, void *pvContext );
+
+#if( configUSE_BENCHMARKS == 1 )
+	void vWorkStealBenchmark( void );
+#endif
+
+#endif /* configUSE_WORK_STEAL */
+
+#endif /* WORK_STEAL_H */